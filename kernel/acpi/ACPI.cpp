@@ -0,0 +1,174 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later */
+/* Copyright © 2016-2023 Byteduck */
+
+#include "ACPI.h"
+#include "../memory/MemoryManager.h"
+#include "../memory/VMRegion.h"
+#include "../kstd/KLog.h"
+
+#define BIOS_EBDA_POINTER 0x40E
+#define BIOS_AREA_START 0xE0000
+#define BIOS_AREA_END 0x100000
+
+namespace ACPI {
+	static bool s_present = false;
+	static MADTInfo s_madt;
+
+	/** Maps a physical range into kernel space, and sets ptr to the virtual address of its start. **/
+	static kstd::Arc<VMRegion> map_physical(PhysicalAddress address, size_t size, uint8_t*& ptr) {
+		PhysicalAddress page = (address / PAGE_SIZE) * PAGE_SIZE;
+		auto region = MM.alloc_mapped_region(page, (address - page) + size);
+		ptr = (uint8_t*) (region->start() + (address - page));
+		return region;
+	}
+
+	static bool signature_matches(const void* data, const char* signature, size_t length) {
+		for(size_t i = 0; i < length; i++)
+			if(((const char*) data)[i] != signature[i])
+				return false;
+		return true;
+	}
+
+	/** Searches for a valid RSDP in a range on 16-byte boundaries, returning its offset or -1 if not found. **/
+	static ssize_t find_rsdp(const uint8_t* start, size_t length) {
+		for(size_t offset = 0; offset + sizeof(RSDP) <= length; offset += 16) {
+			if(signature_matches(start + offset, ACPI_RSDP_SIGNATURE, 8) && checksum_valid(start + offset, sizeof(RSDP)))
+				return (ssize_t) offset;
+		}
+		return -1;
+	}
+
+	static PhysicalAddress find_rsdt() {
+		uint8_t* ptr;
+
+		// The first kilobyte of the EBDA, whose segment is stored in the BIOS data area
+		PhysicalAddress ebda;
+		{
+			auto bda_region = map_physical(BIOS_EBDA_POINTER, sizeof(uint16_t), ptr);
+			ebda = ((PhysicalAddress) *(uint16_t*) ptr) << 4;
+		}
+		if(ebda) {
+			auto ebda_region = map_physical(ebda, 1024, ptr);
+			auto offset = find_rsdp(ptr, 1024);
+			if(offset >= 0)
+				return ((RSDP*) (ptr + offset))->rsdt_address;
+		}
+
+		// The BIOS read-only memory area
+		auto bios_region = map_physical(BIOS_AREA_START, BIOS_AREA_END - BIOS_AREA_START, ptr);
+		auto offset = find_rsdp(ptr, BIOS_AREA_END - BIOS_AREA_START);
+		if(offset >= 0)
+			return ((RSDP*) (ptr + offset))->rsdt_address;
+
+		return 0;
+	}
+
+	/** Maps a whole table given its physical address, or returns a null region if its checksum is invalid. **/
+	static kstd::Arc<VMRegion> map_table(PhysicalAddress address, SDTHeader*& table) {
+		uint8_t* ptr;
+		size_t length;
+		{
+			auto header_region = map_physical(address, sizeof(SDTHeader), ptr);
+			length = ((SDTHeader*) ptr)->length;
+		}
+		if(length < sizeof(SDTHeader))
+			return {};
+		auto region = map_physical(address, length, ptr);
+		if(!checksum_valid(ptr, length))
+			return {};
+		table = (SDTHeader*) ptr;
+		return region;
+	}
+
+	static void parse_madt(const MADT& madt) {
+		s_madt.lapic_address = madt.lapic_address;
+
+		size_t entries_length = madt.header.length - sizeof(MADT);
+		size_t offset = 0;
+		while(offset + sizeof(MADTEntry) <= entries_length) {
+			auto& entry = *(const MADTEntry*) &madt.entries[offset];
+			if(entry.length < sizeof(MADTEntry) || offset + entry.length > entries_length)
+				break;
+
+			switch(entry.type) {
+				case MADT_ENTRY_LAPIC: {
+					auto& lapic = (const MADTLocalAPIC&) entry;
+					if(lapic.flags & (MADT_LAPIC_ENABLED | MADT_LAPIC_ONLINE_CAPABLE))
+						s_madt.processors.push_back({lapic.processor_id, lapic.apic_id});
+					break;
+				}
+				case MADT_ENTRY_IOAPIC: {
+					auto& ioapic = (const MADTIOAPIC&) entry;
+					s_madt.ioapics.push_back({ioapic.ioapic_id, ioapic.address, ioapic.gsi_base});
+					break;
+				}
+				case MADT_ENTRY_INTERRUPT_OVERRIDE: {
+					auto& iso = (const MADTInterruptOverride&) entry;
+					s_madt.overrides.push_back({iso.source, iso.gsi, iso.flags});
+					break;
+				}
+				default:
+					break;
+			}
+
+			offset += entry.length;
+		}
+	}
+
+	bool init() {
+		auto rsdt_address = find_rsdt();
+		if(!rsdt_address) {
+			KLog::warn("ACPI", "Couldn't find the RSDP, assuming a single processor.");
+			return false;
+		}
+
+		SDTHeader* rsdt;
+		auto rsdt_region = map_table(rsdt_address, rsdt);
+		if(!rsdt_region) {
+			KLog::warn("ACPI", "The RSDT is invalid, assuming a single processor.");
+			return false;
+		}
+
+		size_t num_tables = (rsdt->length - sizeof(SDTHeader)) / sizeof(uint32_t);
+		auto* table_addresses = (uint32_t*) (rsdt + 1);
+		for(size_t i = 0; i < num_tables; i++) {
+			SDTHeader* table;
+			auto table_region = map_table(table_addresses[i], table);
+			if(!table_region || !signature_matches(table->signature, ACPI_MADT_SIGNATURE, 4))
+				continue;
+			parse_madt(*(MADT*) table);
+			s_present = true;
+			break;
+		}
+
+		if(!s_present) {
+			KLog::warn("ACPI", "Couldn't find the MADT, assuming a single processor.");
+			return false;
+		}
+
+		KLog::dbg("ACPI", "Found %d processor(s) and %d I/O APIC(s), local APIC at 0x%x",
+				  s_madt.processors.size(), s_madt.ioapics.size(), s_madt.lapic_address);
+		for(size_t i = 0; i < s_madt.processors.size(); i++)
+			KLog::dbg("ACPI", "Processor %d has local APIC ID %d", s_madt.processors[i].processor_id, s_madt.processors[i].apic_id);
+		return true;
+	}
+
+	bool present() {
+		return s_present;
+	}
+
+	const MADTInfo& madt() {
+		return s_madt;
+	}
+
+	size_t num_processors() {
+		return s_present && !s_madt.processors.empty() ? s_madt.processors.size() : 1;
+	}
+
+	bool checksum_valid(const void* table, size_t length) {
+		uint8_t sum = 0;
+		for(size_t i = 0; i < length; i++)
+			sum += ((const uint8_t*) table)[i];
+		return sum == 0;
+	}
+}
@@ -0,0 +1,122 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later */
+/* Copyright © 2016-2023 Byteduck */
+
+#pragma once
+
+#include "../kstd/vector.hpp"
+#include "../kstd/Arc.h"
+#include "../memory/Memory.h"
+
+#define ACPI_RSDP_SIGNATURE "RSD PTR "
+#define ACPI_MADT_SIGNATURE "APIC"
+
+#define MADT_ENTRY_LAPIC 0
+#define MADT_ENTRY_IOAPIC 1
+#define MADT_ENTRY_INTERRUPT_OVERRIDE 2
+#define MADT_LAPIC_ENABLED 0x1
+#define MADT_LAPIC_ONLINE_CAPABLE 0x2
+
+class VMRegion;
+
+namespace ACPI {
+	struct RSDP {
+		char signature[8];
+		uint8_t checksum;
+		char oem_id[6];
+		uint8_t revision;
+		uint32_t rsdt_address;
+	} __attribute__((packed));
+
+	struct SDTHeader {
+		char signature[4];
+		uint32_t length;
+		uint8_t revision;
+		uint8_t checksum;
+		char oem_id[6];
+		char oem_table_id[8];
+		uint32_t oem_revision;
+		uint32_t creator_id;
+		uint32_t creator_revision;
+	} __attribute__((packed));
+
+	struct MADT {
+		SDTHeader header;
+		uint32_t lapic_address;
+		uint32_t flags;
+		uint8_t entries[];
+	} __attribute__((packed));
+
+	struct MADTEntry {
+		uint8_t type;
+		uint8_t length;
+	} __attribute__((packed));
+
+	struct MADTLocalAPIC {
+		MADTEntry entry;
+		uint8_t processor_id;
+		uint8_t apic_id;
+		uint32_t flags;
+	} __attribute__((packed));
+
+	struct MADTIOAPIC {
+		MADTEntry entry;
+		uint8_t ioapic_id;
+		uint8_t reserved;
+		uint32_t address;
+		uint32_t gsi_base;
+	} __attribute__((packed));
+
+	struct MADTInterruptOverride {
+		MADTEntry entry;
+		uint8_t bus;
+		uint8_t source;
+		uint32_t gsi;
+		uint16_t flags;
+	} __attribute__((packed));
+
+	/** A processor described by the MADT. **/
+	struct Processor {
+		uint8_t processor_id;
+		uint8_t apic_id;
+	};
+
+	struct IOAPIC {
+		uint8_t id;
+		PhysicalAddress address;
+		uint32_t gsi_base;
+	};
+
+	/** An ISA IRQ that is wired to a different global system interrupt than its number. **/
+	struct InterruptOverride {
+		uint8_t irq;
+		uint32_t gsi;
+		uint16_t flags;
+	};
+
+	/** The interrupt topology of the machine, as described by the MADT. **/
+	struct MADTInfo {
+		PhysicalAddress lapic_address = 0;
+		kstd::vector<Processor> processors;
+		kstd::vector<IOAPIC> ioapics;
+		kstd::vector<InterruptOverride> overrides;
+	};
+
+	/**
+	 * Searches the BIOS memory areas for the RSDP and parses the MADT, if there is one. Must be called after paging is
+	 * set up, since the tables are mapped into kernel space to be read.
+	 * @return Whether a valid MADT was found.
+	 */
+	bool init();
+
+	/** Whether init() found a valid MADT. **/
+	bool present();
+
+	/** The information parsed from the MADT. Only valid if present() is true. **/
+	const MADTInfo& madt();
+
+	/** The number of usable processors, which is 1 if there is no MADT. **/
+	size_t num_processors();
+
+	/** Checks that the bytes of a table add up to zero. **/
+	bool checksum_valid(const void* table, size_t length);
+}
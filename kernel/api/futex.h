@@ -0,0 +1,13 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later */
+/* Copyright © 2016-2023 Byteduck */
+
+#pragma once
+
+#include "types.h"
+
+__DECL_BEGIN
+
+#define FUTEX_WAIT 1
+#define FUTEX_WAKE 2
+
+__DECL_END
@@ -15,4 +15,7 @@
 #define TIOCGWINSZ	10
 #define TIOCNOTTY	11
 #define TIOSGFX		12
-#define TIOSNOGFX	13
\ No newline at end of file
+#define TIOSNOGFX	13
+#define FIONREAD	14
+#define PIPEGETSZ	15
+#define PIPESETSZ	16
\ No newline at end of file
@@ -0,0 +1,18 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later */
+/* Copyright © 2016-2023 Byteduck */
+
+#pragma once
+
+#include "types.h"
+
+__DECL_BEGIN
+
+#define PRIO_PROCESS 0
+#define PRIO_PGRP 1
+#define PRIO_USER 2
+
+// Nice values range from PRIO_MIN (highest priority) to PRIO_MAX - 1 (lowest priority)
+#define PRIO_MIN (-20)
+#define PRIO_MAX 20
+
+__DECL_END
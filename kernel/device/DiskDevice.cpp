@@ -19,15 +19,72 @@
 
 #include <kernel/memory/PageDirectory.h>
 #include <kernel/kstd/cstring.h>
+#include <kernel/kstd/utility.h>
 #include <kernel/memory/MemoryManager.h>
+#include <kernel/tasking/TaskManager.h>
+#include <kernel/time/TimeManager.h>
+#include <kernel/CommandLine.h>
+#include <kernel/tasking/BooleanBlocker.h>
 #include "DiskDevice.h"
 #include "kernel/kstd/KLog.h"
 
 size_t DiskDevice::s_used_cache_memory = 0;
+Atomic<size_t> DiskDevice::s_dirty_regions = 0;
+Atomic<size_t> DiskDevice::s_read_ahead_hits = 0;
+Atomic<size_t> DiskDevice::s_read_ahead_misses = 0;
+Atomic<size_t> DiskDevice::s_read_ahead_wasted = 0;
+Atomic<size_t> DiskDevice::s_read_ahead_prefetched = 0;
 kstd::vector<DiskDevice*> DiskDevice::s_disk_devices;
 SpinLock DiskDevice::s_disk_devices_lock;
 
+// Write-back settings. These can be changed with the disk_write_through, disk_flush_interval (in ms) and
+// disk_dirty_threshold (in pages) kernel command line options.
+static bool s_write_through = false;
+static long s_flush_interval = DISK_DEFAULT_FLUSH_INTERVAL;
+static size_t s_dirty_threshold = DISK_DEFAULT_DIRTY_THRESHOLD;
+static volatile bool s_flush_requested = false;
+static UninterruptibleBooleanBlocker s_prefetch_blocker;
+
+class DiskDevice::CacheLoadBlocker: public Blocker {
+public:
+	explicit CacheLoadBlocker(kstd::Arc<BlockCacheRegion> region): m_region(kstd::move(region)) {}
+	bool is_ready() override { return !m_region->loading; }
+	bool can_be_interrupted() override { return false; }
+
+private:
+	kstd::Arc<BlockCacheRegion> m_region;
+};
+
+class DiskFlushBlocker: public Blocker {
+public:
+	explicit DiskFlushBlocker(Time deadline): m_deadline(deadline) {}
+	bool is_ready() override { return s_flush_requested || Time::now() >= m_deadline; }
+	bool can_be_interrupted() override { return false; }
+	// Flush requests are signalled with notify_io(), so we don't need to keep the timer ticking while idle
+	WakeMode wake_mode() override { return WakeMode::IOEvent; }
+	Time wake_time() override { return m_deadline; }
+
+private:
+	Time m_deadline;
+};
+
+void kdiskflush_entry() {
+	DiskDevice::flusher_loop();
+}
+
+void kdiskprefetch_entry() {
+	DiskDevice::prefetcher_loop();
+}
+
 DiskDevice::DiskDevice(unsigned int major, unsigned int minor): BlockDevice(major, minor) {
+	auto& cmd_line = CommandLine::inst();
+	s_write_through = cmd_line.has_option("disk_write_through");
+	if(cmd_line.has_option("disk_flush_interval"))
+		s_flush_interval = max(atoi((char*) cmd_line.get_option_value("disk_flush_interval").c_str()), 1);
+	if(cmd_line.has_option("disk_dirty_threshold"))
+		s_dirty_threshold = max(atoi((char*) cmd_line.get_option_value("disk_dirty_threshold").c_str()), 1);
+
+	LOCK(s_disk_devices_lock);
 	s_disk_devices.push_back(this);
 }
 
@@ -42,38 +99,219 @@ DiskDevice::~DiskDevice() {
 };
 
 Result DiskDevice::read_blocks(uint32_t start_block, uint32_t count, uint8_t* buffer) {
-	kstd::Arc<BlockCacheRegion> cache_region;
-	for(size_t i = 0; i < count; i++) {
-		size_t block = start_block + i;
-		if(!cache_region || !cache_region->has_block(block))
-			cache_region = get_cache_region(block);
-		LOCK(cache_region->lock);
-		cache_region->last_used = Time::now();
-		memcpy(buffer + i * block_size(), cache_region->block_data(block), block_size());
-	}
+	ssize_t nread = read_cached(start_block * block_size(), KernelPointer<uint8_t>(buffer), count * block_size());
+	if(nread < 0)
+		return Result(nread);
 	return Result(SUCCESS);
 }
 
 Result DiskDevice::write_blocks(uint32_t start_block, uint32_t count, const uint8_t* buffer) {
-	kstd::Arc<BlockCacheRegion> cache_region;
-	for(size_t i = 0; i < count; i++) {
-		size_t block = start_block + i;
-		if(!cache_region || !cache_region->has_block(block))
-			cache_region = get_cache_region(block);
-		LOCK(cache_region->lock);
-		cache_region->last_used = Time::now();
-		cache_region->dirty = true;
-		memcpy(cache_region->block_data(block), buffer + i * block_size(), block_size());
+	ssize_t nwrote = write_cached(start_block * block_size(), KernelPointer<uint8_t>((uint8_t*) buffer), count * block_size());
+	if(nwrote < 0)
+		return Result(nwrote);
+	if(s_write_through)
+		return flush();
+	return Result(SUCCESS);
+}
+
+ssize_t DiskDevice::read(FileDescriptor& fd, size_t offset, SafePointer<uint8_t> buffer, size_t count) {
+	return read_cached(offset, buffer, count);
+}
+
+ssize_t DiskDevice::write(FileDescriptor& fd, size_t offset, SafePointer<uint8_t> buffer, size_t count) {
+	ssize_t nwrote = write_cached(offset, buffer, count);
+	if(nwrote < 0 || !s_write_through)
+		return nwrote;
+	auto res = flush();
+	if(res.is_error())
+		return res.code();
+	return nwrote;
+}
+
+void DiskDevice::prefetch(size_t offset, size_t count) {
+	if(!count)
+		return;
+
+	size_t first_region = block_cache_region_start(offset / block_size());
+	size_t last_region = block_cache_region_start((offset + count - 1) / block_size());
+	PrefetchRequest request = {first_region, (last_region - first_region) / blocks_per_cache_region() + 1};
+	{
+		LOCK(_prefetch_lock);
+		if(!_prefetch_queue.push_back(request))
+			return;
+	}
+	s_prefetch_blocker.set_ready(true);
+}
+
+ResultRet<PageIndex> DiskDevice::share_cache_page(size_t offset) {
+	if(offset % PAGE_SIZE)
+		return Result(-EINVAL);
+
+	while(true) {
+		auto region = TRY(get_cache_region(offset / block_size()));
+
+		// The page is referenced while holding the cache lock, so that it can't be evicted in between. If it was evicted
+		// before we got here, try again so that we don't share a page that isn't in the cache anymore.
+		LOCK(_cache_lock);
+		auto cached_region = _cache_regions.find(region->start_block);
+		if(!cached_region || cached_region->get() != region.get())
+			continue;
+		{
+			LOCK(region->lock);
+			region->last_used = Time::now();
+		}
+		auto& page = region->region->object()->physical_page(0);
+		page.ref();
+		return page.index();
+	}
+}
+
+void DiskDevice::mark_cache_page_dirty(size_t offset, PageIndex page) {
+	if(offset % PAGE_SIZE)
+		return;
+
+	kstd::Arc<BlockCacheRegion> region;
+	{
+		LOCK(_cache_lock);
+		auto cached_region = _cache_regions.find(offset / block_size());
+		if(!cached_region || (*cached_region)->region->object()->physical_page(0).index() != page)
+			return;
+		region = *cached_region;
+	}
+
+	bool newly_dirty;
+	{
+		LOCK(region->lock);
+		region->last_used = Time::now();
+		newly_dirty = !region->dirty;
+		region->dirty = true;
+	}
+	if(newly_dirty)
+		mark_dirty(region);
+}
+
+Result DiskDevice::sync() {
+	return flush();
+}
+
+void DiskDevice::unshare_cache(size_t offset, size_t count) {
+	if(!count)
+		return;
+
+	size_t first_region = block_cache_region_start(offset / block_size());
+	size_t last_region = block_cache_region_start((offset + count - 1) / block_size());
+	for(size_t start_block = first_region; start_block <= last_region; start_block += blocks_per_cache_region()) {
+		kstd::Arc<BlockCacheRegion> region;
+		{
+			LOCK(_cache_lock);
+			if(!_cache_regions.contains(start_block))
+				continue;
+			region = *_cache_regions.find(start_block);
+		}
+		if(region->loading || !region->is_shared())
+			continue;
+
+		// The rest of the page may hold blocks that are still in use, so write it out before dropping it. If that fails,
+		// keep it cached so the data isn't lost.
+		if(write_back_region(region).is_error())
+			continue;
+
+		LOCK(_cache_lock);
+		auto cached_region = _cache_regions.find(start_block);
+		if(!cached_region || cached_region->get() != region.get())
+			continue;
+		{
+			LOCK(region->lock);
+			if(region->dirty)
+				continue;
+		}
+		if(region->prefetched)
+			s_read_ahead_wasted.add(1);
+		s_used_cache_memory -= PAGE_SIZE;
+		_cache_regions.erase(start_block);
 	}
+}
 
-	//TODO: Flush cached writes to disk periodically instead of on every write
-	return write_uncached_blocks(start_block, count, buffer);
+ssize_t DiskDevice::read_cached(size_t offset, SafePointer<uint8_t> buffer, size_t count) {
+	if(!count)
+		return 0;
+
+	size_t last_page = (offset + count - 1) / PAGE_SIZE;
+	size_t nread = 0;
+	while(nread < count) {
+		size_t pos = offset + nread;
+		auto region_res = get_cache_region(pos / block_size(), last_page - pos / PAGE_SIZE);
+		if(region_res.is_error())
+			return region_res.code();
+		auto& region = region_res.value();
+
+		{
+			LOCK(region->lock);
+			region->last_used = Time::now();
+		}
+
+		// Copy straight out of the cache page, as much of it as the read covers. This is done without holding the
+		// region's lock since the buffer may be in userspace and need to be faulted in.
+		size_t region_offset = pos - region->start_block * block_size();
+		size_t to_copy = min(PAGE_SIZE - region_offset, count - nread);
+		buffer.write((uint8_t*) region->region->start() + region_offset, nread, to_copy);
+		nread += to_copy;
+	}
+
+	return nread;
+}
+
+ssize_t DiskDevice::write_cached(size_t offset, SafePointer<uint8_t> buffer, size_t count) {
+	if(!count)
+		return 0;
+
+	size_t last_page = (offset + count - 1) / PAGE_SIZE;
+	size_t nwrote = 0;
+	while(nwrote < count) {
+		size_t pos = offset + nwrote;
+		auto region_res = get_cache_region(pos / block_size(), last_page - pos / PAGE_SIZE);
+		if(region_res.is_error())
+			return region_res.code();
+		auto& region = region_res.value();
+
+		// The region is only marked dirty after the copy, so a flush that races with it will be followed by another
+		size_t region_offset = pos - region->start_block * block_size();
+		size_t to_copy = min(PAGE_SIZE - region_offset, count - nwrote);
+		buffer.read((uint8_t*) region->region->start() + region_offset, nwrote, to_copy);
+		bool newly_dirty;
+		{
+			LOCK(region->lock);
+			region->last_used = Time::now();
+			newly_dirty = !region->dirty;
+			region->dirty = true;
+		}
+
+		// The region is queued for the flusher outside of its lock, since queueing it may need to allocate memory
+		if(newly_dirty)
+			mark_dirty(region);
+		nwrote += to_copy;
+	}
+
+	return nwrote;
 }
 
 size_t DiskDevice::used_cache_memory() {
 	return s_used_cache_memory;
 }
 
+size_t DiskDevice::dirty_cache_memory() {
+	return s_dirty_regions.load() * PAGE_SIZE;
+}
+
+DiskDevice::ReadAheadStats DiskDevice::read_ahead_stats() {
+	return {
+		s_read_ahead_hits.load(),
+		s_read_ahead_misses.load(),
+		s_read_ahead_wasted.load(),
+		s_read_ahead_prefetched.load()
+	};
+}
+
 size_t DiskDevice::free_pages(size_t num_pages) {
 	size_t num_freed = 0;
 	LOCK(s_disk_devices_lock);
@@ -83,33 +321,61 @@ size_t DiskDevice::free_pages(size_t num_pages) {
 		Time lru_time = Time::distant_future();
 		kstd::Arc<BlockCacheRegion> lru_region;
 
-		// Find the device with the least recently used cache region
+		// Find the device with the least recently used cache region. Regions that are still being read in can't be freed
+		// yet, and regions shared with an inode's page cache wouldn't free anything since their pages are still mapped.
+		// Those are promoted as they're skipped, so each one is only scanned past once rather than on every eviction.
 		for(size_t i = 0; i < s_disk_devices.size(); i++) {
 			auto device = s_disk_devices[i];
 			LOCK_N(device->_cache_lock, device_lock);
-			if(device->_cache_regions.empty())
+			auto device_lru = device->_cache_regions.lru_matching([](const kstd::Arc<BlockCacheRegion>& region) {
+				return !region->loading && !region->is_shared();
+			});
+			if(!device_lru)
 				continue;
-			auto device_lru = device->_cache_regions.lru_unsafe();
-			auto time = device_lru.second->last_used;
-			if(time < lru_time) {
-				lru_time = time;
+			auto& region = device_lru.value().second;
+			if(region->last_used < lru_time) {
+				lru_time = region->last_used;
 				lru_device = device;
-				lru_region = device_lru.second;
+				lru_region = region;
 			}
 		}
 
 		if(!lru_region)
 			break;
 
-		// Flush it if necessary
-		if(lru_region->dirty)
-			lru_device->write_uncached_blocks(lru_region->start_block, lru_region->num_blocks(), (uint8_t*) lru_region->region->start());
+		// Flush it if necessary. Rather than writing just this region, all of the disk's dirty regions are flushed so that
+		// it's merged with any adjacent ones and the next evictions are less likely to have to wait on the disk. The flusher
+		// may have already taken the region though, so make sure it's actually been written before going on.
+		bool dirty;
+		{
+			LOCK_N(lru_region->lock, region_lock);
+			dirty = lru_region->dirty;
+		}
+		if(dirty) {
+			lru_device->flush();
+			if(lru_device->write_back_region(lru_region).is_error())
+				break;
+		}
 
-		// Free it
+		// Free it. The region may have been used or written to again since we looked, so remove it by key rather than
+		// pruning the LRU, and only if it's still the cached region for its blocks. If its page was shared or it was
+		// dirtied in the meantime, leave it be; we'll find something else to free next time around.
+		LOCK_N(lru_device->_cache_lock, device_lock);
+		auto start_block = lru_region->start_block;
+		auto cached_region = lru_device->_cache_regions.find(start_block);
+		if(!cached_region || cached_region->get() != lru_region.get() || lru_region->is_shared())
+			continue;
+		{
+			LOCK_N(lru_region->lock, region_lock);
+			if(lru_region->dirty)
+				continue;
+		}
 		num_freed += lru_region->region->size() / PAGE_SIZE;
 		s_used_cache_memory -= lru_region->region->size();
+		if(lru_region->prefetched)
+			s_read_ahead_wasted.add(1);
 		lru_region.reset();
-		lru_device->_cache_regions.prune(1);
+		lru_device->_cache_regions.erase(start_block);
 	}
 
 	if(num_freed != num_pages)
@@ -118,32 +384,305 @@ size_t DiskDevice::free_pages(size_t num_pages) {
 	return num_freed;
 }
 
-kstd::Arc<DiskDevice::BlockCacheRegion> DiskDevice::get_cache_region(size_t block) {
-	_cache_lock.acquire();
+Result DiskDevice::flush() {
+	// Take the list of dirty regions. Regions are only ever in this list while they're dirty, so they will be re-added
+	// by write_blocks if they're written to after we clean them.
+	kstd::vector<kstd::Arc<BlockCacheRegion>> dirty;
+	{
+		LOCK(_dirty_lock);
+		kstd::swap(dirty, _dirty_regions);
+	}
+
+	if(dirty.empty())
+		return Result(SUCCESS);
+
+	kstd::sort(dirty.storage(), dirty.storage() + dirty.size(), [](const kstd::Arc<BlockCacheRegion>& a, const kstd::Arc<BlockCacheRegion>& b) {
+		return a->start_block < b->start_block;
+	});
+
+	// Write out each run of adjacent regions at once
+	Result ret = Result(SUCCESS);
+	kstd::vector<kstd::Arc<BlockCacheRegion>> failed;
+	{
+		LOCK(_flush_lock);
+		size_t run_start = 0;
+		for(size_t i = 1; i <= dirty.size(); i++) {
+			if(i < dirty.size()
+				&& i - run_start < DISK_MAX_FLUSH_RUN_PAGES
+				&& dirty[i]->start_block == dirty[i - 1]->start_block + blocks_per_cache_region())
+				continue;
+			auto res = write_dirty_run(&dirty[run_start], i - run_start);
+			if(res.is_error()) {
+				ret = res;
+				for(size_t j = run_start; j < i; j++)
+					failed.push_back(dirty[j]);
+			}
+			run_start = i;
+		}
+	}
+
+	// Re-mark regions that failed to be written so that we try again later
+	for(auto& region : failed) {
+		bool newly_dirty;
+		{
+			LOCK(region->lock);
+			newly_dirty = !region->dirty;
+			region->dirty = true;
+		}
+		if(newly_dirty)
+			mark_dirty(region);
+	}
+
+	return ret;
+}
+
+Result DiskDevice::sync_all() {
+	kstd::vector<DiskDevice*> devices;
+	{
+		LOCK(s_disk_devices_lock);
+		devices = s_disk_devices;
+	}
+
+	Result ret = Result(SUCCESS);
+	for(auto device : devices) {
+		auto res = device->flush();
+		if(res.is_error())
+			ret = res;
+	}
+	return ret;
+}
+
+void DiskDevice::flusher_loop() {
+	while(true) {
+		Time interval = Time(s_flush_interval / 1000, (s_flush_interval % 1000) * 1000);
+		DiskFlushBlocker blocker(Time::now() + interval);
+		TaskManager::current_thread()->block(blocker);
+		s_flush_requested = false;
+		sync_all();
+	}
+}
+
+void DiskDevice::prefetcher_loop() {
+	while(true) {
+		TaskManager::current_thread()->block(s_prefetch_blocker);
+		s_prefetch_blocker.set_ready(false);
+
+		kstd::vector<DiskDevice*> devices;
+		{
+			LOCK(s_disk_devices_lock);
+			devices = s_disk_devices;
+		}
+		for(auto device : devices)
+			device->do_prefetches();
+	}
+}
+
+void DiskDevice::do_prefetches() {
+	while(true) {
+		PrefetchRequest request;
+		{
+			LOCK(_prefetch_lock);
+			if(_prefetch_queue.empty())
+				return;
+			request = _prefetch_queue.pop_front();
+
+			// Merge in any queued requests that overlap or directly follow this one
+			while(!_prefetch_queue.empty()) {
+				auto& next = _prefetch_queue.front();
+				size_t end_block = request.start_block + request.num_regions * blocks_per_cache_region();
+				if(next.start_block < request.start_block || next.start_block > end_block)
+					break;
+				size_t next_end_block = next.start_block + next.num_regions * blocks_per_cache_region();
+				if(next_end_block > end_block)
+					request.num_regions = (next_end_block - request.start_block) / blocks_per_cache_region();
+				_prefetch_queue.pop_front();
+			}
+		}
+
+		// Regions that are already cached are skipped, and each run of missing ones is read at once
+		for(size_t i = 0; i < request.num_regions; i++) {
+			size_t block = request.start_block + i * blocks_per_cache_region();
+			{
+				LOCK(_cache_lock);
+				if(_cache_regions.contains(block))
+					continue;
+			}
+			if(get_cache_region(block, request.num_regions - i - 1, true).is_error())
+				break;
+		}
+	}
+}
+
+void DiskDevice::request_flush() {
+	s_flush_requested = true;
+	TaskManager::notify_io();
+}
+
+void DiskDevice::mark_dirty(const kstd::Arc<BlockCacheRegion>& region) {
+	{
+		LOCK(_dirty_lock);
+		_dirty_regions.push_back(region);
+	}
+
+	if(s_dirty_regions.add(1) + 1 >= s_dirty_threshold)
+		request_flush();
+}
+
+Result DiskDevice::write_dirty_run(kstd::Arc<BlockCacheRegion>* regions, size_t count) {
+	ASSERT(_flush_lock.held_by_current_thread());
+	ASSERT(count <= DISK_MAX_FLUSH_RUN_PAGES);
+	VMRegion* pages[DISK_MAX_FLUSH_RUN_PAGES];
 
-	//See if we already have the block
-	auto reg_opt = _cache_regions.get(block_cache_region_start(block));
-	if(reg_opt) {
-		_cache_lock.release();
-		return reg_opt.value();
+	// Regions that were cleaned in the meantime (i.e. by being evicted) are skipped, which splits the run. The pages are
+	// written straight from the cache; since writers only mark a region dirty after they've changed it, anything written
+	// while we're doing this will be flushed again next time.
+	Result ret = Result(SUCCESS);
+	size_t first = 0;
+	while(first < count) {
+		size_t num_pages = 0;
+		while(first + num_pages < count) {
+			auto& region = regions[first + num_pages];
+			LOCK(region->lock);
+			if(!region->dirty)
+				break;
+			region->dirty = false;
+			s_dirty_regions.sub(1);
+			pages[num_pages++] = region->region.get();
+		}
+
+		if(num_pages) {
+			auto res = write_uncached_pages(regions[first]->start_block, pages, num_pages);
+			if(res.is_error()) {
+				KLog::err("DiskDevice", "Failed to flush %d blocks at block %d: %d", num_pages * blocks_per_cache_region(), regions[first]->start_block, res.code());
+				ret = res;
+			}
+		}
+
+		// Skip past the written regions and the clean region that ended the run
+		first += num_pages + 1;
 	}
 
-	//Create a new cache region
-	auto reg = kstd::Arc<BlockCacheRegion>::make(block_cache_region_start(block), block_size());
-	s_used_cache_memory += PAGE_SIZE;
-	reg->lock.acquire();
-	_cache_regions.insert(block_cache_region_start(block), reg);
+	return ret;
+}
+
+Result DiskDevice::write_back_region(const kstd::Arc<BlockCacheRegion>& region) {
+	// Taking the flush lock waits for any flush in progress, which may have taken the region already. If it did, the
+	// region won't be dirty anymore by the time we have the lock and it'll be skipped.
+	Result res = Result(SUCCESS);
+	{
+		LOCK(_flush_lock);
+		auto to_write = region;
+		res = write_dirty_run(&to_write, 1);
+	}
+
+	if(res.is_error()) {
+		bool newly_dirty;
+		{
+			LOCK(region->lock);
+			newly_dirty = !region->dirty;
+			region->dirty = true;
+		}
+		if(newly_dirty)
+			mark_dirty(region);
+	}
+	return res;
+}
+
+Result DiskDevice::read_uncached_pages(uint32_t block, VMRegion* const* pages, size_t num_pages) {
+	for(size_t i = 0; i < num_pages; i++) {
+		auto res = read_uncached_blocks(block + i * blocks_per_cache_region(), blocks_per_cache_region(), (uint8_t*) pages[i]->start());
+		if(res.is_error())
+			return res;
+	}
+	return Result(SUCCESS);
+}
+
+Result DiskDevice::write_uncached_pages(uint32_t block, VMRegion* const* pages, size_t num_pages) {
+	for(size_t i = 0; i < num_pages; i++) {
+		auto res = write_uncached_blocks(block + i * blocks_per_cache_region(), blocks_per_cache_region(), (const uint8_t*) pages[i]->start());
+		if(res.is_error())
+			return res;
+	}
+	return Result(SUCCESS);
+}
+
+ResultRet<kstd::Arc<DiskDevice::BlockCacheRegion>> DiskDevice::get_cache_region(size_t block, size_t num_following, bool prefetch) {
+	size_t start_block = block_cache_region_start(block);
+	kstd::Arc<BlockCacheRegion> cached_region;
+	kstd::Arc<BlockCacheRegion> regions[DISK_MAX_READ_RUN_PAGES];
+	size_t run_length = 1;
+
+	{
+		LOCK(_cache_lock);
+
+		//See if we already have the block
+		auto reg_ptr = _cache_regions.find(start_block);
+		if(reg_ptr) {
+			cached_region = *reg_ptr;
+			if(cached_region->prefetched && !prefetch) {
+				cached_region->prefetched = false;
+				s_read_ahead_hits.add(1);
+			}
+		} else {
+			//Find out how many of the following regions are missing too, so we can read them all in one go
+			size_t max_run_length = min(num_following + 1, (size_t) DISK_MAX_READ_RUN_PAGES);
+			while(run_length < max_run_length && !_cache_regions.contains(start_block + run_length * blocks_per_cache_region()))
+				run_length++;
+
+			//Create the new cache regions and put them in the cache in the loading state, so that anyone else who wants
+			//them waits for us to read them in
+			for(size_t i = 0; i < run_length; i++) {
+				regions[i] = kstd::Arc<BlockCacheRegion>::make(start_block + i * blocks_per_cache_region(), block_size());
+				regions[i]->loading = true;
+				regions[i]->prefetched = prefetch;
+				_cache_regions.insert(regions[i]->start_block, regions[i]);
+				s_used_cache_memory += PAGE_SIZE;
+			}
+		}
+	}
+
+	if(cached_region) {
+		//If someone else is still reading it in, wait for them instead of holding up the whole cache
+		if(cached_region->loading) {
+			CacheLoadBlocker blocker(cached_region);
+			TaskManager::current_thread()->block(blocker);
+		}
+		if(cached_region->load_error)
+			return Result(cached_region->load_error);
+		return cached_region;
+	}
+
+	//Read the blocks straight into them without holding the cache lock
+	VMRegion* pages[DISK_MAX_READ_RUN_PAGES];
+	for(size_t i = 0; i < run_length; i++)
+		pages[i] = regions[i]->region.get();
+	auto res = read_uncached_pages(start_block, pages, run_length);
+
+	if(res.is_error()) {
+		KLog::err("DiskDevice", "Failed to read %d blocks at block %d: %d", run_length * blocks_per_cache_region(), start_block, res.code());
+		LOCK(_cache_lock);
+		for(size_t i = 0; i < run_length; i++) {
+			_cache_regions.erase(regions[i]->start_block);
+			s_used_cache_memory -= PAGE_SIZE;
+		}
+	}
+
+	//Wake up anyone waiting on the regions
+	for(size_t i = 0; i < run_length; i++) {
+		regions[i]->load_error = res.code();
+		regions[i]->loading = false;
+	}
 
-	//Read the blocks into it
-	read_uncached_blocks(reg->start_block, blocks_per_cache_region(), (uint8_t*) reg->region->start());
+	if(res.is_error())
+		return res;
 
-	//TODO: Figure out how to read the block after releasing the cache lock so that other blocks can be used in the meantime
-	//(We cannot do this currently as that would result in acquiring / releasing locks in the wrong order)
-	reg->lock.release();
-	_cache_lock.release();
+	if(prefetch)
+		s_read_ahead_prefetched.add(run_length);
+	else
+		s_read_ahead_misses.add(run_length);
 
 	//Return the requested region
-	return reg;
+	return regions[0];
 }
 
 DiskDevice::BlockCacheRegion::BlockCacheRegion(size_t start_block, size_t block_size):
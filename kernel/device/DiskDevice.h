@@ -21,9 +21,25 @@
 
 #include <kernel/time/Time.h>
 #include <kernel/memory/MemoryManager.h>
+#include <kernel/Atomic.h>
+#include <kernel/kstd/circular_queue.hpp>
 #include "BlockDevice.h"
 #include "../kstd/LRUCache.h"
 
+/** The maximum number of cache pages that will be coalesced into a single write when flushing. **/
+#define DISK_MAX_FLUSH_RUN_PAGES 16
+/** The maximum number of uncached pages that will be read from the disk at once when a read spans several of them. **/
+#define DISK_MAX_READ_RUN_PAGES 16
+/** The default interval at which dirty cache regions are flushed to disk, in milliseconds. **/
+#define DISK_DEFAULT_FLUSH_INTERVAL 1000
+/** The default number of dirty cache pages after which a flush will be triggered early. **/
+#define DISK_DEFAULT_DIRTY_THRESHOLD 256
+/** The maximum number of pending prefetch requests per disk. Requests made while the queue is full are dropped. **/
+#define DISK_PREFETCH_QUEUE_SIZE 32
+
+void kdiskflush_entry();
+void kdiskprefetch_entry();
+
 class DiskDevice: public BlockDevice {
 public:
 	DiskDevice(unsigned major, unsigned minor);
@@ -32,14 +48,48 @@ public:
 	Result read_blocks(uint32_t block, uint32_t count, uint8_t *buffer) override final;
 	Result write_blocks(uint32_t block, uint32_t count, const uint8_t *buffer) override final;
 
+	//File
+	ssize_t read(FileDescriptor& fd, size_t offset, SafePointer<uint8_t> buffer, size_t count) override;
+	ssize_t write(FileDescriptor& fd, size_t offset, SafePointer<uint8_t> buffer, size_t count) override;
+	/** Queues the given range to be read into the cache in the background. **/
+	void prefetch(size_t offset, size_t count) override;
+	ResultRet<PageIndex> share_cache_page(size_t offset) override;
+	void mark_cache_page_dirty(size_t offset, PageIndex page) override;
+	Result sync() override;
+	void unshare_cache(size_t offset, size_t count) override;
+
 	virtual Result read_uncached_blocks(uint32_t block, uint32_t count, uint8_t *buffer) = 0;
 	virtual Result write_uncached_blocks(uint32_t block, uint32_t count, const uint8_t *buffer) = 0;
+	/**
+	 * Reads the blocks starting at the given block straight into a list of page-sized kernel regions, one after another.
+	 * Disks that can scatter/gather should override this; by default it reads each page separately.
+	 */
+	virtual Result read_uncached_pages(uint32_t block, VMRegion* const* pages, size_t num_pages);
+	/** Writes a list of page-sized kernel regions to the disk starting at the given block. See read_uncached_pages. **/
+	virtual Result write_uncached_pages(uint32_t block, VMRegion* const* pages, size_t num_pages);
 
 	static size_t used_cache_memory();
+	static size_t dirty_cache_memory();
 	/** Tries to free a number of pages from the cache. Returns the number of pages that could be freed. **/
 	static size_t free_pages(size_t num_pages);
 
+	/** Writes all dirty cache regions of this disk back to the disk. **/
+	Result flush();
+	/** Writes all dirty cache regions of every disk back to their disks. **/
+	static Result sync_all();
+
+	struct ReadAheadStats {
+		size_t hits; ///< Prefetched cache pages that were used afterwards.
+		size_t misses; ///< Cache pages that had to be read from the disk on demand.
+		size_t wasted; ///< Prefetched cache pages that were evicted without being used.
+		size_t prefetched; ///< Total cache pages that were prefetched.
+	};
+	static ReadAheadStats read_ahead_stats();
+
 private:
+	friend void kdiskflush_entry();
+	friend void kdiskprefetch_entry();
+	class CacheLoadBlocker;
 	class BlockCacheRegion {
 	public:
 		explicit BlockCacheRegion(size_t start_block, size_t block_size);
@@ -48,24 +98,67 @@ private:
 		inline bool has_block(size_t block) const { return block >= start_block && block < start_block + num_blocks(); }
 		inline size_t num_blocks() const { return PAGE_SIZE / block_size; }
 		inline uint8_t* block_data(size_t block) const { return (uint8_t*) (region->start() + block_size * (block - start_block)); }
+		/** Whether the region's page is also mapped by something else (i.e. an inode's page cache), so evicting it wouldn't free anything. **/
+		inline bool is_shared() const { return region->object()->physical_page(0).allocated.ref_count.load() > 1; }
 
 		kstd::Arc<VMRegion> region;
 		size_t block_size;
 		size_t start_block;
 		Time last_used = Time::now();
 		bool dirty = false;
+		bool prefetched = false; ///< Whether this region was prefetched and hasn't been used yet. Protected by _cache_lock.
+		volatile bool loading = false; ///< Whether this region is still being read in from the disk.
+		volatile int load_error = 0; ///< The error that occurred while reading this region in, if any.
 		SpinLock lock;
 	};
 
 	// Static
 	static SpinLock s_disk_devices_lock;
 	static size_t s_used_cache_memory;
+	static Atomic<size_t> s_dirty_regions;
+	static Atomic<size_t> s_read_ahead_hits, s_read_ahead_misses, s_read_ahead_wasted, s_read_ahead_prefetched;
 	static kstd::vector<DiskDevice*> s_disk_devices;
 
+	// Write-back
+	static void flusher_loop();
+	static void request_flush();
+	void mark_dirty(const kstd::Arc<BlockCacheRegion>& region);
+	Result write_dirty_run(kstd::Arc<BlockCacheRegion>* regions, size_t count);
+	/**
+	 * Writes a region back to the disk if it's dirty. If a flush that already took the region is in progress, this waits
+	 * for it to finish instead. If the write fails, the region is marked dirty again.
+	 */
+	Result write_back_region(const kstd::Arc<BlockCacheRegion>& region);
+
+	// Prefetching
+	struct PrefetchRequest {
+		size_t start_block;
+		size_t num_regions;
+	};
+	static void prefetcher_loop();
+	void do_prefetches();
+
+	/** Copies count bytes starting at the given byte offset on the disk from the cache into the buffer. **/
+	ssize_t read_cached(size_t offset, SafePointer<uint8_t> buffer, size_t count);
+	/** Copies count bytes from the buffer into the cache starting at the given byte offset on the disk. **/
+	ssize_t write_cached(size_t offset, SafePointer<uint8_t> buffer, size_t count);
+
 	kstd::LRUCache<size_t, kstd::Arc<BlockCacheRegion>> _cache_regions;
-	kstd::Arc<BlockCacheRegion> get_cache_region(size_t block);
+	/**
+	 * Gets the cache region containing the given block, reading it from the disk if needed. If it isn't cached,
+	 * up to num_following of the regions after it that aren't cached either are read in the same request.
+	 * If prefetch is true, the regions read are counted as prefetched rather than as cache misses.
+	 */
+	ResultRet<kstd::Arc<BlockCacheRegion>> get_cache_region(size_t block, size_t num_following = 0, bool prefetch = false);
 	inline size_t blocks_per_cache_region() { return PAGE_SIZE / block_size(); }
 	inline size_t block_cache_region_start(size_t block) { return block - (block % blocks_per_cache_region()); }
 	SpinLock _cache_lock;
+
+	kstd::vector<kstd::Arc<BlockCacheRegion>> _dirty_regions;
+	SpinLock _dirty_lock;
+	SpinLock _flush_lock;
+
+	kstd::circular_queue<PrefetchRequest> _prefetch_queue {DISK_PREFETCH_QUEUE_SIZE};
+	SpinLock _prefetch_lock;
 };
 
@@ -22,6 +22,8 @@
 #include <kernel/kstd/KLog.h>
 #include <kernel/filesystem/FileDescriptor.h>
 
+SpinLock PATADevice::s_channel_locks[2];
+
 PATADevice *PATADevice::find(PATADevice::Channel channel, PATADevice::DriveType drive, bool use_pio) {
 	PCI::Address addr = {0,0,0};
 	PCI::enumerate_devices([](PCI::Address addr, PCI::ID id, uint16_t type, void* data) {
@@ -41,7 +43,7 @@ PATADevice::PATADevice(PCI::Address addr, PATADevice::Channel channel, PATADevic
 	//IO Ports
 	_io_base = channel == PRIMARY ? 0x1F0 : 0x170;
 	_control_base = channel == PRIMARY ? 0x3F6 : 0x376;
-	_bus_master_base = PCI::read_word(addr, PCI_BAR4) & (~1);
+	_bus_master_base = (PCI::read_word(addr, PCI_BAR4) & (~1)) + (channel == PRIMARY ? 0 : 8);
 
 	//Detect bus mastering capability
 	if(PCI::read_byte(addr, PCI_PROG_IF) & 0x80u) {
@@ -52,9 +54,8 @@ PATADevice::PATADevice(PCI::Address addr, PATADevice::Channel channel, PATADevic
 		use_pio = true;
 	}
 
-	//IRQ
-	//TODO: This will not work for multiple channels since they both use the same IRQs
-	set_irq(drive == MASTER ? 14 : 15);
+	//IRQ. Each channel has its own, and the drive being accessed installs itself as the handler while it's in use.
+	set_irq(channel == PRIMARY ? 14 : 15);
 
 	//Prepare the drive
 	IO::outb(_io_base + ATA_DRIVESEL, 0xA0u | (drive == SLAVE ? 0x10u : 0x00u));
@@ -102,9 +103,9 @@ PATADevice::PATADevice(PCI::Address addr, PATADevice::Channel channel, PATADevic
 	PCI::enable_interrupt(addr);
 	if(!use_pio) {
 		PCI::enable_bus_mastering(addr);
-		_prdt_region = MM.alloc_kernel_region(sizeof(PRDT));
+		_prdt_region = MM.alloc_dma_region(ATA_MAX_PRD_ENTRIES * sizeof(PRDT));
 		_prdt = (PRDT*) _prdt_region->start();
-		_dma_region = MM.alloc_dma_region(ATA_MAX_SECTORS_AT_ONCE * 512);
+		_dma_region = MM.alloc_dma_region(ATA_MAX_BOUNCE_SECTORS * 512);
 
 		//Reset bus master status register
 		IO::outb(_bus_master_base + ATA_BM_STATUS, IO::inb(_bus_master_base + ATA_BM_STATUS) | 0x4u);
@@ -128,78 +129,96 @@ void PATADevice::wait_ready() {
 }
 
 Result PATADevice::read_sectors_dma(size_t lba, uint8_t num_sectors, uint8_t *buf) {
-	ASSERT(num_sectors <= ATA_MAX_SECTORS_AT_ONCE);
-	LOCK(_lock);
+	ASSERT(num_sectors <= ATA_MAX_BOUNCE_SECTORS);
+	LOCK(channel_lock());
 
-	if(num_sectors * 512 > _dma_region->object()->physical_page(0).paddr())
+	if(num_sectors * 512 > _dma_region->size())
 		return Result(-EINVAL);
-	_prdt->addr = _dma_region->object()->physical_page(0).paddr();
-	_prdt->size = num_sectors * 512;
-	_prdt->eot = 0x8000;
-
-	//Select drive and wait 10us
-	IO::outb(_io_base + ATA_DRIVESEL, 0xA0u | (_drive == SLAVE ? 0x8u : 0x0u));
-	IO::wait(10);
-
-	//Stop bus master, write PRDT, clear flags, and set direction to read
-	IO::outb(_bus_master_base, 0);
-	IO::outl(_bus_master_base + ATA_BM_PRDT, _prdt_region->object()->physical_page(0).paddr());
-	IO::outb(_bus_master_base, ATA_BM_READ);
-	IO::outb(_bus_master_base + ATA_BM_STATUS, IO::inb(_bus_master_base + ATA_BM_STATUS) | 0x6u);
-
-	//Access the drive
-	access_drive(ATA_READ_DMA, lba, num_sectors);
-
-	//Wait for DRQ bit and start bus master
-	while(!(IO::inb(_control_base) & ATA_STATUS_DRQ));
-	IO::outb(_bus_master_base, 0x9);
-
-	//Wait for irq
-	TaskManager::current_thread()->block(_blocker);
-	_blocker.set_ready(false);
-	uninstall_irq();
+	_prdt[0].addr = _dma_region->object()->physical_page(0).paddr();
+	_prdt[0].size = num_sectors * 512;
+	_prdt[0].eot = 0x8000;
 
-	if(_post_irq_status & ATA_STATUS_ERR) {
-		KLog::err("PATA", "DMA read fail with status 0x%x and busmaster status 0x%x", _post_irq_status, _post_irq_bm_status);
-		return Result(-EIO);
-	}
+	auto res = do_dma(false, lba, num_sectors);
+	if(res.is_error())
+		return res;
 
 	//Copy to buffer
 	memcpy((void *) buf, (void*) _dma_region->start(), 512 * num_sectors);
-
-	//Tell bus master we're done
-	IO::outb(_bus_master_base + ATA_BM_STATUS, IO::inb(_bus_master_base + ATA_BM_STATUS) | 0x6u);
-
 	return Result(SUCCESS);
 }
 
 Result PATADevice::write_sectors_dma(size_t lba, uint8_t num_sectors, const uint8_t *buf) {
-	ASSERT(num_sectors <= ATA_MAX_SECTORS_AT_ONCE);
-	LOCK(_lock);
+	ASSERT(num_sectors <= ATA_MAX_BOUNCE_SECTORS);
+	LOCK(channel_lock());
 
 	if(num_sectors * 512 > _dma_region->size())
 		return Result(-EINVAL);
-	_prdt->addr = _dma_region->object()->physical_page(0).paddr();
-	_prdt->size = num_sectors * 512;
-	_prdt->eot = 0x8000;
+	_prdt[0].addr = _dma_region->object()->physical_page(0).paddr();
+	_prdt[0].size = num_sectors * 512;
+	_prdt[0].eot = 0x8000;
 
 	//Copy to buffer
 	memcpy((void*) _dma_region->start(), buf, 512 * num_sectors);
 
+	return do_dma(true, lba, num_sectors);
+}
+
+Result PATADevice::transfer_pages_dma(bool write, uint32_t lba, VMRegion* const* pages, size_t num_pages) {
+	size_t num_sectors = num_pages * (PAGE_SIZE / 512);
+	ASSERT(num_sectors <= ATA_MAX_SECTORS_AT_ONCE);
+	LOCK(channel_lock());
+
+	//Build a PRD entry for each run of physically contiguous pages. An entry can't be larger than 64KiB or cross a
+	//64KiB boundary.
+	size_t num_entries = 0;
+	size_t entry_size = 0;
+	for(size_t i = 0; i < num_pages; i++) {
+		PhysicalAddress paddr = pages[i]->object()->physical_page(0).paddr();
+		if(num_entries) {
+			auto& entry = _prdt[num_entries - 1];
+			if(entry.addr + entry_size == paddr && (entry.addr & ~0xFFFFu) == ((paddr + PAGE_SIZE - 1) & ~0xFFFFu)) {
+				entry_size += PAGE_SIZE;
+				entry.size = entry_size; // 64KiB wraps around to 0, which is what the controller expects
+				continue;
+			}
+		}
+		ASSERT(num_entries < ATA_MAX_PRD_ENTRIES);
+		_prdt[num_entries].addr = paddr;
+		_prdt[num_entries].size = PAGE_SIZE;
+		_prdt[num_entries].eot = 0;
+		entry_size = PAGE_SIZE;
+		num_entries++;
+	}
+	_prdt[num_entries - 1].eot = 0x8000;
+
+	return do_dma(write, lba, num_sectors);
+}
+
+Result PATADevice::do_dma(bool write, uint32_t lba, uint8_t num_sectors) {
+	ASSERT(channel_lock().held_by_current_thread());
+
 	//Select drive and wait 10us
 	IO::outb(_io_base + ATA_DRIVESEL, 0xA0u | (_drive == SLAVE ? 0x8u : 0x0u));
 	IO::wait(10);
 
-	//Stop bus master, write PRDT, and clear flags
+	//Stop bus master, write PRDT, clear flags, and set direction
 	IO::outb(_bus_master_base, 0);
 	IO::outl(_bus_master_base + ATA_BM_PRDT, _prdt_region->object()->physical_page(0).paddr());
+	if(!write)
+		IO::outb(_bus_master_base, ATA_BM_READ);
 	IO::outb(_bus_master_base + ATA_BM_STATUS, IO::inb(_bus_master_base + ATA_BM_STATUS) | 0x6u);
 
-	access_drive(ATA_WRITE_DMA, lba, num_sectors);
+	//Access the drive
+	access_drive(write ? ATA_WRITE_DMA : ATA_READ_DMA, lba, num_sectors);
 
-	//Wait for DRQ / not busy and start bus master
-	while(IO::inb(_control_base) & ATA_STATUS_BSY || !(IO::inb(_control_base) & ATA_STATUS_DRQ));
-	IO::outb(_bus_master_base, 0x1);
+	//Wait for DRQ bit and start bus master
+	if(write) {
+		while(IO::inb(_control_base) & ATA_STATUS_BSY || !(IO::inb(_control_base) & ATA_STATUS_DRQ));
+		IO::outb(_bus_master_base, 0x1);
+	} else {
+		while(!(IO::inb(_control_base) & ATA_STATUS_DRQ));
+		IO::outb(_bus_master_base, 0x9);
+	}
 
 	//Wait for irq
 	TaskManager::current_thread()->block(_blocker);
@@ -207,7 +226,7 @@ Result PATADevice::write_sectors_dma(size_t lba, uint8_t num_sectors, const uint
 	uninstall_irq();
 
 	if(_post_irq_status & ATA_STATUS_ERR) {
-		KLog::err("PATA", "DMA write fail with status 0x%x and busmaster status 0x%x", _post_irq_status, _post_irq_bm_status);
+		KLog::err("PATA", "DMA %s fail with status 0x%x and busmaster status 0x%x", write ? "write" : "read", _post_irq_status, _post_irq_bm_status);
 		return Result(-EIO);
 	}
 
@@ -218,7 +237,7 @@ Result PATADevice::write_sectors_dma(size_t lba, uint8_t num_sectors, const uint
 }
 
 void PATADevice::write_sectors_pio(uint32_t sector, uint8_t sectors, const uint8_t *buffer) {
-	LOCK(_lock);
+	LOCK(channel_lock());
 
 	_blocker.set_ready(false);
 	access_drive(ATA_WRITE_PIO, sector, sectors);
@@ -237,7 +256,7 @@ void PATADevice::write_sectors_pio(uint32_t sector, uint8_t sectors, const uint8
 }
 
 void PATADevice::read_sectors_pio(uint32_t sector, uint8_t sectors, uint8_t *buffer) {
-	LOCK(_lock);
+	LOCK(channel_lock());
 
 	_blocker.set_ready(false);
 	access_drive(ATA_READ_PIO, sector, sectors);
@@ -282,10 +301,10 @@ void PATADevice::access_drive(uint8_t command, uint32_t lba, uint8_t num_sectors
 Result PATADevice::read_uncached_blocks(uint32_t block, uint32_t count, uint8_t *buffer) {
 	if(!_use_pio) {
 		//DMA mode
-		size_t num_chunks = (count + ATA_MAX_SECTORS_AT_ONCE - 1) / ATA_MAX_SECTORS_AT_ONCE;
+		size_t num_chunks = (count + ATA_MAX_BOUNCE_SECTORS - 1) / ATA_MAX_BOUNCE_SECTORS;
 		for (size_t i = 0; i < num_chunks; i++) {
-			uint32_t num_sectors = min((size_t) ATA_MAX_SECTORS_AT_ONCE, count);
-			Result res = read_sectors_dma(block + i * ATA_MAX_SECTORS_AT_ONCE, num_sectors, buffer + (512 * i * ATA_MAX_SECTORS_AT_ONCE));
+			uint32_t num_sectors = min((size_t) ATA_MAX_BOUNCE_SECTORS, count);
+			Result res = read_sectors_dma(block + i * ATA_MAX_BOUNCE_SECTORS, num_sectors, buffer + (512 * i * ATA_MAX_BOUNCE_SECTORS));
 			if (res.is_error()) return res;
 			count -= num_sectors;
 		}
@@ -305,10 +324,10 @@ Result PATADevice::read_uncached_blocks(uint32_t block, uint32_t count, uint8_t
 Result PATADevice::write_uncached_blocks(uint32_t block, uint32_t count, const uint8_t *buffer) {
 	if(!_use_pio) {
 		//DMA mode
-		size_t num_chunks = (count + ATA_MAX_SECTORS_AT_ONCE - 1) / ATA_MAX_SECTORS_AT_ONCE;
+		size_t num_chunks = (count + ATA_MAX_BOUNCE_SECTORS - 1) / ATA_MAX_BOUNCE_SECTORS;
 		for (size_t i = 0; i < num_chunks; i++) {
-			uint32_t num_sectors = min((size_t) ATA_MAX_SECTORS_AT_ONCE, count);
-			Result res = write_sectors_dma(block + i * ATA_MAX_SECTORS_AT_ONCE, num_sectors, buffer + (512 * i * ATA_MAX_SECTORS_AT_ONCE));
+			uint32_t num_sectors = min((size_t) ATA_MAX_BOUNCE_SECTORS, count);
+			Result res = write_sectors_dma(block + i * ATA_MAX_BOUNCE_SECTORS, num_sectors, buffer + (512 * i * ATA_MAX_BOUNCE_SECTORS));
 			if(res.is_error())
 				return res;
 			count -= num_sectors;
@@ -326,98 +345,48 @@ Result PATADevice::write_uncached_blocks(uint32_t block, uint32_t count, const u
 	}
 }
 
-size_t PATADevice::block_size() {
-	return 512;
+Result PATADevice::read_uncached_pages(uint32_t block, VMRegion* const* pages, size_t num_pages) {
+	if(_use_pio)
+		return DiskDevice::read_uncached_pages(block, pages, num_pages);
+
+	//DMA straight into the pages, as many at a time as will fit in one command
+	size_t pages_per_command = ATA_MAX_SECTORS_AT_ONCE / (PAGE_SIZE / 512);
+	for(size_t i = 0; i < num_pages; i += pages_per_command) {
+		auto res = transfer_pages_dma(false, block + i * (PAGE_SIZE / 512), pages + i, min(pages_per_command, num_pages - i));
+		if(res.is_error())
+			return res;
+	}
+	return Result(SUCCESS);
 }
 
-ssize_t PATADevice::read(FileDescriptor &fd, size_t offset, SafePointer<uint8_t> buffer, size_t count) {
-	size_t first_block = offset / block_size();
-	size_t first_block_start = offset % block_size();
-	size_t bytes_left = count;
-	size_t block = first_block;
-	ssize_t nread = 0;
-
-	uint8_t block_buf[block_size()];
-	while(bytes_left) {
-		if(block > _max_addressable_block)
-			break;
+Result PATADevice::write_uncached_pages(uint32_t block, VMRegion* const* pages, size_t num_pages) {
+	if(_use_pio)
+		return DiskDevice::write_uncached_pages(block, pages, num_pages);
 
-		Result res = read_block(block, block_buf);
+	size_t pages_per_command = ATA_MAX_SECTORS_AT_ONCE / (PAGE_SIZE / 512);
+	for(size_t i = 0; i < num_pages; i += pages_per_command) {
+		auto res = transfer_pages_dma(true, block + i * (PAGE_SIZE / 512), pages + i, min(pages_per_command, num_pages - i));
 		if(res.is_error())
-			return res.code();
-
-		if(block == first_block) {
-			if(count < block_size() - first_block_start) {
-				buffer.write(block_buf + first_block_start, count);
-				nread += count;
-				bytes_left = 0;
-			} else {
-				buffer.write(block_buf + first_block_start, block_size() - first_block_start);
-				nread += block_size() - first_block_start;
-				bytes_left -= block_size() - first_block_start;
-			}
-		} else {
-			if(bytes_left < block_size()) {
-				buffer.write(block_buf, count - bytes_left, bytes_left);
-				nread += bytes_left;
-				bytes_left = 0;
-			} else {
-				buffer.write(block_buf, count - bytes_left, block_size());
-				nread += block_size();
-				bytes_left -= block_size();
-			}
-		}
-		block++;
+			return res;
 	}
+	return Result(SUCCESS);
+}
 
-	return nread;
+size_t PATADevice::block_size() {
+	return 512;
 }
 
-ssize_t PATADevice::write(FileDescriptor& fd, size_t offset, SafePointer<uint8_t> buffer, size_t count) {
-	size_t first_block = offset / block_size();
-	size_t last_block = (offset + count) / block_size();
-	size_t first_block_start = offset % block_size();
-	size_t bytes_left = count;
-	size_t block = first_block;
+ssize_t PATADevice::read(FileDescriptor &fd, size_t offset, SafePointer<uint8_t> buffer, size_t count) {
+	size_t disk_size = (_max_addressable_block + 1) * block_size();
+	if(offset >= disk_size)
+		return 0;
+	return DiskDevice::read(fd, offset, buffer, min(count, disk_size - offset));
+}
 
-	if(last_block > _max_addressable_block)
+ssize_t PATADevice::write(FileDescriptor& fd, size_t offset, SafePointer<uint8_t> buffer, size_t count) {
+	if((offset + count) / block_size() > _max_addressable_block)
 		return -ENOSPC;
-
-	uint8_t block_buf[block_size()];
-	while(bytes_left) {
-		//Read the block into a buffer
-		Result res = read_block(block, block_buf);
-		if(res.is_error()) {
-			return res.code();
-		}
-
-		//Copy the appropriate portion of the buffer into the appropriate portion of the block buffer
-		if(block == first_block) {
-			if(count < block_size() - first_block_start) {
-				buffer.read(block_buf + first_block_start, count);
-				bytes_left = 0;
-			} else {
-				buffer.read(block_buf + first_block_start, block_size() - first_block_start);
-				bytes_left -= block_size() - first_block_start;
-			}
-		} else {
-			if(bytes_left < block_size()) {
-				buffer.read(block_buf, count - bytes_left, bytes_left);
-				bytes_left = 0;
-			} else {
-				buffer.read(block_buf, count - bytes_left, block_size());
-				bytes_left -= block_size();
-			}
-		}
-
-		res = write_block(block, block_buf);
-		if(res.is_error()) {
-			return res.code();
-		}
-		block++;
-	}
-
-	return count;
+	return DiskDevice::write(fd, offset, buffer, count);
 }
 
 void PATADevice::handle_irq(Registers *regs) {
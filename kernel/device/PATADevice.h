@@ -28,7 +28,12 @@
 #include <kernel/tasking/SpinLock.h>
 #include <kernel/memory/MemoryManager.h>
 
-#define ATA_MAX_SECTORS_AT_ONCE (PAGE_SIZE / 512)
+// The most sectors that will be transferred with one command. Matches the largest disk cache read / flush run.
+#define ATA_MAX_SECTORS_AT_ONCE 128
+// The most sectors that will be transferred at once through the bounce buffer. It's kept to a single page, since a PRD
+// entry can't cross a 64KiB boundary and a larger buffer isn't guaranteed to be aligned to one.
+#define ATA_MAX_BOUNCE_SECTORS (PAGE_SIZE / 512)
+#define ATA_MAX_PRD_ENTRIES (PAGE_SIZE / sizeof(PRDT))
 
 class PATADevice: public IRQHandler, public DiskDevice {
 public:
@@ -43,6 +48,7 @@ public:
 	void wait_ready();
 	Result read_sectors_dma(uint32_t sector, uint8_t num_sectors, uint8_t* buf);
 	Result write_sectors_dma(uint32_t sector, uint8_t num_sectors, const uint8_t* buf);
+	Result transfer_pages_dma(bool write, uint32_t sector, VMRegion* const* pages, size_t num_pages);
 	void read_sectors_pio(uint32_t sector, uint8_t sectors, uint8_t *buffer);
 	void write_sectors_pio(uint32_t sector, uint8_t sectors, const uint8_t *buffer);
 	void access_drive(uint8_t command, uint32_t lba, uint8_t num_sectors);
@@ -51,6 +57,8 @@ public:
 	//BlockDevice
 	Result read_uncached_blocks(uint32_t block, uint32_t count, uint8_t *buffer) override;
 	Result write_uncached_blocks(uint32_t block, uint32_t count, const uint8_t *buffer) override;
+	Result read_uncached_pages(uint32_t block, VMRegion* const* pages, size_t num_pages) override;
+	Result write_uncached_pages(uint32_t block, VMRegion* const* pages, size_t num_pages) override;
 	size_t block_size() override;
 
 	//File
@@ -62,6 +70,8 @@ public:
 
 private:
 	PATADevice(PCI::Address addr, Channel channel, DriveType drive, bool use_pio);
+	Result do_dma(bool write, uint32_t sector, uint8_t num_sectors);
+	SpinLock& channel_lock() { return s_channel_locks[_channel]; }
 
 	//Addresses
 	PCI::Address _pci_addr;
@@ -86,8 +96,8 @@ private:
 	uint8_t _post_irq_status, _post_irq_bm_status;
 	volatile bool _got_irq = false;
 
-	//Lock
-	SpinLock _lock;
+	//Both drives on a channel share its registers and IRQ, so only one of them may be accessed at a time
+	static SpinLock s_channel_locks[2];
 };
 
 
@@ -41,6 +41,26 @@ ssize_t PartitionDevice::write(FileDescriptor& fd, size_t start, SafePointer<uin
 	return _parent->write(fd, start + _offset, buffer, count);
 }
 
+void PartitionDevice::prefetch(size_t start, size_t count) {
+	_parent->prefetch(start + _offset, count);
+}
+
+ResultRet<PageIndex> PartitionDevice::share_cache_page(size_t offset) {
+	return _parent->share_cache_page(offset + _offset);
+}
+
+void PartitionDevice::mark_cache_page_dirty(size_t offset, PageIndex page) {
+	_parent->mark_cache_page_dirty(offset + _offset, page);
+}
+
+Result PartitionDevice::sync() {
+	return _parent->sync();
+}
+
+void PartitionDevice::unshare_cache(size_t start, size_t count) {
+	_parent->unshare_cache(start + _offset, count);
+}
+
 size_t PartitionDevice::block_size() {
 	return _parent->block_size();
 }
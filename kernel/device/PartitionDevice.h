@@ -28,6 +28,11 @@ public:
 	Result write_blocks(uint32_t block, uint32_t count, const uint8_t *buffer) override;
 	ssize_t read(FileDescriptor& fd, size_t offset, SafePointer<uint8_t> buffer, size_t count) override;
 	ssize_t write(FileDescriptor& fd, size_t offset, SafePointer<uint8_t> buffer, size_t count) override;
+	void prefetch(size_t offset, size_t count) override;
+	ResultRet<PageIndex> share_cache_page(size_t offset) override;
+	void mark_cache_page_dirty(size_t offset, PageIndex page) override;
+	Result sync() override;
+	void unshare_cache(size_t offset, size_t count) override;
 	size_t block_size() override;
 	size_t part_offset();
 	kstd::Arc<File> parent();
@@ -0,0 +1,61 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later */
+/* Copyright © 2016-2023 Byteduck */
+
+#include "DentryCache.h"
+
+DentryCache& DentryCache::inst() {
+	static DentryCache s_inst;
+	return s_inst;
+}
+
+kstd::Optional<ino_t> DentryCache::lookup(uint8_t fsid, ino_t parent, const kstd::string& name, uint32_t& generation) {
+	LOCK(m_lock);
+	generation = m_generation;
+	auto inode = m_entries.find({fsid, parent, name});
+	if(!inode) {
+		m_misses.add(1);
+		return kstd::nullopt;
+	}
+	if(*inode)
+		m_hits.add(1);
+	else
+		m_negative_hits.add(1);
+	return *inode;
+}
+
+void DentryCache::insert(uint8_t fsid, ino_t parent, const kstd::string& name, ino_t inode, uint32_t generation) {
+	LOCK(m_lock);
+	if(generation != m_generation)
+		return;
+	m_entries.insert({fsid, parent, name}, inode);
+	if(m_entries.size() > DENTRY_CACHE_MAX_ENTRIES)
+		m_entries.prune(m_entries.size() - DENTRY_CACHE_MAX_ENTRIES);
+}
+
+void DentryCache::invalidate(uint8_t fsid, ino_t parent, const kstd::string& name) {
+	LOCK(m_lock);
+	m_generation++;
+	DentryKey key = {fsid, parent, name};
+	if(m_entries.contains(key)) {
+		m_entries.erase(key);
+		m_invalidations.add(1);
+	}
+}
+
+void DentryCache::invalidate_all() {
+	LOCK(m_lock);
+	m_generation++;
+	m_invalidations.add(m_entries.size());
+	m_entries.prune(m_entries.size());
+}
+
+DentryCache::Stats DentryCache::stats() {
+	LOCK(m_lock);
+	return {
+		m_hits.load(),
+		m_negative_hits.load(),
+		m_misses.load(),
+		m_invalidations.load(),
+		m_entries.size()
+	};
+}
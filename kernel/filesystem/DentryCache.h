@@ -0,0 +1,76 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later */
+/* Copyright © 2016-2023 Byteduck */
+
+#pragma once
+
+#include <kernel/kstd/LRUCache.h>
+#include <kernel/kstd/string.h>
+#include <kernel/kstd/Optional.h>
+#include <kernel/kstd/unix_types.h>
+#include <kernel/tasking/SpinLock.h>
+#include <kernel/Atomic.h>
+
+/** The maximum number of directory entries that will be cached before the least recently used ones are evicted. **/
+#define DENTRY_CACHE_MAX_ENTRIES 2048
+
+struct DentryKey {
+	uint8_t fsid;
+	ino_t parent;
+	kstd::string name;
+
+	bool operator==(const DentryKey& other) const {
+		return fsid == other.fsid && parent == other.parent && name == other.name;
+	}
+};
+
+template<>
+inline uint32_t kstd::hash<DentryKey>(const DentryKey& key) {
+	return hash_bytes(key.name.c_str(), key.name.length()) ^ hash_int(key.parent ^ ((uint32_t) key.fsid << 24));
+}
+
+/**
+ * A cache of directory lookups, keyed by the directory and the name looked up in it. Names that don't exist are cached
+ * too (as inode 0), so that repeatedly looking for something that isn't there (like searching PATH) doesn't have to read
+ * the directory each time either.
+ *
+ * Entries are only valid as long as the directory they're in doesn't change, so anything that adds or removes entries
+ * in a directory has to invalidate the names it touched.
+ */
+class DentryCache {
+public:
+	struct Stats {
+		size_t hits; ///< Lookups that were answered with an inode from the cache.
+		size_t negative_hits; ///< Lookups that were answered from the cache with a name that doesn't exist.
+		size_t misses; ///< Lookups that had to read the directory.
+		size_t invalidations; ///< Entries that were removed because their directory changed.
+		size_t entries; ///< The number of entries currently in the cache.
+	};
+
+	static DentryCache& inst();
+
+	/**
+	 * Looks up a name in a directory.
+	 * @param generation Set to the current generation of the cache, to be passed to insert() if the lookup misses.
+	 * @return The inode the name refers to (or 0 if it's known not to exist), or nullopt if it isn't cached.
+	 */
+	kstd::Optional<ino_t> lookup(uint8_t fsid, ino_t parent, const kstd::string& name, uint32_t& generation);
+
+	/**
+	 * Caches the result of looking up a name in a directory. If anything was invalidated since the generation was
+	 * obtained from lookup(), the result may already be out of date and isn't cached.
+	 */
+	void insert(uint8_t fsid, ino_t parent, const kstd::string& name, ino_t inode, uint32_t generation);
+
+	/** Removes the entry for a name in a directory. Should be called after the directory is modified. **/
+	void invalidate(uint8_t fsid, ino_t parent, const kstd::string& name);
+	/** Removes every entry in the cache. **/
+	void invalidate_all();
+
+	Stats stats();
+
+private:
+	kstd::LRUCache<DentryKey, ino_t> m_entries;
+	SpinLock m_lock;
+	uint32_t m_generation = 0;
+	Atomic<size_t> m_hits = 0, m_negative_hits = 0, m_misses = 0, m_invalidations = 0;
+};
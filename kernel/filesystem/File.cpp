@@ -85,3 +85,22 @@ bool File::can_write(const FileDescriptor& fd) {
 	return true;
 }
 
+void File::prefetch(size_t offset, size_t count) {
+
+}
+
+ResultRet<PageIndex> File::share_cache_page(size_t offset) {
+	return Result(-ENOTSUP);
+}
+
+void File::mark_cache_page_dirty(size_t offset, PageIndex page) {
+
+}
+
+Result File::sync() {
+	return Result(SUCCESS);
+}
+
+void File::unshare_cache(size_t offset, size_t count) {
+
+}
@@ -22,6 +22,7 @@
 #include <kernel/kstd/Arc.h>
 #include <kernel/Result.hpp>
 #include <kernel/memory/SafePointer.h>
+#include <kernel/memory/Memory.h>
 
 class FileDescriptor;
 class DirectoryEntry;
@@ -42,6 +43,25 @@ public:
 	virtual void close(FileDescriptor& fd);
 	virtual bool can_read(const FileDescriptor& fd);
 	virtual bool can_write(const FileDescriptor& fd);
+	/** Hints that the given range of the file is likely to be read soon, so that it can be cached ahead of time. **/
+	virtual void prefetch(size_t offset, size_t count);
+	/**
+	 * Gets the physical page that the page-aligned part of the file at the given offset is cached in, so that it can be
+	 * mapped somewhere else instead of copied. The page is referenced on behalf of the caller.
+	 */
+	virtual ResultRet<PageIndex> share_cache_page(size_t offset);
+	/**
+	 * Marks the cached page at the given offset dirty after it was written to somewhere it was shared, as long as it's
+	 * still the given physical page.
+	 */
+	virtual void mark_cache_page_dirty(size_t offset, PageIndex page);
+	/** Writes anything that's been written to the file but is still only cached back to where the file is stored. **/
+	virtual Result sync();
+	/**
+	 * Stops caching any pages in the given range that were shared with share_cache_page(), so that whoever has them
+	 * keeps their old contents when the range is reused for something else.
+	 */
+	virtual void unshare_cache(size_t offset, size_t count);
 protected:
 	File();
 };
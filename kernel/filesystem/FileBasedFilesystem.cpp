@@ -74,15 +74,22 @@ Result FileBasedFilesystem::read_block(size_t block, uint8_t *buffer) {
 }
 
 Result FileBasedFilesystem::read_blocks(size_t block, size_t count, uint8_t *buffer) {
-	Result res = Result(SUCCESS);
-	for(size_t i = 0; i < count; i++) {
-		res = read_block(block + i, buffer + block_size() * i);
-		if(res.is_error())
-			return res;
-	}
+	return read_block_run(block, 0, count * block_size(), KernelPointer<uint8_t>(buffer));
+}
+
+Result FileBasedFilesystem::read_block_run(size_t block, size_t offset, size_t count, SafePointer<uint8_t> buffer) {
+	ssize_t nread = _file->file()->read(*_file, block * block_size() + offset, buffer, count);
+	if(nread < 0)
+		return Result(nread);
+	if(nread != count)
+		return Result(-EIO);
 	return Result(SUCCESS);
 }
 
+void FileBasedFilesystem::prefetch_blocks(size_t block, size_t count) {
+	_file->file()->prefetch(block * block_size(), count * block_size());
+}
+
 Result FileBasedFilesystem::write_blocks(size_t block, size_t count, const uint8_t* buffer) {
 	Result res = Result(SUCCESS);
 	for(size_t i = 0; i < count; i++) {
@@ -102,6 +109,35 @@ Result FileBasedFilesystem::write_block(size_t block, const uint8_t* buffer) {
 	return Result(SUCCESS);
 }
 
+Result FileBasedFilesystem::write_block_run(size_t block, size_t offset, size_t count, SafePointer<uint8_t> buffer) {
+	ssize_t nwrote = _file->file()->write(*_file, block * block_size() + offset, buffer, count);
+	if(nwrote < 0)
+		return Result(nwrote);
+	if(nwrote != count)
+		return Result(-EIO);
+	return Result(SUCCESS);
+}
+
+ResultRet<PageIndex> FileBasedFilesystem::share_cache_page(size_t block) {
+	return _file->file()->share_cache_page(block * block_size());
+}
+
+void FileBasedFilesystem::mark_cache_page_dirty(size_t block, PageIndex page) {
+	_file->file()->mark_cache_page_dirty(block * block_size(), page);
+}
+
+void FileBasedFilesystem::unshare_blocks(const kstd::vector<uint32_t>& blocks) {
+	//Unshare each run of contiguous blocks at once
+	size_t run_start = 0;
+	for(size_t i = 1; i <= blocks.size(); i++) {
+		if(i < blocks.size() && blocks[i] == blocks[i - 1] + 1)
+			continue;
+		if(blocks[run_start])
+			_file->file()->unshare_cache(blocks[run_start] * block_size(), (i - run_start) * block_size());
+		run_start = i;
+	}
+}
+
 Result FileBasedFilesystem::zero_block(size_t block) {
 	uint8_t zero_buf[block_size()];
 	memset(zero_buf, 0, block_size());
@@ -116,6 +152,35 @@ Result FileBasedFilesystem::zero_block(size_t block) {
 	return Result(SUCCESS);
 }
 
+Result FileBasedFilesystem::zero_blocks(size_t block, size_t count) {
+	if(count == 1)
+		return zero_block(block);
+
+	size_t chunk_blocks = min(count, (size_t) FS_MAX_ZERO_CHUNK / block_size());
+	if(!chunk_blocks)
+		chunk_blocks = 1;
+	auto* zero_buf = (uint8_t*) kmalloc(chunk_blocks * block_size());
+	memset(zero_buf, 0, chunk_blocks * block_size());
+
+	Result res = Result(SUCCESS);
+	while(count) {
+		size_t to_write = min(count, chunk_blocks);
+		ssize_t nwrote = _file->file()->write(*_file, block * block_size(), KernelPointer<const uint8_t>(zero_buf), to_write * block_size());
+		if(nwrote < 0) {
+			res = Result(nwrote);
+			break;
+		} else if(nwrote != to_write * block_size()) {
+			res = Result(-EIO);
+			break;
+		}
+		block += to_write;
+		count -= to_write;
+	}
+
+	kfree(zero_buf);
+	return res;
+}
+
 Result FileBasedFilesystem::truncate_block(size_t block, size_t new_size) {
 	if(new_size >= block_size()) return Result(-EOVERFLOW);
 
@@ -137,9 +202,9 @@ Result FileBasedFilesystem::truncate_block(size_t block, size_t new_size) {
 
 ResultRet<kstd::Arc<Inode>> FileBasedFilesystem::get_cached_inode(ino_t id) {
 	LOCK(m_inode_cache_lock);
-	auto inode = m_inode_cache.get(id);
+	auto inode = m_inode_cache.find(id);
 	if(inode)
-		return inode.value();
+		return *inode;
 	return Result(-ENOENT);
 }
 
@@ -153,6 +218,10 @@ void FileBasedFilesystem::remove_cached_inode(ino_t id) {
 	m_inode_cache.erase(id);
 }
 
+Result FileBasedFilesystem::sync() {
+	return _file->file()->sync();
+}
+
 Inode* FileBasedFilesystem::get_inode_rawptr(ino_t id) {
 	return nullptr;
 }
@@ -25,6 +25,9 @@
 #include <kernel/tasking/SpinLock.h>
 #include <kernel/kstd/vector.hpp>
 
+/** The most bytes that zero_blocks() will write to the disk at once. **/
+#define FS_MAX_ZERO_CHUNK (64 * 1024)
+
 class FileBasedFilesystem: public Filesystem {
 public:
 	explicit FileBasedFilesystem(const kstd::Arc<FileDescriptor>& file);
@@ -40,9 +43,23 @@ public:
 	
 	Result read_block(size_t block, uint8_t* buffer);
 	Result read_blocks(size_t block, size_t count, uint8_t* buffer);
+	/** Reads count bytes starting at offset bytes into the given block, which may span several contiguous blocks. **/
+	Result read_block_run(size_t block, size_t offset, size_t count, SafePointer<uint8_t> buffer);
+	/** Hints that the given blocks will be read soon so that they can be cached in the background. **/
+	void prefetch_blocks(size_t block, size_t count);
 	Result write_block(size_t block, const uint8_t* buffer);
 	Result write_blocks(size_t block, size_t count, const uint8_t* buffer);
+	/** Writes count bytes starting at offset bytes into the given block, which may span several contiguous blocks. **/
+	Result write_block_run(size_t block, size_t offset, size_t count, SafePointer<uint8_t> buffer);
+	/** Gets the physical page that the disk caches the page starting at the given block in. See File::share_cache_page. **/
+	ResultRet<PageIndex> share_cache_page(size_t block);
+	/** Marks the shared cache page starting at the given block dirty. See File::mark_cache_page_dirty. **/
+	void mark_cache_page_dirty(size_t block, PageIndex page);
+	/** Stops sharing the cache pages of blocks that are being freed. See File::unshare_cache. **/
+	void unshare_blocks(const kstd::vector<uint32_t>& blocks);
 	Result zero_block(size_t block);
+	/** Zeroes count contiguous blocks, writing as many at once as possible. **/
+	Result zero_blocks(size_t block, size_t count);
 	Result truncate_block(size_t block, size_t new_size);
 
 	ResultRet<kstd::Arc<Inode>> get_cached_inode(ino_t id);
@@ -50,6 +67,7 @@ public:
 	void remove_cached_inode(ino_t id);
 
 	virtual Inode* get_inode_rawptr(ino_t id);
+	Result sync() override;
 	virtual ResultRet<kstd::Arc<Inode>> get_inode(ino_t id);
 
 protected:
@@ -268,3 +268,7 @@ void FileDescriptor::set_fifo_writer() {
 bool FileDescriptor::is_fifo_writer() const {
 	return _is_fifo_writer;
 }
+
+FileDescriptor::ReadAhead& FileDescriptor::read_ahead() {
+	return _read_ahead;
+}
@@ -32,6 +32,13 @@ class InodeMetadata;
 class Inode;
 class FileDescriptor {
 public:
+	/** Tracks sequential reads through this descriptor so that filesystems can read ahead of them. **/
+	struct ReadAhead {
+		size_t next_offset = 0; ///< The offset a sequential read would start at.
+		size_t window = 0; ///< The number of bytes to keep prefetched ahead of the reader.
+		size_t prefetched_until = 0; ///< The offset up to which prefetches have already been issued.
+	};
+
 	explicit FileDescriptor(const kstd::Arc<File>& file, Process* owner = nullptr);
 	FileDescriptor(FileDescriptor& other, Process* new_owner = nullptr);
 	~FileDescriptor();
@@ -66,6 +73,8 @@ public:
 	void set_fifo_writer();
 	bool is_fifo_writer() const;
 
+	ReadAhead& read_ahead();
+
 private:
 	kstd::Arc<File> _file;
 	kstd::Arc<Inode> _inode;
@@ -81,6 +90,7 @@ private:
 
 	off_t _seek {0};
 	bool _is_fifo_writer = false;
+	ReadAhead _read_ahead;
 
 	SpinLock lock;
 };
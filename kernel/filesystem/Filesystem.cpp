@@ -37,4 +37,12 @@ ino_t Filesystem::root_inode_id() {
 
 uint8_t Filesystem::fsid() {
 	return _fsid;
-}
\ No newline at end of file
+}
+
+bool Filesystem::caches_dentries() {
+	return false;
+}
+
+Result Filesystem::sync() {
+	return Result(SUCCESS);
+}
@@ -32,6 +32,11 @@ public:
 	virtual ResultRet<kstd::Arc<Inode>> get_inode(ino_t id);
 	virtual ino_t root_inode_id();
 	virtual uint8_t fsid();
+	/** Whether lookups in this filesystem's directories can be cached. Directories whose contents change on their own
+	 * (like those in procfs) shouldn't be. **/
+	virtual bool caches_dentries();
+	/** Writes anything cached for this filesystem back to the device it's stored on. **/
+	virtual Result sync();
 
 protected:
 	uint8_t _fsid;
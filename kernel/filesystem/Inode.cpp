@@ -81,13 +81,42 @@ bool Inode::can_write(const FileDescriptor& fd) {
 kstd::Arc<InodeVMObject> Inode::shared_vm_object() {
 	LOCK(m_vmobject_lock);
 
-	kstd::Arc<InodeVMObject> ret;
-	if(!m_shared_vm_object) {
+	kstd::Arc<InodeVMObject> ret = m_shared_vm_object.lock();
+	if(!ret) {
 		ret = InodeVMObject::make_for_inode(self(), InodeVMObject::Type::Shared);
 		m_shared_vm_object = ret;
-	} else {
-		ret = m_shared_vm_object.lock();
 	}
 
 	return ret;
 }
+
+Result Inode::sync() {
+	kstd::Arc<InodeVMObject> object;
+	{
+		LOCK(m_vmobject_lock);
+		object = m_shared_vm_object.lock();
+	}
+	if(object)
+		object->sync();
+	return fs.sync();
+}
+
+ResultRet<PageIndex> Inode::share_page(size_t index) {
+	return Result(-ENOTSUP);
+}
+
+void Inode::mark_page_dirty(size_t index, PageIndex page) {
+
+}
+
+void Inode::update_shared_pages(size_t start, size_t length) {
+	if(!length)
+		return;
+	kstd::Arc<InodeVMObject> object;
+	{
+		LOCK(m_vmobject_lock);
+		object = m_shared_vm_object.lock();
+	}
+	if(object)
+		object->reload_copied_pages(start / PAGE_SIZE, (start + length - 1) / PAGE_SIZE - start / PAGE_SIZE + 1);
+}
@@ -64,7 +64,29 @@ public:
 
 	kstd::Arc<InodeVMObject> shared_vm_object();
 
+	/** Writes the file's changes, including those made through shared mappings of it, back to its filesystem's disk. **/
+	Result sync();
+
+	/**
+	 * Gets the physical page that a page of the file is cached in by the disk, so that mapping the file can share it
+	 * instead of copying it. Only pages that are backed by whole, contiguous, page-aligned blocks can be shared.
+	 * @param index The index of the page in the file.
+	 * @return The page, referenced on behalf of the caller, or an error if the page can't be shared.
+	 */
+	virtual ResultRet<PageIndex> share_page(size_t index);
+
+	/**
+	 * Marks a page of the file that was shared with share_page() as dirty in the disk cache, after it may have been
+	 * written to through a mapping. Nothing happens if the page isn't cached there anymore.
+	 * @param index The index of the page in the file.
+	 * @param page The physical page that was shared.
+	 */
+	virtual void mark_page_dirty(size_t index, PageIndex page);
+
 protected:
+	/** Brings the pages of the shared VM object that were copied from the file up to date after part of it is written. **/
+	void update_shared_pages(size_t start, size_t length);
+
 	InodeMetadata _metadata;
 	SpinLock lock, m_vmobject_lock;
 	kstd::Weak<InodeVMObject> m_shared_vm_object;
@@ -62,3 +62,6 @@ bool InodeFile::can_write(const FileDescriptor& fd) {
 	return _inode->can_write(fd);
 }
 
+Result InodeFile::sync() {
+	return _inode->sync();
+}
@@ -21,68 +21,167 @@
 #include <kernel/tasking/Signal.h>
 #include <kernel/tasking/TaskManager.h>
 #include <kernel/filesystem/FileDescriptor.h>
+#include <kernel/kstd/cstring.h>
+#include <kernel/api/ioctl.h>
 
-Pipe::Pipe(): _queue(PIPE_SIZE) {}
+Pipe::Pipe(size_t capacity): _queue(capacity) {}
 
 Pipe::~Pipe() = default;
 
 void Pipe::add_reader() {
+	LOCK(_lock);
 	_readers++;
 }
 
 void Pipe::add_writer() {
+	LOCK(_lock);
 	_writers++;
 }
 
 void Pipe::remove_reader() {
+	LOCK(_lock);
 	_readers--;
+	if(!_readers) {
+		_write_blocker.set_ready(true);
+		TaskManager::notify_io();
+	}
 }
 
 void Pipe::remove_writer() {
+	LOCK(_lock);
 	_writers--;
 	if(!_writers) {
-		_blocker.set_ready(true);
+		_read_blocker.set_ready(true);
+		TaskManager::notify_io();
 	}
 }
 
-ssize_t Pipe::read(FileDescriptor& fd, size_t offset, SafePointer<uint8_t> buffer, size_t count) {
-	if(!_writers && _queue.empty()) return 0;
-	if(!_blocker.is_ready())
-		TaskManager::current_thread()->block(_blocker);
-	if(_blocker.was_interrupted())
-		return -EINTR;
+Result Pipe::set_capacity(size_t capacity) {
+	if(capacity < PIPE_BUF || capacity > PIPE_MAX_SIZE)
+		return Result(-EINVAL);
+
+	kstd::circular_queue<uint8_t> new_queue(capacity);
 	LOCK(_lock);
-	if(count > _queue.size())
-		count = _queue.size();
-	for(size_t i = 0; i < count; i++)
-		buffer.set(i, _queue.pop_front());
-	if(_queue.empty() && _writers)
-		_blocker.set_ready(false);
-	return count;
-}
+	if(_queue.size() > capacity)
+		return Result(-EBUSY);
 
-ssize_t Pipe::write(FileDescriptor& fd, size_t offset, SafePointer<uint8_t> buffer, size_t count) {
-	//TODO: Block writes bigger than available space
-	if(_readers == 0) {
-		TaskManager::current_process()->kill(SIGPIPE);
-		return -EPIPE;
+	size_t span_length;
+	while(!_queue.empty()) {
+		auto* span = _queue.front_span(span_length);
+		size_t dest_length;
+		memcpy(new_queue.back_span(dest_length), span, span_length);
+		new_queue.commit_back(span_length);
+		_queue.drop_front(span_length);
 	}
+	_queue = kstd::move(new_queue);
 
-	LOCK(_lock);
+	_write_blocker.set_ready(true);
+	TaskManager::notify_io();
+	return Result(SUCCESS);
+}
+
+ssize_t Pipe::read(FileDescriptor& fd, size_t offset, SafePointer<uint8_t> buffer, size_t count) {
+	if(!count)
+		return 0;
+
+	while(true) {
+		{
+			LOCK(_lock);
+			if(!_queue.empty()) {
+				//Copy out of the queue in at most two spans (if the data wraps around the end of it)
+				size_t nread = 0;
+				while(nread < count && !_queue.empty()) {
+					size_t span_length;
+					auto* span = _queue.front_span(span_length);
+					span_length = min(span_length, count - nread);
+					buffer.write(span, nread, span_length);
+					_queue.drop_front(span_length);
+					nread += span_length;
+				}
+
+				if(_queue.empty() && _writers)
+					_read_blocker.set_ready(false);
+				_write_blocker.set_ready(true);
+				TaskManager::notify_io();
+				return nread;
+			}
 
+			if(!_writers)
+				return 0;
+			if(fd.nonblock())
+				return -EAGAIN;
+			_read_blocker.set_ready(false);
+		}
+
+		TaskManager::current_thread()->block(_read_blocker);
+		if(_read_blocker.was_interrupted())
+			return -EINTR;
+	}
+}
+
+ssize_t Pipe::write(FileDescriptor& fd, size_t offset, SafePointer<uint8_t> buffer, size_t count) {
 	size_t nwrote = 0;
-	bool flag = true;
-	while(nwrote < count && flag) {
-		flag = _queue.push_back(buffer.get(nwrote));
-		nwrote++;
+	bool broken = false;
+
+	while(nwrote < count) {
+		{
+			LOCK(_lock);
+			if(!_readers) {
+				broken = true;
+				break;
+			}
+
+			//Writes of up to PIPE_BUF bytes must go in all at once, larger ones can be split up
+			size_t space = _queue.capacity() - _queue.size();
+			size_t needed = count <= PIPE_BUF ? count : 1;
+			if(space >= needed) {
+				while(nwrote < count && _queue.size() < _queue.capacity()) {
+					size_t span_length;
+					auto* span = _queue.back_span(span_length);
+					span_length = min(span_length, count - nwrote);
+					buffer.read(span, nwrote, span_length);
+					_queue.commit_back(span_length);
+					nwrote += span_length;
+				}
+				_read_blocker.set_ready(true);
+				TaskManager::notify_io();
+				continue;
+			}
+
+			if(fd.nonblock())
+				return nwrote ? nwrote : -EAGAIN;
+			_write_blocker.set_ready(false);
+		}
+
+		TaskManager::current_thread()->block(_write_blocker);
+		if(_write_blocker.was_interrupted())
+			return nwrote ? nwrote : -EINTR;
 	}
 
-	if(nwrote)
-		_blocker.set_ready(true);
+	if(broken) {
+		TaskManager::current_process()->kill(SIGPIPE);
+		return nwrote ? nwrote : -EPIPE;
+	}
 
 	return nwrote;
 }
 
+int Pipe::ioctl(unsigned int request, SafePointer<void*> argp) {
+	switch(request) {
+		case FIONREAD: {
+			LOCK(_lock);
+			SafePointer<int>(argp).set((int) _queue.size());
+			return SUCCESS;
+		}
+		case PIPEGETSZ:
+			return (int) _queue.capacity();
+		case PIPESETSZ:
+			return set_capacity((size_t) argp.raw()).code();
+		default:
+			return -EINVAL;
+	}
+}
+
 bool Pipe::is_fifo() {
 	return true;
 }
@@ -90,3 +189,7 @@ bool Pipe::is_fifo() {
 bool Pipe::can_read(const FileDescriptor& fd) {
 	return !_queue.empty() && !fd.is_fifo_writer();
 }
+
+bool Pipe::can_write(const FileDescriptor& fd) {
+	return _queue.size() < _queue.capacity() || !_readers;
+}
@@ -24,31 +24,40 @@
 #include <kernel/kstd/circular_queue.hpp>
 #include <kernel/tasking/SpinLock.h>
 
+/** The default capacity of a pipe. **/
 #define PIPE_SIZE PAGE_SIZE
+/** The largest capacity a pipe can be resized to. **/
+#define PIPE_MAX_SIZE (PAGE_SIZE * 16)
+/** Writes of up to this many bytes to a pipe are atomic, i.e. won't be interleaved with other writes. **/
+#define PIPE_BUF 4096
 
 class Pipe: public File {
 public:
 	//Pipe
-	Pipe();
+	explicit Pipe(size_t capacity = PIPE_SIZE);
 	~Pipe();
 
 	void add_reader();
 	void add_writer();
 	void remove_reader();
 	void remove_writer();
+	/** Resizes the pipe's buffer. Fails if the new capacity can't hold the data currently in the pipe. **/
+	Result set_capacity(size_t capacity);
 
 	//File
 	ssize_t read(FileDescriptor& fd, size_t offset, SafePointer<uint8_t> buffer, size_t count) override;
 	ssize_t write(FileDescriptor& fd, size_t offset, SafePointer<uint8_t> buffer, size_t count) override;
+	int ioctl(unsigned request, SafePointer<void*> argp) override;
 	bool is_fifo() override;
 	bool can_read(const FileDescriptor& fd) override;
+	bool can_write(const FileDescriptor& fd) override;
 
 private:
 	kstd::circular_queue<uint8_t> _queue;
 	size_t _readers = 0;
 	size_t _writers = 0;
-	BooleanBlocker _blocker;
+	BooleanBlocker _read_blocker;
+	BooleanBlocker _write_blocker;
 	SpinLock _lock;
 };
 
-
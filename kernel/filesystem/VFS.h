@@ -74,6 +74,9 @@ public:
 	static kstd::string path_minus_base(const kstd::string& path);
 
 private:
+	ResultRet<kstd::Arc<Inode>> find_child(const kstd::Arc<Inode>& dir, const kstd::string& name);
+	static void invalidate_dentry(const kstd::Arc<Inode>& dir, const kstd::string& name);
+
 	kstd::Arc<Inode> _root_inode;
 	kstd::Arc<LinkedInode> _root_ref;
 	kstd::vector<Mount> mounts;
@@ -41,8 +41,27 @@
 #define EXT2_IMMUTABLE 0x10
 #define EXT2_APPEND_ONLY 0x20
 #define EXT2_DUMP_EXCLUDE 0x40
+#define EXT2_INDEX_FL 0x1000 //Directory is indexed with an HTree
 #define EXT2_JOURNAL_FILE 0x40000
 
+//optional (compat) features
+#define EXT2_FEATURE_COMPAT_DIR_INDEX 0x20
+
+//superblock flags
+#define EXT2_FLAGS_SIGNED_HASH 0x1
+#define EXT2_FLAGS_UNSIGNED_HASH 0x2
+
+//HTree directory hash versions
+#define EXT2_DX_HASH_LEGACY 0
+#define EXT2_DX_HASH_HALF_MD4 1
+#define EXT2_DX_HASH_TEA 2
+#define EXT2_DX_HASH_LEGACY_UNSIGNED 3
+#define EXT2_DX_HASH_HALF_MD4_UNSIGNED 4
+#define EXT2_DX_HASH_TEA_UNSIGNED 5
+
+//An HTree can have the root and at most one level of interior nodes above its leaves
+#define EXT2_DX_MAX_LEVELS 2
+
 #define EXT2_FT_UNKNOWN	0
 #define EXT2_FT_REG_FILE 1
 #define EXT2_FT_DIR	2
@@ -97,7 +116,11 @@ typedef struct __attribute__((packed)) ext2_superblock {
 	uint32_t journal_inode;
 	uint32_t journal_device;
 	uint32_t orphan_inode_head;
-	uint8_t extra[276];
+	uint32_t hash_seed[4];
+	uint8_t default_hash_version;
+	uint8_t unused2[99];
+	uint32_t flags;
+	uint8_t extra[156];
 } ext2_superblock;
 
 typedef struct __attribute__((packed)) ext2_block_group_descriptor {
@@ -116,3 +139,28 @@ typedef struct __attribute__((packed)) ext2_directory {
 	uint8_t name_length;
 	uint8_t type;
 } ext2_directory;
+
+/*
+ * HTree (dir_index) structures. The root of the tree lives in the first block of the directory, after the "." and ".."
+ * entries (".." spans the rest of the block so that the index is invisible to code that doesn't know about it).
+ * Interior nodes are whole blocks that look like a single empty directory entry. Leaves are normal directory blocks.
+ */
+
+typedef struct __attribute__((packed)) ext2_dx_root_info {
+	uint32_t reserved_zero;
+	uint8_t hash_version;
+	uint8_t info_length; //Always 8
+	uint8_t indirect_levels;
+	uint8_t unused_flags;
+} ext2_dx_root_info;
+
+//Overlaps the hash of the first entry in each node, whose hash is implicitly 0
+typedef struct __attribute__((packed)) ext2_dx_countlimit {
+	uint16_t limit;
+	uint16_t count;
+} ext2_dx_countlimit;
+
+typedef struct __attribute__((packed)) ext2_dx_entry {
+	uint32_t hash; //The lowest bit is set if the entry continues a run of names with the same hash from the previous block
+	uint32_t block; //The logical block in the directory
+} ext2_dx_entry;
@@ -41,8 +41,14 @@ void Ext2BlockGroup::write() {
 	buf.free_inodes = free_inodes;
 	buf.num_directories = num_directories;
 	fs->write_block_group_raw(num, &buf);
+	dirty = false;
 }
 
 uint32_t Ext2BlockGroup::first_block() {
 	return num * fs->superblock.blocks_per_group + (fs->block_size() == 1024 ? 1 : 0);
 }
+
+uint32_t Ext2BlockGroup::num_blocks() {
+	//The last group may be cut short by the end of the filesystem
+	return min(fs->superblock.blocks_per_group, fs->superblock.total_blocks - first_block());
+}
@@ -20,6 +20,7 @@
 #pragma once
 
 #include <kernel/kstd/unix_types.h>
+#include <kernel/kstd/vector.hpp>
 
 class Ext2Filesystem;
 class Ext2BlockGroup {
@@ -27,6 +28,7 @@ public:
 	Ext2BlockGroup(Ext2Filesystem* fs, uint32_t num);
 	void write();
 	uint32_t first_block();
+	uint32_t num_blocks();
 
 	Ext2Filesystem* fs;
 	uint32_t num;
@@ -36,6 +38,10 @@ public:
 	uint16_t free_blocks;
 	uint16_t free_inodes;
 	uint16_t num_directories;
+
+	kstd::vector<uint8_t> block_bitmap; ///< The block bitmap, cached once blocks in the group are allocated or freed.
+	bool block_bitmap_dirty = false; ///< Whether the cached block bitmap has changed since it was written.
+	bool dirty = false; ///< Whether the descriptor has changed since it was written.
 };
 
 
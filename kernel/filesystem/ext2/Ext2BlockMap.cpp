@@ -0,0 +1,326 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later */
+/* Copyright © 2016-2023 Byteduck */
+
+#include "Ext2BlockMap.h"
+#include "Ext2Filesystem.h"
+#include <kernel/kstd/KLog.h>
+
+Ext2BlockMap::Ext2BlockMap(Ext2Filesystem& fs, uint32_t* pointers):
+	m_fs(fs), m_pointers(pointers), m_pointers_per_block(fs.block_size() / sizeof(uint32_t)) {}
+
+Ext2BlockMap::~Ext2BlockMap() {
+	for(auto& entry : m_cache)
+		kfree(entry.pointers);
+}
+
+uint32_t Ext2BlockMap::get(uint32_t index) {
+	uint32_t run_length;
+	return resolve(index, run_length);
+}
+
+uint32_t Ext2BlockMap::get_run(uint32_t index, uint32_t max_length, uint32_t& run_length) {
+	uint32_t block = resolve(index, run_length);
+	if(!block) {
+		run_length = 1;
+		return 0;
+	}
+
+	//The run might carry on past the indirect block it was found in
+	while(run_length < max_length) {
+		uint32_t next_length;
+		if(resolve(index + run_length, next_length) != block + run_length)
+			break;
+		run_length += next_length;
+	}
+
+	run_length = max(min(run_length, max_length), (uint32_t) 1);
+	return block;
+}
+
+Result Ext2BlockMap::set(uint32_t index, uint32_t block, uint32_t& indirect_allocated) {
+	uint32_t offsets[3];
+	int depth = find_path(index, offsets);
+	if(depth < 0)
+		return Result(-EFBIG);
+
+	uncache_extent(index);
+	if(depth == 0) {
+		m_pointers[index] = block;
+		return Result(SUCCESS);
+	}
+
+	//Walk down the indirect blocks, allocating the ones that don't exist yet
+	uint32_t* pointer = &m_pointers[11 + depth];
+	uint32_t parent = 0;
+	uint32_t* parent_pointers = nullptr;
+	for(int level = 0; level < depth; level++) {
+		if(!*pointer) {
+			if(!block)
+				return Result(SUCCESS);
+			uint32_t new_block = m_fs.allocate_block(true);
+			if(!new_block)
+				return Result(-ENOSPC);
+			*pointer = new_block;
+			indirect_allocated++;
+			if(parent) {
+				auto res = m_fs.write_block(parent, (uint8_t*) parent_pointers);
+				if(res.is_error())
+					return res;
+			}
+		}
+
+		parent = *pointer;
+		parent_pointers = read_indirect(parent);
+		if(!parent_pointers)
+			return Result(-EIO);
+		pointer = &parent_pointers[offsets[level]];
+	}
+
+	*pointer = block;
+	auto res = m_fs.write_block(parent, (uint8_t*) parent_pointers);
+	if(res.is_error())
+		return res;
+	if(block)
+		cache_extent(index, block, 1);
+	return Result(SUCCESS);
+}
+
+Result Ext2BlockMap::truncate(uint32_t num_blocks, uint32_t old_num_blocks, kstd::vector<uint32_t>& freed) {
+	//Indirect blocks are about to be changed or freed, so don't keep stale copies of them around
+	invalidate();
+
+	for(uint32_t i = num_blocks; i < 12 && i < old_num_blocks; i++) {
+		if(m_pointers[i]) {
+			freed.push_back(m_pointers[i]);
+			m_pointers[i] = 0;
+		}
+	}
+
+	uint64_t first_index = 12;
+	uint64_t span = m_pointers_per_block;
+	for(int depth = 1; depth <= 3 && first_index < old_num_blocks; depth++) {
+		if(m_pointers[11 + depth] && first_index + span > num_blocks) {
+			auto res = truncate_indirect(&m_pointers[11 + depth], depth, first_index, num_blocks, old_num_blocks, freed);
+			if(res.is_error())
+				return res;
+		}
+		first_index += span;
+		span *= m_pointers_per_block;
+	}
+
+	return Result(SUCCESS);
+}
+
+void Ext2BlockMap::invalidate() {
+	m_extents = kstd::vector<Extent>();
+	for(auto& entry : m_cache)
+		entry.block = 0;
+}
+
+int Ext2BlockMap::find_path(uint32_t index, uint32_t offsets[3]) {
+	uint32_t ppb = m_pointers_per_block;
+	if(index < 12)
+		return 0;
+
+	index -= 12;
+	if(index < ppb) {
+		offsets[0] = index;
+		return 1;
+	}
+
+	index -= ppb;
+	if(index < ppb * ppb) {
+		offsets[0] = index / ppb;
+		offsets[1] = index % ppb;
+		return 2;
+	}
+
+	index -= ppb * ppb;
+	if(index / ppb / ppb >= ppb)
+		return -1;
+	offsets[0] = index / ppb / ppb;
+	offsets[1] = (index / ppb) % ppb;
+	offsets[2] = index % ppb;
+	return 3;
+}
+
+uint32_t Ext2BlockMap::resolve(uint32_t index, uint32_t& run_length) {
+	run_length = 1;
+	uint32_t offsets[3];
+	int depth = find_path(index, offsets);
+	if(depth < 0)
+		return 0;
+
+	if(depth == 0) {
+		uint32_t block = m_pointers[index];
+		while(block && index + run_length < 12 && m_pointers[index + run_length] == block + run_length)
+			run_length++;
+		return block;
+	}
+
+	//See if it's in a run we've already looked up
+	size_t position = find_extent(index);
+	if(position) {
+		auto& extent = m_extents[position - 1];
+		if(index < extent.index + extent.length) {
+			run_length = extent.index + extent.length - index;
+			return extent.block + (index - extent.index);
+		}
+	}
+
+	//If not, walk down the indirect blocks to find it
+	uint32_t block = m_pointers[11 + depth];
+	uint32_t* pointers = nullptr;
+	for(int level = 0; level < depth; level++) {
+		if(!block)
+			return 0;
+		pointers = read_indirect(block);
+		if(!pointers)
+			return 0;
+		block = pointers[offsets[level]];
+	}
+	if(!block)
+		return 0;
+
+	//The rest of the blocks in the same indirect block that carry on contiguously are part of the same run
+	uint32_t offset = offsets[depth - 1];
+	while(offset + run_length < m_pointers_per_block && pointers[offset + run_length] == block + run_length)
+		run_length++;
+	cache_extent(index, block, run_length);
+	return block;
+}
+
+uint32_t* Ext2BlockMap::read_indirect(uint32_t block) {
+	CachedBlock* victim = &m_cache[0];
+	for(auto& entry : m_cache) {
+		if(entry.block == block) {
+			entry.last_used = ++m_cache_clock;
+			return entry.pointers;
+		}
+		if(entry.last_used < victim->last_used || !entry.block)
+			victim = &entry;
+	}
+
+	if(!victim->pointers)
+		victim->pointers = (uint32_t*) kmalloc(m_fs.block_size());
+	auto res = m_fs.read_block(block, (uint8_t*) victim->pointers);
+	if(res.is_error()) {
+		KLog::err("ext2", "Error %d reading indirect block %d", res.code(), block);
+		victim->block = 0;
+		return nullptr;
+	}
+	victim->block = block;
+	victim->last_used = ++m_cache_clock;
+	return victim->pointers;
+}
+
+size_t Ext2BlockMap::find_extent(uint32_t index) {
+	//Finds the number of runs that start at or before index
+	size_t low = 0, high = m_extents.size();
+	while(low < high) {
+		size_t mid = (low + high) / 2;
+		if(m_extents[mid].index <= index)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+	return low;
+}
+
+void Ext2BlockMap::insert_extent(size_t position, const Extent& extent) {
+	m_extents.push_back(extent);
+	for(size_t i = m_extents.size() - 1; i > position; i--)
+		m_extents[i] = m_extents[i - 1];
+	m_extents[position] = extent;
+}
+
+void Ext2BlockMap::cache_extent(uint32_t index, uint32_t block, uint32_t length) {
+	if(m_extents.size() >= EXT2_BLOCK_MAP_MAX_EXTENTS)
+		m_extents = kstd::vector<Extent>();
+
+	//Either extend the run before this one, or add a new one
+	size_t position = find_extent(index);
+	if(position && m_extents[position - 1].index + m_extents[position - 1].length == index && m_extents[position - 1].block + m_extents[position - 1].length == block) {
+		position--;
+		m_extents[position].length += length;
+	} else {
+		insert_extent(position, {index, block, length});
+	}
+
+	//Then swallow the runs after it that it now overlaps or runs into
+	auto& extent = m_extents[position];
+	while(position + 1 < m_extents.size()) {
+		auto& next = m_extents[position + 1];
+		uint32_t end = extent.index + extent.length;
+		if(next.index > end)
+			break;
+		if(next.block - next.index != extent.block - extent.index) {
+			extent.length = next.index - extent.index;
+			break;
+		}
+		extent.length = max(end, next.index + next.length) - extent.index;
+		m_extents.erase(position + 1);
+	}
+}
+
+void Ext2BlockMap::uncache_extent(uint32_t index) {
+	size_t position = find_extent(index);
+	if(!position)
+		return;
+	Extent extent = m_extents[position - 1];
+	if(index >= extent.index + extent.length)
+		return;
+
+	//Split the run around the block
+	m_extents.erase(position - 1);
+	if(extent.index + extent.length > index + 1)
+		insert_extent(position - 1, {index + 1, extent.block + (index + 1 - extent.index), extent.index + extent.length - index - 1});
+	if(index > extent.index)
+		insert_extent(position - 1, {extent.index, extent.block, index - extent.index});
+}
+
+Result Ext2BlockMap::truncate_indirect(uint32_t* pointer, int depth, uint32_t first_index, uint32_t num_blocks, uint32_t old_num_blocks, kstd::vector<uint32_t>& freed) {
+	uint64_t child_span = 1;
+	for(int i = 1; i < depth; i++)
+		child_span *= m_pointers_per_block;
+
+	//Use a buffer of our own, since we'll be recursing into other indirect blocks while this one is being changed
+	auto* pointers = (uint32_t*) kmalloc(m_fs.block_size());
+	auto res = m_fs.read_block(*pointer, (uint8_t*) pointers);
+	if(res.is_error()) {
+		kfree(pointers);
+		return res;
+	}
+
+	bool modified = false;
+	for(uint32_t i = 0; i < m_pointers_per_block; i++) {
+		uint64_t child_first = first_index + i * child_span;
+		if(child_first >= old_num_blocks)
+			break;
+		if(!pointers[i] || child_first + child_span <= num_blocks)
+			continue;
+
+		if(depth == 1) {
+			freed.push_back(pointers[i]);
+			pointers[i] = 0;
+		} else {
+			res = truncate_indirect(&pointers[i], depth - 1, child_first, num_blocks, old_num_blocks, freed);
+			if(res.is_error())
+				break;
+		}
+		modified |= !pointers[i];
+	}
+
+	//Free this block if nothing it maps is left, or write it back if it changed
+	if(res.is_success() && first_index >= num_blocks) {
+		freed.push_back(*pointer);
+		*pointer = 0;
+	} else if(modified) {
+		auto write_res = m_fs.write_block(*pointer, (uint8_t*) pointers);
+		if(res.is_success())
+			res = write_res;
+	}
+
+	kfree(pointers);
+	return res;
+}
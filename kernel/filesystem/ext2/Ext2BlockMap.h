@@ -0,0 +1,85 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later */
+/* Copyright © 2016-2023 Byteduck */
+
+#pragma once
+
+#include <kernel/kstd/vector.hpp>
+#include <kernel/kstd/types.h>
+#include <kernel/Result.hpp>
+
+/** How many of an inode's indirect blocks are kept in memory. **/
+#define EXT2_BLOCK_MAP_CACHED_BLOCKS 4
+/** The most runs of contiguous blocks an inode remembers before it forgets them all and starts over. **/
+#define EXT2_BLOCK_MAP_MAX_EXTENTS 128
+
+class Ext2Filesystem;
+
+/**
+ * Maps the blocks of an inode to blocks on disk. Indirect blocks are only read when a block they map is looked up, and
+ * the mappings found are remembered as runs of contiguous blocks, so a large file that was written sequentially only
+ * takes a handful of entries to describe. The most recently used indirect blocks are cached as well.
+ */
+class Ext2BlockMap {
+public:
+	/**
+	 * @param pointers The fifteen block pointers in the inode: twelve direct ones, followed by the singly, doubly, and
+	 *                 triply indirect ones.
+	 */
+	Ext2BlockMap(Ext2Filesystem& fs, uint32_t* pointers);
+	~Ext2BlockMap();
+	Ext2BlockMap(const Ext2BlockMap& other) = delete;
+
+	/** @return The block on disk that a block of the file is in, or 0 if it's a hole or couldn't be read. **/
+	uint32_t get(uint32_t index);
+
+	/**
+	 * Like get(), but also finds how many of the blocks after it are contiguous with it on disk.
+	 * @param run_length Set to the length of the run (at most max_length), or 1 if the block is a hole.
+	 */
+	uint32_t get_run(uint32_t index, uint32_t max_length, uint32_t& run_length);
+
+	/**
+	 * Maps a block of the file to a block on disk, allocating any indirect blocks needed to do so.
+	 * @param indirect_allocated Incremented by the number of indirect blocks that were allocated.
+	 */
+	Result set(uint32_t index, uint32_t block, uint32_t& indirect_allocated);
+
+	/**
+	 * Unmaps every block from num_blocks onwards, along with the indirect blocks that are no longer needed.
+	 * @param old_num_blocks The number of blocks the file had before, so that we don't look any further than that.
+	 * @param freed The blocks that were unmapped are added to this, so that they can be freed all at once.
+	 */
+	Result truncate(uint32_t num_blocks, uint32_t old_num_blocks, kstd::vector<uint32_t>& freed);
+
+	/** Forgets all of the mappings and indirect blocks that are cached. **/
+	void invalidate();
+
+private:
+	struct Extent {
+		uint32_t index;
+		uint32_t block;
+		uint32_t length;
+	};
+
+	struct CachedBlock {
+		uint32_t block = 0;
+		uint32_t last_used = 0;
+		uint32_t* pointers = nullptr;
+	};
+
+	int find_path(uint32_t index, uint32_t offsets[3]);
+	uint32_t resolve(uint32_t index, uint32_t& run_length);
+	uint32_t* read_indirect(uint32_t block);
+	size_t find_extent(uint32_t index);
+	void insert_extent(size_t position, const Extent& extent);
+	void cache_extent(uint32_t index, uint32_t block, uint32_t length);
+	void uncache_extent(uint32_t index);
+	Result truncate_indirect(uint32_t* pointer, int depth, uint32_t first_index, uint32_t num_blocks, uint32_t old_num_blocks, kstd::vector<uint32_t>& freed);
+
+	Ext2Filesystem& m_fs;
+	uint32_t* m_pointers;
+	uint32_t m_pointers_per_block;
+	kstd::vector<Extent> m_extents; ///< Runs of blocks that have been looked up, sorted by index.
+	CachedBlock m_cache[EXT2_BLOCK_MAP_CACHED_BLOCKS];
+	uint32_t m_cache_clock = 0;
+};
@@ -0,0 +1,194 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later */
+/* Copyright © 2016-2023 Byteduck */
+
+#include "Ext2DirectoryIndex.h"
+#include "Ext2.h"
+
+/*
+ * The HTree hash functions. These have to match the ones in Linux and e2fsprogs exactly, since the hashes are stored on
+ * disk. "Signed" versions treat the bytes of names as signed chars, which is what they are on x86.
+ */
+
+static inline uint32_t rotl(uint32_t x, int shift) {
+	return (x << shift) | (x >> (32 - shift));
+}
+
+static uint32_t dx_legacy_hash(const char* name, size_t length, bool is_unsigned) {
+	uint32_t hash, hash0 = 0x12a3fe2d, hash1 = 0x37abe8f9;
+	for(size_t i = 0; i < length; i++) {
+		int c = is_unsigned ? (int) (uint8_t) name[i] : (int) (int8_t) name[i];
+		hash = hash1 + (hash0 ^ (uint32_t) (c * 7152373));
+		if(hash & 0x80000000)
+			hash -= 0x7fffffff;
+		hash1 = hash0;
+		hash0 = hash;
+	}
+	return hash0 << 1;
+}
+
+/** Packs up to num * 4 bytes of a name into num words, padding with the name's length. **/
+static void dx_pack_name(const char* name, size_t length, uint32_t* buf, int num, bool is_unsigned) {
+	uint32_t pad = (uint32_t) length | ((uint32_t) length << 8);
+	pad |= pad << 16;
+
+	uint32_t val = pad;
+	if(length > (size_t) num * 4)
+		length = num * 4;
+	for(size_t i = 0; i < length; i++) {
+		int c = is_unsigned ? (int) (uint8_t) name[i] : (int) (int8_t) name[i];
+		val = (uint32_t) c + (val << 8);
+		if((i % 4) == 3) {
+			*buf++ = val;
+			val = pad;
+			num--;
+		}
+	}
+	if(--num >= 0)
+		*buf++ = val;
+	while(--num >= 0)
+		*buf++ = pad;
+}
+
+#define MD4_F(x, y, z) ((z) ^ ((x) & ((y) ^ (z))))
+#define MD4_G(x, y, z) (((x) & (y)) + (((x) ^ (y)) & (z)))
+#define MD4_H(x, y, z) ((x) ^ (y) ^ (z))
+#define MD4_ROUND(f, a, b, c, d, x, s) (a += f(b, c, d) + (x), a = rotl(a, s))
+#define MD4_K2 013240474631u
+#define MD4_K3 015666365641u
+
+static void dx_half_md4_transform(uint32_t buf[4], const uint32_t in[8]) {
+	uint32_t a = buf[0], b = buf[1], c = buf[2], d = buf[3];
+
+	MD4_ROUND(MD4_F, a, b, c, d, in[0], 3);
+	MD4_ROUND(MD4_F, d, a, b, c, in[1], 7);
+	MD4_ROUND(MD4_F, c, d, a, b, in[2], 11);
+	MD4_ROUND(MD4_F, b, c, d, a, in[3], 19);
+	MD4_ROUND(MD4_F, a, b, c, d, in[4], 3);
+	MD4_ROUND(MD4_F, d, a, b, c, in[5], 7);
+	MD4_ROUND(MD4_F, c, d, a, b, in[6], 11);
+	MD4_ROUND(MD4_F, b, c, d, a, in[7], 19);
+
+	MD4_ROUND(MD4_G, a, b, c, d, in[1] + MD4_K2, 3);
+	MD4_ROUND(MD4_G, d, a, b, c, in[3] + MD4_K2, 5);
+	MD4_ROUND(MD4_G, c, d, a, b, in[5] + MD4_K2, 9);
+	MD4_ROUND(MD4_G, b, c, d, a, in[7] + MD4_K2, 13);
+	MD4_ROUND(MD4_G, a, b, c, d, in[0] + MD4_K2, 3);
+	MD4_ROUND(MD4_G, d, a, b, c, in[2] + MD4_K2, 5);
+	MD4_ROUND(MD4_G, c, d, a, b, in[4] + MD4_K2, 9);
+	MD4_ROUND(MD4_G, b, c, d, a, in[6] + MD4_K2, 13);
+
+	MD4_ROUND(MD4_H, a, b, c, d, in[3] + MD4_K3, 3);
+	MD4_ROUND(MD4_H, d, a, b, c, in[7] + MD4_K3, 9);
+	MD4_ROUND(MD4_H, c, d, a, b, in[2] + MD4_K3, 11);
+	MD4_ROUND(MD4_H, b, c, d, a, in[6] + MD4_K3, 15);
+	MD4_ROUND(MD4_H, a, b, c, d, in[1] + MD4_K3, 3);
+	MD4_ROUND(MD4_H, d, a, b, c, in[5] + MD4_K3, 9);
+	MD4_ROUND(MD4_H, c, d, a, b, in[0] + MD4_K3, 11);
+	MD4_ROUND(MD4_H, b, c, d, a, in[4] + MD4_K3, 15);
+
+	buf[0] += a;
+	buf[1] += b;
+	buf[2] += c;
+	buf[3] += d;
+}
+
+static void dx_tea_transform(uint32_t buf[4], const uint32_t in[4]) {
+	uint32_t sum = 0;
+	uint32_t b0 = buf[0], b1 = buf[1];
+	uint32_t a = in[0], b = in[1], c = in[2], d = in[3];
+	for(int n = 0; n < 16; n++) {
+		sum += 0x9E3779B9;
+		b0 += ((b1 << 4) + a) ^ (b1 + sum) ^ ((b1 >> 5) + b);
+		b1 += ((b0 << 4) + c) ^ (b0 + sum) ^ ((b0 >> 5) + d);
+	}
+	buf[0] += b0;
+	buf[1] += b1;
+}
+
+uint32_t ext2_dx_hash(const char* name, size_t length, uint8_t version, const uint32_t seed[4]) {
+	uint32_t buf[4] = {0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476};
+	if(seed[0] || seed[1] || seed[2] || seed[3]) {
+		for(int i = 0; i < 4; i++)
+			buf[i] = seed[i];
+	}
+
+	uint32_t hash;
+	uint32_t in[8];
+	bool is_unsigned = version >= EXT2_DX_HASH_LEGACY_UNSIGNED;
+	switch(version) {
+		case EXT2_DX_HASH_LEGACY:
+		case EXT2_DX_HASH_LEGACY_UNSIGNED:
+			hash = dx_legacy_hash(name, length, is_unsigned);
+			break;
+
+		case EXT2_DX_HASH_HALF_MD4:
+		case EXT2_DX_HASH_HALF_MD4_UNSIGNED:
+			for(size_t i = 0; i < length; i += 32) {
+				dx_pack_name(name + i, length - i, in, 8, is_unsigned);
+				dx_half_md4_transform(buf, in);
+			}
+			hash = buf[1];
+			break;
+
+		case EXT2_DX_HASH_TEA:
+		case EXT2_DX_HASH_TEA_UNSIGNED:
+			for(size_t i = 0; i < length; i += 16) {
+				dx_pack_name(name + i, length - i, in, 4, is_unsigned);
+				dx_tea_transform(buf, in);
+			}
+			hash = buf[0];
+			break;
+
+		default:
+			return 0;
+	}
+
+	// The lowest bit of hashes in index entries is used to mark collisions, and the highest hash is reserved for EOF
+	hash &= ~1u;
+	if(hash == (0x7fffffffu << 1))
+		hash = (0x7fffffffu - 1) << 1;
+	return hash;
+}
+
+void Ext2DirectoryIndex::insert(uint32_t hash, uint32_t offset) {
+	if((m_used + 1) * 4 > m_slots.size() * 3)
+		rehash(m_slots.empty() ? 64 : m_slots.size() * 2);
+	size_t mask = m_slots.size() - 1;
+	size_t i = hash & mask;
+	while(m_slots[i].offset != EMPTY && m_slots[i].offset != REMOVED)
+		i = (i + 1) & mask;
+	if(m_slots[i].offset == EMPTY)
+		m_used++;
+	m_slots[i] = {hash, offset};
+}
+
+void Ext2DirectoryIndex::remove(uint32_t hash, uint32_t offset) {
+	if(m_slots.empty())
+		return;
+	size_t mask = m_slots.size() - 1;
+	for(size_t i = hash & mask; m_slots[i].offset != EMPTY; i = (i + 1) & mask) {
+		if(m_slots[i].offset == offset) {
+			m_slots[i].offset = REMOVED;
+			return;
+		}
+	}
+}
+
+void Ext2DirectoryIndex::rehash(size_t new_size) {
+	// Only count live entries when sizing, so that lots of removals don't make the table grow forever
+	size_t num_live = 0;
+	for(size_t i = 0; i < m_slots.size(); i++)
+		if(m_slots[i].offset != EMPTY && m_slots[i].offset != REMOVED)
+			num_live++;
+	while(new_size > 64 && (num_live + 1) * 2 < new_size / 2)
+		new_size /= 2;
+
+	auto old_slots = kstd::move(m_slots);
+	m_slots = kstd::vector<Slot>(new_size, {0, EMPTY});
+	m_used = 0;
+	for(size_t i = 0; i < old_slots.size(); i++) {
+		auto& slot = old_slots[i];
+		if(slot.offset != EMPTY && slot.offset != REMOVED)
+			insert(slot.hash, slot.offset);
+	}
+}
@@ -0,0 +1,65 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later */
+/* Copyright © 2016-2023 Byteduck */
+
+#pragma once
+
+#include <kernel/kstd/vector.hpp>
+#include <kernel/kstd/types.h>
+
+/** Directories with at least this many blocks that don't have an HTree get an in-memory index once they're searched. **/
+#define EXT2_DIR_INDEX_MIN_BLOCKS 4
+
+/**
+ * Computes the hash of a name that is used to look it up in an HTree directory.
+ * @param version One of the EXT2_DX_HASH_* versions.
+ * @param seed The hash seed from the superblock. If it's all zeroes, a default seed is used.
+ * @return The hash, with the lowest bit cleared.
+ */
+uint32_t ext2_dx_hash(const char* name, size_t length, uint8_t version, const uint32_t seed[4]);
+
+/**
+ * An in-memory index of the entries in a directory that doesn't have an HTree on disk. It maps the hash of each name to
+ * the offset of its entry in the directory (names aren't stored, so lookups have to check the entry on disk), and keeps
+ * track of the largest free gap in each block so that new entries can be placed without searching every block.
+ */
+class Ext2DirectoryIndex {
+public:
+	static constexpr uint32_t NO_OFFSET = 0xFFFFFFFF;
+
+	void insert(uint32_t hash, uint32_t offset);
+	void remove(uint32_t hash, uint32_t offset);
+
+	/**
+	 * Calls a function with the offset of each entry whose name has the given hash, until it returns true.
+	 * @return The offset the function returned true for, or NO_OFFSET.
+	 */
+	template<typename F>
+	uint32_t find(uint32_t hash, F callback) const {
+		if(m_slots.empty())
+			return NO_OFFSET;
+		size_t mask = m_slots.size() - 1;
+		for(size_t i = hash & mask; m_slots[i].offset != EMPTY; i = (i + 1) & mask) {
+			auto& slot = m_slots[i];
+			if(slot.offset != REMOVED && slot.hash == hash && callback(slot.offset))
+				return slot.offset;
+		}
+		return NO_OFFSET;
+	}
+
+	/** The largest number of contiguous free bytes in each block of the directory. **/
+	kstd::vector<uint16_t> block_free;
+
+private:
+	static constexpr uint32_t EMPTY = 0xFFFFFFFF;
+	static constexpr uint32_t REMOVED = 0xFFFFFFFE;
+
+	struct Slot {
+		uint32_t hash;
+		uint32_t offset;
+	};
+
+	void rehash(size_t new_size);
+
+	kstd::vector<Slot> m_slots;
+	size_t m_used = 0; ///< The number of slots that aren't empty, including removed ones.
+};
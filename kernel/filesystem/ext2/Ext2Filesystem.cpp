@@ -213,9 +213,13 @@ ino_t Ext2Filesystem::root_inode_id() {
 	return 2;
 }
 
+bool Ext2Filesystem::caches_dentries() {
+	return true;
+}
+
 Result Ext2Filesystem::read_block_group_raw(uint32_t block_group, ext2_block_group_descriptor* buffer) {
 	uint8_t block_buf[block_size()];
-	auto ret = read_block(2 + (block_group * sizeof(ext2_block_group_descriptor)) / block_size(), block_buf);
+	auto ret = read_block(block_group_descriptor_table + (block_group * sizeof(ext2_block_group_descriptor)) / block_size(), block_buf);
 	auto* d = (ext2_block_group_descriptor*) block_buf;
 	d += block_group % (block_size() / sizeof(ext2_block_group_descriptor));
 	memcpy((void*) buffer, d, sizeof(ext2_block_group_descriptor));
@@ -224,125 +228,204 @@ Result Ext2Filesystem::read_block_group_raw(uint32_t block_group, ext2_block_gro
 
 Result Ext2Filesystem::write_block_group_raw(uint32_t block_group, const ext2_block_group_descriptor *buffer) {
 	uint8_t block_buf[block_size()];
-	auto res = read_block(2 + (block_group * sizeof(ext2_block_group_descriptor)) / block_size(), block_buf);
+	auto res = read_block(block_group_descriptor_table + (block_group * sizeof(ext2_block_group_descriptor)) / block_size(), block_buf);
 	if(res.is_error())
 		return res;
 
 	auto* d = (ext2_block_group_descriptor*) block_buf;
 	d += block_group % (block_size() / sizeof(ext2_block_group_descriptor));
 	memcpy(d, buffer, sizeof(ext2_block_group_descriptor));
-	auto write_successful = write_block(2 + (block_group * sizeof(ext2_block_group_descriptor)) / block_size(), block_buf);
+	auto write_successful = write_block(block_group_descriptor_table + (block_group * sizeof(ext2_block_group_descriptor)) / block_size(), block_buf);
 
 	return write_successful;
 }
 
-ResultRet<kstd::vector<uint32_t>> Ext2Filesystem::allocate_blocks_in_group(Ext2BlockGroup* group, uint32_t num_blocks, bool zero_out) {
-	if(group->free_blocks < num_blocks) return Result(-ENOSPC);
-	if(num_blocks == 0) return kstd::vector<uint32_t>(0);
+size_t Ext2Filesystem::find_free_run(const uint8_t* bitmap, size_t num_bits, size_t start, size_t max_length, size_t& length) {
+	auto* words = (const uint32_t*) bitmap;
 
-	LOCK(ext2lock);
-	uint8_t block_buf[block_size()];
+	//Find the first clear bit, skipping over words that are full
+	size_t first = start;
+	while(first < num_bits) {
+		uint32_t clear_bits = ~words[first / 32] & (0xFFFFFFFFu << (first % 32));
+		if(clear_bits) {
+			first = (first & ~31u) + __builtin_ctz(clear_bits);
+			break;
+		}
+		first = (first & ~31u) + 32;
+	}
+	if(first >= num_bits || !max_length) {
+		length = 0;
+		return num_bits;
+	}
 
-	Result res = read_block(group->block_bitmap_block, block_buf);
+	//Then find where the run ends, skipping over words that are empty
+	size_t limit = min(num_bits, first + max_length);
+	size_t end = first;
+	while(end < limit) {
+		uint32_t set_bits = words[end / 32] & (0xFFFFFFFFu << (end % 32));
+		if(set_bits) {
+			end = (end & ~31u) + __builtin_ctz(set_bits);
+			break;
+		}
+		end = (end & ~31u) + 32;
+	}
+
+	length = min(end, limit) - first;
+	return first;
+}
+
+Result Ext2Filesystem::load_block_bitmap(Ext2BlockGroup* group) {
+	if(!group->block_bitmap.empty())
+		return Result(SUCCESS);
+
+	kstd::vector<uint8_t> bitmap(block_size());
+	Result res = read_block(group->block_bitmap_block, bitmap.storage());
 	if(res.is_error()) {
 		KLog::err("ext2", "Error %d reading block bitmap for group %d", res.code(), group->num);
 		return res;
 	}
+	group->block_bitmap = kstd::move(bitmap);
+	return Result(SUCCESS);
+}
 
-
-	uint32_t num_allocated = 0;
-	kstd::vector<uint32_t> ret;
-	ret.reserve(num_blocks);
-
-	for(size_t bi = 0; bi < superblock.blocks_per_group; bi++) {
-		if(!get_bitmap_bit(block_buf, bi)) {
-			set_bitmap_bit(block_buf, bi, true);
-			ret.push_back(bi + group->first_block());
-			if(zero_out) zero_block(bi + group->first_block());
-			group->free_blocks--;
-			superblock.free_blocks--;
-			if(++num_allocated == num_blocks) break;
+bool Ext2Filesystem::find_run_in_group(Ext2BlockGroup* group, uint32_t start, uint32_t min_length, uint32_t max_length, uint32_t& run_start, uint32_t& run_length) {
+	if(group->free_blocks < min_length || load_block_bitmap(group).is_error())
+		return false;
+
+	//Search from the starting point to the end of the group, and then from the beginning of the group up to it
+	uint32_t num_blocks = group->num_blocks();
+	for(int pass = 0; pass < 2; pass++) {
+		size_t index = pass ? 0 : start;
+		size_t end = pass ? start : num_blocks;
+		while(index < end) {
+			size_t length;
+			index = find_free_run(group->block_bitmap.storage(), num_blocks, index, max_length, length);
+			if(length >= min_length) {
+				run_start = index;
+				run_length = length;
+				return true;
+			}
+			index += length;
 		}
 	}
 
-	if(num_allocated != num_blocks) {
-		KLog::warn("ext2", "Free block count in block group %d was incorrect!", group->num);
-		group->free_blocks = 0;
-	}
+	return false;
+}
 
-	write_superblock();
-	group->write();
-	res = write_block(group->block_bitmap_block, block_buf);
-	if(res.is_error()) {
-		KLog::err("ext2", "Error writing block bitmap for block group %d!", group->num);
-		return res;
+void Ext2Filesystem::allocate_run(Ext2BlockGroup* group, uint32_t start, uint32_t length, kstd::vector<uint32_t>& blocks) {
+	for(uint32_t i = start; i < start + length; i++) {
+		set_bitmap_bit(group->block_bitmap.storage(), i, true);
+		blocks.push_back(group->first_block() + i);
 	}
-
-	return kstd::move(ret);
+	group->free_blocks -= length;
+	group->block_bitmap_dirty = true;
+	group->dirty = true;
+	superblock.free_blocks -= length;
+	superblock_dirty = true;
 }
 
-ResultRet<kstd::vector<uint32_t>> Ext2Filesystem::allocate_blocks(uint32_t num_blocks, bool zero_out) {
+ResultRet<kstd::vector<uint32_t>> Ext2Filesystem::allocate_blocks(uint32_t num_blocks, bool zero_out, uint32_t goal) {
 	LOCK(ext2lock);
 	if(num_blocks == 0) {
 		KLog::warn("ext2", "Tried to allocate zero ext2 blocks!");
 		return Result(-EINVAL);
 	}
 
-	//First, find a block group that can fit all the blocks, or at least the most spacious block group
-	Ext2BlockGroup* target_bg = nullptr;
-	Ext2BlockGroup* most_spacious_bg = nullptr;
-
-	for(uint32_t bgi = 0; bgi < num_block_groups; bgi++) {
-		Ext2BlockGroup *bg = get_block_group(bgi);
-		if (!bg) {
-			KLog::err("ext2", "Error getting block group %d!", bgi);
-			break;
-		}
-		if (bg->free_blocks >= num_blocks) {
-			target_bg = bg;
-			break;
-		}
-		if (!most_spacious_bg || bg->free_blocks > most_spacious_bg->free_blocks) most_spacious_bg = bg;
+	//Start looking at the goal, or at the start of the filesystem if there isn't one
+	uint32_t goal_group = 0;
+	uint32_t goal_index = 0;
+	if(goal >= superblock.superblock_block && goal < superblock.total_blocks) {
+		goal_group = block_group_of(goal);
+		goal_index = goal - get_block_group(goal_group)->first_block();
 	}
 
-	if(target_bg) {
-		//We found a block group that will house all of the blocks we need to allocate
-		return kstd::move(allocate_blocks_in_group(target_bg, num_blocks, zero_out));
-	} else {
-		//If we couldn't find one bg to fit all the blocks, allocate the blocks in multiple groups
-		kstd::vector<uint32_t> ret;
-		ret.reserve(num_blocks);
-		while(num_blocks) {
-			//Find the most spacious bg
-			most_spacious_bg = nullptr;
-			for(uint32_t bgi = 0; bgi < num_block_groups; bgi++) {
-				Ext2BlockGroup *bg = get_block_group(bgi);
-				if(!bg) continue; //This error would have been printed out above presumably
-				if (!most_spacious_bg || bg->free_blocks > most_spacious_bg->free_blocks) most_spacious_bg = bg;
+	kstd::vector<uint32_t> ret;
+	ret.reserve(num_blocks);
+	uint32_t run_start, run_length;
+
+	//If the goal is free, extend the file right where it leaves off
+	Ext2BlockGroup* group = get_block_group(goal_group);
+	if(goal && find_run_in_group(group, goal_index, 1, num_blocks, run_start, run_length) && run_start == goal_index)
+		allocate_run(group, run_start, run_length, ret);
+
+	//Next, look for a run that fits the rest of the blocks so they're contiguous. If there isn't one, use whatever's free.
+	for(int pass = 0; pass < 2 && ret.size() < num_blocks; pass++) {
+		for(uint32_t i = 0; i < num_block_groups && ret.size() < num_blocks; i++) {
+			group = get_block_group((goal_group + i) % num_block_groups);
+			uint32_t start = i ? 0 : goal_index;
+			while(ret.size() < num_blocks) {
+				uint32_t remaining = num_blocks - ret.size();
+				uint32_t min_length = pass ? 1 : min(remaining, group->num_blocks());
+				if(!find_run_in_group(group, start, min_length, remaining, run_start, run_length))
+					break;
+				allocate_run(group, run_start, run_length, ret);
+				start = run_start + run_length;
 			}
+		}
+	}
 
-			//If the most spacious bg has no free blocks, return ENOSPC
-			if(most_spacious_bg->free_blocks == 0) return Result(-ENOSPC);
-
-			//Allocate the needed amount of blocks in that group
-			auto res = allocate_blocks_in_group(most_spacious_bg, min(most_spacious_bg->free_blocks, num_blocks), zero_out);
-			if(res.is_error()) return res.result();
+	if(ret.size() != num_blocks) {
+		release_blocks(ret);
+		flush_metadata();
+		return Result(-ENOSPC);
+	}
 
-			//Push the blocks allocated into the return vector
-			num_blocks -= res.value().size();
-			for(size_t i = 0; i < res.value().size(); i++) ret.push_back(res.value()[i]);
+	//Zero out each contiguous run of blocks with one write
+	if(zero_out) {
+		for(size_t i = 0; i < ret.size();) {
+			size_t run = 1;
+			while(i + run < ret.size() && ret[i + run] == ret[i] + run)
+				run++;
+			zero_blocks(ret[i], run);
+			i += run;
 		}
-		return kstd::move(ret);
 	}
+
+	Result res = flush_metadata();
+	if(res.is_error())
+		return res;
+	return kstd::move(ret);
 }
 
-uint32_t Ext2Filesystem::allocate_block(bool zero_out) {
-	auto ret_or_err = allocate_blocks(1, zero_out);
+uint32_t Ext2Filesystem::allocate_block(bool zero_out, uint32_t goal) {
+	auto ret_or_err = allocate_blocks(1, zero_out, goal);
 	if(ret_or_err.is_error()) return 0;
 	if(ret_or_err.value().empty()) return 0;
 	return ret_or_err.value().at(0);
 }
 
+uint32_t Ext2Filesystem::prealloc_blocks() {
+	return superblock.file_prealloc_blocks ? superblock.file_prealloc_blocks : EXT2_DEFAULT_PREALLOC_BLOCKS;
+}
+
+void Ext2Filesystem::release_blocks(const kstd::vector<uint32_t>& blocks) {
+	for(size_t i = 0; i < blocks.size(); i++) {
+		uint32_t block = blocks[i];
+		if(!block)
+			continue;
+
+		Ext2BlockGroup* bg = get_block_group(block_group_of(block));
+		if(!bg) {
+			KLog::err("ext2", "Error getting block group %d!", block_group_of(block));
+			continue;
+		}
+		if(load_block_bitmap(bg).is_error())
+			continue;
+
+		uint32_t index = block - bg->first_block();
+		if(!get_bitmap_bit(bg->block_bitmap.storage(), index)) {
+			KLog::warn("ext2", "Tried to free ext2 block %d, which was already free!", block);
+			continue;
+		}
+		set_bitmap_bit(bg->block_bitmap.storage(), index, false);
+		bg->free_blocks++;
+		bg->block_bitmap_dirty = true;
+		bg->dirty = true;
+		superblock.free_blocks++;
+		superblock_dirty = true;
+	}
+}
+
 void Ext2Filesystem::free_block(uint32_t block) {
 	LOCK(ext2lock);
 
@@ -351,34 +434,83 @@ void Ext2Filesystem::free_block(uint32_t block) {
 		return;
 	}
 
-	uint32_t group_index = (block - 1) / superblock.blocks_per_group;
-	Ext2BlockGroup* bg = get_block_group(group_index);
-	if(!bg) {
-		KLog::err("ext2", "Error getting block group %d!", group_index);
-		return;
+	kstd::vector<uint32_t> blocks(1, block);
+	release_blocks(blocks);
+	flush_metadata();
+}
+
+void Ext2Filesystem::free_blocks(kstd::vector<uint32_t>& blocks) {
+	LOCK(ext2lock);
+	release_blocks(blocks);
+	flush_metadata();
+}
+
+Result Ext2Filesystem::flush_metadata() {
+	LOCK(ext2lock);
+	Result ret = Result(SUCCESS);
+
+	for(uint32_t i = 0; i < num_block_groups; i++) {
+		Ext2BlockGroup* bg = block_groups[i];
+		if(!bg || !bg->block_bitmap_dirty)
+			continue;
+		Result res = write_block(bg->block_bitmap_block, bg->block_bitmap.storage());
+		if(res.is_error()) {
+			KLog::err("ext2", "Error writing block bitmap for block group %d!", bg->num);
+			ret = res;
+			continue;
+		}
+		bg->block_bitmap_dirty = false;
 	}
 
-	//Update blockgroup
+	//Write the descriptors of changed groups a whole descriptor table block at a time
+	size_t descriptors_per_block = block_size() / sizeof(ext2_block_group_descriptor);
 	uint8_t block_buf[block_size()];
-	read_block(bg->block_bitmap_block, block_buf);
-	set_bitmap_bit(block_buf, block - bg->first_block(), false);
-	write_block(bg->block_bitmap_block, block_buf);
-	bg->free_blocks++;
+	for(uint32_t first = 0; first < num_block_groups; first += descriptors_per_block) {
+		uint32_t last = min(first + descriptors_per_block, num_block_groups);
+		bool any_dirty = false;
+		for(uint32_t i = first; i < last; i++)
+			any_dirty |= block_groups[i] && block_groups[i]->dirty;
+		if(!any_dirty)
+			continue;
+
+		uint32_t table_block = block_group_descriptor_table + first / descriptors_per_block;
+		Result res = read_block(table_block, block_buf);
+		if(res.is_error()) {
+			ret = res;
+			continue;
+		}
+		auto* descriptors = (ext2_block_group_descriptor*) block_buf;
+		for(uint32_t i = first; i < last; i++) {
+			Ext2BlockGroup* bg = block_groups[i];
+			if(!bg || !bg->dirty)
+				continue;
+			auto& desc = descriptors[i - first];
+			desc.free_blocks = bg->free_blocks;
+			desc.free_inodes = bg->free_inodes;
+			desc.num_directories = bg->num_directories;
+			bg->dirty = false;
+		}
+		res = write_block(table_block, block_buf);
+		if(res.is_error())
+			ret = res;
+	}
 
-	//Update superblock
-	superblock.free_blocks++;
-}
+	if(superblock_dirty) {
+		write_superblock();
+		superblock_dirty = false;
+	}
 
-void Ext2Filesystem::free_blocks(kstd::vector<uint32_t>& blocks) {
-	for(size_t i = 0; i < blocks.size(); i++) free_block(blocks[i]);
+	return ret;
 }
 
 Ext2BlockGroup *Ext2Filesystem::get_block_group(uint32_t block_group) {
-	if(!block_groups || block_group > num_block_groups) return nullptr;
+	if(!block_groups || block_group >= num_block_groups) return nullptr;
 	if(!block_groups[block_group]) {
 		block_groups[block_group] = new Ext2BlockGroup(this, block_group);
 	}
 	return block_groups[block_group];
 }
 
-
+uint32_t Ext2Filesystem::block_group_of(uint32_t block) {
+	return (block - superblock.superblock_block) / superblock.blocks_per_group;
+}
@@ -25,6 +25,11 @@
 #include <kernel/kstd/vector.hpp>
 #include "Ext2.h"
 
+/** How many blocks past the end of a growing file are set aside for it, if the superblock doesn't say. **/
+#define EXT2_DEFAULT_PREALLOC_BLOCKS 8
+/** The most blocks that will be set aside for a growing file. Windows grow with the file up to this size. **/
+#define EXT2_MAX_PREALLOC_BLOCKS 256
+
 class Ext2Filesystem;
 class Ext2BlockGroup;
 class Ext2Inode;
@@ -38,6 +43,7 @@ public:
 	ino_t root_inode_id() override;
 	char* name() override;
 	Inode * get_inode_rawptr(ino_t id) override;
+	bool caches_dentries() override;
 
 	//Reading/writing
 	ResultRet<kstd::Arc<Ext2Inode>> allocate_inode(mode_t mode, uid_t uid, gid_t gid, size_t size, ino_t parent);
@@ -46,15 +52,23 @@ public:
 	void write_superblock();
 
 	//Block stuff
-	ResultRet<kstd::vector<uint32_t>> allocate_blocks_in_group(Ext2BlockGroup* group, uint32_t num_blocks, bool zero_out);
-	ResultRet<kstd::vector<uint32_t>> allocate_blocks(uint32_t num_blocks, bool zero_out = true);
-	uint32_t allocate_block(bool zero_out = true);
+	/**
+	 * Allocates blocks, preferring to put them in one contiguous run.
+	 * @param goal The block to start looking for free blocks at (usually the one after the last block of a file), or 0.
+	 */
+	ResultRet<kstd::vector<uint32_t>> allocate_blocks(uint32_t num_blocks, bool zero_out = true, uint32_t goal = 0);
+	uint32_t allocate_block(bool zero_out = true, uint32_t goal = 0);
+	/** The number of blocks that should be preallocated past the end of a growing file. **/
+	uint32_t prealloc_blocks();
 
 	void free_block(uint32_t block);
 	void free_blocks(kstd::vector<uint32_t>& blocks);
 	Ext2BlockGroup* get_block_group(uint32_t block_group);
+	uint32_t block_group_of(uint32_t block);
 	Result read_block_group_raw(uint32_t block_group, ext2_block_group_descriptor* buffer);
 	Result write_block_group_raw(uint32_t block_group, const ext2_block_group_descriptor* buffer);
+	/** Writes the cached block bitmaps, block group descriptors, and superblock to disk if they've changed. **/
+	Result flush_metadata();
 
 	//Misc
 	static bool probe(FileDescriptor& dev);
@@ -70,6 +84,15 @@ public:
 			bitmap[index / 8] &= (uint8_t) (~(1u << (index  % 8)));
 	}
 
+	/**
+	 * Finds the first run of clear bits in a bitmap at or after a given index, checking a word at a time.
+	 * @param num_bits The number of bits in the bitmap. The bitmap must be a whole number of words long.
+	 * @param max_length The longest run to look for.
+	 * @param length Set to the length of the run found, or 0 if there wasn't one.
+	 * @return The index of the first bit in the run, or num_bits if there wasn't one.
+	 */
+	static size_t find_free_run(const uint8_t* bitmap, size_t num_bits, size_t start, size_t max_length, size_t& length);
+
 	//Member Variables
 	ext2_superblock superblock;
 	uint32_t block_group_descriptor_table;
@@ -81,9 +104,15 @@ public:
 	size_t block_pointers_per_block;
 
 private:
+	Result load_block_bitmap(Ext2BlockGroup* group);
+	bool find_run_in_group(Ext2BlockGroup* group, uint32_t start, uint32_t min_length, uint32_t max_length, uint32_t& run_start, uint32_t& run_length);
+	void allocate_run(Ext2BlockGroup* group, uint32_t start, uint32_t length, kstd::vector<uint32_t>& blocks);
+	void release_blocks(const kstd::vector<uint32_t>& blocks);
+
 	SpinLock ext2lock;
 
 	//Block stuff
 	Ext2BlockGroup** block_groups = nullptr;
+	bool superblock_dirty = false;
 };
 
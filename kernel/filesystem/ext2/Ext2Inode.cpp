@@ -22,9 +22,11 @@
 #include "Ext2BlockGroup.h"
 #include "Ext2Filesystem.h"
 #include <kernel/filesystem/DirectoryEntry.h>
+#include <kernel/filesystem/FileDescriptor.h>
 #include <kernel/kstd/KLog.h>
+#include <kernel/kstd/hash.h>
 
-Ext2Inode::Ext2Inode(Ext2Filesystem& filesystem, ino_t id): Inode(filesystem, id) {
+Ext2Inode::Ext2Inode(Ext2Filesystem& filesystem, ino_t id): Inode(filesystem, id), _block_map(filesystem, raw.block_pointers) {
 	//Get the block group
 	Ext2BlockGroup* bg = ext2fs().get_block_group(block_group());
 
@@ -38,14 +40,17 @@ Ext2Inode::Ext2Inode(Ext2Filesystem& filesystem, ino_t id): Inode(filesystem, id
 	memcpy(&raw, inodeRaw, sizeof(Ext2Inode::Raw));
 
 	create_metadata();
-
-	//Read block pointers
-	if(!_metadata.is_device())
-		read_block_pointers();
 }
 
-Ext2Inode::Ext2Inode(Ext2Filesystem& filesystem, ino_t i, const Raw &raw, kstd::vector<uint32_t>& block_pointers, ino_t parent): Inode(filesystem, i), block_pointers(block_pointers), raw(raw) {
+Ext2Inode::Ext2Inode(Ext2Filesystem& filesystem, ino_t i, const Raw &raw, kstd::vector<uint32_t>& block_pointers, ino_t parent): Inode(filesystem, i), raw(raw), _block_map(filesystem, this->raw.block_pointers) {
 	create_metadata();
+	uint32_t indirect_allocated = 0;
+	for(size_t block = 0; block < block_pointers.size(); block++) {
+		Result res = _block_map.set(block, block_pointers[block], indirect_allocated);
+		if(res.is_error())
+			KLog::err("ext2", "Error %d mapping blocks of new ext2 inode %d", res.code(), i);
+	}
+	this->raw.logical_blocks = (block_pointers.size() + indirect_allocated) * (ext2fs().block_size() / 512);
 	if(IS_DIR(raw.mode)) {
 		kstd::vector<DirectoryEntry> entries;
 		entries.reserve(2);
@@ -61,6 +66,7 @@ Ext2Inode::Ext2Inode(Ext2Filesystem& filesystem, ino_t i, const Raw &raw, kstd::
 Ext2Inode::~Ext2Inode() {
 	if(_dirty && exists())
 		write_to_disk();
+	discard_preallocation();
 }
 
 uint32_t Ext2Inode::block_group(){
@@ -85,35 +91,30 @@ size_t Ext2Inode::num_blocks() {
 }
 
 uint32_t Ext2Inode::get_block_pointer(uint32_t block_index) {
-	if(block_index >= block_pointers.size()) return 0;
-	return block_pointers[block_index];
+	LOCK(lock);
+	if(block_index >= num_blocks()) return 0;
+	return _block_map.get(block_index);
 }
 
 bool Ext2Inode::set_block_pointer(uint32_t block_index, uint32_t block) {
 	LOCK(lock);
+	if(block_index >= num_blocks()) return false;
 
-	if(block_index == 0 && block_pointers.empty()) {
-		block_pointers.push_back(block);
-		_dirty = true;
-		return true;
-	} else if(block_index < block_pointers.size()) {
-		block_pointers[block_index] = block;
-		_dirty = true;
-		return true;
-	} else if(block_index == block_pointers.size()) {
-		block_pointers.push_back(block);
-		_dirty = true;
-		return true;
-	} else return false;
-}
-
-kstd::vector<uint32_t>& Ext2Inode::get_block_pointers() {
-	return block_pointers;
+	uint32_t indirect_allocated = 0;
+	if(_block_map.set(block_index, block, indirect_allocated).is_error()) return false;
+	raw.logical_blocks += indirect_allocated * (ext2fs().block_size() / 512);
+	_dirty = true;
+	return true;
 }
 
 void Ext2Inode::free_all_blocks() {
-	ext2fs().free_blocks(block_pointers);
-	ext2fs().free_blocks(pointer_blocks);
+	LOCK(lock);
+	discard_preallocation();
+	kstd::vector<uint32_t> blocks;
+	_block_map.truncate(0, num_blocks(), blocks);
+	ext2fs().unshare_blocks(blocks);
+	ext2fs().free_blocks(blocks);
+	raw.logical_blocks = 0;
 }
 
 ssize_t Ext2Inode::read(size_t start, size_t length, SafePointer<uint8_t> buffer, FileDescriptor* fd) {
@@ -136,37 +137,52 @@ ssize_t Ext2Inode::read(size_t start, size_t length, SafePointer<uint8_t> buffer
 	if(start + length > _metadata.size) length = _metadata.size - start;
 
 	//TODO: symlinks
-	size_t first_block = start / ext2fs().block_size();
-	size_t first_block_start = start % ext2fs().block_size();
-	size_t bytes_left = length;
-	size_t block_index = first_block;
-
-	uint8_t block_buf[ext2fs().block_size()];
-	while(bytes_left) {
-		ext2fs().read_block(get_block_pointer(block_index), block_buf);
-		if(block_index == first_block) {
-			if(length < ext2fs().block_size() - first_block_start) {
-				buffer.write(block_buf + first_block_start, length);
-				bytes_left = 0;
-			} else {
-				buffer.write(block_buf + first_block_start, ext2fs().block_size() - first_block_start);
-				bytes_left -= ext2fs().block_size() - first_block_start;
-			}
-		} else {
-			if(bytes_left < ext2fs().block_size()) {
-				buffer.write(block_buf, length - bytes_left, bytes_left);
-				bytes_left = 0;
-			} else {
-				buffer.write( block_buf, length - bytes_left, ext2fs().block_size());
-				bytes_left -= ext2fs().block_size();
-			}
+	size_t block_size = ext2fs().block_size();
+	size_t block_index = start / block_size;
+	size_t block_start = start % block_size;
+	size_t nread = 0;
+
+	while(nread < length) {
+		//Read as many blocks as are contiguous on disk at once, straight into the buffer
+		size_t blocks_left = (block_start + (length - nread) + block_size - 1) / block_size;
+		uint32_t run_length;
+		uint32_t block = _block_map.get_run(block_index, blocks_left, run_length);
+
+		//Sparse blocks read as zeroes
+		if(!block) {
+			size_t to_zero = min(block_size - block_start, length - nread);
+			buffer.memset(0, nread, to_zero);
+			nread += to_zero;
+			block_index++;
+			block_start = 0;
+			continue;
 		}
-		block_index++;
+
+		size_t to_read = min(run_length * block_size - block_start, length - nread);
+		auto res = ext2fs().read_block_run(block, block_start, to_read, SafePointer<uint8_t>(buffer.raw() + nread, buffer.is_user()));
+		if(res.is_error())
+			return res.code();
+
+		nread += to_read;
+		block_index += run_length;
+		block_start = 0;
 	}
+
+	if(fd)
+		read_ahead(*fd, start, length);
+
 	return length;
 }
 
 ssize_t Ext2Inode::write(size_t start, size_t length, SafePointer<uint8_t> buf, FileDescriptor* fd) {
+	//Mappings of the file have to be updated after we let go of our lock, since faulting them in locks in the other order
+	ssize_t nwrote = write_data(start, length, buf);
+	if(nwrote > 0)
+		update_shared_pages(start, nwrote);
+	return nwrote;
+}
+
+ssize_t Ext2Inode::write_data(size_t start, size_t length, SafePointer<uint8_t> buf) {
 	if(_metadata.is_device()) return 0;
 	if(length == 0) return 0;
 	if(!exists()) return -ENOENT; //Inode was deleted
@@ -181,107 +197,170 @@ ssize_t Ext2Inode::write(size_t start, size_t length, SafePointer<uint8_t> buf,
 		return length;
 	}
 
-	size_t first_block = start / ext2fs().block_size();
-	size_t first_block_start = start % ext2fs().block_size();
-	size_t bytes_left = length;
-	size_t block_index = first_block;
-
 	//If this write is going to expand the file, resize it
 	if(start + length > _metadata.size) {
 		auto res = truncate((off_t)start + (off_t)length);
 		if(res.is_error()) return res.code();
 	}
 
-	uint8_t block_buf[ext2fs().block_size()];
-	while(bytes_left) {
-		uint32_t block = get_block_pointer(block_index);
+	size_t block_size = ext2fs().block_size();
+	size_t block_index = start / block_size;
+	size_t block_start = start % block_size;
+	size_t nwrote = 0;
+
+	while(nwrote < length) {
+		//Write as many blocks as are contiguous on disk at once, straight from the buffer into the disk cache
+		size_t blocks_left = (block_start + (length - nwrote) + block_size - 1) / block_size;
+		uint32_t run_length;
+		uint32_t block = _block_map.get_run(block_index, blocks_left, run_length);
 
 		//The block isn't allocated, no space
 		if(!block) return -ENOSPC;
 
-		//Read the block into a buffer
-		ext2fs().read_block(block, block_buf);
-
-		//Copy the appropriate portion of the buffer into the appropriate portion of the block buffer
-		if(block_index == first_block) {
-			if(length < ext2fs().block_size() - first_block_start) {
-				buf.read(block_buf + first_block_start, length);
-				bytes_left = 0;
-			} else {
-				buf.read(block_buf + first_block_start, ext2fs().block_size() - first_block_start);
-				bytes_left -= ext2fs().block_size() - first_block_start;
-			}
-		} else {
-			if(bytes_left < ext2fs().block_size()) {
-				buf.read(block_buf, length - bytes_left, bytes_left);
-				bytes_left = 0;
-			} else {
-				buf.read(block_buf, length - bytes_left, ext2fs().block_size());
-				bytes_left -= ext2fs().block_size();
-			}
-		}
+		size_t to_write = min(run_length * block_size - block_start, length - nwrote);
+		auto res = ext2fs().write_block_run(block, block_start, to_write, SafePointer<uint8_t>(buf.raw() + nwrote, buf.is_user()));
+		if(res.is_error())
+			return res.code();
 
-		//Write the block to disk/cache
-		ext2fs().write_block(block, block_buf);
-		block_index++;
+		nwrote += to_write;
+		block_index += run_length;
+		block_start = 0;
 	}
 
 	return length;
 }
 
-ssize_t Ext2Inode::read_dir_entry(size_t start, SafePointer<DirectoryEntry> buffer, FileDescriptor* fd) {
-	LOCK(lock);
+/*
+ * Helpers for working with the entries in a single directory block in memory.
+ */
+
+static inline size_t dirent_size(size_t name_length) {
+	return (sizeof(ext2_directory) + name_length + 3) & ~3u;
+}
+
+static inline ext2_directory* dirent_at(uint8_t* block, size_t offset) {
+	return (ext2_directory*) (block + offset);
+}
 
-	uint8_t buf[ext2fs().block_size()];
-	size_t block = start / ext2fs().block_size();
-	size_t start_in_block = start % ext2fs().block_size();
-	if(read(block * ext2fs().block_size(), ext2fs().block_size(), KernelPointer<uint8_t>(buf), fd) == 0) {
-		return 0;
+/** Checks that an entry fits in its block, so that a corrupt directory can't make us loop forever or overrun. **/
+static inline bool dirent_valid(uint8_t* block, size_t offset, size_t block_size) {
+	if(offset + sizeof(ext2_directory) > block_size)
+		return false;
+	auto* ent = dirent_at(block, offset);
+	return ent->size >= sizeof(ext2_directory) && !(ent->size % 4) && offset + ent->size <= block_size
+		&& sizeof(ext2_directory) + ent->name_length <= ent->size;
+}
+
+static inline bool dirent_matches(ext2_directory* ent, const kstd::string& name) {
+	if(!ent->inode || ent->name_length != name.length())
+		return false;
+	auto* ent_name = (const char*) (ent + 1);
+	for(size_t i = 0; i < name.length(); i++) {
+		if(ent_name[i] != name[i])
+			return false;
 	}
-	auto* dir = (ext2_directory*)(buf + start_in_block);
+	return true;
+}
 
-	size_t name_length = dir->name_length;
-	if(name_length > NAME_MAXLEN - 1) name_length = NAME_MAXLEN - 1;
+/** Finds the entry with the given name in a block, and returns its offset in the block or -1. **/
+static int find_in_block(uint8_t* block, size_t block_size, const kstd::string& name) {
+	for(size_t offset = 0; dirent_valid(block, offset, block_size); offset += dirent_at(block, offset)->size) {
+		if(dirent_matches(dirent_at(block, offset), name))
+			return (int) offset;
+	}
+	return -1;
+}
 
-	if(dir->inode == 0) {
-		return 0;
+/** Returns the size of the largest entry that could be added to a block. **/
+static size_t block_free_space(uint8_t* block, size_t block_size) {
+	size_t largest = 0;
+	for(size_t offset = 0; dirent_valid(block, offset, block_size); offset += dirent_at(block, offset)->size) {
+		auto* ent = dirent_at(block, offset);
+		size_t free = ent->inode ? ent->size - dirent_size(ent->name_length) : ent->size;
+		if(free > largest)
+			largest = free;
 	}
+	return largest;
+}
 
-	DirectoryEntry result;
-	result.name_length = name_length;
-	result.id = dir->inode;
-	result.type = dir->type;
-	buffer.set(result);
-	SafePointer<uint8_t> name_ptr((uint8_t*) buffer.raw()->name, buffer.is_user());
-	name_ptr.write(&dir->type+1, name_length);
+/** Adds an entry to a block if there's room for it, and returns its offset in the block or -1 if there isn't. **/
+static int insert_into_block(uint8_t* block, size_t block_size, const kstd::string& name, ino_t inode, uint8_t type) {
+	size_t needed = dirent_size(name.length());
+	for(size_t offset = 0; dirent_valid(block, offset, block_size); offset += dirent_at(block, offset)->size) {
+		auto* ent = dirent_at(block, offset);
+		size_t new_offset = offset;
+		size_t new_size = ent->size;
+		if(ent->inode) {
+			//Split the free space off the end of the entry
+			size_t used = dirent_size(ent->name_length);
+			if(ent->size - used < needed)
+				continue;
+			new_offset = offset + used;
+			new_size = ent->size - used;
+			ent->size = used;
+		} else if(ent->size < needed) {
+			continue;
+		}
 
-	return dir->size;
+		auto* new_ent = dirent_at(block, new_offset);
+		new_ent->inode = inode;
+		new_ent->size = new_size;
+		new_ent->name_length = name.length();
+		new_ent->type = type;
+		memcpy(new_ent + 1, name.c_str(), name.length());
+		return (int) new_offset;
+	}
+	return -1;
 }
 
-ino_t Ext2Inode::find_id(const kstd::string& find_name) {
-	if(!metadata().is_directory()) return 0;
+ssize_t Ext2Inode::read_dir_entry(size_t start, SafePointer<DirectoryEntry> buffer, FileDescriptor* fd) {
 	LOCK(lock);
-	ino_t ret = 0;
-	auto* buf = static_cast<uint8_t *>(kmalloc(ext2fs().block_size()));
-	for(size_t i = 0; i < num_blocks(); i++) {
-		uint32_t block = get_block_pointer(i);
-		ext2fs().read_block(block, buf);
-		auto* dir = reinterpret_cast<ext2_directory*>(buf);
-		uint32_t add = 0;
-		char name_buf[257];
-		while(dir->inode != 0 && add < ext2fs().block_size()) {
-			memcpy(name_buf, &dir->type+1, dir->name_length);
-			name_buf[dir->name_length] = '\0';
-			if(find_name == name_buf){
-				ret = dir->inode;
-				break;
-			}
-			add += dir->size;
-			dir = (ext2_directory*)((size_t)dir + dir->size);
+
+	size_t block_size = ext2fs().block_size();
+	uint8_t buf[block_size];
+	size_t offset = start;
+	size_t loaded_block = -1;
+
+	//Skip over unused entries, which includes the index blocks of HTree directories
+	while(offset < _metadata.size) {
+		size_t block = offset / block_size;
+		size_t start_in_block = offset % block_size;
+		if(block != loaded_block) {
+			if(read(block * block_size, block_size, KernelPointer<uint8_t>(buf), fd) <= 0)
+				return 0;
+			loaded_block = block;
+		}
+
+		if(!dirent_valid(buf, start_in_block, block_size))
+			return 0;
+		auto* dir = dirent_at(buf, start_in_block);
+		if(!dir->inode) {
+			offset += dir->size;
+			continue;
 		}
+
+		size_t name_length = dir->name_length;
+		if(name_length > NAME_MAXLEN - 1) name_length = NAME_MAXLEN - 1;
+
+		DirectoryEntry result;
+		result.name_length = name_length;
+		result.id = dir->inode;
+		result.type = dir->type;
+		buffer.set(result);
+		SafePointer<uint8_t> name_ptr((uint8_t*) buffer.raw()->name, buffer.is_user());
+		name_ptr.write(&dir->type+1, name_length);
+
+		return offset - start + dir->size;
 	}
-	kfree(buf);
-	return ret;
+
+	return 0;
+}
+
+ino_t Ext2Inode::find_id(const kstd::string& find_name) {
+	if(!metadata().is_directory()) return 0;
+	LOCK(lock);
+	uint32_t offset;
+	return find_entry(find_name, offset);
 }
 
 Result Ext2Inode::add_entry(const kstd::string &name, Inode &inode) {
@@ -291,18 +370,9 @@ Result Ext2Inode::add_entry(const kstd::string &name, Inode &inode) {
 
 	LOCK(lock);
 
-	//Read entries into a vector
-	kstd::vector<DirectoryEntry> entries;
-	size_t offset = 0;
-	ssize_t nread;
-	DirectoryEntry buf;
-	while((nread = read_dir_entry(offset, KernelPointer<DirectoryEntry>(&buf), nullptr))) {
-		offset += nread;
-		buf.name[buf.name_length] = '\0';
-		if(name == buf.name)
-			return Result(-EEXIST);
-		entries.push_back(buf);
-	}
+	uint32_t offset;
+	if(find_entry(name, offset))
+		return Result(-EEXIST);
 
 	//Determine filetype
 	uint8_t type = EXT2_FT_UNKNOWN;
@@ -312,13 +382,10 @@ Result Ext2Inode::add_entry(const kstd::string &name, Inode &inode) {
 	else if(inode.metadata().is_block_device()) type = EXT2_FT_BLKDEV;
 	else if(inode.metadata().is_character_device()) type = EXT2_FT_CHRDEV;
 
-	//Increase hardlink count of new inode
-	((Ext2Inode&) inode).increase_hardlink_count();
-
-	//Push new entry into vector and write to disk
-	entries.push_back({inode.id, type, name});
-	auto res = write_directory_entries(entries);
+	//Add the entry and increase the hardlink count of the new inode
+	auto res = insert_entry(name, inode.id, type);
 	if(res.is_error()) return res;
+	((Ext2Inode&) inode).increase_hardlink_count();
 	if(_dirty) { //We changed the amount of blocks
 		res = write_to_disk();
 		if(res.is_error()) return res;
@@ -362,28 +429,11 @@ Result Ext2Inode::remove_entry(const kstd::string &name) {
 
 	LOCK(lock);
 
-	//Read entries into vector and find the child we need
-	kstd::vector<DirectoryEntry> entries;
-	size_t offset = 0;
-	ssize_t nread;
-	size_t entry_index;
-	bool found = false;
-	size_t i = 0;
-	DirectoryEntry buf;
-	while((nread = read_dir_entry(offset, KernelPointer<DirectoryEntry>(&buf), nullptr))) {
-		offset += nread;
-		buf.name[buf.name_length] = '\0';
-		if(name == buf.name) {
-			entry_index = i;
-			found = true;
-		}
-		entries.push_back(buf);
-		i++;
-	}
-
-	//If we didn't find it or the inode doesn't exist for some reason, return with an error
-	if(!found) return Result(-ENOENT);
-	auto child_or_err = ext2fs().get_inode(entries[entry_index].id);
+	//Find the child, and return with an error if we didn't find it or the inode doesn't exist for some reason
+	uint32_t offset;
+	ino_t child_id = find_entry(name, offset);
+	if(!child_id) return Result(-ENOENT);
+	auto child_or_err = ext2fs().get_inode(child_id);
 	if(child_or_err.is_error()){
 		KLog::warn("ext2", "Orphaned directory entry in inode %d", id);
 		return child_or_err.result();
@@ -399,15 +449,522 @@ Result Ext2Inode::remove_entry(const kstd::string &name) {
 		ext2ino->reduce_hardlink_count();
 	}
 
-	//Erase the entry and write the entries to disk
-	entries.erase(entry_index);
-	auto res = write_directory_entries(entries);
-	if(res.is_error()) return res;
-	if(_dirty) { //We changed the amount of blocks
-		res = write_to_disk();
-		if(res.is_error()) return res;
+	//Erase the entry
+	return remove_entry_at(offset);
+}
+
+/*
+ * Directory entries are looked up in one of three ways: Directories with an HTree (dir_index) on disk are searched by
+ * following the tree down to the one leaf block the name could be in. Large directories without one get an in-memory
+ * index mapping the hashes of names to where their entries are, and small directories are just searched block by block.
+ */
+
+struct Ext2Inode::HTreePath {
+	struct Frame {
+		uint32_t block_index; ///< The block of the directory the node is in.
+		ext2_dx_entry* entries; ///< The node's entries. The hash of the first one holds the count and limit instead.
+		uint16_t count;
+		uint16_t limit;
+		uint16_t position; ///< The entry that was followed to get to the next level.
+	};
+
+	explicit HTreePath(size_t block_size):
+		buffer((uint8_t*) kmalloc(block_size * EXT2_DX_MAX_LEVELS)), block_size(block_size) {}
+	~HTreePath() { kfree(buffer); }
+	uint8_t* node(int level) { return buffer + level * block_size; }
+
+	Frame frames[EXT2_DX_MAX_LEVELS];
+	int levels = 0; ///< The number of levels of interior nodes between the root and the leaves.
+	uint8_t version = 0;
+	uint32_t seed[4]; ///< A copy of the hash seed, since the superblock is packed.
+	uint32_t hash = 0;
+	uint8_t* buffer;
+	size_t block_size;
+};
+
+bool Ext2Inode::has_htree() {
+	return (raw.flags & EXT2_INDEX_FL) && (ext2fs().superblock.optional_features & EXT2_FEATURE_COMPAT_DIR_INDEX);
+}
+
+ino_t Ext2Inode::find_entry(const kstd::string& name, uint32_t& offset) {
+	size_t block_size = ext2fs().block_size();
+	auto* buf = (uint8_t*) kmalloc(block_size);
+	ino_t ret = 0;
+
+	if(has_htree()) {
+		HTreePath path(block_size);
+		auto leaf_or_err = htree_find_leaf(name, path);
+		if(!leaf_or_err.is_error()) {
+			uint32_t leaf = leaf_or_err.value();
+			do {
+				if(ext2fs().read_block(get_block_pointer(leaf), buf).is_error())
+					break;
+				int index = find_in_block(buf, block_size, name);
+				if(index >= 0) {
+					offset = leaf * block_size + index;
+					ret = dirent_at(buf, index)->inode;
+					break;
+				}
+			} while(htree_next_leaf(path, leaf));
+			kfree(buf);
+			return ret;
+		}
+		//If the tree is damaged or uses a feature we don't support, searching every block still works
+	} else {
+		build_directory_index();
 	}
-	return Result(SUCCESS);
+
+	if(_dir_index) {
+		size_t loaded_block = -1;
+		offset = _dir_index->find(kstd::hash_bytes(name.c_str(), name.length()), [&](uint32_t candidate) {
+			size_t block = candidate / block_size;
+			if(block != loaded_block) {
+				if(ext2fs().read_block(get_block_pointer(block), buf).is_error())
+					return false;
+				loaded_block = block;
+			}
+			return dirent_valid(buf, candidate % block_size, block_size) && dirent_matches(dirent_at(buf, candidate % block_size), name);
+		});
+		if(offset != Ext2DirectoryIndex::NO_OFFSET)
+			ret = dirent_at(buf, offset % block_size)->inode;
+	} else {
+		for(size_t block = 0; block < num_blocks() && !ret; block++) {
+			if(ext2fs().read_block(get_block_pointer(block), buf).is_error())
+				break;
+			int index = find_in_block(buf, block_size, name);
+			if(index >= 0) {
+				offset = block * block_size + index;
+				ret = dirent_at(buf, index)->inode;
+			}
+		}
+	}
+
+	kfree(buf);
+	return ret;
+}
+
+Result Ext2Inode::insert_entry(const kstd::string& name, ino_t inode, uint8_t type) {
+	if(has_htree()) {
+		auto inserted_or_err = htree_insert(name, inode, type);
+		if(inserted_or_err.is_error())
+			return inserted_or_err.result();
+		if(inserted_or_err.value())
+			return Result(SUCCESS);
+	}
+
+	//If the directory has an index we can't update, get rid of it and treat it like a normal directory
+	if(raw.flags & EXT2_INDEX_FL)
+		disable_htree();
+	build_directory_index();
+
+	size_t block_size = ext2fs().block_size();
+	size_t needed = dirent_size(name.length());
+	auto* buf = (uint8_t*) kmalloc(block_size);
+	int offset = -1;
+	uint32_t block;
+	for(block = 0; block < num_blocks(); block++) {
+		if(_dir_index && block < _dir_index->block_free.size() && _dir_index->block_free[block] < needed)
+			continue;
+		if(ext2fs().read_block(get_block_pointer(block), buf).is_error()) {
+			kfree(buf);
+			return Result(-EIO);
+		}
+		offset = insert_into_block(buf, block_size, name, inode, type);
+		if(offset >= 0)
+			break;
+	}
+
+	//If none of the blocks have room, add a new one
+	if(offset < 0) {
+		auto block_or_err = append_directory_block();
+		if(block_or_err.is_error()) {
+			kfree(buf);
+			return block_or_err.result();
+		}
+		block = block_or_err.value();
+		memset(buf, 0, block_size);
+		dirent_at(buf, 0)->size = block_size;
+		offset = insert_into_block(buf, block_size, name, inode, type);
+	}
+
+	auto res = ext2fs().write_block(get_block_pointer(block), buf);
+	if(_dir_index) {
+		_dir_index->insert(kstd::hash_bytes(name.c_str(), name.length()), block * block_size + offset);
+		_dir_index->block_free[block] = block_free_space(buf, block_size);
+	}
+	kfree(buf);
+	return res;
+}
+
+Result Ext2Inode::remove_entry_at(uint32_t offset) {
+	size_t block_size = ext2fs().block_size();
+	uint32_t block = offset / block_size;
+	size_t start_in_block = offset % block_size;
+	auto* buf = (uint8_t*) kmalloc(block_size);
+	if(ext2fs().read_block(get_block_pointer(block), buf).is_error()) {
+		kfree(buf);
+		return Result(-EIO);
+	}
+
+	//Find the entry before it in the block
+	size_t prev = block_size;
+	size_t cur = 0;
+	while(cur < start_in_block && dirent_valid(buf, cur, block_size)) {
+		prev = cur;
+		cur += dirent_at(buf, cur)->size;
+	}
+	if(cur != start_in_block || !dirent_valid(buf, cur, block_size)) {
+		kfree(buf);
+		return Result(-EIO);
+	}
+
+	auto* ent = dirent_at(buf, start_in_block);
+	if(_dir_index)
+		_dir_index->remove(kstd::hash_bytes((const char*) (ent + 1), ent->name_length), offset);
+
+	//Give the entry's space to the one before it, or if it's the first in the block, mark it as unused
+	if(prev != block_size)
+		dirent_at(buf, prev)->size += ent->size;
+	else
+		ent->inode = 0;
+
+	auto res = ext2fs().write_block(get_block_pointer(block), buf);
+	if(_dir_index)
+		_dir_index->block_free[block] = block_free_space(buf, block_size);
+	kfree(buf);
+	return res;
+}
+
+ResultRet<uint32_t> Ext2Inode::append_directory_block() {
+	size_t block_size = ext2fs().block_size();
+	uint32_t block = num_blocks();
+	auto res = truncate((off_t) (block + 1) * block_size);
+	if(res.is_error())
+		return res;
+
+	//An empty directory block is a single unused entry that spans the whole block
+	auto* buf = (uint8_t*) kmalloc(block_size);
+	memset(buf, 0, block_size);
+	dirent_at(buf, 0)->size = block_size;
+	res = ext2fs().write_block(get_block_pointer(block), buf);
+	kfree(buf);
+	if(res.is_error())
+		return res;
+
+	if(_dir_index)
+		_dir_index->block_free.push_back(block_size);
+	return block;
+}
+
+void Ext2Inode::disable_htree() {
+	//Index nodes look like empty directory blocks, so the directory is still valid without the flag
+	raw.flags &= ~EXT2_INDEX_FL;
+	write_inode_entry();
+}
+
+void Ext2Inode::build_directory_index() {
+	if(_dir_index || has_htree() || num_blocks() < EXT2_DIR_INDEX_MIN_BLOCKS)
+		return;
+
+	size_t block_size = ext2fs().block_size();
+	auto* buf = (uint8_t*) kmalloc(block_size);
+	auto index = kstd::make_shared<Ext2DirectoryIndex>();
+	index->block_free.reserve(num_blocks());
+	for(size_t block = 0; block < num_blocks(); block++) {
+		if(ext2fs().read_block(get_block_pointer(block), buf).is_error()) {
+			kfree(buf);
+			return;
+		}
+		for(size_t offset = 0; dirent_valid(buf, offset, block_size); offset += dirent_at(buf, offset)->size) {
+			auto* ent = dirent_at(buf, offset);
+			if(ent->inode)
+				index->insert(kstd::hash_bytes((const char*) (ent + 1), ent->name_length), block * block_size + offset);
+		}
+		index->block_free.push_back(block_free_space(buf, block_size));
+	}
+
+	kfree(buf);
+	_dir_index = index;
+}
+
+ResultRet<uint32_t> Ext2Inode::htree_find_leaf(const kstd::string& name, HTreePath& path) {
+	size_t block_size = ext2fs().block_size();
+	auto* root = path.node(0);
+	if(ext2fs().read_block(get_block_pointer(0), root).is_error())
+		return Result(-EIO);
+
+	//The root info comes after the "." and ".." entries
+	auto* info = (ext2_dx_root_info*) (root + 24);
+	if(info->reserved_zero || info->info_length != 8 || info->indirect_levels >= EXT2_DX_MAX_LEVELS || info->hash_version > EXT2_DX_HASH_TEA)
+		return Result(-EINVAL);
+	path.levels = info->indirect_levels;
+	path.version = info->hash_version;
+	if(ext2fs().superblock.flags & EXT2_FLAGS_UNSIGNED_HASH)
+		path.version += EXT2_DX_HASH_LEGACY_UNSIGNED;
+	memcpy(path.seed, ext2fs().superblock.hash_seed, sizeof(path.seed));
+	path.hash = ext2_dx_hash(name.c_str(), name.length(), path.version, path.seed);
+
+	auto* entries = (ext2_dx_entry*) (root + 24 + info->info_length);
+	uint32_t block_index = 0;
+	for(int level = 0;; level++) {
+		auto& frame = path.frames[level];
+		auto* countlimit = (ext2_dx_countlimit*) entries;
+		frame.block_index = block_index;
+		frame.entries = entries;
+		frame.count = countlimit->count;
+		frame.limit = countlimit->limit;
+		size_t max_entries = (block_size - ((uint8_t*) entries - path.node(level))) / sizeof(ext2_dx_entry);
+		if(!frame.count || frame.count > frame.limit || frame.limit > max_entries)
+			return Result(-EINVAL);
+
+		//Find the last entry with a hash less than or equal to ours (the first entry's hash is implicitly zero)
+		size_t low = 1, high = frame.count;
+		while(low < high) {
+			size_t mid = (low + high) / 2;
+			if(entries[mid].hash > path.hash)
+				high = mid;
+			else
+				low = mid + 1;
+		}
+		frame.position = low - 1;
+
+		block_index = entries[frame.position].block & 0x0fffffff;
+		if(block_index >= num_blocks())
+			return Result(-EINVAL);
+		if(level == path.levels)
+			return block_index;
+
+		//Interior nodes are blocks with a single empty directory entry in them, followed by the index
+		auto* node = path.node(level + 1);
+		if(ext2fs().read_block(get_block_pointer(block_index), node).is_error())
+			return Result(-EIO);
+		entries = (ext2_dx_entry*) (node + sizeof(ext2_directory));
+	}
+}
+
+bool Ext2Inode::htree_next_leaf(HTreePath& path, uint32_t& leaf) {
+	//Find the deepest node that has another entry after the one we followed
+	int level = path.levels;
+	while(level >= 0 && path.frames[level].position + 1 >= path.frames[level].count)
+		level--;
+	if(level < 0)
+		return false;
+
+	//Names with the same hash can spill over into the next leaf, which is marked by the lowest bit of its hash
+	auto& frame = path.frames[level];
+	frame.position++;
+	if((frame.entries[frame.position].hash & ~1u) != path.hash)
+		return false;
+
+	//Go back down to the leaf, following the first entry in each node
+	for(; level < path.levels; level++) {
+		auto& parent = path.frames[level];
+		auto& child = path.frames[level + 1];
+		child.block_index = parent.entries[parent.position].block & 0x0fffffff;
+		if(child.block_index >= num_blocks())
+			return false;
+		auto* node = path.node(level + 1);
+		if(ext2fs().read_block(get_block_pointer(child.block_index), node).is_error())
+			return false;
+		child.entries = (ext2_dx_entry*) (node + sizeof(ext2_directory));
+		child.count = ((ext2_dx_countlimit*) child.entries)->count;
+		child.limit = ((ext2_dx_countlimit*) child.entries)->limit;
+		child.position = 0;
+		if(!child.count || child.count > child.limit)
+			return false;
+	}
+
+	auto& leaf_frame = path.frames[path.levels];
+	leaf = leaf_frame.entries[leaf_frame.position].block & 0x0fffffff;
+	return leaf < num_blocks();
+}
+
+ResultRet<bool> Ext2Inode::htree_grow_index(HTreePath& path) {
+	//A full interior node can only be split if there's room for another entry in the root
+	auto& root = path.frames[0];
+	if(path.levels && root.count >= root.limit)
+		return false;
+
+	size_t block_size = ext2fs().block_size();
+	auto new_block_or_err = append_directory_block();
+	if(new_block_or_err.is_error())
+		return new_block_or_err.result();
+	uint32_t new_block = new_block_or_err.value();
+
+	//Interior nodes start with an empty directory entry spanning the block, so they look empty to anything else
+	auto* buf = (uint8_t*) kmalloc(block_size);
+	memset(buf, 0, block_size);
+	dirent_at(buf, 0)->size = block_size;
+	auto* new_entries = (ext2_dx_entry*) (buf + sizeof(ext2_directory));
+	auto* new_countlimit = (ext2_dx_countlimit*) new_entries;
+
+	if(path.levels == 0) {
+		//The root is full, so move all of its entries down into a new node and make that the only entry in the root
+		for(size_t i = 0; i < root.count; i++)
+			new_entries[i] = root.entries[i];
+		new_countlimit->limit = (block_size - sizeof(ext2_directory)) / sizeof(ext2_dx_entry);
+		new_countlimit->count = root.count;
+		((ext2_dx_countlimit*) root.entries)->count = 1;
+		root.entries[0].block = new_block;
+		((ext2_dx_root_info*) (path.node(0) + 24))->indirect_levels = 1;
+	} else {
+		//Move the upper half of the full node's entries into a new node
+		auto& node = path.frames[path.levels];
+		size_t split = node.count / 2;
+		for(size_t i = split; i < node.count; i++)
+			new_entries[i - split] = node.entries[i];
+		new_countlimit->limit = (block_size - sizeof(ext2_directory)) / sizeof(ext2_dx_entry);
+		new_countlimit->count = node.count - split;
+		((ext2_dx_countlimit*) node.entries)->count = split;
+
+		for(size_t i = root.count; i > root.position + 1u; i--)
+			root.entries[i] = root.entries[i - 1];
+		root.entries[root.position + 1] = {node.entries[split].hash, new_block};
+		((ext2_dx_countlimit*) root.entries)->count = ++root.count;
+
+		auto res = ext2fs().write_block(get_block_pointer(node.block_index), path.node(path.levels));
+		if(res.is_error()) {
+			kfree(buf);
+			return res;
+		}
+	}
+
+	auto res = ext2fs().write_block(get_block_pointer(new_block), buf);
+	kfree(buf);
+	if(res.is_error())
+		return res;
+	res = ext2fs().write_block(get_block_pointer(0), path.node(0));
+	if(res.is_error())
+		return res;
+	return true;
+}
+
+ResultRet<bool> Ext2Inode::htree_insert(const kstd::string& name, ino_t inode, uint8_t type) {
+	size_t block_size = ext2fs().block_size();
+	HTreePath path(block_size);
+	auto leaf_or_err = htree_find_leaf(name, path);
+	if(leaf_or_err.is_error())
+		return false;
+	uint32_t leaf = leaf_or_err.value();
+
+	//Buffers for the leaf as it is now, and the two halves it will be split into if it's full
+	auto* buf = (uint8_t*) kmalloc(block_size * 3);
+	auto* lower = buf + block_size;
+	auto* upper = buf + block_size * 2;
+	if(ext2fs().read_block(get_block_pointer(leaf), buf).is_error()) {
+		kfree(buf);
+		return Result(-EIO);
+	}
+	memcpy(lower, buf, block_size);
+	if(insert_into_block(lower, block_size, name, inode, type) >= 0) {
+		auto res = ext2fs().write_block(get_block_pointer(leaf), lower);
+		kfree(buf);
+		if(res.is_error())
+			return res;
+		return true;
+	}
+
+	//The leaf is full, so it has to be split in two, which needs room for another entry in the node above it
+	auto& frame = path.frames[path.levels];
+	if(frame.count >= frame.limit) {
+		kfree(buf);
+		auto grown_or_err = htree_grow_index(path);
+		if(grown_or_err.is_error() || !grown_or_err.value())
+			return grown_or_err;
+		return htree_insert(name, inode, type);
+	}
+
+	//Sort the entries in the leaf by hash, so that they can be split into two ranges of hashes
+	struct SortedEntry {
+		uint32_t hash;
+		uint16_t offset;
+		uint16_t size;
+	};
+	kstd::vector<SortedEntry> entries;
+	size_t total_size = 0;
+	for(size_t offset = 0; dirent_valid(buf, offset, block_size); offset += dirent_at(buf, offset)->size) {
+		auto* ent = dirent_at(buf, offset);
+		if(!ent->inode)
+			continue;
+		uint32_t hash = ext2_dx_hash((const char*) (ent + 1), ent->name_length, path.version, path.seed);
+		uint16_t size = dirent_size(ent->name_length);
+		entries.push_back({hash, (uint16_t) offset, size});
+		total_size += size;
+	}
+	if(entries.size() < 2) {
+		kfree(buf);
+		return false;
+	}
+	for(size_t i = 1; i < entries.size(); i++) {
+		auto entry = entries[i];
+		size_t j = i;
+		for(; j > 0 && entries[j - 1].hash > entry.hash; j--)
+			entries[j] = entries[j - 1];
+		entries[j] = entry;
+	}
+
+	//Move the upper half (by size) of the entries into a new block
+	size_t split = 0;
+	size_t lower_size = 0;
+	while(split < entries.size() - 1 && lower_size + entries[split].size <= total_size / 2)
+		lower_size += entries[split++].size;
+	if(!split)
+		split = 1;
+	uint32_t split_hash = entries[split].hash;
+	bool continued = split_hash == entries[split - 1].hash;
+
+	auto pack = [&](uint8_t* dest, size_t start, size_t end) {
+		memset(dest, 0, block_size);
+		size_t offset = 0;
+		ext2_directory* last = nullptr;
+		for(size_t i = start; i < end; i++) {
+			memcpy(dest + offset, buf + entries[i].offset, entries[i].size);
+			last = dirent_at(dest, offset);
+			last->size = entries[i].size;
+			offset += entries[i].size;
+		}
+		last->size += block_size - offset;
+	};
+	pack(lower, 0, split);
+	pack(upper, split, entries.size());
+	if(insert_into_block(path.hash >= split_hash ? upper : lower, block_size, name, inode, type) < 0) {
+		kfree(buf);
+		return false;
+	}
+
+	auto new_block_or_err = append_directory_block();
+	if(new_block_or_err.is_error()) {
+		kfree(buf);
+		return new_block_or_err.result();
+	}
+	uint32_t new_block = new_block_or_err.value();
+
+	//Write the new block first, so that if either write fails, the leaf on disk still has all of its entries and the index
+	//can be left alone. If the leaf can't be written, empty the new block again so its entries don't show up twice.
+	auto res = ext2fs().write_block(get_block_pointer(new_block), upper);
+	if(res.is_error()) {
+		kfree(buf);
+		return res;
+	}
+	res = ext2fs().write_block(get_block_pointer(leaf), lower);
+	if(res.is_error()) {
+		memset(upper, 0, block_size);
+		dirent_at(upper, 0)->size = block_size;
+		ext2fs().write_block(get_block_pointer(new_block), upper);
+		kfree(buf);
+		return res;
+	}
+	kfree(buf);
+
+	//Add the new block to the index, right after the leaf it was split from
+	for(size_t i = frame.count; i > frame.position + 1u; i--)
+		frame.entries[i] = frame.entries[i - 1];
+	frame.entries[frame.position + 1] = {split_hash | (continued ? 1 : 0), new_block};
+	((ext2_dx_countlimit*) frame.entries)->count = ++frame.count;
+	res = ext2fs().write_block(get_block_pointer(frame.block_index), path.node(path.levels));
+	if(res.is_error())
+		return res;
+	return true;
 }
 
 Result Ext2Inode::truncate(off_t length) {
@@ -419,7 +976,7 @@ Result Ext2Inode::truncate(off_t length) {
 
 	if(new_num_blocks > num_blocks()) {
 		//We're expanding the file, allocate new blocks
-		auto new_blocks_res = ext2fs().allocate_blocks(new_num_blocks - num_blocks(), true);
+		auto new_blocks_res = allocate_data_blocks(new_num_blocks - num_blocks());
 		if(new_blocks_res.is_error())
 			return new_blocks_res.result();
 
@@ -427,30 +984,42 @@ Result Ext2Inode::truncate(off_t length) {
 		auto new_blocks = new_blocks_res.value();
 		if(new_blocks.size() != new_num_blocks - num_blocks()) return Result(-ENOSPC);
 
-		//Add the new blocks to the block pointers
-		for(size_t i = 0; i < new_blocks.size(); i++)
-			block_pointers.push_back(new_blocks[i]);
+		//Map the new blocks after the end of the file
+		uint32_t old_num_blocks = num_blocks();
+		uint32_t indirect_allocated = 0;
+		for(size_t i = 0; i < new_blocks.size(); i++) {
+			auto res = _block_map.set(old_num_blocks + i, new_blocks[i], indirect_allocated);
+			if(res.is_error()) {
+				//Undo what was mapped so far, and give back the blocks
+				kstd::vector<uint32_t> unmapped;
+				_block_map.truncate(old_num_blocks, old_num_blocks + i, unmapped);
+				for(size_t j = i; j < new_blocks.size(); j++)
+					unmapped.push_back(new_blocks[j]);
+				ext2fs().free_blocks(unmapped);
+				return res;
+			}
+		}
+		raw.logical_blocks += (new_blocks.size() + indirect_allocated) * (ext2fs().block_size() / 512);
 
-		//Write inode entry and block pointers to disk
+		//Write inode entry to disk
 		_metadata.size = (size_t) length;
 		write_to_disk();
 	} else if(new_num_blocks < num_blocks()) {
-		//We're shrinking the file, free old blocks
-		for(size_t i = num_blocks(); i > new_num_blocks; i--)
-			ext2fs().free_block(get_block_pointer(i - 1));
-		block_pointers.resize(new_num_blocks);
-
-		//Free old pointer blocks as well
-		size_t new_num_pointer_blocks = calculate_num_ptr_blocks(new_num_blocks);
-		for(size_t i = pointer_blocks.size(); i > new_num_pointer_blocks; i--)
-			ext2fs().free_block(pointer_blocks[i - 1]);
-		pointer_blocks.resize(new_num_pointer_blocks);
+		//We're shrinking the file, unmap the old blocks and free them (and indirect blocks) all at once
+		discard_preallocation();
+		kstd::vector<uint32_t> old_blocks;
+		auto res = _block_map.truncate(new_num_blocks, num_blocks(), old_blocks);
+		ext2fs().unshare_blocks(old_blocks);
+		ext2fs().free_blocks(old_blocks);
+		raw.logical_blocks -= min(raw.logical_blocks, old_blocks.size() * (ext2fs().block_size() / 512));
+		if(res.is_error())
+			return res;
 
 		//Zero out the unused portion of the last block
 		if(length % ext2fs().block_size())
 			ext2fs().truncate_block(get_block_pointer(new_num_blocks - 1), length % ext2fs().block_size());
 
-		//Write inode entry and block pointers to disk
+		//Write inode entry to disk
 		_metadata.size = (size_t) length;
 		write_to_disk();
 	} else {
@@ -477,155 +1046,9 @@ Result Ext2Inode::chown(uid_t uid, gid_t gid) {
 	return Result(SUCCESS);
 }
 
-void Ext2Inode::read_singly_indirect(uint32_t singly_indirect_block, uint32_t& block_index) {
-	if(block_index >= num_blocks()) return;
-	uint8_t block_buf[ext2fs().block_size()];
-	ext2fs().read_block(singly_indirect_block, block_buf);
-	pointer_blocks.push_back(singly_indirect_block);
-	for(uint32_t i = 0; i < ext2fs().block_pointers_per_block && block_index < num_blocks(); i++) {
-		block_pointers.push_back(((uint32_t*)block_buf)[i]);
-		block_index++;
-	}
-}
-
-void Ext2Inode::read_doubly_indirect(uint32_t doubly_indirect_block, uint32_t& block_index) {
-	if(block_index >= num_blocks()) return;
-	uint8_t block_buf[ext2fs().block_size()];
-	ext2fs().read_block(doubly_indirect_block, block_buf);
-	pointer_blocks.push_back(doubly_indirect_block);
-	for(uint32_t i = 0; i < ext2fs().block_pointers_per_block && block_index < num_blocks(); i++)
-		read_singly_indirect(((uint32_t*)block_buf)[i], block_index);
-}
-
-void Ext2Inode::read_triply_indirect(uint32_t triply_indirect_block, uint32_t& block_index) {
-	if(block_index >= num_blocks()) return;
-	uint8_t block_buf[ext2fs().block_size()];
-	ext2fs().read_block(triply_indirect_block, block_buf);
-	pointer_blocks.push_back(triply_indirect_block);
-	for(uint32_t i = 0; i < ext2fs().block_pointers_per_block && block_index < num_blocks(); i++) {
-		read_doubly_indirect(((uint32_t*)block_buf)[i], block_index);
-	}
-}
-
-void Ext2Inode::read_block_pointers() {
-	LOCK(lock);
-
-	if(_metadata.is_symlink() && _metadata.size < 60) {
-		pointer_blocks = kstd::vector<uint32_t>();
-		block_pointers = kstd::vector<uint32_t>();
-		return;
-	}
-
-	uint8_t buf[ext2fs().block_size()];
-	block_pointers = kstd::vector<uint32_t>();
-	block_pointers.reserve(num_blocks());
-	pointer_blocks = kstd::vector<uint32_t>();
-
-	uint32_t block_index = 0;
-	while(block_index < 12 && block_index < num_blocks()) {
-		block_pointers.push_back(raw.block_pointers[block_index]);
-		block_index++;
-	}
-
-	read_singly_indirect(raw.s_pointer, block_index);
-	read_doubly_indirect(raw.d_pointer, block_index);
-	read_triply_indirect(raw.t_pointer, block_index);
-}
-
 Result Ext2Inode::write_to_disk() {
-	LOCK(lock);
-
-	Result res = write_block_pointers();
-	if(res.is_error())
-		return res;
-
-
-	res = write_inode_entry();
-	if(res.is_error())
-		return res;
-
-	return Result(SUCCESS);
-}
-
-Result Ext2Inode::write_block_pointers() {
-	LOCK(lock);
-	if(_metadata.is_symlink() && _metadata.size < 60) return Result(SUCCESS);
-
-	pointer_blocks = kstd::vector<uint32_t>(0);
-	pointer_blocks.reserve(calculate_num_ptr_blocks(num_blocks()));
-
-	if(_metadata.is_device()) {
-		//TODO: Update device inode
-	} else {
-		for(uint32_t block_index = 0; block_index < 12; block_index++) {
-			raw.block_pointers[block_index] = get_block_pointer(block_index);
-		}
-	}
-
-	uint8_t block_buf[ext2fs().block_size()];
-
-	if(num_blocks() > 12) {
-		if (!raw.s_pointer) {
-			raw.s_pointer = ext2fs().allocate_block();
-			if (!raw.s_pointer) return Result(-ENOSPC); //Block allocation failed
-		}
-		pointer_blocks.push_back(raw.s_pointer);
-
-		//Write singly indirect block to disk
-		ext2fs().read_block(raw.s_pointer, block_buf);
-		for (uint32_t block_index = 12; block_index < 12 + ext2fs().block_pointers_per_block; block_index++) {
-			((uint32_t *) block_buf)[block_index - 12] = get_block_pointer(block_index);
-		}
-		ext2fs().write_block(raw.s_pointer, block_buf);
-	} else raw.s_pointer = 0;
-
-	if(num_blocks() > 12 + ext2fs().block_pointers_per_block) {
-		//Allocate doubly indirect block if needed and read
-		if(!raw.d_pointer) {
-			raw.d_pointer = ext2fs().allocate_block();
-			if(!raw.d_pointer) return Result(-ENOSPC); //Block allocation failed
-			ext2fs().read_block(raw.d_pointer, block_buf);
-			memset(block_buf, 0, ext2fs().block_size());
-		} else ext2fs().read_block(raw.d_pointer, block_buf);
-		pointer_blocks.push_back(raw.d_pointer);
-
-		uint8_t dblock_buf[ext2fs().block_size()];
-
-		uint32_t cur_block = 12 + ext2fs().block_pointers_per_block;
-		//For each block pointed to in the doubly indirect block,
-		for(uint32_t dindex = 0; dindex < ext2fs().block_pointers_per_block; dindex++) {
-			if(!get_block_pointer(cur_block)) break;
-
-			uint32_t dblock = ((uint32_t*)block_buf)[dindex];
-			//If the block isn't allocated, allocate it
-			if(!dblock) {
-				dblock = ext2fs().allocate_block();
-				((uint32_t*)block_buf)[dindex] = dblock;
-				if(!dblock) return Result(-ENOSPC); //Allocation failed
-			}
-			pointer_blocks.push_back(dblock);
-
-			//Update entries in the block and write to disk
-			ext2fs().read_block(dblock, dblock_buf);
-			for(uint32_t dblock_index = 0; dblock_index < ext2fs().block_size() / sizeof(uint32_t); dblock_index++) {
-				((uint32_t *) dblock_buf)[dblock_index] = get_block_pointer(cur_block);
-				cur_block++;
-			}
-			ext2fs().write_block(dblock, dblock_buf);
-		}
-
-		//Write doubly-indirect block to disk
-		ext2fs().write_block(raw.d_pointer, block_buf);
-	} else raw.d_pointer = 0;
-
-	if(num_blocks() > 12 + ext2fs().block_pointers_per_block * ext2fs().block_pointers_per_block) {
-		KLog::err("ext2", "Writing triply-indirect blocks to disk isn't supported yet!");
-		//TODO: Triply indirect blocks
-	} else raw.t_pointer = 0;
-
-	raw.logical_blocks = (block_pointers.size() + pointer_blocks.size()) * (ext2fs().block_size() / 512);
-	_dirty = true;
-	return Result(SUCCESS);
+	//The block map writes indirect blocks as soon as it changes them, so only the inode entry needs writing
+	return write_inode_entry();
 }
 
 Result Ext2Inode::write_inode_entry() {
@@ -794,26 +1217,113 @@ Result Ext2Inode::try_remove_dir() {
 	return Result(SUCCESS);
 }
 
-uint32_t Ext2Inode::calculate_num_ptr_blocks(uint32_t num_blocks) {
-	if(num_blocks <= 12) return 0;
+ResultRet<kstd::vector<uint32_t>> Ext2Inode::allocate_data_blocks(uint32_t count) {
+	//Try to put the new blocks right after the end of the file, or in the inode's block group if it doesn't have any yet
+	uint32_t last_block = num_blocks() ? get_block_pointer(num_blocks() - 1) : 0;
+	uint32_t goal = last_block ? last_block + 1 : ext2fs().get_block_group(block_group())->first_block();
+
+	//Start new files on a page boundary, so that their pages line up with the disk cache's and can be mapped from it
+	uint32_t blocks_per_page = PAGE_SIZE / ext2fs().block_size();
+	if(!last_block && blocks_per_page > 1)
+		goal = ((goal + blocks_per_page - 1) / blocks_per_page) * blocks_per_page;
+
+	//Use up the blocks set aside for the file first, as long as they're still where the file leaves off
+	if(_prealloc_count && _prealloc_block != goal)
+		discard_preallocation();
+	kstd::vector<uint32_t> blocks;
+	blocks.reserve(count);
+	while(_prealloc_count && blocks.size() < count) {
+		blocks.push_back(_prealloc_block++);
+		_prealloc_count--;
+	}
+	if(blocks.size() == count)
+		return blocks;
+
+	//Allocate the rest along with a new window for regular files to grow into, so appends stay contiguous on disk.
+	//The window grows with the file, so that files being appended to at the same time don't end up interleaved.
+	uint32_t needed = count - blocks.size();
+	uint32_t window = 0;
+	if(_metadata.is_simple_file())
+		window = max(ext2fs().prealloc_blocks(), min((uint32_t) num_blocks(), (uint32_t) EXT2_MAX_PREALLOC_BLOCKS));
+	goal = blocks.empty() ? goal : blocks[blocks.size() - 1] + 1;
+	auto new_blocks_or_err = ext2fs().allocate_blocks(needed + window, true, goal);
+	if(new_blocks_or_err.is_error() && window)
+		new_blocks_or_err = ext2fs().allocate_blocks(needed, true, goal);
+	if(new_blocks_or_err.is_error()) {
+		ext2fs().free_blocks(blocks);
+		return new_blocks_or_err.result();
+	}
+
+	auto& new_blocks = new_blocks_or_err.value();
+	for(size_t i = 0; i < needed; i++)
+		blocks.push_back(new_blocks[i]);
+
+	//Only keep the extra blocks that carry on contiguously from the ones we're using
+	size_t extra = new_blocks.size() - needed;
+	uint32_t window_start = new_blocks[needed - 1] + 1;
+	size_t window_length = 0;
+	while(window_length < extra && new_blocks[needed + window_length] == window_start + window_length)
+		window_length++;
+	if(window_length < extra) {
+		kstd::vector<uint32_t> unused;
+		for(size_t i = needed + window_length; i < new_blocks.size(); i++)
+			unused.push_back(new_blocks[i]);
+		ext2fs().free_blocks(unused);
+	}
+	_prealloc_block = window_start;
+	_prealloc_count = window_length;
 
-	uint32_t ret = 0;
-	uint32_t blocks_left = num_blocks - 12;
+	return blocks;
+}
 
-	//Singly indirect blocks
-	blocks_left -= min(blocks_left, ext2fs().block_pointers_per_block);
-	ret += 1;
-	if(blocks_left == 0) return ret;
+void Ext2Inode::discard_preallocation() {
+	LOCK(lock);
+	if(!_prealloc_count)
+		return;
+	kstd::vector<uint32_t> blocks;
+	blocks.reserve(_prealloc_count);
+	for(uint32_t i = 0; i < _prealloc_count; i++)
+		blocks.push_back(_prealloc_block + i);
+	_prealloc_count = 0;
+	ext2fs().free_blocks(blocks);
+}
 
-	//Doubly indirect blocks
-	uint32_t dind_blocks = min(blocks_left, ext2fs().block_pointers_per_block * ext2fs().block_pointers_per_block);
-	blocks_left -= dind_blocks;
-	ret += 1 + (dind_blocks + ext2fs().block_pointers_per_block - 1) / ext2fs().block_pointers_per_block;
-	if(blocks_left == 0) return ret;
+void Ext2Inode::read_ahead(FileDescriptor& fd, size_t start, size_t length) {
+	auto& state = fd.read_ahead();
+	size_t end = start + length;
 
-	//TODO: Calculate triply indirect blocks
-	PANIC("EXT2_TIND", "We don't know how to calculate triply indirect blocks yet!");
-	return ret;
+	//Grow the window while reads are sequential, and shrink it (eventually to nothing) when they aren't
+	if(start == state.next_offset) {
+		state.window = state.window ? min(state.window * 2, (size_t) EXT2_READ_AHEAD_MAX) : EXT2_READ_AHEAD_MIN;
+	} else {
+		state.window /= 4;
+		if(state.window < EXT2_READ_AHEAD_MIN)
+			state.window = 0;
+		state.prefetched_until = 0;
+	}
+	state.next_offset = end;
+	if(!state.window)
+		return;
+
+	//Only top up the prefetched range once the reader has used up half of it, so requests are issued in batches
+	size_t prefetch_start = max(end, state.prefetched_until);
+	size_t prefetch_end = min(end + state.window, (size_t) _metadata.size);
+	if(prefetch_start >= prefetch_end || prefetch_start - end > state.window / 2)
+		return;
+
+	//Prefetch each run of blocks that is contiguous on disk with one request
+	size_t block_size = ext2fs().block_size();
+	size_t block_index = prefetch_start / block_size;
+	size_t end_index = (prefetch_end + block_size - 1) / block_size;
+	while(block_index < end_index) {
+		uint32_t run_length;
+		uint32_t block = _block_map.get_run(block_index, end_index - block_index, run_length);
+		if(block)
+			ext2fs().prefetch_blocks(block, run_length);
+		block_index += run_length;
+	}
+
+	state.prefetched_until = end_index * block_size;
 }
 
 void Ext2Inode::open(FileDescriptor& fd, int options) {
@@ -821,7 +1331,44 @@ void Ext2Inode::open(FileDescriptor& fd, int options) {
 }
 
 void Ext2Inode::close(FileDescriptor& fd) {
+	//Give back the blocks set aside for the file to grow into, since it's probably done being written to
+	discard_preallocation();
+}
+
+ResultRet<PageIndex> Ext2Inode::share_page(size_t index) {
+	size_t block_size = ext2fs().block_size();
+	if(_metadata.is_device() || block_size > PAGE_SIZE || !exists())
+		return Result(-ENOTSUP);
+
+	LOCK(lock);
+
+	//Only pages that are entirely inside the file can be shared, since the rest of the last page has to read as zeroes
+	if((index + 1) * PAGE_SIZE > _metadata.size)
+		return Result(-ENOTSUP);
+
+	//The page's blocks have to be contiguous on disk to all be in the same page of the disk cache
+	size_t blocks_per_page = PAGE_SIZE / block_size;
+	uint32_t run_length;
+	uint32_t block = _block_map.get_run(index * blocks_per_page, blocks_per_page, run_length);
+	if(!block || run_length < blocks_per_page)
+		return Result(-ENOTSUP);
+
+	return ext2fs().share_cache_page(block);
+}
+
+void Ext2Inode::mark_page_dirty(size_t index, PageIndex page) {
+	size_t block_size = ext2fs().block_size();
+	if(_metadata.is_device() || block_size > PAGE_SIZE || !exists())
+		return;
+
+	LOCK(lock);
+	size_t blocks_per_page = PAGE_SIZE / block_size;
+	uint32_t run_length;
+	uint32_t block = _block_map.get_run(index * blocks_per_page, blocks_per_page, run_length);
+	if(!block || run_length < blocks_per_page)
+		return;
 
+	ext2fs().mark_cache_page_dirty(block, page);
 }
 
 
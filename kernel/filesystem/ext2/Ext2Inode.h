@@ -21,11 +21,20 @@
 
 #include <kernel/filesystem/Inode.h>
 #include <kernel/kstd/vector.hpp>
+#include <kernel/kstd/Arc.h>
+#include "Ext2DirectoryIndex.h"
+#include "Ext2BlockMap.h"
+
+/** The read-ahead window used when sequential reads of a file are first detected, in bytes. **/
+#define EXT2_READ_AHEAD_MIN (16 * 1024)
+/** The largest the read-ahead window will grow to while a file is read sequentially, in bytes. **/
+#define EXT2_READ_AHEAD_MAX (256 * 1024)
 
 class Ext2Filesystem;
 class Ext2Inode: public Inode {
 public:
-	typedef struct __attribute__((packed)) Raw {
+	//Aligned so that the block pointers can be handed to Ext2BlockMap
+	typedef struct __attribute__((packed, aligned(4))) Raw {
 		uint16_t mode = 0;
 		uid_t uid = 0;
 		uint32_t size = 0;
@@ -61,7 +70,6 @@ public:
 
 	uint32_t get_block_pointer(uint32_t block_index);
 	bool set_block_pointer(uint32_t block_index, uint32_t block);
-	kstd::vector<uint32_t>& get_block_pointers();
 	void free_all_blocks();
 
 	ssize_t read(size_t start, size_t length, SafePointer<uint8_t> buffer, FileDescriptor* fd) override;
@@ -76,26 +84,42 @@ public:
 	Result chown(uid_t uid, gid_t gid) override;
 	void open(FileDescriptor& fd, int options) override;
 	void close(FileDescriptor& fd) override;
+	ResultRet<PageIndex> share_page(size_t index) override;
+	void mark_page_dirty(size_t index, PageIndex page) override;
 
 private:
-	void read_singly_indirect(uint32_t singly_indirect_block, uint32_t& block_index);
-	void read_doubly_indirect(uint32_t doubly_indirect_block, uint32_t& block_index);
-	void read_triply_indirect(uint32_t triply_indirect_block, uint32_t& block_index);
-	void read_block_pointers();
+	struct HTreePath;
+
 	Result write_to_disk();
-	Result write_block_pointers();
 	Result write_inode_entry();
 	Result write_directory_entries(kstd::vector<DirectoryEntry>& entries);
+
+	//Directory entries
+	ino_t find_entry(const kstd::string& name, uint32_t& offset);
+	Result insert_entry(const kstd::string& name, ino_t inode, uint8_t type);
+	Result remove_entry_at(uint32_t offset);
+	ResultRet<uint32_t> append_directory_block();
+	bool has_htree();
+	ResultRet<uint32_t> htree_find_leaf(const kstd::string& name, HTreePath& path);
+	bool htree_next_leaf(HTreePath& path, uint32_t& leaf);
+	ResultRet<bool> htree_insert(const kstd::string& name, ino_t inode, uint8_t type);
+	ResultRet<bool> htree_grow_index(HTreePath& path);
+	void disable_htree();
+	void build_directory_index();
 	void create_metadata();
 	void reduce_hardlink_count();
 	void increase_hardlink_count();
 	Result try_remove_dir();
-	uint32_t calculate_num_ptr_blocks(uint32_t num_blocks);
-
-	kstd::vector<uint32_t> block_pointers;
-	kstd::vector<uint32_t> pointer_blocks;
+	ResultRet<kstd::vector<uint32_t>> allocate_data_blocks(uint32_t count);
+	void discard_preallocation();
+	void read_ahead(FileDescriptor& fd, size_t start, size_t length);
+	ssize_t write_data(size_t start, size_t length, SafePointer<uint8_t> buffer);
 
 	Raw raw;
+	Ext2BlockMap _block_map; ///< Maps the blocks of the file to blocks on disk, using the pointers in raw.
 	bool _dirty = false;
+	uint32_t _prealloc_block = 0; ///< The first of the blocks set aside for the file to grow into.
+	uint32_t _prealloc_count = 0; ///< The number of blocks set aside for the file to grow into.
+	kstd::Arc<Ext2DirectoryIndex> _dir_index; ///< An in-memory index of the entries, for large directories without an HTree.
 };
 
@@ -75,6 +75,18 @@ ProcFSEntry::ProcFSEntry(ProcFSInodeType type, pid_t pid): type(type), pid(pid)
 			parent = 1;
 			break;
 
+		case RootDiskStats:
+			name = "diskstats";
+			dirent_type = TYPE_FILE;
+			parent = 1;
+			break;
+
+		case RootDentryStats:
+			name = "dentrystats";
+			dirent_type = TYPE_FILE;
+			parent = 1;
+			break;
+
 		case ProcCwd:
 			name = "cwd";
 			dirent_type = TYPE_SYMLINK;
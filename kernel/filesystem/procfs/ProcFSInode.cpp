@@ -31,6 +31,8 @@
 #include <kernel/tasking/Process.h>
 #include <kernel/memory/PageDirectory.h>
 #include <kernel/device/DiskDevice.h>
+#include <kernel/filesystem/DentryCache.h>
+#include <kernel/acpi/ACPI.h>
 
 const char* PROC_STATE_NAMES[] = {"Running", "Zombie", "Dead", "Sleeping"};
 
@@ -132,6 +134,10 @@ ssize_t ProcFSInode::read(size_t start, size_t length, SafePointer<uint8_t> buff
 			str += "\nkcache = ";
 			itoa((int) DiskDevice::used_cache_memory(), numbuf, 10);
 			str += numbuf;
+
+			str += "\nkdirty = ";
+			itoa((int) DiskDevice::dirty_cache_memory(), numbuf, 10);
+			str += numbuf;
 			str += "\n";
 
 			if(start >= str.length())
@@ -178,6 +184,72 @@ ssize_t ProcFSInode::read(size_t start, size_t length, SafePointer<uint8_t> buff
 				num_decimals++;
 			}
 
+			str += "\nprocessors = ";
+			itoa((int) ACPI::num_processors(), numbuf, 10);
+			str += numbuf;
+
+			if(start >= str.length())
+				return 0;
+			if(start + length > str.length())
+				length = str.length() - start;
+			buffer.write((unsigned char*) str.c_str() + start, length);
+			return length;
+		}
+
+		case RootDiskStats: {
+			char numbuf[12];
+			auto stats = DiskDevice::read_ahead_stats();
+
+			kstd::string str = "[readahead]\nhits = ";
+			itoa((int) stats.hits, numbuf, 10);
+			str += numbuf;
+
+			str += "\nmisses = ";
+			itoa((int) stats.misses, numbuf, 10);
+			str += numbuf;
+
+			str += "\nwasted = ";
+			itoa((int) stats.wasted, numbuf, 10);
+			str += numbuf;
+
+			str += "\nprefetched = ";
+			itoa((int) stats.prefetched, numbuf, 10);
+			str += numbuf;
+			str += "\n";
+
+			if(start >= str.length())
+				return 0;
+			if(start + length > str.length())
+				length = str.length() - start;
+			buffer.write((unsigned char*) str.c_str() + start, length);
+			return length;
+		}
+
+		case RootDentryStats: {
+			char numbuf[12];
+			auto stats = DentryCache::inst().stats();
+
+			kstd::string str = "[dcache]\nhits = ";
+			itoa((int) stats.hits, numbuf, 10);
+			str += numbuf;
+
+			str += "\nnegative_hits = ";
+			itoa((int) stats.negative_hits, numbuf, 10);
+			str += numbuf;
+
+			str += "\nmisses = ";
+			itoa((int) stats.misses, numbuf, 10);
+			str += numbuf;
+
+			str += "\ninvalidations = ";
+			itoa((int) stats.invalidations, numbuf, 10);
+			str += numbuf;
+
+			str += "\nentries = ";
+			itoa((int) stats.entries, numbuf, 10);
+			str += numbuf;
+			str += "\n";
+
 			if(start >= str.length())
 				return 0;
 			if(start + length > str.length())
@@ -231,6 +303,16 @@ ssize_t ProcFSInode::read(size_t start, size_t length, SafePointer<uint8_t> buff
 			str += "\nshmem = ";
 			itoa(proc.value()->used_shmem(), numbuf, 10);
 			str += numbuf;
+
+			str += "\nnice = ";
+			itoa(proc.value()->nice(), numbuf, 10);
+			str += numbuf;
+
+			// The current run queue level of the main thread, where 0 is the highest priority
+			auto main_thread = proc.value()->get_thread(pid);
+			str += "\npriority = ";
+			itoa(main_thread ? max(main_thread->sched_level, 0) : 0, numbuf, 10);
+			str += numbuf;
 			str += "\n";
 
 			if(start >= str.length())
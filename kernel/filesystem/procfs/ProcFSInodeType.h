@@ -30,6 +30,8 @@ enum ProcFSInodeType {
 	RootCmdLine,
 	RootUptime,
 	RootCpuInfo,
+	RootDiskStats,
+	RootDentryStats,
 
 	//Process entries
 	ProcExe,
@@ -0,0 +1,18 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later */
+/* Copyright © 2016-2023 Byteduck */
+
+#include "SocketFSClient.h"
+
+SocketFSPacketBuffer::SocketFSPacketBuffer(size_t size): _size(size) {
+	if(size >= SOCKETFS_PAGE_BUFFER_THRESHOLD) {
+		_region = MM.alloc_kernel_region(size);
+		_data = (uint8_t*) _region->start();
+	} else {
+		_data = (uint8_t*) kmalloc(size);
+	}
+}
+
+SocketFSPacketBuffer::~SocketFSPacketBuffer() {
+	if(!_region)
+		kfree(_data);
+}
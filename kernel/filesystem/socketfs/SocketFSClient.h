@@ -23,16 +23,40 @@
 #include <kernel/kstd/queue.hpp>
 #include <kernel/kstd/unix_types.h>
 #include <kernel/tasking/SpinLock.h>
+#include <kernel/memory/MemoryManager.h>
+#include "socketfs_defines.h"
+
+/** Packets at least this large are backed by whole kernel pages instead of the kernel heap. **/
+#define SOCKETFS_PAGE_BUFFER_THRESHOLD PAGE_SIZE
+
+/**
+ * A single packet (header and body) waiting to be read by a SocketFS client. Packets are refcounted so that a broadcast
+ * is only copied from the sender once, no matter how many clients it's queued on.
+ */
+class SocketFSPacketBuffer {
+public:
+	explicit SocketFSPacketBuffer(size_t size);
+	~SocketFSPacketBuffer();
+
+	[[nodiscard]] uint8_t* data() const { return _data; }
+	[[nodiscard]] size_t size() const { return _size; }
+
+private:
+	uint8_t* _data;
+	size_t _size;
+	kstd::Arc<VMRegion> _region; ///< The pages backing the packet if it's large, otherwise null.
+};
 
 class Process;
 class SocketFSClient {
 public:
-	explicit SocketFSClient(sockid_t id, pid_t pid): id(id), pid(pid), data_queue() {}
+	explicit SocketFSClient(sockid_t id, pid_t pid): id(id), pid(pid) {}
 
 	sockid_t id;
 	pid_t pid;
-	kstd::queue<uint8_t> data_queue;
+	kstd::queue<kstd::Arc<SocketFSPacketBuffer>> packets;
+	size_t queued_bytes = 0; ///< The number of unread bytes in packets.
+	size_t front_offset = 0; ///< The number of bytes of the front packet that have already been read.
 	SpinLock data_lock;
 	BooleanBlocker blocker;
 };
-
@@ -90,19 +90,25 @@ ssize_t SocketFSInode::read(size_t start, size_t length, SafePointer<uint8_t> bu
 
 	LOCK(reader->data_lock);
 
-	if(length > reader->data_queue.size())
-		length = reader->data_queue.size();
-
-	//Read into the buffer from the queue
-	auto& queue = reader->data_queue;
-	for(size_t i = 0; i < length; i++) {
-		buffer.set(i, queue.front());
-		queue.pop_front();
+	//Copy out of each queued packet in one go, popping packets once they've been read entirely
+	auto& packets = reader->packets;
+	size_t nread = 0;
+	while(nread < length && !packets.empty()) {
+		auto& packet = packets.front();
+		size_t to_copy = min(length - nread, packet->size() - reader->front_offset);
+		buffer.write(packet->data() + reader->front_offset, nread, to_copy);
+		nread += to_copy;
+		reader->front_offset += to_copy;
+		if(reader->front_offset == packet->size()) {
+			packets.pop_front();
+			reader->front_offset = 0;
+		}
 	}
 
+	reader->queued_bytes -= nread;
 	reader->blocker.set_ready(true);
 
-	return length;
+	return nread;
 }
 
 ResultRet<kstd::Arc<LinkedInode>> SocketFSInode::resolve_link(const kstd::Arc<LinkedInode>& base, const User& user, kstd::Arc<LinkedInode>* parent_storage, int options, int recursion_level) {
@@ -160,14 +166,17 @@ ssize_t SocketFSInode::write(size_t start, size_t length, SafePointer<uint8_t> b
 	}
 
 	if(is_broadcast && sender == host) {
-		//If it's a broadcast, send it to all clients
+		//If it's a broadcast, copy it once and queue the same buffer on all clients
+		auto packet_res = make_packet(SOCKETFS_TYPE_MSG, sender->id, packet.length, packet.shm_id, packet.shm_perms, packet_data);
+		if(packet_res.is_error())
+			return packet_res.code();
 		LOCK(m_clients_lock);
 		for(auto& client : m_clients) {
 			//Share shm with client if we need to
 			if(packet.shm_id)
 				TaskManager::current_process()->sys_shmallow(packet.shm_id, client->pid, packet.shm_perms);
 			//We don't care about errors here, we should just continue sending it to the rest of the clients
-			write_packet(client, SOCKETFS_TYPE_MSG, sender->id, packet.length, packet.shm_id, packet.shm_perms, packet_data, fd->nonblock());
+			queue_packet(client, packet_res.value(), fd->nonblock());
 		}
 		return SUCCESS;
 	} else if(sender == host) {
@@ -301,40 +310,53 @@ void SocketFSInode::close(FileDescriptor& fd) {
 bool SocketFSInode::can_read(const FileDescriptor& fd) {
 	auto id = SocketFS::client_hash(&fd);
 	if(id == host->id)
-		return !host->data_queue.empty();
+		return host->queued_bytes;
 	for(auto& client : m_clients)
 		if(client->id == id)
-			return !client->data_queue.empty();
+			return client->queued_bytes;
 	return false;
 }
 
 Result SocketFSInode::write_packet(const kstd::Arc<SocketFSClient>& client, int type, sockid_t sender, size_t length, int shm_id, int shm_perms, SafePointer<uint8_t> buffer, bool nonblock) {
-	//If there's room in the buffer, block (if O_NONBLOCK isn't set)
-	while(sizeof(SocketFSPacket) + length + client->data_queue.size() > SOCKETFS_MAX_BUFFER_SIZE) {
-		if(!nonblock) {
-			client->blocker.set_ready(false);
-			TaskManager::current_thread()->block(client->blocker);
-			if(client->blocker.was_interrupted())
-				return Result(EINTR);
-		} else {
-			return Result(-ENOSPC);
-		}
-	}
+	auto packet = TRY(make_packet(type, sender, length, shm_id, shm_perms, buffer));
+	return queue_packet(client, packet, nonblock);
+}
 
-	//Acquire the lock
-	LOCK(client->data_lock);
+ResultRet<kstd::Arc<SocketFSPacketBuffer>> SocketFSInode::make_packet(int type, sockid_t sender, size_t length, int shm_id, int shm_perms, SafePointer<uint8_t> buffer) {
+	if(sizeof(SocketFSPacket) + length > SOCKETFS_MAX_BUFFER_SIZE)
+		return Result(-EMSGSIZE);
 
-	//Write the packet header
+	//Copy the header and body into a kernel buffer up front so we don't have to touch the sender's memory while locked
+	auto packet = kstd::Arc<SocketFSPacketBuffer>::make(sizeof(SocketFSPacket) + length);
 	SocketFSPacket packet_header = {type, sender, TaskManager::current_process()->pid(), length, shm_id, shm_perms};
-	auto* data = (const uint8_t*) &packet_header;
-	for(size_t i = 0; i < sizeof(SocketFSPacket); i++)
-		client->data_queue.push_back(*data++);
+	memcpy(packet->data(), &packet_header, sizeof(SocketFSPacket));
+	if(length)
+		buffer.read(packet->data() + sizeof(SocketFSPacket), 0, length);
 
-	//Write the packet body
-	for(size_t i = 0; i < length; i++)
-		client->data_queue.push_back(buffer.get(i));
+	return packet;
+}
 
-	return Result(SUCCESS);
+Result SocketFSInode::queue_packet(const kstd::Arc<SocketFSClient>& client, const kstd::Arc<SocketFSPacketBuffer>& packet, bool nonblock) {
+	while(true) {
+		{
+			LOCK(client->data_lock);
+			if(client->queued_bytes + packet->size() <= SOCKETFS_MAX_BUFFER_SIZE) {
+				client->packets.push_back(packet);
+				client->queued_bytes += packet->size();
+				TaskManager::notify_io();
+				return Result(SUCCESS);
+			}
+
+			//There's no room in the buffer, so block (if O_NONBLOCK isn't set) until the client reads
+			if(nonblock)
+				return Result(-ENOSPC);
+			client->blocker.set_ready(false);
+		}
+
+		TaskManager::current_thread()->block(client->blocker);
+		if(client->blocker.was_interrupted())
+			return Result(-EINTR);
+	}
 }
 
 kstd::Arc<SocketFSClient> SocketFSInode::get_client(const FileDescriptor* fd) const {
@@ -61,6 +61,8 @@ public:
 
 private:
 	Result write_packet(const kstd::Arc<SocketFSClient>& recipient, int type, sockid_t sender, size_t size, int shm_id, int shm_perms, SafePointer<uint8_t> buffer, bool nonblock);
+	ResultRet<kstd::Arc<SocketFSPacketBuffer>> make_packet(int type, sockid_t sender, size_t size, int shm_id, int shm_perms, SafePointer<uint8_t> buffer);
+	Result queue_packet(const kstd::Arc<SocketFSClient>& recipient, const kstd::Arc<SocketFSPacketBuffer>& packet, bool nonblock);
 
 	[[nodiscard]] kstd::Arc<SocketFSClient> get_client(const FileDescriptor* fd) const;
 
@@ -0,0 +1,42 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later */
+/* Copyright © 2016-2023 Byteduck */
+
+#include "APIC.h"
+#include "../acpi/ACPI.h"
+#include "../memory/MemoryManager.h"
+#include "../memory/VMRegion.h"
+#include "../kstd/KLog.h"
+
+namespace APIC {
+	static kstd::Arc<VMRegion> s_lapic_region;
+
+	static bool cpu_has_apic() {
+		uint32_t eax = 1, ebx, ecx, edx;
+		asm volatile("cpuid" : "+a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx));
+		return edx & CPUID_FEATURE_APIC;
+	}
+
+	bool init() {
+		if(!cpu_has_apic() || !ACPI::present()) {
+			KLog::dbg("APIC", "No local APIC found.");
+			return false;
+		}
+
+		s_lapic_region = MM.alloc_mapped_region(ACPI::madt().lapic_address, PAGE_SIZE);
+		KLog::dbg("APIC", "Bootstrap processor has local APIC ID %d, version 0x%x", id(), read(LAPIC_REG_VERSION) & 0xFF);
+		return true;
+	}
+
+	bool present() {
+		return s_lapic_region;
+	}
+
+	uint32_t read(size_t reg) {
+		ASSERT(s_lapic_region);
+		return *(volatile uint32_t*) (s_lapic_region->start() + reg);
+	}
+
+	uint8_t id() {
+		return read(LAPIC_REG_ID) >> 24;
+	}
+}
@@ -0,0 +1,28 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later */
+/* Copyright © 2016-2023 Byteduck */
+
+#pragma once
+
+#include "../kstd/types.h"
+
+#define LAPIC_REG_ID 0x20
+#define LAPIC_REG_VERSION 0x30
+#define CPUID_FEATURE_APIC (1 << 9)
+
+namespace APIC {
+	/**
+	 * Detects and maps the local APIC of the bootstrap processor using the address from the MADT. The PIC still
+	 * delivers all interrupts, so the local APIC is left in whatever state the firmware left it in.
+	 * @return Whether a local APIC is present.
+	 */
+	bool init();
+
+	/** Whether init() found a local APIC. **/
+	bool present();
+
+	/** Reads a register of the local APIC of the current processor. **/
+	uint32_t read(size_t reg);
+
+	/** The local APIC ID of the current processor. **/
+	uint8_t id();
+}
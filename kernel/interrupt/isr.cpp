@@ -79,6 +79,10 @@ namespace Interrupt {
 					handle_fault("DIVIDE_BY_ZERO", "Please don't do that.", SIGILL);
 					break;
 
+				case 7: //Device not available
+					TaskManager::handle_fpu_trap();
+					break;
+
 				case 13: //GPF
 					handle_fault("GENERAL_PROTECTION_FAULT", "How did you manage to do that?", SIGILL);
 					break;
@@ -89,16 +93,12 @@ namespace Interrupt {
 					} else {
 						size_t err_pos;
 						asm volatile ("mov %%cr2, %0" : "=r" (err_pos));
-						PageFault::Type type;
-						if(r->err_code == FAULT_USER_READ)
-							type = PageFault::Type::Read;
-						else if(r->err_code == FAULT_USER_WRITE)
-							type = PageFault::Type::Write;
-						else
-							type = PageFault::Type::Unknown;
+						// The write bit of the error code is set for writes from both userspace and the kernel
+						PageFault::Type type = (r->err_code & FAULT_KERNEL_WRITE) ? PageFault::Type::Write : PageFault::Type::Read;
 						TaskManager::current_thread()->handle_pagefault({
 							err_pos,
 							r->eip,
+							type
 						});
 					}
 					break;
@@ -45,6 +45,8 @@
 #include <kernel/KernelMapper.h>
 #include <kernel/tasking/ProcessArgs.h>
 #include <kernel/kstd/KLog.h>
+#include <kernel/acpi/ACPI.h>
+#include <kernel/interrupt/APIC.h>
 #include <kernel/tests/KernelTest.h>
 #include "bootlogo.h"
 
@@ -80,6 +82,8 @@ int kmain(uint32_t mbootptr){
 	Interrupt::init();
 	MemoryManager::inst().setup_paging();
 	VMWare::detect();
+	ACPI::init();
+	APIC::init();
 	Device::init();
 
 	//Try setting up VGA
@@ -3,92 +3,213 @@
 
 #pragma once
 
-#include "map.hpp"
-#include "vector.hpp"
+#include "hash.h"
 #include "pair.hpp"
 #include "../Result.hpp"
 #include "Optional.h"
 
 namespace kstd {
+	/**
+	 * A least-recently-used cache. Items are kept in an intrusive doubly-linked list ordered by recency, and are indexed
+	 * by a chained hash table, so looking up, inserting, promoting, and evicting items are all O(1).
+	 */
 	template<typename Key, typename Value>
 	class LRUCache {
 	public:
 		LRUCache() = default;
+		LRUCache(const LRUCache<Key, Value>& other) = delete;
+		LRUCache<Key, Value>& operator=(const LRUCache<Key, Value>& other) = delete;
+
+		~LRUCache() {
+			Node* node = m_lru;
+			while(node) {
+				Node* next = node->newer;
+				delete node;
+				node = next;
+			}
+			delete[] m_buckets;
+		}
 
 		/** Insert the item with the given key and value, replacing it if it exists. **/
 		void insert(Key key, Value value) {
-			auto node = m_map.get(key);
+			auto node = find_node(key);
 			if(node) {
-				*node = value;
-				promote(key);
-			} else {
-				m_map.insert({key, value});
-				m_lru_list.push_back(key);
+				node->value = value;
+				move_to_front(node);
+				return;
 			}
+
+			if(m_size + 1 > m_num_buckets - (m_num_buckets / 4))
+				rehash(m_num_buckets ? m_num_buckets * 2 : 16);
+
+			node = new Node {key, value};
+			auto& bucket = m_buckets[bucket_index(key)];
+			node->hash_next = bucket;
+			bucket = node;
+			link_front(node);
+			m_size++;
 		}
 
 		/** Removes the item with the given key if it exists. **/
 		void erase(Key key) {
-			m_map.erase(key);
-			for(size_t i = 0; i < m_lru_list.size(); i++) {
-				if(m_lru_list[i] == key) {
-					m_lru_list.erase(i);
+			if(!m_num_buckets)
+				return;
+			Node** link = &m_buckets[bucket_index(key)];
+			while(*link) {
+				if((*link)->key == key) {
+					remove_node(*link, link);
 					return;
 				}
+				link = &(*link)->hash_next;
 			}
 		}
 
 		/** Promote the item with the given key, if in the list, to be most recently used. **/
 		void promote(Key key) {
-			bool found = false;
-			for(size_t i = 0; i < m_lru_list.size(); i++) {
-				if(m_lru_list[i] == key) {
-					m_lru_list.erase(i);
-					found = true;
-					break;
-				}
-			}
-
-			if(found)
-				m_lru_list.push_back(key);
+			auto node = find_node(key);
+			if(node)
+				move_to_front(node);
 		}
 
 		/** Gets the item with the given key **/
 		kstd::Optional<Value> get(Key key) {
-			auto item = m_map.get(key);
-			if(item) {
-				promote(key);
-				return *item;
-			}
+			auto value = find(key);
+			if(value)
+				return *value;
 			return kstd::nullopt;
 		}
 
+		/**
+		 * Gets a pointer to the item with the given key and promotes it, or nullptr if it isn't in the cache. Unlike get(),
+		 * this doesn't need to copy the value. The pointer is only valid until the item is removed from the cache.
+		 */
+		Value* find(Key key) {
+			auto node = find_node(key);
+			if(!node)
+				return nullptr;
+			move_to_front(node);
+			return &node->value;
+		}
+
+		/** Checks whether an item with the given key is in the cache without promoting it. **/
+		[[nodiscard]] bool contains(const Key& key) const {
+			return find_node(key);
+		}
+
 		/** Prunes a number of items from the cache. **/
 		void prune(size_t num) {
-			while(!m_lru_list.empty() && num--) {
-				m_map.erase(m_lru_list[0]);
-				m_lru_list.erase(0);
-			}
+			while(m_lru && num--)
+				erase(m_lru->key);
 		}
 
 		/** Returns the least recently used item. **/
 		kstd::Optional<kstd::pair<Key, Value&>> lru() {
 			if(empty())
 				return kstd::nullopt;
-			return kstd::pair<Key, Value&> {m_lru_list[0], m_map[m_lru_list[0]]};
+			return kstd::pair<Key, Value&> {m_lru->key, m_lru->value};
 		}
 
 		/** Returns the least recently used item without wrapping in an optional. **/
 		kstd::pair<Key, Value&> lru_unsafe() {
 			ASSERT(!empty());
-			return kstd::pair<Key, Value&> {m_lru_list[0], m_map[m_lru_list[0]]};
+			return kstd::pair<Key, Value&> {m_lru->key, m_lru->value};
+		}
+
+		/**
+		 * Returns the least recently used item that the predicate returns true for, without promoting it. The items that
+		 * were skipped over are promoted instead, so that repeated calls don't keep scanning past the same ones.
+		 */
+		template<typename F>
+		kstd::Optional<kstd::pair<Key, Value&>> lru_matching(F predicate) {
+			for(size_t i = 0; i < m_size; i++) {
+				Node* node = m_lru;
+				if(predicate(node->value))
+					return kstd::pair<Key, Value&> {node->key, node->value};
+				move_to_front(node);
+			}
+			return kstd::nullopt;
 		}
 
-		[[nodiscard]] size_t size() const { return m_lru_list.size(); }
-		[[nodiscard]] bool empty() const { return m_lru_list.empty(); }
+		[[nodiscard]] size_t size() const { return m_size; }
+		[[nodiscard]] bool empty() const { return !m_size; }
 
 	private:
-		kstd::map<Key, Value> m_map;
-		kstd::vector<Key> m_lru_list;
+		struct Node {
+			Key key;
+			Value value;
+			Node* older = nullptr;
+			Node* newer = nullptr;
+			Node* hash_next = nullptr;
+		};
+
+		inline size_t bucket_index(const Key& key) const {
+			return kstd::hash(key) & (m_num_buckets - 1);
+		}
+
+		Node* find_node(const Key& key) const {
+			if(!m_num_buckets)
+				return nullptr;
+			Node* node = m_buckets[bucket_index(key)];
+			while(node && !(node->key == key))
+				node = node->hash_next;
+			return node;
+		}
+
+		/** Links a node in as the most recently used. **/
+		void link_front(Node* node) {
+			node->older = m_mru;
+			node->newer = nullptr;
+			if(m_mru)
+				m_mru->newer = node;
+			else
+				m_lru = node;
+			m_mru = node;
+		}
+
+		void unlink(Node* node) {
+			if(node->older)
+				node->older->newer = node->newer;
+			else
+				m_lru = node->newer;
+			if(node->newer)
+				node->newer->older = node->older;
+			else
+				m_mru = node->older;
+		}
+
+		void move_to_front(Node* node) {
+			if(node == m_mru)
+				return;
+			unlink(node);
+			link_front(node);
+		}
+
+		/** Removes a node, given the pointer in its hash chain that points to it. **/
+		void remove_node(Node* node, Node** link) {
+			*link = node->hash_next;
+			unlink(node);
+			delete node;
+			m_size--;
+		}
+
+		void rehash(size_t new_num_buckets) {
+			auto** new_buckets = new Node*[new_num_buckets];
+			for(size_t i = 0; i < new_num_buckets; i++)
+				new_buckets[i] = nullptr;
+			for(Node* node = m_lru; node; node = node->newer) {
+				auto& bucket = new_buckets[kstd::hash(node->key) & (new_num_buckets - 1)];
+				node->hash_next = bucket;
+				bucket = node;
+			}
+			delete[] m_buckets;
+			m_buckets = new_buckets;
+			m_num_buckets = new_num_buckets;
+		}
+
+		Node** m_buckets = nullptr;
+		size_t m_num_buckets = 0;
+		size_t m_size = 0;
+		Node* m_lru = nullptr; ///< The least recently used item, i.e. the head of the recency list
+		Node* m_mru = nullptr; ///< The most recently used item, i.e. the tail of the recency list
 	};
-}
\ No newline at end of file
+}
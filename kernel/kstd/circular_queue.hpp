@@ -120,6 +120,53 @@ namespace kstd {
 			return _storage;
 		}
 
+		/**
+		 * Gets the longest contiguous run of elements at the front of the queue. The whole queue can be consumed with
+		 * at most two calls to this and drop_front(). Only meant for trivially copyable types.
+		 * @param length Set to the number of elements in the run.
+		 * @return A pointer to the first element of the run.
+		 */
+		T* front_span(size_t& length) const {
+			length = _capacity - _front < _size ? _capacity - _front : _size;
+			return &_storage[_front];
+		}
+
+		/** Removes count elements from the front of the queue without destroying them. See front_span(). **/
+		void drop_front(size_t count) {
+			_size -= count;
+			if(_size == 0) {
+				_front = 0;
+				_back = 0;
+			} else {
+				_front = (_front + count) % _capacity;
+			}
+		}
+
+		/**
+		 * Gets the longest contiguous run of free space after the back of the queue. Once elements have been written
+		 * there, they can be added to the queue with commit_back(). Only meant for trivially copyable types.
+		 * @param length Set to the number of elements that fit in the run.
+		 * @return A pointer to the start of the run.
+		 */
+		T* back_span(size_t& length) const {
+			size_t start = _size ? (_back + 1) % _capacity : 0;
+			length = _capacity - start < _capacity - _size ? _capacity - start : _capacity - _size;
+			return &_storage[start];
+		}
+
+		/** Adds count elements that were written into the space returned by back_span() to the queue. **/
+		void commit_back(size_t count) {
+			if(!count)
+				return;
+			if(_size == 0) {
+				_front = 0;
+				_back = count - 1;
+			} else {
+				_back = (_back + count) % _capacity;
+			}
+			_size += count;
+		}
+
 		circular_queue<T>& operator=(const circular_queue<T>& other) noexcept {
 			if(this != &other) {
 				for(size_t i = 0; i < _size; i++) _storage[i].~T();
@@ -0,0 +1,39 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later */
+/* Copyright © 2016-2023 Byteduck */
+
+#pragma once
+
+#include "types.h"
+
+namespace kstd {
+	/** Mixes the bits of a 32-bit integer so that keys differing only in a few bits spread evenly across buckets. **/
+	inline uint32_t hash_int(uint32_t x) {
+		x ^= x >> 16;
+		x *= 0x7feb352d;
+		x ^= x >> 15;
+		x *= 0x846ca68b;
+		x ^= x >> 16;
+		return x;
+	}
+
+	/** Hashes an integral value. **/
+	template<typename T>
+	inline uint32_t hash(const T& value) {
+		auto wide = (uint64_t) value;
+		return hash_int((uint32_t) wide ^ (uint32_t) (wide >> 32));
+	}
+
+	/** Hashes a string of bytes with FNV-1a. **/
+	inline uint32_t hash_bytes(const char* data, size_t length) {
+		uint32_t hash = 2166136261u;
+		for(size_t i = 0; i < length; i++)
+			hash = (hash ^ (uint8_t) data[i]) * 16777619u;
+		return hash;
+	}
+
+	/** Hashes a pointer by its address. **/
+	template<typename T>
+	inline uint32_t hash(T* const& value) {
+		return hash_int((uint32_t) (uintptr_t) value);
+	}
+}
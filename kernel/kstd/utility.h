@@ -20,6 +20,7 @@
 #pragma once
 
 #include <kernel/kstd/type_traits.h>
+#include <kernel/kstd/types.h>
 
 namespace kstd {
 	template <typename T>
@@ -39,6 +40,30 @@ namespace kstd {
 		return (a + (b - 1)) / b;
 	}
 
+	/** Sorts the elements in [begin, end) in-place according to the given less-than comparison (using heapsort). **/
+	template<typename T, typename Compare>
+	void sort(T* begin, T* end, Compare less) {
+		size_t count = end - begin;
+		auto sift_down = [&](size_t root, size_t size) {
+			while(root * 2 + 1 < size) {
+				size_t child = root * 2 + 1;
+				if(child + 1 < size && less(begin[child], begin[child + 1]))
+					child++;
+				if(!less(begin[root], begin[child]))
+					return;
+				swap(begin[root], begin[child]);
+				root = child;
+			}
+		};
+
+		for(size_t i = count / 2; i > 0; i--)
+			sift_down(i - 1, count);
+		for(size_t i = count; i > 1; i--) {
+			swap(begin[0], begin[i - 1]);
+			sift_down(0, i - 1);
+		}
+	}
+
 	template<typename T, typename U>
 	inline constexpr bool is_base_of = __is_base_of(T, U);
 }
@@ -3,7 +3,6 @@
 
 #include "AnonymousVMObject.h"
 #include "MemoryManager.h"
-#include "../kstd/cstring.h"
 
 SpinLock AnonymousVMObject::s_shared_lock;
 int AnonymousVMObject::s_cur_shm_id = 1;
@@ -16,22 +15,25 @@ AnonymousVMObject::~AnonymousVMObject() {
 	}
 }
 
-ResultRet<kstd::Arc<AnonymousVMObject>> AnonymousVMObject::alloc(size_t size) {
+ResultRet<kstd::Arc<AnonymousVMObject>> AnonymousVMObject::alloc(size_t size, bool read_zero_page) {
+	size_t num_pages = kstd::ceil_div(size, PAGE_SIZE);
+	return kstd::Arc<AnonymousVMObject>(new AnonymousVMObject(kstd::vector<PageIndex>(num_pages, 0), false, read_zero_page));
+}
+
+ResultRet<kstd::Arc<AnonymousVMObject>> AnonymousVMObject::alloc_committed(size_t size) {
 	size_t num_pages = kstd::ceil_div(size, PAGE_SIZE);
 	auto pages = TRY(MemoryManager::inst().alloc_physical_pages(num_pages));
-	auto object = kstd::Arc<AnonymousVMObject>(new AnonymousVMObject(pages, false));
-	auto tmp_mapped = MM.map_object(object);
-	memset((void*) tmp_mapped->start(), 0, object->size());
-	return object;
+	for(auto page : pages)
+		MM.zero_page(page);
+	return kstd::Arc<AnonymousVMObject>(new AnonymousVMObject(pages, false));
 }
 
 ResultRet<kstd::Arc<AnonymousVMObject>> AnonymousVMObject::alloc_contiguous(size_t size) {
 	size_t num_pages = kstd::ceil_div(size, PAGE_SIZE);
 	auto pages = TRY(MemoryManager::inst().alloc_contiguous_physical_pages(num_pages));
-	auto object = kstd::Arc<AnonymousVMObject>(new AnonymousVMObject(pages, false));
-	auto tmp_mapped = MM.map_object(object);
-	memset((void*) tmp_mapped->start(), 0, object->size());
-	return object;
+	for(auto page : pages)
+		MM.zero_page(page);
+	return kstd::Arc<AnonymousVMObject>(new AnonymousVMObject(pages, false));
 }
 
 ResultRet<kstd::Arc<AnonymousVMObject>> AnonymousVMObject::map_to_physical(PhysicalAddress start, size_t size) {
@@ -89,13 +91,52 @@ ResultRet<VMProt> AnonymousVMObject::get_shared_permissions(pid_t pid) {
 	return node->data.second;
 }
 
+ResultRet<bool> AnonymousVMObject::try_fault_page(PageIndex page, bool write) {
+	ASSERT(page < m_physical_pages.size());
+	LOCK(m_page_lock);
+
+	auto& physical_page = m_physical_pages[page];
+	if(physical_page)
+		return false;
+
+	// If we're just reading, we can get away with mapping the zero page until the page is written to
+	if(!write && m_read_zero_page) {
+		physical_page = MM.shared_zero_page();
+		m_cow_pages.set(page, true);
+		return true;
+	}
+
+	auto new_page = TRY(MM.alloc_physical_page());
+	MM.zero_page(new_page);
+	physical_page = new_page;
+	return true;
+}
+
+Result AnonymousVMObject::commit_pages(PageIndex start, size_t num_pages) {
+	ASSERT(start + num_pages <= m_physical_pages.size());
+	LOCK(m_page_lock);
+
+	for(PageIndex page = start; page < start + num_pages; page++) {
+		auto& physical_page = m_physical_pages[page];
+		if(physical_page && physical_page != MM.shared_zero_page())
+			continue;
+		auto new_page = TRY(MM.alloc_physical_page());
+		MM.zero_page(new_page);
+		physical_page = new_page;
+		m_cow_pages.set(page, false);
+	}
+
+	return Result(SUCCESS);
+}
+
 ResultRet<kstd::Arc<VMObject>> AnonymousVMObject::clone() {
 	LOCK(m_page_lock);
 	ASSERT(!is_shared());
 	become_cow_and_ref_pages();
-	auto new_object = kstd::Arc(new AnonymousVMObject(m_physical_pages, true));
+	auto new_object = kstd::Arc(new AnonymousVMObject(m_physical_pages, true, m_read_zero_page));
 	return kstd::static_pointer_cast<VMObject>(new_object);
 }
 
-AnonymousVMObject::AnonymousVMObject(kstd::vector<PageIndex> physical_pages, bool cow):
-	VMObject(kstd::move(physical_pages), cow) {}
+AnonymousVMObject::AnonymousVMObject(kstd::vector<PageIndex> physical_pages, bool cow, bool read_zero_page):
+	VMObject(kstd::move(physical_pages), cow),
+	m_read_zero_page(read_zero_page) {}
@@ -16,11 +16,23 @@ public:
 	~AnonymousVMObject() override;
 
 	/**
-	 * Allocates a new anonymous VMObject.
+	 * Allocates a new anonymous VMObject. No physical pages are allocated up front; each page is allocated and zeroed
+	 * the first time it's touched (see try_fault_page).
 	 * @param size The minimum size, in bytes, of the object.
+	 * @param read_zero_page If true, pages that are read before they are written to are backed by the shared zero
+	 *                       page until they are written to. Only use this for objects that are never mapped into
+	 *                       more than one place at once, since writing to the page replaces it.
 	 * @return The newly allocated object, if successful.
 	 */
-	static ResultRet<kstd::Arc<AnonymousVMObject>> alloc(size_t size);
+	static ResultRet<kstd::Arc<AnonymousVMObject>> alloc(size_t size, bool read_zero_page = false);
+
+	/**
+	 * Allocates a new anonymous VMObject with all of its pages allocated and zeroed up front. This should be used for
+	 * memory that is accessed by the kernel directly, which can't be faulted in lazily.
+	 * @param size The minimum size, in bytes, of the object.
+	 * @return The newly allocated object, if successful.
+	 */
+	static ResultRet<kstd::Arc<AnonymousVMObject>> alloc_committed(size_t size);
 
 	/**
 	 * Allocates a new anonymous VMObject backed by contiguous physical pages.
@@ -64,6 +76,23 @@ public:
 	 */
 	void set_fork_action(ForkAction action) { m_fork_action = action; }
 
+	/**
+	 * Backs a page of the object that hasn't been touched yet with a zeroed physical page, or with the shared zero page
+	 * (marked CoW) if this is a read and the object was allocated with read_zero_page.
+	 * @param page The index of the page in the object.
+	 * @param write Whether the page is being written to.
+	 * @return Whether the page was backed. If false, it was already backed and the fault should be handled otherwise.
+	 */
+	ResultRet<bool> try_fault_page(PageIndex page, bool write);
+
+	/**
+	 * Backs every page in the given range of the object that hasn't been touched yet (or is backed by the shared zero
+	 * page) with a zeroed physical page of its own.
+	 * @param start The index of the first page in the object to commit.
+	 * @param num_pages The number of pages to commit.
+	 */
+	Result commit_pages(PageIndex start, size_t num_pages);
+
 	bool is_shared() const { return m_is_shared; }
 	pid_t shared_owner() const { return m_shared_owner; }
 	int shm_id() const { return m_shm_id; }
@@ -77,7 +106,7 @@ public:
 private:
 	friend class MemoryManager;
 
-	explicit AnonymousVMObject(kstd::vector<PageIndex> physical_pages, bool cow);
+	explicit AnonymousVMObject(kstd::vector<PageIndex> physical_pages, bool cow, bool read_zero_page = false);
 
 	static SpinLock s_shared_lock;
 	static int s_cur_shm_id;
@@ -88,4 +117,5 @@ private:
 	ForkAction m_fork_action = ForkAction::BecomeCoW;
 	pid_t m_shared_owner;
 	int m_shm_id = 0;
+	bool m_read_zero_page;
 };
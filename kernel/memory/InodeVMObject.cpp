@@ -2,6 +2,7 @@
 /* Copyright © 2016-2023 Byteduck */
 
 #include "InodeVMObject.h"
+#include "MemoryManager.h"
 
 kstd::Arc<InodeVMObject> InodeVMObject::make_for_inode(kstd::Arc<Inode> inode, InodeVMObject::Type type) {
 	kstd::vector<PageIndex> pages;
@@ -22,25 +23,97 @@ ResultRet<kstd::Arc<VMObject>> InodeVMObject::clone() {
 InodeVMObject::InodeVMObject(kstd::vector<PageIndex> physical_pages, kstd::Arc<Inode> inode, InodeVMObject::Type type, bool cow):
 	VMObject(kstd::move(physical_pages), cow),
 	m_inode(kstd::move(inode)),
-	m_type(type)
+	m_type(type),
+	m_copied_pages(type == Type::Shared ? m_physical_pages.size() : 0),
+	m_written_pages(type == Type::Shared ? m_physical_pages.size() : 0)
 {}
 
+InodeVMObject::~InodeVMObject() {
+	// Our references to the disk cache's pages are about to go away, so make sure it writes out what was changed in them
+	if(m_type == Type::Shared)
+		sync();
+}
+
 ResultRet<bool> InodeVMObject::read_page_if_needed(size_t index) {
 	if(index >= m_physical_pages.size())
 		return Result(ERANGE);
 	if(m_physical_pages[index])
 		return false;
 
+	// Private objects start out sharing the pages of the inode's shared object (its page cache), and copy them on write
+	if(m_type == Type::Private) {
+		auto shared_object = m_inode->shared_vm_object();
+		PageIndex shared_page;
+		{
+			LOCK(shared_object->lock());
+			TRY(shared_object->read_page_if_needed(index));
+			shared_page = shared_object->physical_page_index(index);
+			MM.get_physical_page(shared_page).ref();
+		}
+		m_physical_pages[index] = shared_page;
+		m_cow_pages.set(index, true);
+		return true;
+	}
+
+	// If the page is cached by the disk, use the same physical page so that the data isn't in memory twice, and so that
+	// reads and writes of the inode and mappings of it see each other's changes
+	auto cache_page = m_inode->share_page(index);
+	if(!cache_page.is_error()) {
+		m_physical_pages[index] = cache_page.value();
+		return true;
+	}
+
+	// Otherwise, read it into a copy of our own
 	auto new_page = TRY(MM.alloc_physical_page());
-	ssize_t nread;
-	MM.with_quickmapped(new_page, [&](void* buf) {
-		nread = m_inode->read(index * PAGE_SIZE, PAGE_SIZE, KernelPointer<uint8_t>((uint8_t*) buf), nullptr);
-	});
-	if(nread < 0) {
+	auto res = read_page(index, new_page);
+	if(res.is_error()) {
 		MM.free_physical_page(new_page);
-		return Result(-nread);
+		return res;
 	}
 	m_physical_pages[index] = new_page;
+	m_copied_pages.set(index, true);
 
 	return true;
 }
+
+void InodeVMObject::reload_copied_pages(size_t first, size_t num_pages) {
+	ASSERT(m_type == Type::Shared);
+	LOCK(m_page_lock);
+	for(size_t index = first; index < first + num_pages && index < m_physical_pages.size(); index++) {
+		if(m_physical_pages[index] && m_copied_pages.get(index))
+			read_page(index, m_physical_pages[index]);
+	}
+}
+
+void InodeVMObject::pages_mapped(const VMRegion& region, size_t first, size_t num_pages) {
+	if(m_type != Type::Shared || !region.prot().write || !region.max_prot().write)
+		return;
+	ASSERT(m_page_lock.held_by_current_thread());
+	for(size_t index = first; index < first + num_pages && index < m_physical_pages.size(); index++) {
+		if(m_physical_pages[index] && !m_copied_pages.get(index))
+			m_written_pages.set(index, true);
+	}
+}
+
+void InodeVMObject::sync() {
+	ASSERT(m_type == Type::Shared);
+	LOCK(m_page_lock);
+	// Pages stay marked as written, since the mappings may write to them again after this
+	for(size_t index = 0; index < m_physical_pages.size(); index++) {
+		if(m_written_pages.get(index))
+			m_inode->mark_page_dirty(index, m_physical_pages[index]);
+	}
+}
+
+Result InodeVMObject::read_page(size_t index, PageIndex page) {
+	ssize_t nread;
+	MM.with_quickmapped(page, [&](void* buf) {
+		nread = m_inode->read(index * PAGE_SIZE, PAGE_SIZE, KernelPointer<uint8_t>((uint8_t*) buf), nullptr);
+		// Anything past the end of the file reads as zeroes
+		if(nread >= 0 && nread < PAGE_SIZE)
+			memset((uint8_t*) buf + nread, 0, PAGE_SIZE - nread);
+	});
+	if(nread < 0)
+		return Result(-nread);
+	return Result(SUCCESS);
+}
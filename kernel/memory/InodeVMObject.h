@@ -4,6 +4,7 @@
 #pragma once
 
 #include "VMObject.h"
+#include "VMRegion.h"
 #include "../filesystem/Inode.h"
 
 class InodeVMObject: public VMObject {
@@ -13,7 +14,7 @@ public:
 	};
 
 	static kstd::Arc<InodeVMObject> make_for_inode(kstd::Arc<Inode> inode, Type type);
-
+	~InodeVMObject() override;
 
 	PageIndex& physical_page_index(size_t index) const {
 		return m_physical_pages[index];
@@ -26,6 +27,27 @@ public:
 	 */
 	ResultRet<bool> read_page_if_needed(size_t index);
 
+	/**
+	 * Re-reads the pages in the given range that are copies of the inode's data rather than pages shared with the disk
+	 * cache. This should be called after the inode is written to, so that mappings of it see the change.
+	 * @param first The index of the first page to reload.
+	 * @param num_pages The number of pages to reload.
+	 */
+	void reload_copied_pages(size_t first, size_t num_pages);
+
+	/**
+	 * Notes that the pages in the given range were mapped by a region, so if the region is writable, any of them that are
+	 * shared with the disk cache may be written to without the disk cache knowing. Only regions that are allowed to be
+	 * writable at all (see VMRegion::max_prot) count, so mapping a file can't be used to write to it. The lock must be held.
+	 * @param region The region the pages were mapped by.
+	 * @param first The index of the first page mapped.
+	 * @param num_pages The number of pages mapped.
+	 */
+	void pages_mapped(const VMRegion& region, size_t first, size_t num_pages);
+
+	/** Marks the disk cache pages that may have been written to through mappings of this object dirty. **/
+	void sync();
+
 	kstd::Arc<Inode> inode() const { return m_inode; }
 	SpinLock& lock() { return m_page_lock; }
 	Type type() const { return m_type; }
@@ -35,11 +57,14 @@ public:
 	}
 	ResultRet<kstd::Arc<VMObject>> clone() override;
 
-	// TODO: Syncing
-
 private:
 	explicit InodeVMObject(kstd::vector<PageIndex> physical_pages, kstd::Arc<Inode> inode, Type type, bool cow);
 
+	/** Reads the page at the given index from the inode into a physical page. **/
+	Result read_page(size_t index, PageIndex page);
+
 	kstd::Arc<Inode> m_inode;
 	Type m_type;
+	kstd::Bitmap m_copied_pages; ///< Pages of a shared object that couldn't be shared with the disk cache, and were copied.
+	kstd::Bitmap m_written_pages; ///< Pages of a shared object that are shared with the disk cache and were mapped writable.
 };
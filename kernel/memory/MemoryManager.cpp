@@ -133,6 +133,10 @@ void MemoryManager::setup_paging() {
 	ASSERT(map_res.is_success());
 
 	did_setup_paging = true;
+
+	// Allocate the zero page that untouched anonymous memory is mapped to when read
+	m_shared_zero_page = alloc_physical_page().value();
+	zero_page(m_shared_zero_page);
 }
 
 void MemoryManager::load_page_directory(const kstd::Arc<PageDirectory>& page_directory) {
@@ -329,7 +333,7 @@ ResultRet<kstd::vector<PageIndex>> MemoryManager::alloc_contiguous_physical_page
 
 kstd::Arc<VMRegion> MemoryManager::alloc_kernel_region(size_t size) {
 	auto do_alloc = [&]() -> ResultRet<kstd::Arc<VMRegion>> {
-		auto object = TRY(AnonymousVMObject::alloc(size));
+		auto object = TRY(AnonymousVMObject::alloc_committed(size));
 		return TRY(m_kernel_space->map_object(object, VMProt::RW));
 	};
 	auto res = do_alloc();
@@ -361,6 +365,13 @@ kstd::Arc<VMRegion> MemoryManager::alloc_mapped_region(PhysicalAddress start, si
 }
 
 kstd::Arc<VMRegion> MemoryManager::map_object(kstd::Arc<VMObject> object, VirtualRange range) {
+	if(object->is_anonymous()) {
+		size_t size = range.size ? range.size : object->size() - range.start;
+		auto commit_res = kstd::static_pointer_cast<AnonymousVMObject>(object)->commit_pages(range.start / PAGE_SIZE, kstd::ceil_div(size, PAGE_SIZE));
+		if(commit_res.is_error())
+			PANIC("ALLOC_MAPPED_FAIL", "Could not commit the pages of an anonymous object mapped into kernel space.");
+	}
+
 	auto res = m_kernel_space->map_object(object, VMProt::RW, {0, range.size}, range.start);
 	if(res.is_error())
 		PANIC("ALLOC_MAPPED_FAIL", "Could not map an existing object into kernel space.");
@@ -373,6 +384,12 @@ void MemoryManager::copy_page(PageIndex src, PageIndex dest) {
 	});
 }
 
+void MemoryManager::zero_page(PageIndex page) {
+	MM.with_quickmapped(page, [](void* page_ptr) {
+		memset(page_ptr, 0, PAGE_SIZE);
+	});
+}
+
 void MemoryManager::free_physical_page(PageIndex page) const {
 	ASSERT(get_physical_page(page).allocated.ref_count.load(MemoryOrder::Relaxed) == 0);
 
@@ -133,8 +133,10 @@ public:
 	kstd::Arc<VMRegion> alloc_mapped_region(PhysicalAddress start, size_t size);
 
 	/**
-	 * Maps a VMObject into kernel space.
+	 * Maps a VMObject into kernel space. Since the kernel can't fault in anonymous memory lazily, any untouched pages
+	 * of an anonymous object in the range are committed first.
 	 * @param object The object to map.
+	 * @param range The range of the object to map. The start is the offset into the object.
 	 * @return The region the object was mapped to.
 	 */
 	kstd::Arc<VMRegion> map_object(kstd::Arc<VMObject> object, VirtualRange range = {0, 0});
@@ -177,6 +179,15 @@ public:
 	/** Copies the contents of one physical page to another. **/
 	void copy_page(PageIndex src, PageIndex dest);
 
+	/** Fills a physical page with zeroes. **/
+	void zero_page(PageIndex page);
+
+	/**
+	 * A physical page filled with zeroes that untouched anonymous memory can be mapped to (as CoW) when read. It is not
+	 * reference counted, and must never be written to.
+	 */
+	PageIndex shared_zero_page() const { return m_shared_zero_page; }
+
 	kstd::Arc<VMSpace> kernel_space() { return m_kernel_space; }
 	kstd::Arc<VMSpace> heap_space() { return m_heap_space; }
 
@@ -236,6 +247,8 @@ private:
 
 	SpinLock m_quickmap_lock;
 	bool m_is_quickmapping = false;
+
+	PageIndex m_shared_zero_page = 0;
 };
 
 void liballoc_lock();
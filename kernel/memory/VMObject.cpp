@@ -19,7 +19,7 @@ VMObject::VMObject(kstd::vector<PageIndex> physical_pages, bool all_cow):
 
 VMObject::~VMObject() {
 	for(auto physical_page : m_physical_pages)
-		if(physical_page)
+		if(physical_page && physical_page != MM.shared_zero_page())
 			MemoryManager::inst().get_physical_page(physical_page).unref();
 }
 
@@ -35,14 +35,18 @@ Result VMObject::try_cow_page(PageIndex page) {
 	if(!page_is_cow(page))
 		return Result(EINVAL);
 
-	// Copy the page
+	// Copy the page (or just zero it, if it's the shared zero page)
 	auto& old_page = m_physical_pages[page];
 	ASSERT(old_page);
 	auto new_page = TRY(MM.alloc_physical_page());
-	MM.copy_page(old_page, new_page);
+	if(old_page == MM.shared_zero_page()) {
+		MM.zero_page(new_page);
+	} else {
+		MM.copy_page(old_page, new_page);
+		MM.get_physical_page(old_page).unref();
+	}
 
-	// Unref the old page and replace it with the new one
-	MM.get_physical_page(old_page).unref();
+	// Replace the old page with the new one
 	old_page = new_page;
 
 	// Mark the page not CoW
@@ -60,7 +64,8 @@ void VMObject::become_cow_and_ref_pages() {
 	for(size_t i = 0; i < m_physical_pages.size(); i++) {
 		if(m_physical_pages[i]) {
 			m_cow_pages.set(i, true);
-			physical_page(i).ref();
+			if(m_physical_pages[i] != MM.shared_zero_page())
+				physical_page(i).ref();
 		}
 	}
 }
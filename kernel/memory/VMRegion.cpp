@@ -47,4 +47,8 @@ VMRegion::~VMRegion() {
 
 void VMRegion::set_prot(VMProt prot) {
 	m_prot = prot;
+}
+
+void VMRegion::set_max_prot(VMProt max_prot) {
+	m_max_prot = max_prot;
 }
\ No newline at end of file
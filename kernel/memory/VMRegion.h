@@ -43,6 +43,9 @@ public:
 	bool contains(VirtualAddress address) const { return m_range.contains(address); }
 	VMProt prot() const { return m_prot; }
 	void set_prot(VMProt prot);
+	/** The most permissive protection the region may be given with mprotect(). **/
+	VMProt max_prot() const { return m_max_prot; }
+	void set_max_prot(VMProt max_prot);
 
 private:
 	friend class VMSpace;
@@ -51,4 +54,5 @@ private:
 	VirtualRange m_range; /// Where in the VMSpace this region resides.
 	size_t m_object_start; /// Where in the VMObject this region begins.
 	VMProt m_prot; /// The protection of this region.
+	VMProt m_max_prot = VMProt::RWX; /// The most permissive protection this region can be given.
 };
@@ -19,7 +19,9 @@ VMSpace::VMSpace(VirtualAddress start, size_t size, PageDirectory& page_director
 	m_size(size),
 	m_region_map(new VMSpaceRegion {.start = start, .size = size, .used = false, .next = nullptr, .prev = nullptr}),
 	m_page_directory(page_directory)
-{}
+{
+	tree_insert(m_region_map);
+}
 
 VMSpace::~VMSpace() {
 	auto cur_region = m_region_map;
@@ -35,6 +37,7 @@ kstd::Arc<VMSpace> VMSpace::fork(PageDirectory& page_directory, kstd::vector<kst
 	auto new_space = kstd::Arc<VMSpace>(new VMSpace(m_start, m_size, page_directory));
 	new_space->m_used = m_used;
 	delete new_space->m_region_map;
+	new_space->m_region_tree = nullptr;
 
 	// Clone regions
 	auto cur_region = m_region_map;
@@ -45,9 +48,12 @@ kstd::Arc<VMSpace> VMSpace::fork(PageDirectory& page_directory, kstd::vector<kst
 		if(cur_region == m_region_map)
 			new_space->m_region_map = new_region;
 		new_region->prev = prev_new_region;
+		new_region->next = nullptr;
 		if(prev_new_region)
 			prev_new_region->next = new_region;
 		prev_new_region = new_region;
+		new_region->vmRegion = nullptr;
+		new_space->tree_insert(new_region);
 
 		// Clone the vmRegion
 		if(cur_region->vmRegion) {
@@ -71,6 +77,7 @@ kstd::Arc<VMSpace> VMSpace::fork(PageDirectory& page_directory, kstd::vector<kst
 							new_space,
 							region->range(), region->object_start(),
 							region->prot());
+					new_vmRegion->set_max_prot(region->max_prot());
 					page_directory.map(*new_vmRegion);
 					new_region->vmRegion = new_vmRegion.get();
 					regions_vec.push_back(new_vmRegion);
@@ -119,11 +126,7 @@ ResultRet<kstd::Arc<VMRegion>> VMSpace::map_stack(kstd::Arc<VMObject> object, VM
 	LOCK(m_lock);
 
 	// Find the endmost region with space in it
-	auto cur_region = m_region_map;
-	while(cur_region->next)
-		cur_region = cur_region->next;
-	while((cur_region->used || cur_region->size < object->size()) && cur_region)
-		cur_region = cur_region->prev;
+	auto cur_region = tree_last_fit(object->size());
 	if(!cur_region)
 		return Result(ENOMEM);
 	return map_object(object, prot, {cur_region->end() - object->size(), object->size()});
@@ -131,73 +134,47 @@ ResultRet<kstd::Arc<VMRegion>> VMSpace::map_stack(kstd::Arc<VMObject> object, VM
 
 Result VMSpace::unmap_region(VMRegion& region) {
 	m_lock.acquire();
-	VMSpaceRegion* cur_region = m_region_map;
-	while(cur_region) {
-		if(cur_region->vmRegion == &region) {
-			if(cur_region->vmRegion) {
-				cur_region->vmRegion->m_space.reset();
-				m_page_directory.unmap(*cur_region->vmRegion);
-				m_lock.release();
-				auto free_res = free_region(cur_region);
-				ASSERT(!free_res.is_error());
-				return free_res;
-			}
-			m_lock.release();
-			return Result(ENOENT);
-		}
-		cur_region = cur_region->next;
+	VMSpaceRegion* cur_region = tree_find(region.start());
+	if(!cur_region || cur_region->vmRegion != &region) {
+		m_lock.release();
+		return Result(ENOENT);
 	}
+	cur_region->vmRegion->m_space.reset();
+	m_page_directory.unmap(*cur_region->vmRegion);
 	m_lock.release();
-	return Result(ENOENT);
+	auto free_res = free_region(cur_region);
+	ASSERT(!free_res.is_error());
+	return free_res;
 }
 
 Result VMSpace::unmap_region(VirtualAddress address) {
 	m_lock.acquire();
-	VMSpaceRegion* cur_region = m_region_map;
-	while(cur_region) {
-		if(cur_region->start == address) {
-			if(cur_region->vmRegion) {
-				cur_region->vmRegion->m_space.reset();
-				m_page_directory.unmap(*cur_region->vmRegion);
-				m_lock.release();
-				auto free_res = free_region(cur_region);
-				ASSERT(!free_res.is_error());
-				return free_res;
-			}
-			m_lock.release();
-			return Result(ENOENT);
-		}
-		cur_region = cur_region->next;
+	VMSpaceRegion* cur_region = tree_find(address);
+	if(!cur_region || cur_region->start != address || !cur_region->vmRegion) {
+		m_lock.release();
+		return Result(ENOENT);
 	}
+	cur_region->vmRegion->m_space.reset();
+	m_page_directory.unmap(*cur_region->vmRegion);
 	m_lock.release();
-	return Result(ENOENT);
+	auto free_res = free_region(cur_region);
+	ASSERT(!free_res.is_error());
+	return free_res;
 }
 
 ResultRet<kstd::Arc<VMRegion>> VMSpace::get_region_at(VirtualAddress address) {
 	LOCK(m_lock);
-	VMSpaceRegion* cur_region = m_region_map;
-	while(cur_region) {
-		if(cur_region->start == address) {
-			if(cur_region->vmRegion)
-				return cur_region->vmRegion->self();
-			return Result(ENOENT);
-		}
-		cur_region = cur_region->next;
-	}
+	VMSpaceRegion* cur_region = tree_find(address);
+	if(cur_region && cur_region->start == address && cur_region->vmRegion)
+		return cur_region->vmRegion->self();
 	return Result(ENOENT);
 }
 
 ResultRet<kstd::Arc<VMRegion>> VMSpace::get_region_containing(VirtualAddress address) {
 	LOCK(m_lock);
-	VMSpaceRegion* cur_region = m_region_map;
-	while(cur_region) {
-		if(cur_region->contains(address)) {
-			if(cur_region->vmRegion)
-				return cur_region->vmRegion->self();
-			return Result(ENOENT);
-		}
-		cur_region = cur_region->next;
-	}
+	VMSpaceRegion* cur_region = tree_find(address);
+	if(cur_region && cur_region->vmRegion)
+		return cur_region->vmRegion->self();
 	return Result(ENOENT);
 }
 
@@ -208,79 +185,97 @@ Result VMSpace::reserve_region(VirtualAddress start, size_t size) {
 
 Result VMSpace::try_pagefault(PageFault fault) {
 	LOCK(m_lock);
-	auto cur_region = m_region_map;
-	while(cur_region) {
-		if(cur_region->contains(fault.address)) {
-			auto vmRegion = cur_region->vmRegion;
-			if(!vmRegion)
-				return Result(EINVAL);
-
-			// First, sanity check. If the region doesn't have the proper permissions, we can just fail here.
-			auto prot = vmRegion->prot();
-			if(
-				(!prot.read && fault.type == PageFault::Type::Read) ||
-				(!prot.write && fault.type == PageFault::Type::Write) ||
-				(!prot.execute && fault.type == PageFault::Type::Execute)
-			) {
-				return Result(EINVAL);
-			}
-
-			PageIndex error_page = (fault.address - vmRegion->start()) / PAGE_SIZE;
-
-			// Check if the region is a mapped inode.
-			if(vmRegion->object()->is_inode()) {
-				PageIndex inode_page = error_page + (vmRegion->object_start() / PAGE_SIZE);
-				auto inode_object = kstd::static_pointer_cast<InodeVMObject>(vmRegion->object());
-
-				// Check to see if it needs to be read in
-				LOCK_N(inode_object->lock(), inode_locker);
-				if(inode_object->physical_page_index(inode_page)) {
-					// This page may be marked CoW, so copy it if it is
-					if(vmRegion->prot().write && inode_object->page_is_cow(inode_page)) {
-						auto res = vmRegion->m_object->try_cow_page(inode_page);
-						if(res.is_error())
-							return res;
-					}
+	auto cur_region = tree_find(fault.address);
+	if(!cur_region)
+		return Result(ENOENT);
 
-					// Or, we may have encountered a race where the page was created by another thread after the fault.
-					m_page_directory.map(*vmRegion, VirtualRange { inode_page * PAGE_SIZE, PAGE_SIZE });
-					return Result(SUCCESS);
-				}
+	auto vmRegion = cur_region->vmRegion;
+	if(!vmRegion)
+		return Result(EINVAL);
 
-				// Otherwise, read in the page and map it
-				auto did_read = TRY(inode_object->read_page_if_needed(inode_page));
-				ASSERT(inode_object->physical_page_index(inode_page));
-				if(did_read)
-					m_page_directory.map(*vmRegion, VirtualRange { error_page * PAGE_SIZE, PAGE_SIZE });
+	// First, sanity check. If the region doesn't have the proper permissions, we can just fail here.
+	auto prot = vmRegion->prot();
+	if(
+		(!prot.read && fault.type == PageFault::Type::Read) ||
+		(!prot.write && fault.type == PageFault::Type::Write) ||
+		(!prot.execute && fault.type == PageFault::Type::Execute)
+	) {
+		return Result(EINVAL);
+	}
 
-				return Result(SUCCESS);
+	PageIndex error_page = (fault.address - vmRegion->start()) / PAGE_SIZE;
+
+	// Check if the region is a mapped inode.
+	if(vmRegion->object()->is_inode()) {
+		PageIndex inode_page = error_page + (vmRegion->object_start() / PAGE_SIZE);
+		auto inode_object = kstd::static_pointer_cast<InodeVMObject>(vmRegion->object());
+
+		// Check to see if it needs to be read in
+		LOCK_N(inode_object->lock(), inode_locker);
+		if(inode_object->physical_page_index(inode_page)) {
+			// This page may be marked CoW, so copy it if it is
+			if(vmRegion->prot().write && inode_object->page_is_cow(inode_page)) {
+				auto res = vmRegion->m_object->try_cow_page(inode_page);
+				if(res.is_error())
+					return res;
 			}
 
-			// CoW if the region is writeable.
-			if(vmRegion->prot().write) {
-				auto result = vmRegion->m_object->try_cow_page(error_page);
-				if(result.is_success())
-					m_page_directory.map(*vmRegion, VirtualRange { error_page * PAGE_SIZE, PAGE_SIZE });
-				return result;
-			}
+			// Or, we may have encountered a race where the page was created by another thread after the fault.
+			inode_object->pages_mapped(*vmRegion, inode_page, 1);
+			m_page_directory.map(*vmRegion, VirtualRange { error_page * PAGE_SIZE, PAGE_SIZE });
+			return Result(SUCCESS);
+		}
 
-			return Result(EINVAL);
+		// Otherwise, read in the page (copying it right away if it's private and being written to) and map it
+		auto did_read = TRY(inode_object->read_page_if_needed(inode_page));
+		ASSERT(inode_object->physical_page_index(inode_page));
+		if(fault.type == PageFault::Type::Write && inode_object->page_is_cow(inode_page)) {
+			auto res = inode_object->try_cow_page(inode_page);
+			if(res.is_error())
+				return res;
 		}
-		cur_region = cur_region->next;
+		inode_object->pages_mapped(*vmRegion, inode_page, 1);
+		if(did_read)
+			m_page_directory.map(*vmRegion, VirtualRange { error_page * PAGE_SIZE, PAGE_SIZE });
+
+		return Result(SUCCESS);
 	}
 
-	return Result(ENOENT);
+	// Check if the region is anonymous memory.
+	if(vmRegion->object()->is_anonymous()) {
+		PageIndex object_page = error_page + (vmRegion->object_start() / PAGE_SIZE);
+		auto anon_object = kstd::static_pointer_cast<AnonymousVMObject>(vmRegion->object());
+		bool write = fault.type == PageFault::Type::Write;
+
+		// If the page hasn't been touched yet, back it. Otherwise, it may need to be copied if it's CoW.
+		if(!TRY(anon_object->try_fault_page(object_page, write)) && write && anon_object->page_is_cow(object_page)) {
+			auto res = anon_object->try_cow_page(object_page);
+			if(res.is_error())
+				return res;
+		}
+
+		// If neither, the page was backed through another mapping of the object (i.e. shared memory).
+		m_page_directory.map(*vmRegion, VirtualRange { error_page * PAGE_SIZE, PAGE_SIZE });
+		return Result(SUCCESS);
+	}
+
+	// CoW if the region is writeable.
+	if(vmRegion->prot().write) {
+		auto result = vmRegion->m_object->try_cow_page(error_page);
+		if(result.is_success())
+			m_page_directory.map(*vmRegion, VirtualRange { error_page * PAGE_SIZE, PAGE_SIZE });
+		return result;
+	}
+
+	return Result(EINVAL);
 }
 
 ResultRet<VirtualAddress> VMSpace::find_free_space(size_t size) {
 	LOCK(m_lock);
-	auto cur_region = m_region_map;
-	while(cur_region) {
-		if(!cur_region->used && cur_region->size >= size)
-			return cur_region->start;
-		cur_region = cur_region->next;
-	}
-	return Result(ENOMEM);
+	auto region = tree_first_fit(size);
+	if(!region)
+		return Result(ENOMEM);
+	return region->start;
 }
 
 size_t VMSpace::calculate_regular_anonymous_total() {
@@ -305,24 +300,20 @@ ResultRet<VMSpace::VMSpaceRegion*> VMSpace::alloc_space(size_t size) {
 	ASSERT(size % PAGE_SIZE == 0);
 
 	/**
-	 * We allocate a new region if we need one BEFORE iterating through the regions, because there's a chance we'll
-	 * need to allocate more pages for the heap and if we're in the middle of iterating through regions when that
-	 * happens, it could get ugly.
+	 * We allocate a new region if we need one BEFORE looking for space, because there's a chance we'll need to
+	 * allocate more pages for the heap and if we're in the middle of modifying the regions when that happens, it could
+	 * get ugly.
 	 */
 	auto new_region = new VMSpaceRegion;
 
 	{
 		LOCK(m_lock);
-		auto cur_region = m_region_map;
-		while(cur_region) {
-			if(cur_region->used || cur_region->size < size) {
-				cur_region = cur_region->next;
-				continue;
-			}
-
+		auto cur_region = tree_first_fit(size);
+		if(cur_region) {
 			if(cur_region->size == size) {
 				cur_region->used = true;
 				m_used += cur_region->size;
+				tree_update(cur_region);
 				delete new_region;
 				return cur_region;
 			}
@@ -342,6 +333,8 @@ ResultRet<VMSpace::VMSpaceRegion*> VMSpace::alloc_space(size_t size) {
 			cur_region->size -= size;
 			cur_region->prev = new_region;
 			m_used += new_region->size;
+			tree_update(cur_region);
+			tree_insert(new_region);
 
 			if(m_region_map == cur_region)
 				m_region_map = new_region;
@@ -358,81 +351,68 @@ ResultRet<VMSpace::VMSpaceRegion*> VMSpace::alloc_space_at(size_t size, VirtualA
 	ASSERT(size % PAGE_SIZE == 0);
 
 	/**
-	 * We allocate new regions if we need one BEFORE iterating through the regions, because there's a chance we'll
-	 * need to allocate more pages for the heap and if we're in the middle of iterating through regions when that
-	 * happens, it could get ugly.
+	 * We allocate new regions if we need one BEFORE looking for space, because there's a chance we'll need to
+	 * allocate more pages for the heap and if we're in the middle of modifying the regions when that happens, it could
+	 * get ugly.
 	 */
 	auto new_region_before = new VMSpaceRegion;
 	auto new_region_after = new VMSpaceRegion;
 
 	{
 		LOCK(m_lock);
-		auto cur_region = m_region_map;
-		while(cur_region) {
-			if(cur_region->contains(address)) {
-				if(cur_region->used) {
-					delete new_region_before;
-					delete new_region_after;
-					return Result(ENOMEM);
-				}
-
-				if(cur_region->size == size) {
-					cur_region->used = true;
-					m_used += cur_region->size;
-					delete new_region_before;
-					delete new_region_after;
-					return cur_region;
-				}
-
-				if(cur_region->size - (address - cur_region->start) >= size) {
-					// Create new region before if needed
-					if(cur_region->start < address) {
-						*new_region_before = VMSpaceRegion {
-								.start = cur_region->start,
-								.size = address - cur_region->start,
-								.used = false,
-								.next = cur_region,
-								.prev = cur_region->prev
-						};
-						if(cur_region->prev)
-							cur_region->prev->next = new_region_before;
-						cur_region->prev = new_region_before;
-						if(m_region_map == cur_region)
-							m_region_map = new_region_before;
-					} else {
-						delete new_region_before;
-					}
-
-					// Create new region after if needed
-					if(cur_region->end() > address + size) {
-						*new_region_after = VMSpaceRegion {
-								.start = address + size,
-								.size = cur_region->end() - (address + size),
-								.used = false,
-								.next = cur_region->next,
-								.prev = cur_region
-						};
-						if(cur_region->next)
-							cur_region->next->prev = new_region_after;
-						cur_region->next = new_region_after;
-					} else {
-						delete new_region_after;
-					}
-
-					cur_region->start = address;
-					cur_region->size = size;
-					cur_region->used = true;
-					m_used += cur_region->size;
-					return cur_region;
-				}
+		auto cur_region = tree_find(address);
+		if(cur_region && !cur_region->used && cur_region->end() - address >= size) {
+			// Create new region before if needed
+			if(cur_region->start < address) {
+				*new_region_before = VMSpaceRegion {
+						.start = cur_region->start,
+						.size = address - cur_region->start,
+						.used = false,
+						.next = cur_region,
+						.prev = cur_region->prev
+				};
+				if(cur_region->prev)
+					cur_region->prev->next = new_region_before;
+				cur_region->prev = new_region_before;
+				if(m_region_map == cur_region)
+					m_region_map = new_region_before;
+			} else {
+				delete new_region_before;
+				new_region_before = nullptr;
+			}
 
-				return Result(ENOMEM);
+			// Create new region after if needed
+			if(cur_region->end() > address + size) {
+				*new_region_after = VMSpaceRegion {
+						.start = address + size,
+						.size = cur_region->end() - (address + size),
+						.used = false,
+						.next = cur_region->next,
+						.prev = cur_region
+				};
+				if(cur_region->next)
+					cur_region->next->prev = new_region_after;
+				cur_region->next = new_region_after;
+			} else {
+				delete new_region_after;
+				new_region_after = nullptr;
 			}
 
-			cur_region = cur_region->next;
+			cur_region->start = address;
+			cur_region->size = size;
+			cur_region->used = true;
+			m_used += cur_region->size;
+			tree_update(cur_region);
+			if(new_region_before)
+				tree_insert(new_region_before);
+			if(new_region_after)
+				tree_insert(new_region_after);
+			return cur_region;
 		}
 	}
 
+	delete new_region_before;
+	delete new_region_after;
 	return Result(ENOMEM);
 }
 
@@ -447,6 +427,7 @@ Result VMSpace::free_region(VMSpaceRegion* region) {
 		// Merge previous region if needed
 		if(region->prev && !region->prev->used) {
 			to_delete[0] = region->prev;
+			tree_remove(to_delete[0]);
 			region->prev = region->prev->prev;
 			if(to_delete[0]->prev)
 				to_delete[0]->prev->next = region;
@@ -459,11 +440,14 @@ Result VMSpace::free_region(VMSpaceRegion* region) {
 		// Merge next region if needed
 		if(region->next && !region->next->used) {
 			to_delete[1] = region->next;
+			tree_remove(to_delete[1]);
 			region->next = region->next->next;
 			if(to_delete[1]->next)
 				to_delete[1]->next->prev = region;
 			region->size += to_delete[1]->size;
 		}
+
+		tree_update(region);
 	}
 
 	// We do this while not holding the lock just in case this triggers a page free in the allocator.
@@ -472,3 +456,164 @@ Result VMSpace::free_region(VMSpaceRegion* region) {
 
 	return Result(SUCCESS);
 }
+
+void VMSpace::VMSpaceRegion::recalculate() {
+	height = 1 + max(height_of(left), height_of(right));
+	max_free = max(used ? 0 : size, max(max_free_of(left), max_free_of(right)));
+}
+
+void VMSpace::tree_insert(VMSpaceRegion* region) {
+	region->parent = nullptr;
+	region->left = nullptr;
+	region->right = nullptr;
+	region->height = 1;
+	region->recalculate();
+
+	if(!m_region_tree) {
+		m_region_tree = region;
+		return;
+	}
+
+	auto cur_region = m_region_tree;
+	while(true) {
+		auto& child = region->start < cur_region->start ? cur_region->left : cur_region->right;
+		if(!child) {
+			child = region;
+			region->parent = cur_region;
+			break;
+		}
+		cur_region = child;
+	}
+
+	tree_update(cur_region);
+}
+
+void VMSpace::tree_remove(VMSpaceRegion* region) {
+	VMSpaceRegion* update_from;
+	if(!region->left || !region->right) {
+		// If the region has at most one child, just replace it with the child
+		auto child = region->left ? region->left : region->right;
+		tree_replace_child(region->parent, region, child);
+		if(child)
+			child->parent = region->parent;
+		update_from = region->parent;
+	} else {
+		// Otherwise, replace it with its successor
+		auto successor = region->right;
+		while(successor->left)
+			successor = successor->left;
+		if(successor->parent != region) {
+			update_from = successor->parent;
+			successor->parent->left = successor->right;
+			if(successor->right)
+				successor->right->parent = successor->parent;
+			successor->right = region->right;
+			region->right->parent = successor;
+		} else {
+			update_from = successor;
+		}
+		successor->left = region->left;
+		region->left->parent = successor;
+		tree_replace_child(region->parent, region, successor);
+		successor->parent = region->parent;
+	}
+
+	region->parent = region->left = region->right = nullptr;
+	if(update_from)
+		tree_update(update_from);
+}
+
+void VMSpace::tree_update(VMSpaceRegion* region) {
+	while(region) {
+		region->recalculate();
+		int balance = VMSpaceRegion::height_of(region->left) - VMSpaceRegion::height_of(region->right);
+		if(balance > 1) {
+			if(VMSpaceRegion::height_of(region->left->left) < VMSpaceRegion::height_of(region->left->right))
+				tree_rotate_left(region->left);
+			region = tree_rotate_right(region);
+		} else if(balance < -1) {
+			if(VMSpaceRegion::height_of(region->right->right) < VMSpaceRegion::height_of(region->right->left))
+				tree_rotate_right(region->right);
+			region = tree_rotate_left(region);
+		}
+		region = region->parent;
+	}
+}
+
+VMSpace::VMSpaceRegion* VMSpace::tree_find(VirtualAddress address) const {
+	auto cur_region = m_region_tree;
+	while(cur_region) {
+		if(address < cur_region->start)
+			cur_region = cur_region->left;
+		else if(address >= cur_region->end())
+			cur_region = cur_region->right;
+		else
+			return cur_region;
+	}
+	return nullptr;
+}
+
+VMSpace::VMSpaceRegion* VMSpace::tree_first_fit(size_t size) const {
+	auto cur_region = m_region_tree;
+	if(!cur_region || cur_region->max_free < size)
+		return nullptr;
+	while(true) {
+		if(VMSpaceRegion::max_free_of(cur_region->left) >= size)
+			cur_region = cur_region->left;
+		else if(!cur_region->used && cur_region->size >= size)
+			return cur_region;
+		else
+			cur_region = cur_region->right;
+	}
+}
+
+VMSpace::VMSpaceRegion* VMSpace::tree_last_fit(size_t size) const {
+	auto cur_region = m_region_tree;
+	if(!cur_region || cur_region->max_free < size)
+		return nullptr;
+	while(true) {
+		if(VMSpaceRegion::max_free_of(cur_region->right) >= size)
+			cur_region = cur_region->right;
+		else if(!cur_region->used && cur_region->size >= size)
+			return cur_region;
+		else
+			cur_region = cur_region->left;
+	}
+}
+
+VMSpace::VMSpaceRegion* VMSpace::tree_rotate_left(VMSpaceRegion* region) {
+	auto new_root = region->right;
+	region->right = new_root->left;
+	if(new_root->left)
+		new_root->left->parent = region;
+	tree_replace_child(region->parent, region, new_root);
+	new_root->parent = region->parent;
+	new_root->left = region;
+	region->parent = new_root;
+	region->recalculate();
+	new_root->recalculate();
+	return new_root;
+}
+
+VMSpace::VMSpaceRegion* VMSpace::tree_rotate_right(VMSpaceRegion* region) {
+	auto new_root = region->left;
+	region->left = new_root->right;
+	if(new_root->right)
+		new_root->right->parent = region;
+	tree_replace_child(region->parent, region, new_root);
+	new_root->parent = region->parent;
+	new_root->right = region;
+	region->parent = new_root;
+	region->recalculate();
+	new_root->recalculate();
+	return new_root;
+}
+
+void VMSpace::tree_replace_child(VMSpaceRegion* parent, VMSpaceRegion* old_child, VMSpaceRegion* new_child) {
+	if(!parent)
+		m_region_tree = new_child;
+	else if(parent->left == old_child)
+		parent->left = new_child;
+	else
+		parent->right = new_child;
+}
@@ -109,6 +109,11 @@ public:
 	SpinLock& lock() { return m_lock; }
 
 private:
+	/**
+	 * A used or free range of the space. These are kept both in a list in address order, and in an AVL tree keyed by
+	 * start address where each node also tracks the largest free region in its subtree, so that finding the region
+	 * containing an address or the first free region that fits a size are O(log n).
+	 */
 	struct VMSpaceRegion {
 		VirtualAddress start;
 		size_t size;
@@ -117,17 +122,46 @@ private:
 		VMSpaceRegion* prev;
 		VMRegion* vmRegion;
 
+		VMSpaceRegion* parent = nullptr;
+		VMSpaceRegion* left = nullptr;
+		VMSpaceRegion* right = nullptr;
+		int height = 1;
+		size_t max_free = 0; ///< The size of the largest free region in this region's subtree.
+
 		size_t end() const { return start + size; }
 		bool contains(VirtualAddress address) const { return start <= address && end() > address; }
+
+		/** Recalculates the height and largest free region of this region's subtree from its children. **/
+		void recalculate();
+		static int height_of(const VMSpaceRegion* region) { return region ? region->height : 0; }
+		static size_t max_free_of(const VMSpaceRegion* region) { return region ? region->max_free : 0; }
 	};
 
 	ResultRet<VMSpaceRegion*> alloc_space(size_t size);
 	ResultRet<VMSpaceRegion*> alloc_space_at(size_t size, VirtualAddress address);
 	Result free_region(VMSpaceRegion* region);
 
+	// Region tree
+	/** Inserts a region into the tree by its start address. **/
+	void tree_insert(VMSpaceRegion* region);
+	/** Removes a region from the tree. **/
+	void tree_remove(VMSpaceRegion* region);
+	/** Updates the tree after a region's size or used status changed, rebalancing from it upwards. **/
+	void tree_update(VMSpaceRegion* region);
+	/** Finds the region containing the given address. **/
+	VMSpaceRegion* tree_find(VirtualAddress address) const;
+	/** Finds the lowest free region that is at least `size` bytes. **/
+	VMSpaceRegion* tree_first_fit(size_t size) const;
+	/** Finds the highest free region that is at least `size` bytes. **/
+	VMSpaceRegion* tree_last_fit(size_t size) const;
+	VMSpaceRegion* tree_rotate_left(VMSpaceRegion* region);
+	VMSpaceRegion* tree_rotate_right(VMSpaceRegion* region);
+	void tree_replace_child(VMSpaceRegion* parent, VMSpaceRegion* old_child, VMSpaceRegion* new_child);
+
 	VirtualAddress m_start;
 	size_t m_size;
 	VMSpaceRegion* m_region_map;
+	VMSpaceRegion* m_region_tree = nullptr;
 	size_t m_used = 0;
 	SpinLock m_lock;
 	PageDirectory& m_page_directory;
@@ -20,6 +20,7 @@ int Process::exec(const kstd::string& filename, ProcessArgs* args) {
 		new_proc->_user = _user;
 		new_proc->_pgid = _pgid;
 		new_proc->_sid = _sid;
+		new_proc->_nice = _nice;
 		if (_kernel_mode) {
 			//Kernel processes have no file descriptors, so we need to initialize them
 			auto ttydesc = kstd::make_shared<FileDescriptor>(VirtualTTY::current_tty());
@@ -0,0 +1,71 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later */
+/* Copyright © 2016-2023 Byteduck */
+
+#include "../tasking/Process.h"
+#include "../tasking/Thread.h"
+#include "../tasking/TaskManager.h"
+#include "../tasking/BooleanBlocker.h"
+#include "../memory/SafePointer.h"
+#include "../api/futex.h"
+
+int Process::sys_futex(UserspacePointer<int> futex, int op, int val) {
+	auto addr = (size_t) futex.raw();
+	if(addr % sizeof(int))
+		return -EINVAL;
+
+	switch(op) {
+		case FUTEX_WAIT: {
+			BooleanBlocker blocker;
+			{
+				// The value is checked with the lock held, so a waker can't slip in between the check and us queueing.
+				LOCK(m_futex_lock);
+				if(futex.get() != val)
+					return -EAGAIN;
+				m_futexes[addr].push_back(&blocker);
+			}
+
+			TaskManager::current_thread()->block(blocker);
+			if(blocker.is_ready())
+				return SUCCESS;
+
+			// We were interrupted, so take ourselves off the queue if a waker didn't already.
+			LOCK(m_futex_lock);
+			auto node = m_futexes.find_node(addr);
+			if(node) {
+				auto& waiters = node->data.second;
+				for(size_t i = 0; i < waiters.size(); i++) {
+					if(waiters[i] == &blocker) {
+						waiters.erase(i);
+						break;
+					}
+				}
+				if(waiters.empty())
+					m_futexes.erase(addr);
+			}
+			return blocker.is_ready() ? SUCCESS : -EINTR;
+		}
+
+		case FUTEX_WAKE: {
+			LOCK(m_futex_lock);
+			auto node = m_futexes.find_node(addr);
+			if(!node || val <= 0)
+				return 0;
+
+			// Wake waiters in the order they started waiting.
+			auto& waiters = node->data.second;
+			size_t num_woken = min((size_t) val, waiters.size());
+			for(size_t i = 0; i < num_woken; i++)
+				waiters[i]->set_ready(true);
+			if(num_woken == waiters.size()) {
+				m_futexes.erase(addr);
+			} else {
+				for(size_t i = 0; i < num_woken; i++)
+					waiters.erase(0);
+			}
+			return (int) num_woken;
+		}
+
+		default:
+			return -EINVAL;
+	}
+}
@@ -125,9 +125,13 @@ ResultRet<void*> Process::sys_mmap(UserspacePointer<struct mmap_args> args_ptr)
 		.execute = (bool) (args.prot & PROT_EXEC)
 	};
 
+	// The most mprotect() can give the region later. Writes to a shared file mapping go to the file, so it can only ever be
+	// made writable if the file was opened for writing. Writes to a private mapping are copied, so they're always allowed.
+	VMProt max_prot = VMProt::RWX;
+
 	// First, create an appropriate object
 	if(args.flags & MAP_ANONYMOUS) {
-		vm_object = TRY(AnonymousVMObject::alloc(args.length));
+		vm_object = TRY(AnonymousVMObject::alloc(args.length, true));
 	} else {
 		if(args.fd >= _file_descriptors.size() || !_file_descriptors[args.fd])
 			return Result(EBADF);
@@ -138,10 +142,13 @@ ResultRet<void*> Process::sys_mmap(UserspacePointer<struct mmap_args> args_ptr)
 		if(!file || !file->is_inode())
 			return Result(EBADF);
 		auto inode = kstd::static_pointer_cast<InodeFile>(file)->inode();
-		if(args.flags & MAP_SHARED)
+		max_prot.read = file_desc->readable();
+		if(args.flags & MAP_SHARED) {
 			vm_object = inode->shared_vm_object();
-		else
+			max_prot.write = file_desc->writable();
+		} else {
 			vm_object = InodeVMObject::make_for_inode(inode, InodeVMObject::Type::Private);
+		}
 	}
 
 	if(!vm_object)
@@ -158,6 +165,7 @@ ResultRet<void*> Process::sys_mmap(UserspacePointer<struct mmap_args> args_ptr)
 
 	if(!region)
 		return Result(EINVAL);
+	region->set_max_prot(max_prot);
 
 	m_used_pmem += region->size();
 	_vm_regions.push_back(region);
@@ -189,14 +197,39 @@ int Process::sys_mprotect(void* addr, size_t length, int prot_flags) {
 			.execute = (bool) (prot_flags & PROT_EXEC)
 	};
 
-	// Find the region
+	// Find the regions starting in the range (i.e. an ELF segment may be split into a file-backed and anonymous region),
+	// and make sure they can all be given the protection asked for before changing any of them
+	auto start = (VirtualAddress) addr;
+	auto in_range = [&](const kstd::Arc<VMRegion>& region) {
+		return region->start() == start || (region->start() > start && region->start() < start + length);
+	};
 	for(size_t i = 0; i < _vm_regions.size(); i++) {
-		if(_vm_regions[i]->start() == (VirtualAddress) addr) {
-			_vm_regions[i]->set_prot(prot);
-			_page_directory->map(*_vm_regions[i]);
-			return SUCCESS;
+		if(!in_range(_vm_regions[i]))
+			continue;
+		auto max_prot = _vm_regions[i]->max_prot();
+		if((prot.read && !max_prot.read) || (prot.write && !max_prot.write) || (prot.execute && !max_prot.execute))
+			return -EACCES;
+	}
+
+	bool found = false;
+	for(size_t i = 0; i < _vm_regions.size(); i++) {
+		if(in_range(_vm_regions[i])) {
+			auto& region = _vm_regions[i];
+			region->set_prot(prot);
+
+			// Pages of a shared file mapping that were already faulted in won't fault again when written to now
+			if(region->object()->is_inode()) {
+				auto inode_object = kstd::static_pointer_cast<InodeVMObject>(region->object());
+				LOCK(inode_object->lock());
+				inode_object->pages_mapped(*region, region->object_start() / PAGE_SIZE, region->size() / PAGE_SIZE);
+			}
+
+			_page_directory->map(*region);
+			found = true;
 		}
 	}
+	if(found)
+		return SUCCESS;
 
 	KLog::warn("Process", "mprotect() for %s(%d) failed.", _name.c_str(), _pid);
 	return ENOENT;
@@ -0,0 +1,48 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later */
+/* Copyright © 2016-2023 Byteduck */
+
+#include "../tasking/Process.h"
+#include "../tasking/TaskManager.h"
+#include "../api/resource.h"
+
+int Process::sys_getpriority(int which, int who) {
+	if(which != PRIO_PROCESS)
+		return -EINVAL;
+
+	Process* proc = this;
+	if(who) {
+		auto res = TaskManager::process_for_pid(who);
+		if(res.is_error())
+			return -ESRCH;
+		proc = res.value();
+	}
+
+	// Offset the nice value so that it can't be mistaken for an error. libc undoes this.
+	return proc->nice() - PRIO_MIN;
+}
+
+int Process::sys_setpriority(int which, int who, int prio) {
+	if(which != PRIO_PROCESS)
+		return -EINVAL;
+
+	Process* proc = this;
+	if(who) {
+		auto res = TaskManager::process_for_pid(who);
+		if(res.is_error())
+			return -ESRCH;
+		proc = res.value();
+	}
+
+	prio = max(min(prio, PRIO_MAX - 1), PRIO_MIN);
+
+	// Only root can change other users' processes or raise a process's priority
+	if(!_user.can_override_permissions()) {
+		if(proc->_user.euid != _user.euid)
+			return -EPERM;
+		if(prio < proc->nice())
+			return -EACCES;
+	}
+
+	proc->set_nice(prio);
+	return SUCCESS;
+}
@@ -0,0 +1,20 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later */
+/* Copyright © 2016-2023 Byteduck */
+
+#include "../tasking/Process.h"
+#include "../device/DiskDevice.h"
+#include "../filesystem/FileDescriptor.h"
+
+int Process::sys_sync() {
+	DiskDevice::sync_all();
+	return SUCCESS;
+}
+
+int Process::sys_fsync(int fd) {
+	if(fd < 0 || fd >= (int) _file_descriptors.size() || !_file_descriptors[fd])
+		return -EBADF;
+	auto file = _file_descriptors[fd]->file();
+	if(!file)
+		return -EBADF;
+	return file->sync().code();
+}
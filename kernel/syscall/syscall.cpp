@@ -186,6 +186,16 @@ int handle_syscall(Registers& regs, uint32_t call, uint32_t arg1, uint32_t arg2,
 			return cur_proc->sys_mprotect((void*) arg1, (size_t) arg2, arg3);
 		case SYS_UNAME:
 			return cur_proc->sys_uname((struct utsname*) arg1);
+		case SYS_SYNC:
+			return cur_proc->sys_sync();
+		case SYS_FSYNC:
+			return cur_proc->sys_fsync((int) arg1);
+		case SYS_FUTEX:
+			return cur_proc->sys_futex((int*) arg1, (int) arg2, (int) arg3);
+		case SYS_GETPRIORITY:
+			return cur_proc->sys_getpriority((int) arg1, (int) arg2);
+		case SYS_SETPRIORITY:
+			return cur_proc->sys_setpriority((int) arg1, (int) arg2, (int) arg3);
 
 		//TODO: Implement these syscalls
 		case SYS_TIMES:
@@ -78,6 +78,11 @@
 #define SYS_ACCESS 75
 #define SYS_MPROTECT 76
 #define SYS_UNAME 77
+#define SYS_SYNC 78
+#define SYS_FSYNC 79
+#define SYS_FUTEX 80
+#define SYS_GETPRIORITY 81
+#define SYS_SETPRIORITY 82
 
 #ifndef DUCKOS_KERNEL
 #include <sys/types.h>
@@ -19,6 +19,7 @@
 
 #include "Blocker.h"
 #include "Process.h"
+#include "TaskManager.h"
 
 bool Blocker::can_be_interrupted() {
 	return true;
@@ -47,3 +48,39 @@ bool Blocker::is_lock() {
 Thread* Blocker::responsible_thread() {
 	return nullptr;
 }
+
+Blocker::WakeMode Blocker::wake_mode() {
+	return WakeMode::Poll;
+}
+
+Time Blocker::wake_time() {
+	return Time::distant_future();
+}
+
+void Blocker::notify() {
+	CRITICAL_LOCK(TaskManager::g_tasking_lock);
+	// Several threads may be waiting on the same blocker (i.e. readers of a pipe), so wake all of them
+	Thread* thread = _waiters;
+	while(thread) {
+		Thread* next = thread->blocker_next;
+		if(thread->is_blocked() && thread->should_unblock())
+			thread->unblock();
+		thread = next;
+	}
+}
+
+void Blocker::add_waiter(Thread* thread) {
+	ASSERT(TaskManager::g_tasking_lock.held_by_current_thread());
+	thread->blocker_next = _waiters;
+	_waiters = thread;
+}
+
+void Blocker::remove_waiter(Thread* thread) {
+	ASSERT(TaskManager::g_tasking_lock.held_by_current_thread());
+	Thread** link = &_waiters;
+	while(*link && *link != thread)
+		link = &(*link)->blocker_next;
+	if(*link)
+		*link = thread->blocker_next;
+	thread->blocker_next = nullptr;
+}
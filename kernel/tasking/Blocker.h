@@ -19,23 +19,44 @@
 
 #pragma once
 
+#include <kernel/time/Time.h>
+
 class Process;
 class Thread;
 class Blocker {
 public:
+	/** How the scheduler finds out that a blocker has become ready. **/
+	enum class WakeMode {
+		Poll, ///< is_ready() is checked on every preemption.
+		IOEvent, ///< is_ready() is checked on the next preemption after TaskManager::notify_io() is called.
+		Notify ///< The blocker calls notify() itself when it becomes ready.
+	};
+
 	virtual bool is_ready() = 0;
 	virtual bool can_be_interrupted();
 	virtual bool is_lock();
 	virtual Thread* responsible_thread();
+	virtual WakeMode wake_mode();
+
+	/** The time at which the blocker becomes ready by itself so the thread can be woken then, if any. **/
+	virtual Time wake_time();
 
 	void interrupt();
 	void reset_interrupted();
 	bool was_interrupted();
 
+	/** Wakes up every thread blocked on this blocker, if the blocker is ready. Safe to call from an IRQ. **/
+	void notify();
+
 protected:
 	virtual void on_interrupted();
 
 private:
+	friend class Thread;
+	void add_waiter(Thread* thread);
+	void remove_waiter(Thread* thread);
+
 	bool _interrupted = false;
+	Thread* _waiters = nullptr; ///< The threads currently blocked on this blocker, linked by Thread::blocker_next
 };
 
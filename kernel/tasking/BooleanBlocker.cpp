@@ -25,4 +25,6 @@ bool BooleanBlocker::is_ready() {
 
 void BooleanBlocker::set_ready(bool value) {
 	ready = value;
+	if(value)
+		notify();
 }
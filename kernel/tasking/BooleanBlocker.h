@@ -26,6 +26,7 @@ public:
 	BooleanBlocker() = default;
 	~BooleanBlocker() = default;
 	bool is_ready() override;
+	WakeMode wake_mode() override { return WakeMode::Notify; }
 	void set_ready(bool value);
 
 private:
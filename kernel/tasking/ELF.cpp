@@ -22,6 +22,9 @@
 #include <kernel/memory/MemoryManager.h>
 #include <kernel/filesystem/FileDescriptor.h>
 #include <kernel/memory/PageDirectory.h>
+#include <kernel/memory/InodeVMObject.h>
+#include <kernel/memory/AnonymousVMObject.h>
+#include <kernel/filesystem/InodeFile.h>
 #include <kernel/kstd/KLog.h>
 
 bool ELF::is_valid_elf_header(elf32_header* header) {
@@ -113,27 +116,74 @@ ResultRet<kstd::string> ELF::read_interp(FileDescriptor& fd, kstd::vector<elf32_
 }
 
 ResultRet<kstd::vector<kstd::Arc<VMRegion>>> ELF::load_sections(FileDescriptor& fd, kstd::vector<elf32_segment_header>& headers, const kstd::Arc<VMSpace>& vm_space) {
+	kstd::Arc<Inode> inode;
+	auto file = fd.file();
+	if(file && file->is_inode())
+		inode = kstd::static_pointer_cast<InodeFile>(file)->inode();
+
 	kstd::vector<kstd::Arc<VMRegion>> regions;
 	for(uint32_t i = 0; i < headers.size(); i++) {
 		auto& header = headers[i];
 		if(header.p_type == ELF_PT_LOAD) {
-			size_t loadloc_pagealigned = (header.p_vaddr/PAGE_SIZE) * PAGE_SIZE;
-			size_t loadsize_pagealigned = header.p_memsz + (header.p_vaddr % PAGE_SIZE);
-
-			//Allocate a kernel memory region to load the section into
-			auto tmp_region = MM.alloc_kernel_region(loadsize_pagealigned);
-
-			//Read the section into the region
-			fd.seek(header.p_offset, SEEK_SET);
-			fd.read(KernelPointer<uint8_t>((uint8_t*) tmp_region->start() + (header.p_vaddr - loadloc_pagealigned)), header.p_filesz);
-
-			//Map it into the program's vmem
+			size_t vaddr_mod = header.p_vaddr % PAGE_SIZE;
+			size_t loadloc_pagealigned = header.p_vaddr - vaddr_mod;
+			size_t loadsize_pagealigned = kstd::ceil_div(header.p_memsz + vaddr_mod, PAGE_SIZE) * PAGE_SIZE;
+			size_t file_end = vaddr_mod + header.p_filesz;
 			VMProt prot = {
 				.read = (bool) (header.p_flags & ELF_PF_R),
 				.write = (bool) (header.p_flags & ELF_PF_W),
 				.execute = (bool) (header.p_flags & ELF_PF_X)
 			};
-			auto vmem_region = TRY(vm_space->map_object(tmp_region->object(), prot, VirtualRange { loadloc_pagealigned, tmp_region->size() }));
+
+			// If the segment is aligned the same way in the file as in memory, map the pages backed by the file straight
+			// from the page cache. They're mapped privately even if the segment is read-only, so that they're copied if
+			// the program makes them writable later instead of changing the file. If the segment is followed by bss, its
+			// last partial page can't be mapped since it needs to be zero-filled.
+			size_t mapped_size = 0;
+			if(inode && header.p_filesz && header.p_offset % PAGE_SIZE == vaddr_mod) {
+				if(header.p_memsz > header.p_filesz)
+					mapped_size = (file_end / PAGE_SIZE) * PAGE_SIZE;
+				else
+					mapped_size = kstd::ceil_div(file_end, PAGE_SIZE) * PAGE_SIZE;
+			}
+
+			if(mapped_size) {
+				auto object = InodeVMObject::make_for_inode(inode, InodeVMObject::Type::Private);
+				auto file_region = TRY(vm_space->map_object(object, prot, VirtualRange { loadloc_pagealigned, mapped_size }, header.p_offset - vaddr_mod));
+				regions.push_back(file_region);
+			}
+
+			if(mapped_size >= loadsize_pagealigned)
+				continue;
+
+			//The rest of the section goes in anonymous memory, which is only backed by physical pages as it's touched
+			auto rest_object = TRY(AnonymousVMObject::alloc(loadsize_pagealigned - mapped_size));
+
+			//Only the pages holding the part of the file that wasn't mapped need to be read in up front; bss is left to
+			//be zeroed when it's first used
+			size_t read_start = max(vaddr_mod, mapped_size);
+			if(file_end > read_start) {
+				size_t first_page = (read_start - mapped_size) / PAGE_SIZE;
+				size_t last_page = (file_end - mapped_size - 1) / PAGE_SIZE;
+				auto commit_res = rest_object->commit_pages(first_page, last_page - first_page + 1);
+				if(commit_res.is_error())
+					return commit_res;
+				for(size_t page = first_page; page <= last_page; page++) {
+					size_t page_start = max(read_start, mapped_size + page * PAGE_SIZE);
+					size_t page_end = min(file_end, mapped_size + (page + 1) * PAGE_SIZE);
+					fd.seek(header.p_offset + (page_start - vaddr_mod), SEEK_SET);
+					ssize_t nread;
+					MM.with_quickmapped(rest_object->physical_page(page).index(), [&](void* buf) {
+						auto* page_buf = (uint8_t*) buf + (page_start - mapped_size - page * PAGE_SIZE);
+						nread = fd.read(KernelPointer<uint8_t>(page_buf), page_end - page_start);
+					});
+					if(nread < 0)
+						return Result(nread);
+				}
+			}
+
+			//Map it into the program's vmem
+			auto vmem_region = TRY(vm_space->map_object(rest_object, prot, VirtualRange { loadloc_pagealigned + mapped_size, rest_object->size() }));
 			regions.push_back(vmem_region);
 		}
 	}
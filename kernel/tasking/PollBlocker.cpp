@@ -47,4 +47,12 @@ bool PollBlocker::is_ready() {
 		return true;
 
 	return false;
-}
\ No newline at end of file
+}
+
+Blocker::WakeMode PollBlocker::wake_mode() {
+	return WakeMode::IOEvent;
+}
+
+Time PollBlocker::wake_time() {
+	return has_timeout ? end_time : Time::distant_future();
+}
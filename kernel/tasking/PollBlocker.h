@@ -36,6 +36,8 @@ public:
 
 	PollBlocker(kstd::vector<PollFD>& pollfd, Time timeout);
 	bool is_ready() override;
+	WakeMode wake_mode() override;
+	Time wake_time() override;
 
 	int polled;
 	short polled_revent;
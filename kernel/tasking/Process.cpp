@@ -100,6 +100,14 @@ pid_t Process::sid() {
 	return _sid;
 }
 
+int Process::nice() {
+	return _nice;
+}
+
+void Process::set_nice(int nice) {
+	_nice = nice;
+}
+
 User Process::user() {
 	return _user;
 }
@@ -211,6 +219,7 @@ Process::Process(Process *to_fork, Registers &regs): _user(to_fork->_user), _sel
 	_sid = to_fork->_sid;
 	_pgid = to_fork->_pgid;
 	_umask = to_fork->_umask;
+	_nice = to_fork->_nice;
 	_tty = to_fork->_tty;
 	m_used_pmem = to_fork->m_used_pmem;
 	m_used_shmem = to_fork->m_used_shmem;
@@ -30,6 +30,7 @@
 
 class FileDescriptor;
 class Blocker;
+class BooleanBlocker;
 class ProcessArgs;
 class TTYDevice;
 class Thread;
@@ -70,6 +71,8 @@ public:
 	int all_threads_state();
 	int exit_status();
 	bool is_kernel_mode();
+	int nice();
+	void set_nice(int nice);
 
 	//Threads
 	tid_t last_active_thread();
@@ -167,6 +170,11 @@ public:
 	int sys_munmap(void* addr, size_t length);
 	int sys_mprotect(void* addr, size_t length, int prot);
 	int sys_uname(UserspacePointer<struct utsname> buf);
+	int sys_sync();
+	int sys_fsync(int fd);
+	int sys_futex(UserspacePointer<int> futex, int op, int val);
+	int sys_getpriority(int which, int who);
+	int sys_setpriority(int which, int who, int prio);
 
 private:
 	friend class Thread;
@@ -189,6 +197,7 @@ private:
 	kstd::Arc<TTYDevice> _tty;
 	User _user;
 	mode_t _umask = 022;
+	int _nice = 0;
 	int _exit_status = 0;
 	State _state;
 	bool _kernel_mode = false;
@@ -218,6 +227,10 @@ private:
 	tid_t _last_active_thread = 1;
 	SpinLock _thread_lock;
 
+	//Futexes
+	kstd::map<size_t, kstd::vector<BooleanBlocker*>> m_futexes;
+	SpinLock m_futex_lock;
+
 	Process* _self_ptr;
 };
 
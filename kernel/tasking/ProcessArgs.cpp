@@ -24,6 +24,16 @@
 
 ProcessArgs::ProcessArgs(const kstd::Arc<LinkedInode>& working_dir): working_dir(working_dir) {}
 
+size_t ProcessArgs::stack_size() const {
+	// The argv and env pointer arrays (null-terminated), env, argv, argc, and the zero at the top
+	size_t size = (argv.size() + env.size() + 2) * sizeof(uint32_t) + sizeof(size_t) * 2 + sizeof(int) + sizeof(uint32_t);
+	for(size_t i = 0; i < argv.size(); i++)
+		size += argv[i].length() + 1;
+	for(size_t i = 0; i < env.size(); i++)
+		size += env[i].length() + 1;
+	return size;
+}
+
 void ProcessArgs::setup_stack(Stack& stack) {
 	auto* argp = new size_t[argv.size()];
 	auto* envp = new size_t[env.size()];
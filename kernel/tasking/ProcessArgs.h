@@ -30,6 +30,8 @@ public:
 	ProcessArgs(const kstd::Arc<LinkedInode>& working_dir);
 
 	void setup_stack(Stack& stack);
+	/** The number of bytes that setup_stack will push onto the stack. **/
+	size_t stack_size() const;
 
 	kstd::vector<kstd::string> argv;
 	kstd::vector<kstd::string> env;
@@ -27,6 +27,15 @@ bool SleepBlocker::is_ready() {
 	return Time::now() >= _end_time;
 }
 
+Blocker::WakeMode SleepBlocker::wake_mode() {
+	// We're woken by the scheduler once wake_time() passes
+	return WakeMode::Notify;
+}
+
+Time SleepBlocker::wake_time() {
+	return _end_time;
+}
+
 Time SleepBlocker::end_time() {
 	return _end_time;
 }
@@ -29,6 +29,8 @@ public:
 
 	///Blocker
 	bool is_ready() override;
+	WakeMode wake_mode() override;
+	Time wake_time() override;
 
 	///SleepBlocker
 	Time end_time();
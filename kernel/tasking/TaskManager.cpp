@@ -25,7 +25,11 @@
 #include "Process.h"
 #include "Thread.h"
 #include "Reaper.h"
+#include <kernel/device/DiskDevice.h>
 #include <kernel/kstd/KLog.h>
+#include <kernel/CommandLine.h>
+#include <kernel/api/resource.h>
+#include <kernel/time/TimeManager.h>
 
 TSS TaskManager::tss;
 SpinLock TaskManager::g_tasking_lock;
@@ -34,19 +38,62 @@ SpinLock TaskManager::g_process_lock;
 kstd::Arc<Thread> cur_thread;
 Process* kernel_process;
 kstd::vector<Process*>* processes = nullptr;
-Thread* TaskManager::g_next_thread;
 
 Atomic<int> next_pid = 0;
 bool tasking_enabled = false;
 bool yield_async = false;
 bool preempting = false;
-static uint8_t quantum_counter = 0;
+
+// The scheduler is a multilevel feedback queue. Threads start at (and are boosted back to when they wake up) a base level
+// determined by their process's nice value. Threads that use up their quantum drop down a level, and lower levels get
+// longer quanta. Every so often, all threads are boosted back to their base level so that nothing starves.
+#define SCHED_NUM_LEVELS 16
+#define SCHED_NUM_BASE_LEVELS 8
+#define SCHED_DEFAULT_QUANTUM 4 // In ticks
+#define SCHED_BOOST_INTERVAL 1000 // In ticks
+static Thread* s_run_queue_heads[SCHED_NUM_LEVELS] = {nullptr};
+static Thread* s_run_queue_tails[SCHED_NUM_LEVELS] = {nullptr};
+static int s_base_quantum = SCHED_DEFAULT_QUANTUM;
+static int s_boost_ticks = 0;
+static bool s_boost_pending = false;
+static bool s_timer_preempting = false;
+
+// Blocked threads whose blockers have to be checked on every preemption, or after IO events, respectively
+static Thread* s_polled_threads = nullptr;
+static Thread* s_io_threads = nullptr;
+static volatile bool s_io_pending = false;
+
+// A min-heap of blocked threads ordered by the time they should be woken. Room for every thread is made when threads are
+// created, since we can't allocate memory when a thread blocks in a critical section.
+#define SLEEP_HEAP_INITIAL_CAPACITY 64
+static Thread* s_initial_sleep_heap[SLEEP_HEAP_INITIAL_CAPACITY];
+static Thread** s_sleep_heap = s_initial_sleep_heap;
+static size_t s_sleep_heap_capacity = SLEEP_HEAP_INITIAL_CAPACITY;
+static size_t s_sleep_heap_size = 0;
+static Atomic<size_t> s_num_threads = 0;
+
+// The FPU state is switched lazily. CR0.TS is set whenever we switch to a thread other than the one whose state is loaded
+// in the FPU, so that the first FPU instruction it runs faults and we can swap the state in then.
+#define CR0_TS 0x8
+#define MXCSR_DEFAULT 0x1F80
+static Thread* s_fpu_owner = nullptr;
+
+static inline void set_fpu_trap(bool trap) {
+	if(trap) {
+		size_t cr0;
+		asm volatile("mov %%cr0, %0" : "=r"(cr0));
+		asm volatile("mov %0, %%cr0" :: "r"(cr0 | CR0_TS));
+	} else {
+		asm volatile("clts");
+	}
+}
 
 void kidle(){
 	tasking_enabled = true;
 	TaskManager::yield();
 	while(1) {
-		asm volatile("hlt");
+		TimeManager::idle_wait();
+		TaskManager::yield();
 	}
 }
 
@@ -135,6 +182,11 @@ void TaskManager::init(){
 	KLog::dbg("TaskManager", "Initializing tasking...");
 	g_tasking_lock.acquire();
 
+	// The base quantum (in ticks) can be changed with the sched_quantum kernel command line option
+	auto& cmd_line = CommandLine::inst();
+	if(cmd_line.has_option("sched_quantum"))
+		s_base_quantum = max(atoi((char*) cmd_line.get_option_value("sched_quantum").c_str()), 1);
+
 	processes = new kstd::vector<Process*>();
 
 	//Create kernel process
@@ -148,9 +200,12 @@ void TaskManager::init(){
 
 	//Create kernel threads
 	kernel_process->spawn_kernel_thread(kreaper_entry);
+	kernel_process->spawn_kernel_thread(kdiskflush_entry);
+	kernel_process->spawn_kernel_thread(kdiskprefetch_entry);
 
 	//Preempt
 	cur_thread = kernel_process->get_thread(kernel_process->pid());
+	set_fpu_trap(true);
 	preempt_init_asm(cur_thread->registers.esp);
 }
 
@@ -206,42 +261,330 @@ void TaskManager::queue_thread(const kstd::Arc<Thread>& thread) {
 		return;
 	}
 
-	if(g_next_thread)
-		g_next_thread->enqueue_thread(thread.get());
+	if(thread->run_queued)
+		return;
+
+	// Make sure the thread isn't running at a higher priority than its process's nice value allows
+	int base_level = base_priority_level(thread.get());
+	if(thread->sched_level < base_level)
+		thread->sched_level = base_level;
+
+	auto* raw_thread = thread.get();
+	int level = raw_thread->sched_level;
+	raw_thread->run_queued = true;
+	raw_thread->run_next = nullptr;
+	raw_thread->run_prev = s_run_queue_tails[level];
+	if(s_run_queue_tails[level])
+		s_run_queue_tails[level]->run_next = raw_thread;
+	else
+		s_run_queue_heads[level] = raw_thread;
+	s_run_queue_tails[level] = raw_thread;
+}
+
+void TaskManager::wake_thread(const kstd::Arc<Thread>& thread) {
+	ASSERT(g_tasking_lock.held_by_current_thread());
+	// Threads that block (usually on I/O) are likely to be interactive, so they go back to the front of the line
+	if(!thread->run_queued)
+		thread->sched_level = base_priority_level(thread.get());
+	queue_thread(thread);
+}
+
+void TaskManager::dequeue_thread(Thread* thread) {
+	ASSERT(g_tasking_lock.held_by_current_thread());
+	if(!thread->run_queued)
+		return;
+
+	int level = thread->sched_level;
+	if(thread->run_prev)
+		thread->run_prev->run_next = thread->run_next;
+	else
+		s_run_queue_heads[level] = thread->run_next;
+	if(thread->run_next)
+		thread->run_next->run_prev = thread->run_prev;
 	else
-		g_next_thread = thread.get();
+		s_run_queue_tails[level] = thread->run_prev;
+	thread->run_next = nullptr;
+	thread->run_prev = nullptr;
+	thread->run_queued = false;
+}
+
+int TaskManager::base_priority_level(Thread* thread) {
+	int nice = thread->process()->nice();
+	return (nice - PRIO_MIN) * SCHED_NUM_BASE_LEVELS / (PRIO_MAX - PRIO_MIN);
+}
+
+static int quantum_for_level(int level) {
+	return s_base_quantum << (level * 4 / SCHED_NUM_LEVELS);
+}
+
+/** Moves every thread back to its base level so that threads stuck at low priorities get a chance to run. **/
+static void boost_all_threads() {
+	Thread* threads = nullptr;
+	for(int level = 0; level < SCHED_NUM_LEVELS; level++) {
+		while(auto* thread = s_run_queue_heads[level]) {
+			TaskManager::dequeue_thread(thread);
+			thread->run_next = threads;
+			threads = thread;
+		}
+	}
+
+	while(threads) {
+		auto* next = threads->run_next;
+		threads->run_next = nullptr;
+		threads->sched_level = TaskManager::base_priority_level(threads);
+		if(threads->can_be_run())
+			TaskManager::queue_thread(threads->self());
+		threads = next;
+	}
+
+	if(!TaskManager::is_idle())
+		cur_thread->sched_level = TaskManager::base_priority_level(cur_thread.get());
+}
+
+static void sleep_heap_swap(size_t a, size_t b) {
+	auto* tmp = s_sleep_heap[a];
+	s_sleep_heap[a] = s_sleep_heap[b];
+	s_sleep_heap[b] = tmp;
+	s_sleep_heap[a]->sleep_index = (int) a;
+	s_sleep_heap[b]->sleep_index = (int) b;
+}
+
+static void sleep_heap_sift_up(size_t index) {
+	while(index) {
+		size_t parent = (index - 1) / 2;
+		if(s_sleep_heap[parent]->wake_time <= s_sleep_heap[index]->wake_time)
+			break;
+		sleep_heap_swap(index, parent);
+		index = parent;
+	}
+}
+
+static void sleep_heap_sift_down(size_t index) {
+	while(true) {
+		size_t smallest = index;
+		size_t left = index * 2 + 1;
+		size_t right = left + 1;
+		if(left < s_sleep_heap_size && s_sleep_heap[left]->wake_time < s_sleep_heap[smallest]->wake_time)
+			smallest = left;
+		if(right < s_sleep_heap_size && s_sleep_heap[right]->wake_time < s_sleep_heap[smallest]->wake_time)
+			smallest = right;
+		if(smallest == index)
+			return;
+		sleep_heap_swap(index, smallest);
+		index = smallest;
+	}
+}
+
+void TaskManager::add_blocked_thread(Thread* thread, Blocker& blocker) {
+	ASSERT(g_tasking_lock.held_by_current_thread());
+
+	Thread** list = nullptr;
+	switch(blocker.wake_mode()) {
+		case Blocker::WakeMode::Poll:
+			list = &s_polled_threads;
+			break;
+		case Blocker::WakeMode::IOEvent:
+			list = &s_io_threads;
+			break;
+		case Blocker::WakeMode::Notify:
+			break;
+	}
+	if(list) {
+		thread->waiting_list = list;
+		thread->waiting_prev = nullptr;
+		thread->waiting_next = *list;
+		if(*list)
+			(*list)->waiting_prev = thread;
+		*list = thread;
+	}
+
+	thread->wake_time = blocker.wake_time();
+	if(thread->wake_time < Time::distant_future()) {
+		ASSERT(s_sleep_heap_size < s_sleep_heap_capacity);
+		thread->sleep_index = (int) s_sleep_heap_size;
+		s_sleep_heap[s_sleep_heap_size++] = thread;
+		sleep_heap_sift_up(thread->sleep_index);
+		if(thread->sleep_index == 0)
+			TimeManager::arm_deadline(thread->wake_time);
+	}
+}
+
+void TaskManager::remove_blocked_thread(Thread* thread) {
+	ASSERT(g_tasking_lock.held_by_current_thread());
+
+	if(thread->waiting_list) {
+		if(thread->waiting_prev)
+			thread->waiting_prev->waiting_next = thread->waiting_next;
+		else
+			*thread->waiting_list = thread->waiting_next;
+		if(thread->waiting_next)
+			thread->waiting_next->waiting_prev = thread->waiting_prev;
+		thread->waiting_list = nullptr;
+		thread->waiting_next = nullptr;
+		thread->waiting_prev = nullptr;
+	}
+
+	if(thread->sleep_index >= 0) {
+		size_t index = thread->sleep_index;
+		thread->sleep_index = -1;
+		if(index != --s_sleep_heap_size) {
+			auto* moved = s_sleep_heap[s_sleep_heap_size];
+			s_sleep_heap[index] = moved;
+			moved->sleep_index = (int) index;
+			sleep_heap_sift_up(index);
+			sleep_heap_sift_down(moved->sleep_index);
+		}
+	}
+}
+
+void TaskManager::notify_io() {
+	s_io_pending = true;
+}
+
+bool TaskManager::can_stop_tick() {
+	return !s_polled_threads && !s_io_pending;
+}
+
+Time TaskManager::next_wake_time() {
+	return s_sleep_heap_size ? s_sleep_heap[0]->wake_time : Time::distant_future();
+}
+
+void TaskManager::reserve_wake_slot() {
+	size_t needed = s_num_threads.add(1) + 1;
+	if(needed <= s_sleep_heap_capacity)
+		return;
+
+	size_t new_capacity = needed * 2;
+	auto** new_heap = new Thread*[new_capacity];
+	Thread** old_heap = nullptr;
+	{
+		CRITICAL_LOCK(g_tasking_lock);
+		if(s_sleep_heap_capacity < needed) {
+			memcpy(new_heap, s_sleep_heap, s_sleep_heap_size * sizeof(Thread*));
+			old_heap = s_sleep_heap;
+			s_sleep_heap = new_heap;
+			s_sleep_heap_capacity = new_capacity;
+			new_heap = nullptr;
+		}
+	}
+
+	// Free whichever heap we aren't using anymore outside of the critical section
+	delete[] new_heap;
+	if(old_heap != s_initial_sleep_heap)
+		delete[] old_heap;
+}
+
+void TaskManager::release_wake_slot() {
+	s_num_threads.sub(1);
+}
+
+void TaskManager::handle_fpu_trap() {
+	set_fpu_trap(false);
+	auto* thread = cur_thread.get();
+	if(s_fpu_owner == thread)
+		return;
+
+	if(s_fpu_owner)
+		asm volatile("fxsave %0" : "=m"(s_fpu_owner->fpu_state));
+	if(thread->fpu_used) {
+		asm volatile("fxrstor %0" :: "m"(thread->fpu_state));
+	} else {
+		// This thread has never used the FPU, so give it a clean state
+		uint32_t mxcsr = MXCSR_DEFAULT;
+		asm volatile("fninit; ldmxcsr %0" :: "m"(mxcsr));
+		thread->fpu_used = true;
+	}
+	s_fpu_owner = thread;
+}
+
+void TaskManager::save_fpu_state() {
+	ScopedCritical critical;
+	if(s_fpu_owner && s_fpu_owner == cur_thread.get())
+		asm volatile("fxsave %0" : "=m"(s_fpu_owner->fpu_state));
+}
+
+void TaskManager::release_fpu(Thread* thread) {
+	ScopedCritical critical;
+	if(s_fpu_owner == thread)
+		s_fpu_owner = nullptr;
+}
+
+/** Wakes up threads that are done sleeping, and threads whose polled blockers have become ready. **/
+static void wake_blocked_threads() {
+	if(s_sleep_heap_size) {
+		auto now = Time::now();
+		while(s_sleep_heap_size && s_sleep_heap[0]->wake_time <= now) {
+			auto* thread = s_sleep_heap[0];
+			if(thread->is_blocked())
+				thread->unblock();
+			else
+				TaskManager::remove_blocked_thread(thread);
+		}
+	}
+
+	auto poll_list = [](Thread* thread) {
+		while(thread) {
+			auto* next = thread->waiting_next;
+			if(thread->is_blocked() && thread->should_unblock())
+				thread->unblock();
+			thread = next;
+		}
+	};
+
+	poll_list(s_polled_threads);
+	if(s_io_pending) {
+		s_io_pending = false;
+		poll_list(s_io_threads);
+	}
 }
 
 void TaskManager::notify_current(uint32_t sig){
 	cur_thread->process()->kill(sig);
 }
 
-kstd::Arc<Thread> TaskManager::pick_next_thread() {
+kstd::Arc<Thread> TaskManager::pick_next_thread(bool timer_preempted) {
 	ASSERT(g_tasking_lock.held_by_current_thread());
 
-	// Make sure the next thread is in a runnable state
-	while(g_next_thread && !g_next_thread->can_be_run())
-		g_next_thread = g_next_thread->next_thread();
+	bool cur_runnable = !is_idle() && cur_thread->can_be_run();
+	if(cur_runnable && timer_preempted) {
+		// If the current thread still has time left, keep running it unless a higher priority thread is waiting
+		if(cur_thread->sched_ticks_left > 0) {
+			bool higher_priority_waiting = false;
+			for(int level = 0; level < cur_thread->sched_level && !higher_priority_waiting; level++)
+				higher_priority_waiting = s_run_queue_heads[level];
+			if(!higher_priority_waiting)
+				return cur_thread;
+		} else if(cur_thread->sched_level < SCHED_NUM_LEVELS - 1) {
+			// The thread used up its whole quantum, so it's probably CPU-bound. Move it down a level.
+			cur_thread->sched_level++;
+		}
+	}
 
-	// If we don't have a next thread to run, either continue running the current thread or run kidle
-	if(!g_next_thread) {
-		if(cur_thread->can_be_run()) {
-			return cur_thread;
-		} else if(kernel_process->get_thread(kernel_process->pid())->state() != Thread::ALIVE) {
-			PANIC("KTHREAD_DEADLOCK", "The kernel idle thread is blocked!");
-		} else {
-			return kernel_process->get_thread(kernel_process->pid());
+	// Find the first runnable thread in the highest priority queue
+	for(int level = 0; level < SCHED_NUM_LEVELS; level++) {
+		while(auto* thread = s_run_queue_heads[level]) {
+			dequeue_thread(thread);
+			if(!thread->can_be_run())
+				continue;
+			thread->sched_ticks_left = quantum_for_level(thread->sched_level);
+			return thread->self();
 		}
 	}
 
-	auto next = g_next_thread->self();
-	g_next_thread = g_next_thread->next_thread();
-	return next;
+	// If we don't have a next thread to run, either continue running the current thread or run kidle
+	if(cur_thread->can_be_run()) {
+		if(cur_thread->sched_ticks_left <= 0)
+			cur_thread->sched_ticks_left = quantum_for_level(max(cur_thread->sched_level, 0));
+		return cur_thread;
+	} else if(kernel_process->get_thread(kernel_process->pid())->state() != Thread::ALIVE) {
+		PANIC("KTHREAD_DEADLOCK", "The kernel idle thread is blocked!");
+	} else {
+		return kernel_process->get_thread(kernel_process->pid());
+	}
 }
 
 bool TaskManager::yield() {
 	ASSERT(!preempting);
-	quantum_counter = 0;
 	if(Interrupt::in_irq()) {
 		// We can't yield in an interrupt. Instead, we'll yield immediately after we exit the interrupt
 		yield_async = true;
@@ -275,6 +618,20 @@ void TaskManager::do_yield_async() {
 
 void TaskManager::tick() {
 	ASSERT(Interrupt::in_irq());
+	if(!is_idle())
+		cur_thread->sched_ticks_left--;
+	if(++s_boost_ticks >= SCHED_BOOST_INTERVAL) {
+		s_boost_ticks = 0;
+		s_boost_pending = true;
+	}
+	s_timer_preempting = true;
+	yield();
+}
+
+void TaskManager::timer_deadline() {
+	ASSERT(Interrupt::in_irq());
+	// Like a tick, but without using up any of the current thread's quantum
+	s_timer_preempting = true;
 	yield();
 }
 
@@ -287,10 +644,18 @@ void TaskManager::enter_critical() {
 
 void TaskManager::leave_critical() {
 	ASSERT(g_critical_count.load() > 0);
-	if(g_critical_count.sub(1) == 1)
+	// Interrupts are already disabled while handling an IRQ, so don't turn them back on until it's done
+	if(g_critical_count.sub(1) == 1 && !Interrupt::in_irq())
 		asm volatile("sti");
 }
 
+void TaskManager::leave_critical_and_halt() {
+	ASSERT(g_critical_count.load() == 1 && !Interrupt::in_irq());
+	g_critical_count.sub(1);
+	// sti only takes effect after the next instruction, so we can't miss an interrupt that arrives before the hlt
+	asm volatile("sti; hlt");
+}
+
 bool TaskManager::in_critical() {
 	return g_critical_count.load();
 }
@@ -304,26 +669,17 @@ void TaskManager::preempt(){
 	cur_thread->enter_critical();
 	preempting = true;
 
-	// Try unblocking threads that are blocked
-	if(g_process_lock.try_acquire()) {
-		for(auto& process : *processes) {
-			if(process->state() != Process::ALIVE)
-				continue;
-			for(auto& tid : process->threads()) {
-				auto thread = process->get_thread(tid);
-				if(!thread)
-					continue;
-				if(thread->state() == Thread::BLOCKED && thread->should_unblock())
-					thread->unblock();
-			}
-		}
-		g_process_lock.release();
-	}
+	// Wake up blocked threads that are ready. Threads whose blockers notify us when they're ready aren't checked here.
+	wake_blocked_threads();
 
 	// Pick a new thread
 	auto old_thread = cur_thread;
-	auto next_thread = pick_next_thread();
-	quantum_counter = 1; //Every process has a quantum of 1 for now
+	if(s_boost_pending) {
+		s_boost_pending = false;
+		boost_all_threads();
+	}
+	auto next_thread = pick_next_thread(s_timer_preempting);
+	s_timer_preempting = false;
 
 	bool should_preempt = old_thread != next_thread;
 
@@ -378,9 +734,10 @@ void TaskManager::preempt(){
 		next_thread.reset();
 		old_thread.reset();
 
-		asm volatile("fxsave %0" : "=m"(cur_thread->fpu_state));
+		if(cur_thread->tid() != kernel_process->pid())
+			TimeManager::resume_tick();
+		set_fpu_trap(cur_thread.get() != s_fpu_owner);
 		preempt_asm(old_esp, new_esp, cur_thread->page_directory()->entries_physaddr());
-		asm volatile("fxrstor %0" ::"m"(cur_thread->fpu_state));
 	}
 
 	preempt_finish();
@@ -29,6 +29,7 @@
 class Process;
 class Thread;
 class SpinLock;
+class Blocker;
 struct TSS;
 
 namespace TaskManager {
@@ -44,11 +45,6 @@ namespace TaskManager {
 	/** This lock is acquired while editing the process list. **/
 	extern SpinLock g_process_lock;
 
-	/** This is the thread at the beginning of the thread queue. The thread queue is updated on calls to `queue_thread`
-	 *  and in Thread::reap (which ensures that the reaped thread is removed from the queue.
-	 */
-	extern Thread* g_next_thread;
-
 	void init();
 	bool enabled();
 	bool is_idle();
@@ -58,7 +54,34 @@ namespace TaskManager {
 	kstd::vector<Process*>* process_list();
 	int add_process(Process* proc);
 	void remove_process(Process* proc);
+	/** Puts a thread at the back of the run queue for its priority level. **/
 	void queue_thread(const kstd::Arc<Thread>& thread);
+	/** Queues a thread that just woke up from blocking, boosting it back up to its base priority level. **/
+	void wake_thread(const kstd::Arc<Thread>& thread);
+	/** Removes a thread from the run queues if it's queued. **/
+	void dequeue_thread(Thread* thread);
+	/** The run queue level a thread starts at and returns to when it wakes up, based on its process's nice value. **/
+	int base_priority_level(Thread* thread);
+
+	/** Starts keeping track of a thread that just blocked so it can be woken. g_tasking_lock must be held. **/
+	void add_blocked_thread(Thread* thread, Blocker& blocker);
+	/** Stops keeping track of a blocked thread. g_tasking_lock must be held. **/
+	void remove_blocked_thread(Thread* thread);
+	/** Signals that a file may have become readable or writable, so threads waiting in poll() should be checked. **/
+	void notify_io();
+	/** Whether the periodic tick can be stopped while idle, i.e. no blocked thread needs to be polled on every tick. **/
+	bool can_stop_tick();
+	/** The earliest time a sleeping thread needs to be woken up, or Time::distant_future() if none. **/
+	Time next_wake_time();
+	/** Makes room for a new thread in the sleeping thread heap. Must be called outside of a critical section. **/
+	void reserve_wake_slot();
+	void release_wake_slot();
+	/** Handles a device not available fault by loading the current thread's FPU state, saving the previous owner's. **/
+	void handle_fpu_trap();
+	/** Saves the FPU state of the current thread into its fpu_state, if it's the one loaded in the FPU. **/
+	void save_fpu_state();
+	/** Makes sure a thread being destroyed is no longer considered the owner of the FPU. **/
+	void release_fpu(Thread* thread);
 	kstd::Arc<Thread>& current_thread();
 	Process* current_process();
 	ResultRet<Process*> process_for_pid(pid_t pid);
@@ -73,9 +96,13 @@ namespace TaskManager {
 	bool yield_if_idle();
 	void do_yield_async();
 	void tick();
+	/** Called when a one-shot timer armed for a sleeping thread's deadline fires. **/
+	void timer_deadline();
 
 	void enter_critical();
 	extern "C" void leave_critical();
+	/** Leaves the outermost critical section and halts until the next interrupt. Used by the idle thread. **/
+	void leave_critical_and_halt();
 	bool in_critical();
 
 	class ScopedCritical {
@@ -101,7 +128,7 @@ namespace TaskManager {
 	void notify_current(uint32_t sig);
 
 	pid_t get_new_pid();
-	kstd::Arc<Thread> pick_next_thread();
+	kstd::Arc<Thread> pick_next_thread(bool timer_preempted);
 
 
 	extern "C" void preempt();
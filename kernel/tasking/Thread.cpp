@@ -35,6 +35,8 @@ Thread::Thread(Process* process, tid_t tid, size_t entry_point, ProcessArgs* arg
 	m_vm_space(process->_vm_space),
 	m_page_directory(process->_page_directory)
 {
+	TaskManager::reserve_wake_slot();
+
 	//Create the kernel stack
 	_kernel_stack_region = MM.alloc_kernel_region(THREAD_KERNEL_STACK_SIZE);
 	kstd::Arc<VMRegion> mapped_user_stack_region;
@@ -45,7 +47,9 @@ Thread::Thread(Process* process, tid_t tid, size_t entry_point, ProcessArgs* arg
 		auto do_create_stack = [&]() -> Result {
 			auto stack_object = TRY(AnonymousVMObject::alloc(THREAD_STACK_SIZE));
 			_stack_region = TRY(m_vm_space->map_stack(stack_object));
-			mapped_user_stack_region = MM.map_object(stack_object);
+			// Only map (and commit) the top of the stack, where the arguments go
+			size_t args_size = kstd::ceil_div(args->stack_size(), PAGE_SIZE) * PAGE_SIZE;
+			mapped_user_stack_region = MM.map_object(stack_object, {stack_object->size() - args_size, args_size});
 			return Result(SUCCESS);
 		};
 		if (do_create_stack().is_error())
@@ -96,9 +100,17 @@ Thread::Thread(Process* process, tid_t tid, Registers& regs):
 	m_vm_space(process->_vm_space),
 	m_page_directory(process->_page_directory)
 {
+	TaskManager::reserve_wake_slot();
+
 	//Allocate kernel stack
 	_kernel_stack_region = MM.alloc_kernel_region(THREAD_KERNEL_STACK_SIZE);
 
+	// The child inherits the FPU state of the forking thread
+	auto& parent = TaskManager::current_thread();
+	TaskManager::save_fpu_state();
+	memcpy(fpu_state, parent->fpu_state, sizeof(fpu_state));
+	fpu_used = parent->fpu_used;
+
 	//Setup registers and stack
 	registers.eax = 0; // fork() in child returns zero
 	Stack stack((void*) (_kernel_stack_region->start() + _kernel_stack_region->size()));
@@ -111,6 +123,8 @@ Thread::Thread(Process* process, tid_t tid, void* (*entry_func)(void* (*)(void*)
 	m_vm_space(process->_vm_space),
 	m_page_directory(process->_page_directory)
 {
+	TaskManager::reserve_wake_slot();
+
 	//Create the kernel stack
 	_kernel_stack_region = MM.alloc_kernel_region(THREAD_KERNEL_STACK_SIZE);
 	kstd::Arc<VMRegion> mapped_user_stack_region;
@@ -121,7 +135,8 @@ Thread::Thread(Process* process, tid_t tid, void* (*entry_func)(void* (*)(void*)
 		auto do_create_stack = [&]() -> Result {
 			auto stack_object = TRY(AnonymousVMObject::alloc(THREAD_STACK_SIZE));
 			_stack_region = TRY(m_vm_space->map_stack(stack_object));
-			mapped_user_stack_region = MM.map_object(stack_object);
+			// Only map (and commit) the top page of the stack, where the arguments go
+			mapped_user_stack_region = MM.map_object(stack_object, {stack_object->size() - PAGE_SIZE, PAGE_SIZE});
 			return Result(SUCCESS);
 		};
 
@@ -170,6 +185,8 @@ Thread::Thread(Process* process, tid_t tid, void* (*entry_func)(void* (*)(void*)
 
 Thread::~Thread() {
 	ASSERT(_state == DEAD);
+	TaskManager::release_wake_slot();
+	TaskManager::release_fpu(this);
 }
 
 Process* Thread::process() {
@@ -282,24 +299,32 @@ void Thread::block(Blocker& blocker) {
 	}
 
 	{
-		TaskManager::ScopedCritical critical;
+		CRITICAL_LOCK(TaskManager::g_tasking_lock);
+
+		// The blocker may have become ready since we checked. Notify and IOEvent blockers won't tell us again if so, since
+		// the wakeup happened before we were waiting on them.
+		if(blocker.is_ready())
+			return;
+
 		_state = BLOCKED;
 		_blocker = &blocker;
+		blocker.add_waiter(this);
+		TaskManager::add_blocked_thread(this, blocker);
 	}
 
 	ASSERT(TaskManager::yield());
 }
 
 void Thread::unblock() {
+	CRITICAL_LOCK(TaskManager::g_tasking_lock);
 	if(!_blocker)
 		return;
+	TaskManager::remove_blocked_thread(this);
+	_blocker->remove_waiter(this);
 	_blocker = nullptr;
 	if(_state == BLOCKED)
 		_state = ALIVE;
-	{
-		CRITICAL_LOCK(TaskManager::g_tasking_lock);
-		TaskManager::queue_thread(self());
-	}
+	TaskManager::wake_thread(self());
 }
 
 bool Thread::is_blocked() {
@@ -401,7 +426,8 @@ bool Thread::call_signal_handler(int signal) {
 
 	// Map the user stack into kernel space
 	// FIXME: We panic here after the second time this is called. Why?
-	auto k_ustack = MM.map_object(_sighandler_ustack_region->object());
+	auto ustack_object = _sighandler_ustack_region->object();
+	auto k_ustack = MM.map_object(ustack_object, {ustack_object->size() - PAGE_SIZE, PAGE_SIZE});
 
 	//Allocate a kernel stack
 	if(!_sighandler_kstack_region)
@@ -495,24 +521,6 @@ void Thread::handle_pagefault(PageFault fault) {
 	}
 }
 
-void Thread::enqueue_thread(Thread* thread) {
-	ASSERT(TaskManager::g_tasking_lock.held_by_current_thread());
-	if(thread == this)
-		return;
-	if(m_next) {
-		m_next->enqueue_thread(thread);
-	} else {
-		m_next = thread;
-		thread->m_prev = this;
-	}
-}
-
-Thread* Thread::next_thread() {
-	auto next = m_next;
-	m_next = nullptr;
-	return next;
-}
-
 void Thread::setup_kernel_stack(Stack& kernel_stack, size_t user_stack_ptr, Registers& regs) {
 	//If usermode, push ss and useresp
 	if(!is_kernel_mode()) {
@@ -557,11 +565,11 @@ void Thread::exit(void* return_value) {
 
 void Thread::reap() {
 	_process->alert_thread_died(self());
-	TaskManager::ScopedCritical critical;
-	if(TaskManager::g_next_thread == this)
-		TaskManager::g_next_thread = m_next;
-	if(m_prev && m_prev->m_next == this)
-		m_prev->m_next = m_next;
-	if(m_next)
-		m_next->m_prev = this;
+	CRITICAL_LOCK(TaskManager::g_tasking_lock);
+	if(_blocker) {
+		TaskManager::remove_blocked_thread(this);
+		_blocker->remove_waiter(this);
+		_blocker = nullptr;
+	}
+	TaskManager::dequeue_thread(this);
 }
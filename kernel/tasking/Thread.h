@@ -29,6 +29,7 @@
 #include "../memory/PageDirectory.h"
 #include "../kstd/queue.hpp"
 #include "kernel/kstd/circular_queue.hpp"
+#include "../time/Time.h"
 
 #define THREAD_STACK_SIZE 1048576 //1024KiB
 #define THREAD_KERNEL_STACK_SIZE 524288 //512KiB
@@ -90,14 +91,26 @@ public:
 	//Misc
 	void handle_pagefault(PageFault fault);
 
-	//Thread queue
-	void enqueue_thread(Thread* thread);
-	Thread* next_thread();
-
 	uint8_t fpu_state[512] __attribute__((aligned(16)));
+	bool fpu_used = false; ///< Whether this thread has used the FPU, i.e. whether fpu_state is meaningful
 	Registers registers = {};
 	Registers signal_registers = {};
 
+	// Used by TaskManager to keep track of blocked threads that may need waking
+	Thread** waiting_list = nullptr; ///< The list of polled threads this thread is in, if any
+	Thread* waiting_next = nullptr;
+	Thread* waiting_prev = nullptr;
+	Time wake_time;
+	int sleep_index = -1; ///< The index of this thread in the sleeping thread heap, or -1 if not sleeping
+	Thread* blocker_next = nullptr; ///< The next thread waiting on the same blocker as this one
+
+	// Used by TaskManager for scheduling
+	Thread* run_next = nullptr;
+	Thread* run_prev = nullptr;
+	bool run_queued = false;
+	int sched_level = -1; ///< The run queue this thread goes in, from 0 (highest priority) to SCHED_NUM_LEVELS - 1
+	int sched_ticks_left = 0; ///< The number of ticks left in this thread's quantum
+
 private:
 	friend class Process;
 	friend class Reaper;
@@ -136,9 +149,5 @@ private:
 	size_t _signal_stack_top = 0;
 	kstd::Arc<VMRegion> _sighandler_ustack_region;
 	kstd::Arc<VMRegion> _sighandler_kstack_region;
-
-	// Thread queue
-	Thread* m_next = nullptr;
-	Thread* m_prev = nullptr;
 };
 
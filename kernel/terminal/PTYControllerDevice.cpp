@@ -95,6 +95,7 @@ size_t PTYControllerDevice::putchars(const uint8_t* buffer, size_t count) {
 	size_t count_loop = count;
 	while(count_loop--)
 		_output_buffer.push_back(*(buffer++));
+	TaskManager::notify_io();
 
 	_output_lock.release();
 
@@ -103,6 +104,7 @@ size_t PTYControllerDevice::putchars(const uint8_t* buffer, size_t count) {
 
 void PTYControllerDevice::notify_pty_closed() {
 	_pty = kstd::Arc<PTYDevice>(nullptr);
+	TaskManager::notify_io();
 }
 
 void PTYControllerDevice::ref_inc() {
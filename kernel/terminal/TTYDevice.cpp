@@ -115,6 +115,7 @@ void TTYDevice::emit(uint8_t c) {
 			_input_buffer.push_back('\0');
 			_lines++;
 			_buffer_blocker.set_ready(true);
+			TaskManager::notify_io();
 			return;
 		}
 		if(c == '\n' || c == _termios.c_cc[VEOL]) {
@@ -139,6 +140,7 @@ void TTYDevice::emit(uint8_t c) {
 	}
 
 	_input_buffer.push_back(c);
+	TaskManager::notify_io();
 
 	if(!(_termios.c_lflag & ICANON))
 		_buffer_blocker.set_ready(true);
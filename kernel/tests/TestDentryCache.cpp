@@ -0,0 +1,62 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later */
+/* Copyright © 2016-2023 Byteduck */
+
+#include "KernelTest.h"
+#include "../filesystem/DentryCache.h"
+
+KERNEL_TEST(dentry_cache_lookup) {
+	DentryCache cache;
+	uint32_t generation;
+	ENSURE(!cache.lookup(1, 2, "bin", generation));
+	cache.insert(1, 2, "bin", 12, generation);
+	cache.insert(1, 2, "nonexistent", 0, generation);
+
+	// Entries are keyed by the filesystem and directory as well as the name
+	ENSURE_EQ(cache.lookup(1, 2, "bin", generation).value(), (ino_t) 12);
+	ENSURE(!cache.lookup(1, 3, "bin", generation));
+	ENSURE(!cache.lookup(2, 2, "bin", generation));
+
+	// Names that don't exist are cached as inode 0
+	ENSURE_EQ(cache.lookup(1, 2, "nonexistent", generation).value(), (ino_t) 0);
+
+	auto stats = cache.stats();
+	ENSURE_EQ(stats.hits, 1);
+	ENSURE_EQ(stats.negative_hits, 1);
+	ENSURE_EQ(stats.misses, 3);
+	ENSURE_EQ(stats.entries, 2);
+}
+
+KERNEL_TEST(dentry_cache_invalidation) {
+	DentryCache cache;
+	uint32_t generation;
+	cache.lookup(1, 2, "file", generation);
+	cache.insert(1, 2, "file", 0, generation);
+	cache.insert(1, 2, "other", 13, generation);
+	cache.invalidate(1, 2, "file");
+	ENSURE(!cache.lookup(1, 2, "file", generation));
+	ENSURE(cache.lookup(1, 2, "other", generation));
+
+	// A lookup that raced with an invalidation shouldn't be cached, since it may have seen the old directory
+	uint32_t stale_generation;
+	cache.lookup(1, 2, "file", stale_generation);
+	cache.invalidate(1, 2, "file");
+	cache.insert(1, 2, "file", 0, stale_generation);
+	ENSURE(!cache.lookup(1, 2, "file", generation));
+
+	cache.invalidate_all();
+	ENSURE_EQ(cache.stats().entries, 0);
+}
+
+KERNEL_TEST(dentry_cache_size_bound) {
+	DentryCache cache;
+	uint32_t generation;
+	cache.lookup(1, 2, "", generation);
+	char name[12];
+	for(int i = 0; i < DENTRY_CACHE_MAX_ENTRIES * 2; i++)
+		cache.insert(1, 2, itoa(i, name, 10), i + 1, generation);
+	ENSURE_EQ(cache.stats().entries, DENTRY_CACHE_MAX_ENTRIES);
+
+	// The oldest entries should have been evicted first
+	ENSURE(!cache.lookup(1, 2, "0", generation));
+	ENSURE(cache.lookup(1, 2, itoa(DENTRY_CACHE_MAX_ENTRIES * 2 - 1, name, 10), generation));
+}
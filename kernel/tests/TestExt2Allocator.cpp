@@ -0,0 +1,36 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later */
+/* Copyright © 2016-2023 Byteduck */
+
+#include "KernelTest.h"
+#include "../filesystem/ext2/Ext2Filesystem.h"
+
+KERNEL_TEST(ext2_find_free_run) {
+	uint32_t bitmap[8];
+	memset(bitmap, 0xFF, sizeof(bitmap));
+	auto* bytes = (uint8_t*) bitmap;
+	for(size_t i = 40; i < 45; i++)
+		Ext2Filesystem::set_bitmap_bit(bytes, i, false);
+	for(size_t i = 100; i < 200; i++)
+		Ext2Filesystem::set_bitmap_bit(bytes, i, false);
+
+	// Full words should be skipped over to find the first run
+	size_t length;
+	ENSURE_EQ(Ext2Filesystem::find_free_run(bytes, 256, 0, 1000, length), 40);
+	ENSURE_EQ(length, 5);
+
+	// Runs can start partway through one, and span multiple words
+	ENSURE_EQ(Ext2Filesystem::find_free_run(bytes, 256, 42, 1000, length), 42);
+	ENSURE_EQ(length, 3);
+	ENSURE_EQ(Ext2Filesystem::find_free_run(bytes, 256, 45, 1000, length), 100);
+	ENSURE_EQ(length, 100);
+
+	// Runs shouldn't be longer than asked for, or go past the end of the bitmap
+	ENSURE_EQ(Ext2Filesystem::find_free_run(bytes, 256, 45, 10, length), 100);
+	ENSURE_EQ(length, 10);
+	ENSURE_EQ(Ext2Filesystem::find_free_run(bytes, 150, 45, 1000, length), 100);
+	ENSURE_EQ(length, 50);
+
+	// There's nothing free after the second run
+	ENSURE_EQ(Ext2Filesystem::find_free_run(bytes, 256, 200, 1000, length), 256);
+	ENSURE_EQ(length, 0);
+}
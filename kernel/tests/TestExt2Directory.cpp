@@ -0,0 +1,38 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later */
+/* Copyright © 2016-2023 Byteduck */
+
+#include "KernelTest.h"
+#include "../filesystem/ext2/Ext2.h"
+#include "../filesystem/ext2/Ext2DirectoryIndex.h"
+
+KERNEL_TEST(ext2_dx_hash) {
+	// These have to match what e2fsprogs computes (e.g. with debugfs's dx_hash command), since they're stored on disk
+	uint32_t seed[4] = {0, 0, 0, 0};
+	ENSURE_EQ(ext2_dx_hash("hello", 5, EXT2_DX_HASH_LEGACY, seed), 0x32252546u);
+	ENSURE_EQ(ext2_dx_hash("hello", 5, EXT2_DX_HASH_HALF_MD4, seed), 0x1746da32u);
+	ENSURE_EQ(ext2_dx_hash("hello", 5, EXT2_DX_HASH_TEA, seed), 0x6f5bb1a8u);
+
+	// Names longer than one round of the hash
+	const char* long_name = "averyveryverylongfilenamethatspansmorethan32bytes_xyz";
+	ENSURE_EQ(ext2_dx_hash(long_name, 53, EXT2_DX_HASH_HALF_MD4, seed), 0x44cf63f2u);
+	ENSURE_EQ(ext2_dx_hash(long_name, 53, EXT2_DX_HASH_TEA, seed), 0xdedb7d8eu);
+}
+
+KERNEL_TEST(ext2_directory_index) {
+	Ext2DirectoryIndex index;
+	for(uint32_t i = 0; i < 1000; i++)
+		index.insert(i % 100, i * 16);
+
+	// Every entry with a matching hash should be offered until one is accepted
+	size_t num_candidates = 0;
+	auto offset = index.find(42, [&](uint32_t candidate) {
+		num_candidates++;
+		return candidate == 842 * 16;
+	});
+	ENSURE_EQ(offset, 842u * 16);
+	ENSURE(num_candidates <= 10);
+
+	index.remove(42, 842 * 16);
+	ENSURE_EQ(index.find(42, [](uint32_t candidate) { return candidate == 842 * 16; }), Ext2DirectoryIndex::NO_OFFSET);
+	ENSURE_EQ(index.find(42, [](uint32_t candidate) { return candidate == 942 * 16; }), 942u * 16);
+}
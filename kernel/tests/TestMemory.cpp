@@ -2,6 +2,7 @@
 /* Copyright © 2016-2022 Byteduck */
 #include "KernelTest.h"
 #include "../memory/PageDirectory.h"
+#include "../memory/AnonymousVMObject.h"
 #include "../random.h"
 
 #define NUM_REGIONS 100
@@ -23,4 +24,30 @@ KERNEL_TEST(allocate_and_free_regions) {
 		regions[i].reset();
 		ENSURE(!MM.kernel_page_directory.is_mapped(start, true));
 	}
-}
\ No newline at end of file
+}
+KERNEL_TEST(lazy_anonymous_object) {
+	auto object = AnonymousVMObject::alloc(PAGE_SIZE * 1024, true).value();
+	ENSURE_EQ(object->physical_page(0).index(), 0);
+
+	// Reading an untouched page should back it with the shared zero page, and writing to it should replace it
+	ENSURE(object->try_fault_page(0, false).value());
+	ENSURE_EQ(object->physical_page(0).index(), MM.shared_zero_page());
+	ENSURE(object->page_is_cow(0));
+	ENSURE(object->try_cow_page(0).is_success());
+	ENSURE(object->physical_page(0).index() != MM.shared_zero_page());
+	ENSURE(!object->page_is_cow(0));
+
+	// Writing to an untouched page should back it with a page of its own right away
+	ENSURE(object->try_fault_page(1, true).value());
+	ENSURE(!object->try_fault_page(1, true).value());
+	ENSURE(object->physical_page(1).index() != MM.shared_zero_page());
+
+	// Mapping part of the object into the kernel should commit (and zero) only that part
+	auto region = MM.map_object(object, {PAGE_SIZE * 1022, PAGE_SIZE * 2});
+	bool zeroed = true;
+	for(size_t i = 0; i < region->size(); i++)
+		zeroed &= ((uint8_t*) region->start())[i] == 0;
+	ENSURE(zeroed);
+	ENSURE(object->physical_page(1023).index());
+	ENSURE_EQ(object->physical_page(2).index(), 0);
+}
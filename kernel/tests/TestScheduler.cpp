@@ -0,0 +1,78 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later */
+/* Copyright © 2016-2023 Byteduck */
+
+#include "KernelTest.h"
+#include "../tasking/TaskManager.h"
+#include "../tasking/SleepBlocker.h"
+#include "../tasking/BooleanBlocker.h"
+#include "../time/TimeManager.h"
+#include "../api/resource.h"
+
+KERNEL_TEST(sleep_wakeup) {
+	// Sleepers are woken by the timer, so make sure we wake up and don't wake before the deadline. How long we overslept
+	// is only reported, since it depends on how busy the host is when running under emulation.
+	for(int i = 0; i < 3; i++) {
+		SleepBlocker blocker(Time(0, 10000 * (i + 1)));
+		TaskManager::current_thread()->block(blocker);
+		auto now = Time::now();
+		ENSURE(!TaskManager::current_thread()->is_blocked());
+		ENSURE(now >= blocker.end_time());
+		auto oversleep = now - blocker.end_time();
+		KLog::info("sleep_wakeup", "Overslept %dms sleep by %dus", 10 * (i + 1), oversleep.sec() * 1000000 + oversleep.usec());
+	}
+}
+
+KERNEL_TEST(short_sleep_wakeup) {
+	// Sleeps shorter than a tick should be woken by the one-shot timer rather than waiting for the next tick. If they
+	// waited for the tick, each sleep after the first would start just after a tick and oversleep by most of a period.
+	const int num_sleeps = 20;
+	long total_oversleep = 0;
+	for(int i = 0; i < num_sleeps; i++) {
+		SleepBlocker blocker(Time(0, 250));
+		TaskManager::current_thread()->block(blocker);
+		auto now = Time::now();
+		ENSURE(!TaskManager::current_thread()->is_blocked());
+		ENSURE(now >= blocker.end_time());
+		auto oversleep = now - blocker.end_time();
+		total_oversleep += oversleep.sec() * 1000000 + oversleep.usec();
+	}
+	KLog::info("short_sleep_wakeup", "Average oversleep for 250us sleeps: %dus", total_oversleep / num_sleeps);
+	ENSURE(total_oversleep / num_sleeps < TimeManager::tick_period() / 2, "Short sleeps are woken before the next tick");
+}
+
+KERNEL_TEST(ready_blocker_doesnt_block) {
+	BooleanBlocker blocker;
+	blocker.set_ready(true);
+	TaskManager::current_thread()->block(blocker);
+	ENSURE(!TaskManager::current_thread()->is_blocked());
+}
+
+KERNEL_TEST(nice_priority_levels) {
+	auto* proc = TaskManager::current_process();
+	auto* thread = TaskManager::current_thread().get();
+	int old_nice = proc->nice();
+
+	// Lower nice values should never get a lower priority (higher level) than higher nice values
+	int last_level = -1;
+	for(int nice = PRIO_MIN; nice < PRIO_MAX; nice++) {
+		proc->set_nice(nice);
+		int level = TaskManager::base_priority_level(thread);
+		ENSURE(level >= last_level);
+		last_level = level;
+	}
+
+	proc->set_nice(PRIO_MIN);
+	ENSURE_EQ(TaskManager::base_priority_level(thread), 0);
+	proc->set_nice(old_nice);
+}
+
+KERNEL_TEST(fpu_state_survives_switch) {
+	// The first FPU instruction should fault in a clean FPU state, which should then be kept across context switches
+	volatile double value = 1.5;
+	double result = value * 3.0;
+	ENSURE(TaskManager::current_thread()->fpu_used);
+
+	SleepBlocker blocker(Time(0, 10000));
+	TaskManager::current_thread()->block(blocker);
+	ENSURE(result * value == 6.75);
+}
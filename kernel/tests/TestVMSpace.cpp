@@ -0,0 +1,51 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later */
+/* Copyright © 2016-2023 Byteduck */
+
+#include "KernelTest.h"
+#include "../memory/VMSpace.h"
+#include "../memory/AnonymousVMObject.h"
+#include "../time/TimeManager.h"
+#include "../time/Time.h"
+#include "../random.h"
+
+/** Maps the given number of single-page regions into a fresh space, and returns the average time per fault in ns. **/
+static long time_faults(size_t num_regions) {
+	// Declared before the regions so that the regions are unmapped before the space goes away
+	PageDirectory page_directory;
+	auto space = kstd::make_shared<VMSpace>(PAGE_SIZE, HIGHER_HALF - PAGE_SIZE, page_directory);
+	kstd::vector<kstd::Arc<VMRegion>> regions;
+	regions.reserve(num_regions);
+
+	for(size_t i = 0; i < num_regions; i++) {
+		auto object = AnonymousVMObject::alloc(PAGE_SIZE, true).value();
+		regions.push_back(space->map_object(object, VMProt::RW).value());
+	}
+
+	// Free every fourth region so the space isn't just one contiguous run of regions
+	for(size_t i = 0; i < num_regions; i += 4)
+		regions[i].reset();
+
+	// Read faults are backed by the zero page, so this is all lookup and mapping
+	bool all_faulted = true;
+	auto start = Time(TimeManager::precise_uptime());
+	for(size_t i = 0; i < num_regions; i++) {
+		auto& region = regions[rand() % num_regions];
+		if(region)
+			all_faulted &= space->try_pagefault({region->start(), 0, PageFault::Type::Read}).is_success();
+	}
+	auto elapsed = Time(TimeManager::precise_uptime()) - start;
+	ENSURE(all_faulted);
+
+	// Looking up a freed region should fail
+	ENSURE(space->get_region_containing(PAGE_SIZE).is_error());
+	ENSURE(!space->get_region_containing(regions[1]->start()).is_error());
+
+	auto elapsed_ns = (elapsed.sec() * 1000000LL + elapsed.usec()) * 1000LL;
+	return (long) (elapsed_ns / num_regions);
+}
+
+KERNEL_TEST(vmspace_region_faults) {
+	long ns_1k = time_faults(1000);
+	long ns_10k = time_faults(10000);
+	KLog::info("vmspace_region_faults", "1k regions: %dns/fault, 10k regions: %dns/fault", ns_1k, ns_10k);
+}
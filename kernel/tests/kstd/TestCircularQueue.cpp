@@ -0,0 +1,69 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later */
+/* Copyright © 2016-2023 Byteduck */
+
+#include "../KernelTest.h"
+#include "../../kstd/circular_queue.hpp"
+
+using kstd::circular_queue;
+
+KERNEL_TEST(circular_queue_push_pop) {
+	circular_queue<int> queue(4);
+	for(int i = 0; i < 4; i++)
+		ENSURE(queue.push_back(i));
+	ENSURE(!queue.push_back(4));
+	for(int i = 0; i < 4; i++)
+		ENSURE_EQ(queue.pop_front(), i);
+	ENSURE(queue.empty());
+}
+
+KERNEL_TEST(circular_queue_spans) {
+	circular_queue<uint8_t> queue(8);
+	size_t length;
+
+	// An empty queue has all of its space in one span
+	auto* back = queue.back_span(length);
+	ENSURE_EQ(length, 8);
+	for(int i = 0; i < 6; i++)
+		back[i] = i;
+	queue.commit_back(6);
+	ENSURE_EQ(queue.size(), 6);
+
+	// Consume some from the front so that the next write wraps around
+	auto* front = queue.front_span(length);
+	ENSURE_EQ(length, 6);
+	ENSURE_EQ(front[0], 0);
+	queue.drop_front(4);
+
+	back = queue.back_span(length);
+	ENSURE_EQ(length, 2);
+	back[0] = 6;
+	back[1] = 7;
+	queue.commit_back(2);
+	back = queue.back_span(length);
+	ENSURE_EQ(length, 4);
+	for(int i = 0; i < 4; i++)
+		back[i] = 8 + i;
+	queue.commit_back(4);
+	ENSURE_EQ(queue.size(), 8);
+
+	// Reading it back out should take two spans
+	front = queue.front_span(length);
+	ENSURE_EQ(length, 4);
+	for(size_t i = 0; i < length; i++)
+		ENSURE_EQ(front[i], 4 + i);
+	queue.drop_front(length);
+	front = queue.front_span(length);
+	ENSURE_EQ(length, 4);
+	for(size_t i = 0; i < length; i++)
+		ENSURE_EQ(front[i], 8 + i);
+	queue.drop_front(length);
+	ENSURE(queue.empty());
+
+	// Mixing single elements with spans should keep them in order
+	ENSURE(queue.push_back(42));
+	back = queue.back_span(length);
+	back[0] = 43;
+	queue.commit_back(1);
+	ENSURE_EQ(queue.pop_front(), 42);
+	ENSURE_EQ(queue.pop_front(), 43);
+}
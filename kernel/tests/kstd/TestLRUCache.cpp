@@ -0,0 +1,166 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later */
+/* Copyright © 2016-2023 Byteduck */
+
+#include "../KernelTest.h"
+#include <kernel/kstd/LRUCache.h>
+#include <kernel/random.h>
+
+static int lru_num_constructed = 0;
+static int lru_num_destructed = 0;
+
+class LRUTestValue {
+public:
+	LRUTestValue() {
+		lru_num_constructed++;
+	}
+	LRUTestValue(const LRUTestValue&) {
+		lru_num_constructed++;
+	}
+	~LRUTestValue() {
+		lru_num_destructed++;
+	}
+};
+
+using IntCache = kstd::LRUCache<size_t, int>;
+
+KERNEL_TEST(lru_cache_insert_get) {
+	IntCache cache;
+	for(size_t i = 0; i < 1000; i++)
+		cache.insert(i * 8, (int) i);
+	ENSURE_EQ(cache.size(), 1000);
+	for(size_t i = 0; i < 1000; i++) {
+		auto value = cache.find(i * 8);
+		ENSURE(value);
+		if(value)
+			ENSURE_EQ(*value, (int) i);
+	}
+	ENSURE(!cache.find(1));
+	ENSURE(!cache.get(8000));
+
+	// Replacing a value shouldn't add a new item
+	cache.insert(0, 1234);
+	ENSURE_EQ(cache.size(), 1000);
+	ENSURE_EQ(cache.get(0).value(), 1234);
+}
+
+KERNEL_TEST(lru_cache_eviction_order) {
+	IntCache cache;
+	for(size_t i = 0; i < 100; i++)
+		cache.insert(i, (int) i);
+	ENSURE_EQ(cache.lru_unsafe().first, 0);
+
+	// Using 0 and 1 should make 2 the least recently used item
+	cache.get(0);
+	cache.promote(1);
+	ENSURE_EQ(cache.lru_unsafe().first, 2);
+
+	// Pruning should remove items in order of use
+	cache.prune(98);
+	ENSURE_EQ(cache.size(), 2);
+	ENSURE_EQ(cache.lru_unsafe().first, 0);
+	ENSURE(!cache.find(99));
+	cache.prune(1);
+	ENSURE_EQ(cache.lru_unsafe().first, 1);
+	cache.prune(5);
+	ENSURE(cache.empty());
+	ENSURE(!cache.lru());
+}
+
+KERNEL_TEST(lru_cache_lru_matching) {
+	IntCache cache;
+	for(size_t i = 0; i < 100; i++)
+		cache.insert(i, (int) i);
+
+	// The oldest item that matches should be found, and finding it shouldn't promote it. The ones skipped should be.
+	auto odd = cache.lru_matching([](int value) { return value % 2 == 1; });
+	ENSURE(odd);
+	if(odd)
+		ENSURE_EQ(odd.value().first, 1);
+	ENSURE_EQ(cache.lru_unsafe().first, 1);
+	cache.promote(1);
+	auto next_odd = cache.lru_matching([](int value) { return value % 2 == 1; });
+	ENSURE(next_odd);
+	if(next_odd)
+		ENSURE_EQ(next_odd.value().first, 3);
+
+	// If nothing matches, every item is skipped over once and the order stays the same
+	ENSURE(!cache.lru_matching([](int value) { return value >= 100; }));
+	ENSURE_EQ(cache.size(), 100);
+	ENSURE_EQ(cache.lru_unsafe().first, 3);
+}
+
+KERNEL_TEST(lru_cache_erase) {
+	IntCache cache;
+	for(size_t i = 0; i < 1000; i++)
+		cache.insert(i, (int) i);
+	for(size_t i = 0; i < 1000; i += 2)
+		cache.erase(i);
+	cache.erase(5000);
+	ENSURE_EQ(cache.size(), 500);
+	for(size_t i = 0; i < 1000; i++)
+		ENSURE_EQ(!!cache.find(i), i % 2 == 1);
+
+	// The LRU list should have been kept intact
+	ENSURE_EQ(cache.lru_unsafe().first, 1);
+	cache.prune(499);
+	ENSURE_EQ(cache.lru_unsafe().first, 999);
+}
+
+KERNEL_TEST(lru_cache_constructors_destructors) {
+	lru_num_constructed = 0;
+	lru_num_destructed = 0;
+	{
+		kstd::LRUCache<int, LRUTestValue> cache;
+		for(int i = 0; i < 1000; i++)
+			cache.insert(i, LRUTestValue());
+		for(int i = 0; i < 1000; i += 2)
+			cache.erase(i);
+		cache.prune(100);
+		for(int i = 0; i < 1000; i++)
+			cache.insert(i, LRUTestValue());
+	}
+	ENSURE_EQ(lru_num_constructed, lru_num_destructed);
+}
+
+/** A cache key that counts how many times it's compared, which is how many entries the cache had to look at. **/
+static size_t lru_num_comparisons = 0;
+
+struct CountedKey {
+	size_t value;
+	bool operator==(const CountedKey& other) const {
+		lru_num_comparisons++;
+		return value == other.value;
+	}
+};
+
+template<>
+inline uint32_t kstd::hash(const CountedKey& key) {
+	return kstd::hash(key.value);
+}
+
+/** Runs a mix of cache operations on a cache of the given size and returns the average number of keys compared per op. **/
+static size_t count_lru_comparisons(size_t num_entries) {
+	kstd::LRUCache<CountedKey, int> cache;
+	lru_num_comparisons = 0;
+
+	for(size_t i = 0; i < num_entries; i++)
+		cache.insert({i * 8}, (int) i);
+	for(size_t i = 0; i < num_entries; i++)
+		cache.find({(rand() % num_entries) * 8});
+	for(size_t i = 0; i < num_entries / 2; i++)
+		cache.erase({(rand() % num_entries) * 8});
+	for(size_t i = 0; i < num_entries / 2; i++) {
+		cache.prune(1);
+		cache.insert({(num_entries + i) * 8}, (int) i);
+	}
+
+	return lru_num_comparisons / (num_entries * 3);
+}
+
+KERNEL_TEST(lru_cache_performance) {
+	// Operations are O(1), so sixteen times as many entries shouldn't make each one look at many more of them
+	size_t small = count_lru_comparisons(8000);
+	size_t large = count_lru_comparisons(128000);
+	KLog::info("lru_cache_performance", "8k entries: %d comparisons/op, 128k entries: %d comparisons/op", small, large);
+	ENSURE(large <= max(small, (size_t) 1) * 4, "LRU cache operations scale with the number of entries");
+}
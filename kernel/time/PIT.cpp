@@ -20,28 +20,38 @@
 #include <kernel/kstd/kstddef.h>
 #include <kernel/time/PIT.h>
 #include <kernel/IO.h>
+#include <kernel/kstd/kstdlib.h>
 #include "TimeManager.h"
 
 PIT::PIT(TimeManager* manager): TimeKeeper(manager), IRQHandler(PIT_IRQ) {
-	auto divisor = (uint16_t)(1193180u / PIT_FREQUENCY);
+	// Stop whatever periodic interrupt the BIOS left running until we're asked for one
+	disarm();
+}
 
-	uint8_t ocw = 0;
-	ocw = (ocw & ~0xEu) | 0x6u;
-	ocw = (ocw & ~0x30u) | 0x30u;
-	ocw = (ocw & ~0xC0u) | 0u;
-	IO::outb(PIT_CMD, ocw);
+void PIT::arm_oneshot(long micros) {
+	micros = max(min(micros, (long) PIT_MAX_ONESHOT_MICROS), 1L);
+	auto count = (uint16_t) max(((uint64_t) micros * PIT_BASE_FREQUENCY) / 1000000, (uint64_t) 1);
+	m_periodic = false;
+	IO::outb(PIT_CMD, PIT_CMD_ONESHOT);
+	write(count & 0xffu, 0);
+	write((count >> 8u) & 0xffu, 0);
+}
 
-	// set frequency rate
-	write(divisor & 0xffu, 0);
-	write((divisor >> 8u) & 0xffu, 0);
+void PIT::disarm() {
+	// Writing the command without a count stops the counter until one is written
+	m_periodic = false;
+	IO::outb(PIT_CMD, PIT_CMD_ONESHOT);
 }
 
 void PIT::handle_irq(Registers* regs) {
-	TimeKeeper::tick();
+	if(m_periodic)
+		TimeKeeper::tick();
+	else
+		TimeKeeper::deadline();
 }
 
 bool PIT::mark_in_irq() {
-	return false;
+	return true;
 }
 
 int PIT::frequency() {
@@ -49,11 +59,15 @@ int PIT::frequency() {
 }
 
 void PIT::enable() {
-	//TODO
+	auto divisor = (uint16_t)(PIT_BASE_FREQUENCY / PIT_FREQUENCY);
+	m_periodic = true;
+	IO::outb(PIT_CMD, PIT_CMD_PERIODIC);
+	write(divisor & 0xffu, 0);
+	write((divisor >> 8u) & 0xffu, 0);
 }
 
 void PIT::disable() {
-	//TODO
+	disarm();
 }
 
 void PIT::write(uint16_t data, uint8_t counter){
@@ -25,6 +25,10 @@
 #define PIT_CMD  0x43
 #define PIT_IRQ 0
 #define PIT_FREQUENCY 1000 //Hz
+#define PIT_BASE_FREQUENCY 1193182 //Hz
+#define PIT_CMD_ONESHOT 0x30 // Counter 0, lobyte/hibyte, mode 0 (interrupt on terminal count)
+#define PIT_CMD_PERIODIC 0x36 // Counter 0, lobyte/hibyte, mode 3 (square wave)
+#define PIT_MAX_ONESHOT_MICROS 54000
 
 #include <kernel/interrupt/IRQHandler.h>
 #include "TimeKeeper.h"
@@ -34,6 +38,16 @@ public:
 	///PIT
 	PIT(TimeManager* manager);
 
+	/**
+	 * Switches the PIT to one-shot mode (if it isn't already) and fires a single interrupt after the given amount of
+	 * time, which tells the TimeManager that its deadline has passed.
+	 * @param micros The number of microseconds from now, clamped to between 1 and PIT_MAX_ONESHOT_MICROS.
+	 */
+	void arm_oneshot(long micros);
+
+	/** Cancels a pending one-shot interrupt. **/
+	void disarm();
+
 	///IRQHandler
 	void handle_irq(Registers* regs) override;
 	bool mark_in_irq() override;
@@ -45,4 +59,6 @@ public:
 
 private:
 	static void write(uint16_t data, uint8_t counter);
+
+	bool m_periodic = false;
 };
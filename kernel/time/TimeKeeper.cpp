@@ -27,3 +27,7 @@ TimeKeeper::TimeKeeper(TimeManager* time): _manager(time) {
 void TimeKeeper::tick() {
 	_manager->tick();
 }
+
+void TimeKeeper::deadline() {
+	_manager->deadline();
+}
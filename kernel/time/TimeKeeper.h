@@ -31,6 +31,8 @@ public:
 
 protected:
 	void tick();
+	/** Tells the TimeManager that a one-shot deadline it asked for has passed. **/
+	void deadline();
 
 private:
 	TimeManager* _manager;
@@ -22,6 +22,7 @@
 #include "PIT.h"
 #include "RTC.h"
 #include <kernel/kstd/KLog.h>
+#include <kernel/kstd/kstdlib.h>
 
 TimeManager* TimeManager::_inst = nullptr;
 
@@ -42,7 +43,7 @@ void TimeManager::init() {
 	_inst->_keeper->enable();
 }
 
-TimeManager::TimeManager(): _keeper(new RTC(this)) {
+TimeManager::TimeManager(): _keeper(new RTC(this)), _deadline_timer(new PIT(this)) {
 	// Measure the tsc speed in MHz for accurate time measurement by using the PIT.
 	_boot_epoch = RTC::timestamp();
 	measure_tsc_speed();
@@ -55,13 +56,21 @@ TimeManager& TimeManager::inst() {
 }
 
 timespec TimeManager::uptime() {
-	if(!_inst)
+	return precise_uptime();
+}
+
+timespec TimeManager::precise_uptime() {
+	if(!_inst || !_inst->_tsc_speed)
 		return {0, 0};
-	return _inst->_uptime;
+	auto uptime_us = (read_tsc() - initial_tsc) / _inst->_tsc_speed;
+	return {(long) (uptime_us / 1000000), (long) (uptime_us % 1000000)};
 }
 
 timespec TimeManager::now() {
-	return _inst->_epoch;
+	if(!_inst)
+		return {0, 0};
+	auto uptime = precise_uptime();
+	return {(long) (_inst->_boot_epoch + uptime.tv_sec), uptime.tv_usec};
 }
 
 void TimeManager::tick() {
@@ -71,12 +80,74 @@ void TimeManager::tick() {
 		idle_ticks.pop_front();
 	idle_ticks.push_back(TaskManager::is_idle());
 	TaskManager::tick();
+}
+
+void TimeManager::deadline() {
+	_deadline_armed = false;
+	TaskManager::timer_deadline();
+}
+
+void TimeManager::arm_deadline(Time deadline) {
+	if(_inst)
+		_inst->do_arm_deadline(deadline);
+}
+
+void TimeManager::do_arm_deadline(Time deadline) {
+	auto now = Time::now();
+	long micros = 0;
+	if(deadline > now) {
+		auto until = deadline - now;
+		micros = until.sec() ? PIT_MAX_ONESHOT_MICROS : until.usec();
+	}
+
+	// The periodic tick will take care of anything that isn't due before the next tick
+	if(!_tick_stopped && micros >= 1000000 / _keeper->frequency())
+		return;
+
+	micros = max(min(micros, (long) PIT_MAX_ONESHOT_MICROS), 1L);
+	auto fire_time = now + Time(0, micros);
+	if(_deadline_armed && _armed_deadline <= fire_time)
+		return;
+	_deadline_armed = true;
+	_armed_deadline = fire_time;
+	_deadline_timer->arm_oneshot(micros);
+}
+
+void TimeManager::idle_wait() {
+	TaskManager::enter_critical();
+	if(_inst && !_inst->_tick_stopped && TaskManager::can_stop_tick()) {
+		_inst->_keeper->disable();
+		_inst->_tick_stopped = true;
+		_inst->_tick_stopped_tsc = read_tsc();
+		_inst->do_arm_deadline(TaskManager::next_wake_time());
+	}
+	TaskManager::leave_critical_and_halt();
+
+	TaskManager::enter_critical();
+	resume_tick();
+	TaskManager::leave_critical();
+}
+
+void TimeManager::resume_tick() {
+	if(!_inst || !_inst->_tick_stopped)
+		return;
+	auto& inst = *_inst;
+	inst._tick_stopped = false;
+
+	// Account for the ticks we skipped, which were all idle
+	auto idle_micros = (read_tsc() - inst._tick_stopped_tsc) / inst._tsc_speed;
+	auto skipped_ticks = min(idle_micros * inst._keeper->frequency() / 1000000, (uint64_t) 100);
+	for(uint64_t i = 0; i < skipped_ticks; i++) {
+		if(inst.idle_ticks.size() == 100)
+			inst.idle_ticks.pop_front();
+		inst.idle_ticks.push_back(true);
+	}
+
+	inst._keeper->enable();
+}
 
-	auto uptime_us = (read_tsc() - initial_tsc) / _tsc_speed;
-	_uptime.tv_usec = (long) (uptime_us % 1000000);
-	_uptime.tv_sec = (long) (uptime_us / 1000000);
-	_epoch.tv_sec = _boot_epoch + _uptime.tv_sec;
-	_epoch.tv_usec = _uptime.tv_usec;
+long TimeManager::tick_period() {
+	return 1000000 / _inst->_keeper->frequency();
 }
 
 double TimeManager::percent_idle() {
@@ -21,28 +21,57 @@
 
 #include <kernel/kstd/unix_types.h>
 #include "TimeKeeper.h"
+#include "Time.h"
 #include <kernel/kstd/circular_queue.hpp>
 
+class PIT;
+
 class TimeManager {
 public:
 	static void init();
 	static TimeManager& inst();
 
 	static timespec uptime();
+	/** Returns the uptime as read from the TSC. Since the tick may be stopped while idle, this is the same as uptime(). **/
+	static timespec precise_uptime();
+	/** Returns the current time as read from the TSC. **/
 	static timespec now();
 	static double percent_idle();
+	/** Returns the period of the periodic tick in microseconds. **/
+	static long tick_period();
+
+	/**
+	 * Makes sure the CPU is interrupted at (or shortly after) the given time. If the periodic tick won't come soon
+	 * enough, a one-shot timer is armed. Must be called with interrupts disabled.
+	 */
+	static void arm_deadline(Time deadline);
+
+	/**
+	 * Halts the CPU until the next interrupt. If nothing needs the periodic tick, it's stopped until we wake up, and a
+	 * one-shot timer is armed for the next sleeping thread's deadline instead. Called by the idle thread.
+	 */
+	static void idle_wait();
+
+	/** Restarts the periodic tick if idle_wait() stopped it. Must be called with interrupts disabled. **/
+	static void resume_tick();
 
 protected:
 	friend class TimeKeeper;
 	void tick();
+	void deadline();
 
 private:
 	TimeManager();
 
+	void do_arm_deadline(Time deadline);
+
 	static TimeManager* _inst;
 	TimeKeeper* _keeper = nullptr;
-	timespec _epoch = {0, 0};
-	timespec _uptime = {0, 0};
+	PIT* _deadline_timer = nullptr;
+	bool _deadline_armed = false;
+	Time _armed_deadline;
+	bool _tick_stopped = false;
+	uint64_t _tick_stopped_tsc = 0;
 	int _ticks = 0;
 	time_t _boot_epoch = 0;
 	uint64_t _tsc_speed = 0; // Measured in MHz
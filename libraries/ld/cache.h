@@ -0,0 +1,47 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later */
+/* Copyright © 2016-2023 Byteduck */
+
+#pragma once
+
+#include <stdint.h>
+
+#define LD_CACHE_PATH "/etc/ld.cache"
+#define LD_CACHE_MAGIC 0x4843444c // 'LDCH'
+#define LD_CACHE_VERSION 1
+#define LD_CACHE_NONE 0xffffffff
+
+/*
+ * The layout of /etc/ld.cache, which is generated by ldconfig. All offsets are from the start of the file, and all
+ * strings are offsets into the string table.
+ *
+ * The cache records where each library in the default search path lives so that ld doesn't have to search for it, and
+ * which library defines each of the symbols it imports. A resolution is only recorded if exactly one library in the
+ * cache defines the symbol, so it's the same no matter what order the libraries end up being loaded in.
+ */
+
+typedef struct {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t num_libraries;
+	uint32_t libraries_offset;
+	uint32_t num_resolutions;
+	uint32_t resolutions_offset;
+	uint32_t strings_size;
+	uint32_t strings_offset;
+} ld_cache_header;
+
+typedef struct {
+	uint32_t name;					// The name that DT_NEEDED refers to the library by
+	uint32_t path;					// The path find_library would find the library at
+	uint32_t inode;
+	uint32_t size;
+	int64_t mtime;
+	uint32_t first_resolution;		// Resolutions for a library are contiguous and sorted by symbol index
+	uint32_t num_resolutions;
+} ld_cache_library;
+
+typedef struct {
+	uint32_t symbol_index;			// The index of the undefined symbol in the importing library's symbol table
+	uint32_t library;				// The index of the library that defines the symbol
+	uint32_t value;					// The value of the symbol in the defining library, relative to its load address
+} ld_cache_resolution;
@@ -25,19 +25,27 @@
 #include <cstring>
 #include <cstdlib>
 #include <map>
+#include <algorithm>
 #include <libduck/Log.h>
+#include <libduck/Time.h>
 #include <sys/mman.h>
 
-using Duck::Log;
+using Duck::Log, Duck::Time;
 
-std::unordered_map<std::string, uintptr_t> global_symbols;
-std::unordered_map<std::string, uintptr_t> symbols;
 std::map<std::string, Object*> objects;
+std::vector<Object*> symbol_scope; // The executable followed by its dependencies in breadth-first order
 size_t current_brk = 0;
 bool debug = false;
+bool bind_now = false;
+size_t num_lazy_relocations = 0;
+size_t num_cached_resolutions = 0;
+ld_cache_header* cache = nullptr;
+std::vector<Object*> cache_objects; // The loaded object for each library in the cache, if any
+bool use_cached_resolutions = false;
 Object* executable;
 
 extern "C" [[noreturn]] void call_main(int argc, char** argv, char** envp, main_t main);
+extern "C" void resolve_plt_trampoline();
 
 int main(int argc, char** argv, char** envp) {
 	if(argc < 2) {
@@ -45,6 +53,11 @@ int main(int argc, char** argv, char** envp) {
 		return -1;
 	}
 
+	debug = getenv("LD_DEBUG");
+	bind_now = getenv("LD_BIND_NOW");
+	auto start_time = Time::now();
+	open_cache();
+
 	executable = new Object();
 	objects[std::string(argv[1])] = executable;
 
@@ -70,32 +83,39 @@ int main(int argc, char** argv, char** envp) {
 	if(executable->load(argv[1], true) < 0)
 		return errno;
 
-	//Read the symbols from the libraries and executable
-	auto rev_it = objects.rbegin();
-	while(rev_it != objects.rend()) {
-		auto* object = rev_it->second;
-		object->read_symbols();
-		rev_it++;
+	//Build the symbol lookup scope
+	symbol_scope.push_back(executable);
+	for(size_t i = 0; i < symbol_scope.size(); i++) {
+		for(auto& library_name : symbol_scope[i]->required_libraries) {
+			auto object_it = objects.find(library_name);
+			if(object_it == objects.end() || !object_it->second->loaded)
+				continue;
+			if(std::find(symbol_scope.begin(), symbol_scope.end(), object_it->second) == symbol_scope.end())
+				symbol_scope.push_back(object_it->second);
+		}
 	}
 
-	//Relocate the libraries and executable
-	rev_it = objects.rbegin();
-	while(rev_it != objects.rend()) {
-		auto* object = rev_it->second;
-		object->relocate();
-		object->mprotect_sections();
-		rev_it++;
+	//Cached resolutions are only valid if every library we're using was found in the cache and is up to date
+	use_cached_resolutions = cache && std::all_of(symbol_scope.begin() + 1, symbol_scope.end(), [](Object* object) {
+		return object->cache_entry != nullptr;
+	});
+	auto load_time = Time::now();
+
+	//Relocate the libraries and executable, dependencies first
+	for(auto it = symbol_scope.rbegin(); it != symbol_scope.rend(); it++) {
+		(*it)->relocate();
+		(*it)->mprotect_sections();
 	}
+	auto relocate_time = Time::now();
 
 	//Call __init_stdio for libc.so before any other initializer
-	if(symbols["__init_stdio"] != 0) {
-		((void(*)()) symbols["__init_stdio"])();
-	}
+	auto init_stdio = find_symbol("__init_stdio");
+	if(init_stdio)
+		((void(*)()) init_stdio)();
 
 	//Call the initializer methods for the libraries and executable
-	rev_it = objects.rbegin();
-	while(rev_it != objects.rend()) {
-		auto* object = rev_it->second;
+	for(auto it = symbol_scope.rbegin(); it != symbol_scope.rend(); it++) {
+		auto* object = *it;
 
 		if(object->init_func) {
 			if(debug)
@@ -110,12 +130,15 @@ int main(int argc, char** argv, char** envp) {
 				object->init_array[i]();
 			}
 		}
-
-		rev_it++;
 	}
 
-	if(debug)
+	if(debug) {
+		auto init_time = Time::now();
+		Log::dbgf("Loaded {} objects in {}us, relocated in {}us ({} PLT slots deferred, {} symbols from cache), initialized in {}us",
+				  symbol_scope.size(), (load_time - start_time).micros(), (relocate_time - load_time).micros(),
+				  num_lazy_relocations, num_cached_resolutions, (init_time - relocate_time).micros());
 		Log::dbgf("Calling entry point for {} {#x}", executable->name, (size_t) executable->entry);
+	}
 
 	// Finally, jump to the executable's entry point!
 	executable->entry(argc - 2, argv + 2, envp);
@@ -177,12 +200,6 @@ int Object::load(char* name_cstr, bool is_main_executable) {
 	// Read the dynamic table
 	read_dynamic_table();
 
-	//Read the copy relocations of the main executable
-	if(is_main_executable && read_copy_relocations() < 0) {
-		Log::err("Failed to read copy relocations of ", name_cstr, ": ", strerror(errno));
-		return -1;
-	}
-
 	//Load the required libraries
 	for(auto& library_name : required_libraries) {
 		//Open the library
@@ -209,17 +226,34 @@ Object* Object::open_library(char* library_name) {
 		return objects[library_name];
 	}
 
-	//Find the library
-	auto library_loc = find_library(library_name);
-	if(library_loc.empty())
-		return nullptr;
-
-	//Open the library
-	int fd = open(library_loc.c_str(), O_RDONLY);
-	if(fd < 0)
-		return nullptr;
+	//If the library is in the cache, try opening it where it was when the cache was generated
+	int fd = -1;
 	struct stat statbuf;
-	fstat(fd, &statbuf);
+	auto* cache_entry = find_cached_library(library_name);
+	if(cache_entry) {
+		fd = open(cache_string(cache_entry->path), O_RDONLY);
+		if(fd >= 0 && (fstat(fd, &statbuf) < 0 || statbuf.st_ino != cache_entry->inode ||
+					   (size_t) statbuf.st_size != cache_entry->size || statbuf.st_mtime != cache_entry->mtime)) {
+			if(debug)
+				Log::dbgf("ld: Cache entry for {} is stale", library_name);
+			close(fd);
+			fd = -1;
+		}
+		if(fd < 0)
+			cache_entry = nullptr;
+	}
+
+	//Otherwise, find and open the library
+	if(fd < 0) {
+		auto library_loc = find_library(library_name);
+		if(library_loc.empty())
+			return nullptr;
+		fd = open(library_loc.c_str(), O_RDONLY);
+		if(fd < 0)
+			return nullptr;
+		fstat(fd, &statbuf);
+	}
+
 	size_t mapped_size = ((statbuf.st_size + PAGE_SIZE - 1) / PAGE_SIZE) * PAGE_SIZE;
 	auto* mapped_file = mmap(nullptr, mapped_size, PROT_READ, MAP_SHARED, fd, 0);
 	if(mapped_file == MAP_FAILED) {
@@ -234,6 +268,9 @@ Object* Object::open_library(char* library_name) {
 	object->name = library_name;
 	object->mapped_file = (uint8_t*) mapped_file;
 	object->mapped_size = mapped_size;
+	object->cache_entry = cache_entry;
+	if(cache_entry)
+		cache_objects[cache_entry - cache_libraries()] = object;
 
 	return object;
 }
@@ -301,6 +338,26 @@ void Object::read_dynamic_table() {
 				symbol_table_size = hash[1];
 				break;
 
+			case DT_GNU_HASH:
+				gnu_hash = (uint32_t*) (memloc + dynamic.d_val);
+				break;
+
+			case DT_PLTGOT:
+				plt_got = (uintptr_t*) (memloc + dynamic.d_val);
+				break;
+
+			case DT_JMPREL:
+				plt_relocations = (elf32_rel*) (memloc + dynamic.d_val);
+				break;
+
+			case DT_PLTRELSZ:
+				plt_relocations_size = dynamic.d_val;
+				break;
+
+			case DT_PLTREL:
+				plt_is_rel = dynamic.d_val == DT_REL;
+				break;
+
 			case DT_STRTAB:
 				string_table = (char*) (memloc + dynamic.d_val);
 				break;
@@ -342,29 +399,37 @@ int Object::load_sections() {
 		if(pheader.p_type != PT_LOAD)
 			continue;
 
-		// Allocate memory for the section
 		size_t vaddr_mod = pheader.p_vaddr % PAGE_SIZE;
 		size_t round_memloc = memloc + pheader.p_vaddr - vaddr_mod;
 		size_t round_size = ((pheader.p_memsz + vaddr_mod + PAGE_SIZE - 1) / PAGE_SIZE) * PAGE_SIZE;
-		if(mmap((void*) round_memloc, round_size, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_FIXED, 0, 0) == MAP_FAILED)
-			Duck::Log::errf("ld: Failed to allocate memory for section at {#x}->{#x}: {}", pheader.p_vaddr, pheader.p_vaddr + pheader.p_memsz, strerror(errno));
-		lseek(fd, pheader.p_offset, SEEK_SET);
-		read(fd, (void*) (memloc + pheader.p_vaddr), pheader.p_filesz);
-
-		// Map the section into memory
-		// TODO: Why is this slower?
-//		size_t round_offset = pheader.p_offset - vaddr_mod;
-//		size_t round_filesz = ((pheader.p_filesz + vaddr_mod + PAGE_SIZE - 1) / PAGE_SIZE) * PAGE_SIZE;
-//		if(mmap((void*) round_memloc, round_filesz, PROT_READ | PROT_WRITE, MAP_FIXED | MAP_PRIVATE, fd, round_offset) == MAP_FAILED)
-//			Duck::Log::errf("ld: Failed to allocate memory for section at {#x}->{#x}: {}", pheader.p_vaddr, pheader.p_vaddr + pheader.p_memsz, strerror(errno));
-//		if(pheader.p_memsz != pheader.p_filesz)
-//			if(mmap((void*) (round_memloc + round_filesz), round_size - round_filesz, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_FIXED, 0, 0) == MAP_FAILED)
-//				Duck::Log::errf("ld: Failed to allocate memory for section at {#x}->{#x}: {}", pheader.p_vaddr, pheader.p_vaddr + pheader.p_memsz, strerror(errno));
+		size_t file_end = vaddr_mod + pheader.p_filesz;
+
+		// Map the pages of the section backed by the file privately, so that the pages we don't write to (i.e. text) are
+		// shared with the page cache. If the section is followed by bss, its last partial page has to be zero-filled.
+		size_t mapped_size = 0;
+		if(pheader.p_filesz && pheader.p_offset % PAGE_SIZE == vaddr_mod) {
+			if(pheader.p_memsz > pheader.p_filesz)
+				mapped_size = (file_end / PAGE_SIZE) * PAGE_SIZE;
+			else
+				mapped_size = ((file_end + PAGE_SIZE - 1) / PAGE_SIZE) * PAGE_SIZE;
+		}
+		if(mapped_size && mmap((void*) round_memloc, mapped_size, PROT_READ | PROT_WRITE, MAP_FIXED | MAP_PRIVATE, fd, pheader.p_offset - vaddr_mod) == MAP_FAILED) {
+			Duck::Log::errf("ld: Failed to map section at {#x}->{#x}: {}", pheader.p_vaddr, pheader.p_vaddr + pheader.p_memsz, strerror(errno));
+			return -1;
+		}
+		if(mapped_size >= round_size)
+			continue;
 
-		// Zero out the remaining bytes
-		size_t bytes_left = pheader.p_memsz - pheader.p_filesz;
-		if(bytes_left)
-			memset((void*) (memloc + pheader.p_vaddr + pheader.p_filesz), 0, bytes_left);
+		// Allocate anonymous memory for the rest of the section and read in whatever part of the file is in it
+		if(mmap((void*) (round_memloc + mapped_size), round_size - mapped_size, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_FIXED, 0, 0) == MAP_FAILED) {
+			Duck::Log::errf("ld: Failed to allocate memory for section at {#x}->{#x}: {}", pheader.p_vaddr, pheader.p_vaddr + pheader.p_memsz, strerror(errno));
+			return -1;
+		}
+		size_t read_start = std::max(vaddr_mod, mapped_size);
+		if(file_end > read_start) {
+			lseek(fd, pheader.p_offset + (read_start - vaddr_mod), SEEK_SET);
+			read(fd, (void*) (round_memloc + read_start), file_end - read_start);
+		}
 	}
 
 	return 0;
@@ -385,37 +450,10 @@ void Object::mprotect_sections() {
 	}
 }
 
-int Object::read_copy_relocations() {
-	//In the relocation table, find all of the copy relocations (ELF32_R_TYPE == STT_COMMON) and put them in the global symbols
-	for(auto& shdr : sheaders) {
-		if(shdr.sh_type != SHT_REL)
-			continue;
-		auto* rel_table = (elf32_rel*) (shdr.sh_addr + memloc);
-		for(size_t i = 0; i < shdr.sh_size / sizeof(elf32_rel); i++) {
-			auto& rel = rel_table[i];
-			if(ELF32_R_TYPE(rel.r_info) == R_386_COPY) {
-				auto& symbol = symbol_table[ELF32_R_SYM(rel.r_info)];
-				auto* symbol_name = (char*)((uintptr_t)string_table + symbol.st_name);
-				global_symbols[symbol_name] = rel.r_offset;
-			}
-		}
-	}
-	return 0;
-}
-
-int Object::read_symbols() {
-	//Put all the symbols into the symbols map if they aren't there already
-	for(size_t i = 0; i < symbol_table_size; i++) {
-		auto* symbol = &symbol_table[i];
-		char* symbol_name = (char*)((uintptr_t) string_table + symbol->st_name);
-		if(symbol->st_shndx && symbols.find(symbol_name) == symbols.end()) {
-			symbols[symbol_name] = symbol->st_value + memloc;
-		}
-	}
-	return 0;
-}
-
 int Object::relocate() {
+	// We can only bind PLT slots lazily if we know where the GOT is so that we can install the resolver in it
+	bool lazy_plt = !bind_now && plt_got && plt_relocations && plt_is_rel;
+
 	//Relocate the symbols
 	for(auto& shdr : sheaders) {
 		if(shdr.sh_type != SHT_REL)
@@ -425,40 +463,36 @@ int Object::relocate() {
 			auto& rel = rel_table[i];
 			uint8_t rel_type = ELF32_R_TYPE(rel.r_info);
 			uint32_t rel_symbol = ELF32_R_SYM(rel.r_info);
+			auto* reloc_loc = (void*) (memloc + rel.r_offset);
 
 			if(rel_type == R_386_NONE)
 				continue;
 
+			//The slot points back into the PLT at link time, so it just needs to be rebased to go to the resolver
+			if(rel_type == R_386_JMP_SLOT && lazy_plt) {
+				*((uintptr_t*) reloc_loc) += memloc;
+				num_lazy_relocations++;
+				continue;
+			}
+
 			auto& symbol = symbol_table[rel_symbol];
 			uintptr_t symbol_loc = memloc + symbol.st_value;
 			char* symbol_name = (char *)((uintptr_t) string_table + symbol.st_name);
 
-			//If this kind of relocation is a symbol, look it up
+			//If this kind of relocation is a symbol, look it up. Copy relocations must come from somewhere other than
+			//the executable, since the executable's definition is the destination of the copy.
 			if(rel_type == R_386_32 || rel_type == R_386_PC32 || rel_type == R_386_COPY || rel_type == R_386_GLOB_DAT || rel_type == R_386_JMP_SLOT) {
-				if(symbol_name) {
-					auto map_it = symbols.find(symbol_name);
-					if(map_it == symbols.end()) {
-						if(debug)
-							Log::warn("Symbol ", symbol_name, " not found for ", name);
-						symbol_loc = 0x0;
-					} else {
-						symbol_loc = map_it->second;
-					}
-				}
-			}
-
-			//If this is a global symbol, try finding it in the global symbol table
-			if(rel_type == R_386_GLOB_DAT) {
-				if(symbol_name) {
-					auto map_it = global_symbols.find(symbol_name);
-					if(map_it != symbols.end()) {
-						symbol_loc = map_it->second;
-					}
-				}
+				if(!rel_symbol)
+					symbol_loc = 0;
+				else if(rel_type == R_386_COPY)
+					symbol_loc = find_symbol(symbol_name, this);
+				else
+					symbol_loc = find_import(rel_symbol);
+				if(!symbol_loc && rel_symbol && debug)
+					Log::warn("Symbol ", symbol_name, " not found for ", name);
 			}
 
 			//Perform the actual relocation
-			auto* reloc_loc = (void*) (memloc + rel.r_offset);
 			switch(rel_type) {
 				case R_386_32:
 					symbol_loc += *((ssize_t*) reloc_loc);
@@ -472,7 +506,8 @@ int Object::relocate() {
 					break;
 
 				case R_386_COPY:
-					memcpy(reloc_loc, (const void*) symbol_loc, symbol.st_size);
+					if(symbol_loc)
+						memcpy(reloc_loc, (const void*) symbol_loc, symbol.st_size);
 					break;
 
 				case R_386_GLOB_DAT:
@@ -493,9 +528,202 @@ int Object::relocate() {
 		}
 	}
 
+	//PLT0 pushes GOT[1] and jumps to GOT[2], so that's where the object and the resolver go
+	if(lazy_plt) {
+		plt_got[1] = (uintptr_t) this;
+		plt_got[2] = (uintptr_t) resolve_plt_trampoline;
+	}
+
+	return 0;
+}
+
+const elf32_sym* Object::lookup_symbol(const char* symbol_name, uint32_t sysv_hash, uint32_t gnu_hash_value) const {
+	auto matches = [&](uint32_t index) {
+		auto& symbol = symbol_table[index];
+		return symbol.st_shndx != SHN_UNDEF && ELF32_ST_BIND(symbol.st_info) != STB_LOCAL && !strcmp(string_table + symbol.st_name, symbol_name);
+	};
+
+	if(gnu_hash) {
+		// Layout: nbuckets, symoffset, bloom_size, bloom_shift, bloom[bloom_size], buckets[nbuckets], chain[]
+		uint32_t num_buckets = gnu_hash[0];
+		uint32_t sym_offset = gnu_hash[1];
+		uint32_t bloom_size = gnu_hash[2];
+		uint32_t bloom_shift = gnu_hash[3];
+		const uint32_t* bloom = &gnu_hash[4];
+		const uint32_t* buckets = &bloom[bloom_size];
+		const uint32_t* chain = &buckets[num_buckets];
+
+		// The bloom filter rules out most objects that don't define the symbol without touching the symbol table
+		uint32_t bloom_word = bloom[(gnu_hash_value / 32) % bloom_size];
+		uint32_t bloom_mask = (1u << (gnu_hash_value % 32)) | (1u << ((gnu_hash_value >> bloom_shift) % 32));
+		if((bloom_word & bloom_mask) != bloom_mask)
+			return nullptr;
+
+		uint32_t index = buckets[gnu_hash_value % num_buckets];
+		if(index < sym_offset)
+			return nullptr;
+		for(;; index++) {
+			uint32_t chain_hash = chain[index - sym_offset];
+			if((chain_hash | 1) == (gnu_hash_value | 1) && matches(index))
+				return &symbol_table[index];
+			if(chain_hash & 1)
+				return nullptr;
+		}
+	}
+
+	if(hash) {
+		// Layout: nbucket, nchain, buckets[nbucket], chain[nchain]
+		uint32_t num_buckets = hash[0];
+		const uint32_t* buckets = &hash[2];
+		const uint32_t* chain = &buckets[num_buckets];
+		for(uint32_t index = buckets[sysv_hash % num_buckets]; index; index = chain[index]) {
+			if(matches(index))
+				return &symbol_table[index];
+		}
+	}
+
+	return nullptr;
+}
+
+uintptr_t Object::resolve_plt(size_t reloc_offset) {
+	auto& rel = *(elf32_rel*) ((uintptr_t) plt_relocations + reloc_offset);
+	uintptr_t symbol_loc = find_import(ELF32_R_SYM(rel.r_info));
+	if(!symbol_loc) {
+		Log::errf("ld: Couldn't resolve symbol {} for {}", string_table + symbol_table[ELF32_R_SYM(rel.r_info)].st_name, name);
+		exit(-1);
+	}
+	*((uintptr_t*) (memloc + rel.r_offset)) = symbol_loc;
+	return symbol_loc;
+}
+
+uintptr_t Object::find_import(uint32_t symbol_index) {
+	char* symbol_name = string_table + symbol_table[symbol_index].st_name;
+	if(!use_cached_resolutions || !cache_entry)
+		return find_symbol(symbol_name);
+
+	//Binary search for the resolution generated by ldconfig
+	auto* resolutions = (ld_cache_resolution*) ((uintptr_t) cache + cache->resolutions_offset) + cache_entry->first_resolution;
+	auto* resolution = std::lower_bound(resolutions, resolutions + cache_entry->num_resolutions, symbol_index,
+										[](const ld_cache_resolution& res, uint32_t index) { return res.symbol_index < index; });
+	if(resolution == resolutions + cache_entry->num_resolutions || resolution->symbol_index != symbol_index)
+		return find_symbol(symbol_name);
+
+	//Resolutions aren't checked when the cache is opened since there are so many of them, so check this one here
+	if(resolution->library >= cache->num_libraries)
+		return find_symbol(symbol_name);
+
+	//The cache only knows about libraries, so the executable could still be overriding the symbol
+	auto* defining_object = cache_objects[resolution->library];
+	uint32_t sysv_hash, gnu_hash;
+	hash_symbol(symbol_name, sysv_hash, gnu_hash);
+	if(!defining_object || executable->lookup_symbol(symbol_name, sysv_hash, gnu_hash))
+		return find_symbol(symbol_name);
+
+	num_cached_resolutions++;
+	return defining_object->memloc + resolution->value;
+}
+
+/** Called by resolve_plt_trampoline the first time a PLT slot is used. Returns the address to jump to. **/
+extern "C" uintptr_t resolve_plt_slot(Object* object, size_t reloc_offset) {
+	return object->resolve_plt(reloc_offset);
+}
+
+void hash_symbol(const char* symbol_name, uint32_t& sysv_hash, uint32_t& gnu_hash) {
+	sysv_hash = 0;
+	gnu_hash = 5381;
+	for(auto* c = (const uint8_t*) symbol_name; *c; c++) {
+		sysv_hash = (sysv_hash << 4) + *c;
+		uint32_t high = sysv_hash & 0xf0000000;
+		if(high)
+			sysv_hash ^= high >> 24;
+		sysv_hash &= ~high;
+		gnu_hash = gnu_hash * 33 + *c;
+	}
+}
+
+uintptr_t find_symbol(const char* symbol_name, const Object* skip) {
+	uint32_t sysv_hash, gnu_hash;
+	hash_symbol(symbol_name, sysv_hash, gnu_hash);
+
+	for(auto* object : symbol_scope) {
+		if(object == skip)
+			continue;
+		auto* symbol = object->lookup_symbol(symbol_name, sysv_hash, gnu_hash);
+		if(symbol)
+			return object->memloc + symbol->st_value;
+	}
+
 	return 0;
 }
 
+void open_cache() {
+	//The cache only describes the default search path
+	if(getenv("LD_LIBRARY_PATH") || getenv("LD_NO_CACHE"))
+		return;
+
+	int fd = open(LD_CACHE_PATH, O_RDONLY);
+	if(fd < 0)
+		return;
+	struct stat statbuf;
+	if(fstat(fd, &statbuf) < 0 || (size_t) statbuf.st_size < sizeof(ld_cache_header)) {
+		close(fd);
+		return;
+	}
+	auto* mapped = mmap(nullptr, statbuf.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if(mapped == MAP_FAILED)
+		return;
+
+	//Make sure the cache is one we understand and that its tables are inside of the file
+	auto* header = (ld_cache_header*) mapped;
+	size_t size = statbuf.st_size;
+	auto fits = [size](uint32_t offset, uint32_t count, size_t entry_size) {
+		return offset <= size && count <= (size - offset) / entry_size;
+	};
+	if(header->magic != LD_CACHE_MAGIC || header->version != LD_CACHE_VERSION ||
+	   !fits(header->libraries_offset, header->num_libraries, sizeof(ld_cache_library)) ||
+	   !fits(header->resolutions_offset, header->num_resolutions, sizeof(ld_cache_resolution)) ||
+	   !fits(header->strings_offset, header->strings_size, 1) || !header->strings_size ||
+	   ((char*) mapped)[header->strings_offset + header->strings_size - 1] != '\0') {
+		if(debug)
+			Log::warnf("ld: {} is invalid, ignoring it", LD_CACHE_PATH);
+		munmap(mapped, size);
+		return;
+	}
+	for(size_t i = 0; i < header->num_libraries; i++) {
+		auto& library = ((ld_cache_library*) ((uintptr_t) header + header->libraries_offset))[i];
+		if(library.name >= header->strings_size || library.path >= header->strings_size ||
+		   library.first_resolution > header->num_resolutions ||
+		   library.num_resolutions > header->num_resolutions - library.first_resolution) {
+			if(debug)
+				Log::warnf("ld: {} is invalid, ignoring it", LD_CACHE_PATH);
+			munmap(mapped, size);
+			return;
+		}
+	}
+
+	cache = header;
+	cache_objects.resize(cache->num_libraries);
+}
+
+ld_cache_library* cache_libraries() {
+	return (ld_cache_library*) ((uintptr_t) cache + cache->libraries_offset);
+}
+
+const char* cache_string(uint32_t offset) {
+	return (const char*) cache + cache->strings_offset + offset;
+}
+
+const ld_cache_library* find_cached_library(const char* library_name) {
+	if(!cache || strchr(library_name, '/'))
+		return nullptr;
+	for(size_t i = 0; i < cache->num_libraries; i++) {
+		if(!strcmp(cache_string(cache_libraries()[i].name), library_name))
+			return &cache_libraries()[i];
+	}
+	return nullptr;
+}
+
 std::string find_library(char* library_name) {
 	if(strchr(library_name, '/')) return library_name;
 
@@ -20,8 +20,9 @@
 #pragma once
 
 #include <vector>
-#include <unordered_map>
+#include <string>
 #include <kernel/api/page_size.h>
+#include "cache.h"
 
 #define ELF_MAGIC 0x464C457F //0x7F followed by 'ELF'
 
@@ -84,6 +85,7 @@
 #define DT_VALRNGLO		0x6ffffd00
 #define DT_VALRNGHI		0x6ffffdff
 #define DT_ADDRRNGLO	0x6ffffe00
+#define DT_GNU_HASH		0x6ffffef5
 #define DT_ADDRRNGHI	0x6ffffeff
 #define DT_VERSYM		0x6ffffff0
 #define DT_RELACOUNT	0x6ffffff9
@@ -123,6 +125,12 @@
 #define STT_COMMON  5
 #define STT_TLS     6
 
+#define STB_LOCAL   0
+#define STB_GLOBAL  1
+#define STB_WEAK    2
+
+#define SHN_UNDEF   0
+
 #define R_386_NONE		0
 #define R_386_32		1
 #define R_386_PC32		2
@@ -136,6 +144,7 @@
 
 #define ELF32_R_SYM(x) ((x) >> 8u)
 #define ELF32_R_TYPE(x) ((x) & 0xffu)
+#define ELF32_ST_BIND(x) ((x) >> 4u)
 
 typedef struct {
 	unsigned char	e_ident[16];
@@ -219,9 +228,10 @@ public:
 	void read_dynamic_table();
 	int load_sections();
 	void mprotect_sections();
-	int read_copy_relocations();
-	int read_symbols();
 	int relocate();
+	const elf32_sym* lookup_symbol(const char* symbol_name, uint32_t sysv_hash, uint32_t gnu_hash_value) const;
+	uintptr_t resolve_plt(size_t reloc_offset);
+	uintptr_t find_import(uint32_t symbol_index);
 
 	std::string name;
 	int fd = 0;
@@ -236,6 +246,12 @@ public:
 	elf32_sym* symbol_table = nullptr;
 	size_t symbol_table_size = 0;
 	uint32_t* hash = nullptr;
+	uint32_t* gnu_hash = nullptr;
+	uintptr_t* plt_got = nullptr;
+	elf32_rel* plt_relocations = nullptr;
+	size_t plt_relocations_size = 0;
+	bool plt_is_rel = false;
+	const ld_cache_library* cache_entry = nullptr;
 	void (**init_array)() = nullptr;
 	size_t init_array_size = 0;
 	void (*init_func)() = nullptr;
@@ -250,4 +266,10 @@ public:
 };
 
 std::string find_library(char* library_name);
+void hash_symbol(const char* symbol_name, uint32_t& sysv_hash, uint32_t& gnu_hash);
+uintptr_t find_symbol(const char* symbol_name, const Object* skip = nullptr);
+void open_cache();
+ld_cache_library* cache_libraries();
+const char* cache_string(uint32_t offset);
+const ld_cache_library* find_cached_library(const char* library_name);
 
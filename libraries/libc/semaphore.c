@@ -0,0 +1,61 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later */
+/* Copyright © 2016-2023 Byteduck */
+
+#include <semaphore.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <sys/futex.h>
+
+int sem_init(sem_t* sem, int pshared, unsigned int value) {
+	if(pshared) {
+		errno = ENOSYS;
+		return -1;
+	}
+	if(value > INT_MAX) {
+		errno = EINVAL;
+		return -1;
+	}
+	sem->value = (int) value;
+	sem->waiters = 0;
+	return 0;
+}
+
+int sem_destroy(sem_t* sem) {
+	(void) sem;
+	return 0;
+}
+
+int sem_trywait(sem_t* sem) {
+	int value = __atomic_load_n(&sem->value, __ATOMIC_RELAXED);
+	while(value > 0) {
+		if(__atomic_compare_exchange_n(&sem->value, &value, value - 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+			return 0;
+	}
+	errno = EAGAIN;
+	return -1;
+}
+
+int sem_wait(sem_t* sem) {
+	while(sem_trywait(sem)) {
+		// If sem_post() runs before we sleep, the value won't be zero anymore and futex_wait will return immediately
+		__atomic_add_fetch(&sem->waiters, 1, __ATOMIC_SEQ_CST);
+		int res = futex_wait(&sem->value, 0);
+		__atomic_sub_fetch(&sem->waiters, 1, __ATOMIC_SEQ_CST);
+		if(res && errno == EINTR)
+			return -1;
+	}
+	return 0;
+}
+
+int sem_post(sem_t* sem) {
+	__atomic_add_fetch(&sem->value, 1, __ATOMIC_SEQ_CST);
+	if(__atomic_load_n(&sem->waiters, __ATOMIC_SEQ_CST))
+		futex_wake(&sem->value, 1);
+	return 0;
+}
+
+int sem_getvalue(sem_t* sem, int* value) {
+	*value = __atomic_load_n(&sem->value, __ATOMIC_RELAXED);
+	return 0;
+}
@@ -0,0 +1,30 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later */
+/* Copyright © 2016-2023 Byteduck */
+
+#pragma once
+
+#include <sys/cdefs.h>
+
+__DECL_BEGIN
+
+/** A counting semaphore. Waiters sleep on the value with a futex while it's zero. **/
+typedef struct {
+	int value;
+	int waiters;
+} sem_t;
+
+/**
+ * Initializes a semaphore.
+ * @param sem The semaphore to initialize.
+ * @param pshared Must be zero; semaphores can't be shared between processes.
+ * @param value The initial value of the semaphore.
+ * @return 0 if successful, -1 if not.
+ */
+int sem_init(sem_t* sem, int pshared, unsigned int value);
+int sem_destroy(sem_t* sem);
+int sem_wait(sem_t* sem);
+int sem_trywait(sem_t* sem);
+int sem_post(sem_t* sem);
+int sem_getvalue(sem_t* sem, int* value);
+
+__DECL_END
@@ -0,0 +1,13 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later */
+/* Copyright © 2016-2023 Byteduck */
+
+#include <sys/futex.h>
+#include <sys/syscall.h>
+
+int futex_wait(int* futex, int val) {
+	return syscall4(SYS_FUTEX, (int) futex, FUTEX_WAIT, val);
+}
+
+int futex_wake(int* futex, int count) {
+	return syscall4(SYS_FUTEX, (int) futex, FUTEX_WAKE, count);
+}
@@ -0,0 +1,28 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later */
+/* Copyright © 2016-2023 Byteduck */
+
+#pragma once
+
+#include <sys/cdefs.h>
+#include <kernel/api/futex.h>
+
+__DECL_BEGIN
+
+/**
+ * Puts the calling thread to sleep until another thread calls futex_wake() on the same address, as long as the value
+ * at that address is still the expected value. Futexes are private to the calling process.
+ * @param futex The address to wait on.
+ * @param val The value the futex is expected to hold.
+ * @return 0 if woken, or -1 if not with errno set to EAGAIN if the value changed or EINTR if interrupted.
+ */
+int futex_wait(int* futex, int val);
+
+/**
+ * Wakes up threads waiting on the given address with futex_wait().
+ * @param futex The address to wake waiters on.
+ * @param count The maximum number of waiters to wake.
+ * @return The number of waiters woken, or -1 on error.
+ */
+int futex_wake(int* futex, int count);
+
+__DECL_END
@@ -0,0 +1,538 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later */
+/* Copyright © 2016-2023 Byteduck */
+
+#include "malloc.h"
+#include "mman.h"
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include <libduck/SpinLock.h>
+
+/*
+ * Small allocations are rounded up to a size class and carved out of spans of pages that only hold objects of that
+ * class. Spans belong to one of several arenas, each with its own lock. A thread starts at the arena picked by its
+ * stack address and moves on to the next one if that one is contended, so threads mostly don't share a lock.
+ *
+ * Bigger allocations are runs of pages from the page heap, which gets memory from the kernel a chunk at a time and
+ * only gives a chunk back once it is completely free and another free chunk is already being kept around. Anything
+ * too big for a chunk gets a mapping of its own.
+ */
+
+#define PAGE_SHIFT 12
+#define MALLOC_ALIGNMENT 16
+#define MAX_SMALL_SIZE 2048
+#define NUM_SIZE_CLASSES 24
+#define MIN_SMALL_SPAN_PAGES 2
+#define NUM_ARENAS 8
+#define ARENA_STACK_SHIFT 20 // Each thread has its own 1MiB stack
+#define CHUNK_PAGES 256
+#define MAX_LARGE_PAGES 64
+#define MAX_CACHED_CHUNKS 1
+#define META_BLOCK_SIZE (64 * 1024)
+#define PAGEMAP_LEAF_BITS 10
+#define PAGEMAP_ROOT_BITS (32 - PAGE_SHIFT - PAGEMAP_LEAF_BITS)
+
+static constexpr size_t class_sizes[NUM_SIZE_CLASSES] = {
+	16, 32, 48, 64, 80, 96, 112, 128,
+	160, 192, 224, 256, 320, 384, 448, 512,
+	640, 768, 896, 1024, 1280, 1536, 1792, 2048
+};
+
+struct SizeClassTable {
+	uint8_t classes[MAX_SMALL_SIZE / MALLOC_ALIGNMENT + 1];
+
+	constexpr SizeClassTable(): classes() {
+		uint8_t size_class = 0;
+		for(size_t i = 0; i <= MAX_SMALL_SIZE / MALLOC_ALIGNMENT; i++) {
+			while(class_sizes[size_class] < i * MALLOC_ALIGNMENT)
+				size_class++;
+			classes[i] = size_class;
+		}
+	}
+};
+
+static constexpr SizeClassTable size_class_table;
+
+struct Arena;
+struct Chunk;
+struct PageHeap;
+
+enum class SpanType : uint8_t {
+	Free, Small, Large, Huge
+};
+
+/** A run of pages. Depending on its type, it's either free, carved into small objects, or one big allocation. **/
+struct Span {
+	uintptr_t start;
+	size_t num_pages;
+	Span* prev;
+	Span* next;
+	Chunk* chunk; // The chunk this span is in, or null for huge allocations.
+	SpanType type;
+	uint8_t size_class;
+	uint16_t num_used;
+	uint16_t capacity;
+	Arena* arena;
+	void* free_list; // Objects that were freed back to the span.
+	uintptr_t bump; // The next object that has never been handed out.
+};
+
+/** A block of memory we got from the kernel, which can only be given back as a whole. **/
+struct Chunk {
+	uintptr_t start;
+	size_t used_pages;
+	PageHeap* heap;
+	Chunk* next_free;
+};
+
+/** Free runs of pages, by size. Runs bigger than MAX_LARGE_PAGES are in free_runs[0]. **/
+struct PageHeap {
+	Span* free_runs[MAX_LARGE_PAGES + 1] = {};
+	size_t num_empty_chunks = 0;
+};
+
+struct Arena {
+	Duck::SpinLock lock;
+	Span* bins[NUM_SIZE_CLASSES] = {}; // Spans with free objects for each size class.
+};
+
+// Everything below is protected by heap_lock, except for the pagemap, which may be read without it. Small spans come
+// from different chunks than large allocations, so that the small spans that stay around don't pin mostly free chunks.
+static Duck::SpinLock heap_lock;
+static PageHeap small_heap;
+static PageHeap large_heap;
+static Span** pagemap[1 << PAGEMAP_ROOT_BITS];
+static uint8_t* meta_next = nullptr;
+static size_t meta_left = 0;
+static Span* free_span_descriptors = nullptr;
+static Chunk* free_chunk_descriptors = nullptr;
+
+static Arena arenas[NUM_ARENAS];
+
+static inline size_t ceil_div(size_t a, size_t b) {
+	return (a + b - 1) / b;
+}
+
+/** Allocates metadata that is never freed (it's recycled instead). **/
+static void* meta_alloc(size_t size) {
+	size = ceil_div(size, MALLOC_ALIGNMENT) * MALLOC_ALIGNMENT;
+	if(meta_left < size) {
+		void* block = mmap(nullptr, META_BLOCK_SIZE, PROT_READ | PROT_WRITE, MAP_ANONYMOUS, 0, 0);
+		if(block == MAP_FAILED)
+			return nullptr;
+		meta_next = (uint8_t*) block;
+		meta_left = META_BLOCK_SIZE;
+	}
+	void* ret = meta_next;
+	meta_next += size;
+	meta_left -= size;
+	return ret;
+}
+
+static Span* alloc_span_descriptor() {
+	Span* span = free_span_descriptors;
+	if(span)
+		free_span_descriptors = span->next;
+	else
+		span = (Span*) meta_alloc(sizeof(Span));
+	if(span)
+		memset(span, 0, sizeof(Span));
+	return span;
+}
+
+static void free_span_descriptor(Span* span) {
+	span->next = free_span_descriptors;
+	free_span_descriptors = span;
+}
+
+static Chunk* alloc_chunk_descriptor() {
+	Chunk* chunk = free_chunk_descriptors;
+	if(chunk)
+		free_chunk_descriptors = chunk->next_free;
+	else
+		chunk = (Chunk*) meta_alloc(sizeof(Chunk));
+	return chunk;
+}
+
+static void free_chunk_descriptor(Chunk* chunk) {
+	chunk->next_free = free_chunk_descriptors;
+	free_chunk_descriptors = chunk;
+}
+
+/** Makes sure the pagemap has leaves for a range of pages so that setting their entries can't fail. **/
+static bool pagemap_reserve(uintptr_t start, size_t num_pages) {
+	size_t first_leaf = start >> (PAGE_SHIFT + PAGEMAP_LEAF_BITS);
+	size_t last_leaf = (start + (num_pages - 1) * PAGE_SIZE) >> (PAGE_SHIFT + PAGEMAP_LEAF_BITS);
+	for(size_t leaf = first_leaf; leaf <= last_leaf; leaf++) {
+		if(pagemap[leaf])
+			continue;
+		auto* new_leaf = (Span**) meta_alloc(sizeof(Span*) << PAGEMAP_LEAF_BITS);
+		if(!new_leaf)
+			return false;
+		memset(new_leaf, 0, sizeof(Span*) << PAGEMAP_LEAF_BITS);
+		pagemap[leaf] = new_leaf;
+	}
+	return true;
+}
+
+static inline void pagemap_set(uintptr_t addr, Span* span) {
+	pagemap[addr >> (PAGE_SHIFT + PAGEMAP_LEAF_BITS)][(addr >> PAGE_SHIFT) & ((1 << PAGEMAP_LEAF_BITS) - 1)] = span;
+}
+
+static inline Span* pagemap_get(uintptr_t addr) {
+	auto* leaf = pagemap[addr >> (PAGE_SHIFT + PAGEMAP_LEAF_BITS)];
+	return leaf ? leaf[(addr >> PAGE_SHIFT) & ((1 << PAGEMAP_LEAF_BITS) - 1)] : nullptr;
+}
+
+/** Free runs only need their ends mapped, since that's all that's looked at when coalescing. **/
+static void pagemap_set_ends(Span* span) {
+	pagemap_set(span->start, span);
+	pagemap_set(span->start + (span->num_pages - 1) * PAGE_SIZE, span);
+}
+
+static void pagemap_set_all(Span* span) {
+	for(size_t i = 0; i < span->num_pages; i++)
+		pagemap_set(span->start + i * PAGE_SIZE, span);
+}
+
+static inline Span*& free_list_for(PageHeap& heap, size_t num_pages) {
+	return heap.free_runs[num_pages <= MAX_LARGE_PAGES ? num_pages : 0];
+}
+
+static void list_push(Span*& head, Span* span) {
+	span->prev = nullptr;
+	span->next = head;
+	if(head)
+		head->prev = span;
+	head = span;
+}
+
+static void list_remove(Span*& head, Span* span) {
+	if(span->prev)
+		span->prev->next = span->next;
+	else
+		head = span->next;
+	if(span->next)
+		span->next->prev = span->prev;
+	span->prev = nullptr;
+	span->next = nullptr;
+}
+
+/** Gets a new chunk from the kernel, returning a free span covering all of it. **/
+static Span* heap_grow(PageHeap& heap) {
+	Span* span = alloc_span_descriptor();
+	Chunk* chunk = alloc_chunk_descriptor();
+	void* memory = MAP_FAILED;
+	if(span && chunk)
+		memory = mmap(nullptr, CHUNK_PAGES * PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_ANONYMOUS, 0, 0);
+	if(memory == MAP_FAILED || !pagemap_reserve((uintptr_t) memory, CHUNK_PAGES)) {
+		if(memory != MAP_FAILED)
+			munmap(memory, CHUNK_PAGES * PAGE_SIZE);
+		if(span)
+			free_span_descriptor(span);
+		if(chunk)
+			free_chunk_descriptor(chunk);
+		return nullptr;
+	}
+
+	chunk->start = (uintptr_t) memory;
+	chunk->used_pages = 0;
+	chunk->heap = &heap;
+	span->start = chunk->start;
+	span->num_pages = CHUNK_PAGES;
+	span->chunk = chunk;
+	span->type = SpanType::Free;
+	pagemap_set_ends(span);
+	heap.num_empty_chunks++;
+	return span;
+}
+
+/** Takes a run of pages out of the page heap. heap_lock must be held. **/
+static Span* heap_alloc_run(PageHeap& heap, size_t num_pages) {
+	// Get the descriptor for the leftover pages up front so we don't have to undo anything if it fails
+	Span* rest = alloc_span_descriptor();
+	if(!rest)
+		return nullptr;
+
+	Span* span = nullptr;
+	for(size_t i = num_pages; i <= MAX_LARGE_PAGES && !span; i++)
+		span = heap.free_runs[i];
+	for(Span* run = heap.free_runs[0]; run && !span; run = run->next) {
+		if(run->num_pages >= num_pages)
+			span = run;
+	}
+
+	if(span) {
+		list_remove(free_list_for(heap, span->num_pages), span);
+	} else if(!(span = heap_grow(heap))) {
+		free_span_descriptor(rest);
+		return nullptr;
+	}
+
+	Chunk* chunk = span->chunk;
+	if(!chunk->used_pages)
+		heap.num_empty_chunks--;
+	chunk->used_pages += num_pages;
+
+	if(span->num_pages > num_pages) {
+		rest->start = span->start + num_pages * PAGE_SIZE;
+		rest->num_pages = span->num_pages - num_pages;
+		rest->chunk = chunk;
+		rest->type = SpanType::Free;
+		pagemap_set_ends(rest);
+		list_push(free_list_for(heap, rest->num_pages), rest);
+		span->num_pages = num_pages;
+	} else {
+		free_span_descriptor(rest);
+	}
+
+	return span;
+}
+
+/** Gives a run of pages back to the page heap, merging it with its free neighbors. heap_lock must be held. **/
+static void heap_free_run(Span* span) {
+	Chunk* chunk = span->chunk;
+	PageHeap& heap = *chunk->heap;
+	uintptr_t chunk_end = chunk->start + CHUNK_PAGES * PAGE_SIZE;
+	chunk->used_pages -= span->num_pages;
+	span->type = SpanType::Free;
+	span->arena = nullptr;
+
+	if(span->start > chunk->start) {
+		Span* prev = pagemap_get(span->start - PAGE_SIZE);
+		if(prev && prev->type == SpanType::Free && prev->chunk == chunk) {
+			list_remove(free_list_for(heap, prev->num_pages), prev);
+			prev->num_pages += span->num_pages;
+			free_span_descriptor(span);
+			span = prev;
+		}
+	}
+
+	uintptr_t span_end = span->start + span->num_pages * PAGE_SIZE;
+	if(span_end < chunk_end) {
+		Span* next = pagemap_get(span_end);
+		if(next && next->type == SpanType::Free && next->chunk == chunk) {
+			list_remove(free_list_for(heap, next->num_pages), next);
+			span->num_pages += next->num_pages;
+			free_span_descriptor(next);
+		}
+	}
+
+	// Give the chunk back to the kernel if it's empty, unless it's the only empty one we have
+	if(!chunk->used_pages) {
+		if(heap.num_empty_chunks >= MAX_CACHED_CHUNKS) {
+			pagemap_set(span->start, nullptr);
+			pagemap_set(span->start + (span->num_pages - 1) * PAGE_SIZE, nullptr);
+			munmap((void*) chunk->start, CHUNK_PAGES * PAGE_SIZE);
+			free_span_descriptor(span);
+			free_chunk_descriptor(chunk);
+			return;
+		}
+		heap.num_empty_chunks++;
+	}
+
+	pagemap_set_ends(span);
+	list_push(free_list_for(heap, span->num_pages), span);
+}
+
+/** Locks and returns an arena for the calling thread to use. **/
+static Arena* lock_arena() {
+	size_t home = ((uintptr_t) __builtin_frame_address(0) >> ARENA_STACK_SHIFT) % NUM_ARENAS;
+	for(size_t i = 0; i < NUM_ARENAS; i++) {
+		auto& arena = arenas[(home + i) % NUM_ARENAS];
+		if(arena.lock.try_acquire())
+			return &arena;
+	}
+	arenas[home].lock.acquire();
+	return &arenas[home];
+}
+
+static void* alloc_small(size_t size) {
+	uint8_t size_class = size_class_table.classes[ceil_div(size, MALLOC_ALIGNMENT)];
+	size_t object_size = class_sizes[size_class];
+
+	Arena* arena = lock_arena();
+	Span* span = arena->bins[size_class];
+	if(!span) {
+		size_t num_pages = ceil_div(object_size * 8, PAGE_SIZE);
+		if(num_pages < MIN_SMALL_SPAN_PAGES)
+			num_pages = MIN_SMALL_SPAN_PAGES;
+
+		heap_lock.acquire();
+		span = heap_alloc_run(small_heap, num_pages);
+		if(span) {
+			span->type = SpanType::Small;
+			pagemap_set_all(span);
+		}
+		heap_lock.release();
+		if(!span) {
+			arena->lock.release();
+			errno = ENOMEM;
+			return nullptr;
+		}
+
+		span->size_class = size_class;
+		span->arena = arena;
+		span->num_used = 0;
+		span->capacity = (num_pages * PAGE_SIZE) / object_size;
+		span->free_list = nullptr;
+		span->bump = span->start;
+		list_push(arena->bins[size_class], span);
+	}
+
+	void* ptr = span->free_list;
+	if(ptr)
+		span->free_list = *(void**) ptr;
+	else {
+		ptr = (void*) span->bump;
+		span->bump += object_size;
+	}
+	if(++span->num_used == span->capacity)
+		list_remove(arena->bins[size_class], span);
+
+	arena->lock.release();
+	return ptr;
+}
+
+static void free_small(Span* span, void* ptr) {
+	Arena* arena = span->arena;
+	arena->lock.acquire();
+	auto& bin = arena->bins[span->size_class];
+
+	*(void**) ptr = span->free_list;
+	span->free_list = ptr;
+	if(span->num_used-- == span->capacity)
+		list_push(bin, span);
+
+	// Give empty spans back to the page heap, but keep one around so alternating malloc/free doesn't thrash
+	if(span->num_used || (bin == span && !span->next)) {
+		arena->lock.release();
+		return;
+	}
+	list_remove(bin, span);
+	arena->lock.release();
+
+	heap_lock.acquire();
+	heap_free_run(span);
+	heap_lock.release();
+}
+
+static void* alloc_large(size_t size) {
+	size_t num_pages = ceil_div(size, PAGE_SIZE);
+	LOCK(heap_lock);
+
+	if(num_pages <= MAX_LARGE_PAGES) {
+		Span* span = heap_alloc_run(large_heap, num_pages);
+		if(!span) {
+			errno = ENOMEM;
+			return nullptr;
+		}
+		span->type = SpanType::Large;
+		pagemap_set_all(span);
+		return (void*) span->start;
+	}
+
+	// Huge allocations get their own mapping. Only the first page is in the pagemap, since it's all free() needs.
+	Span* span = alloc_span_descriptor();
+	void* memory = MAP_FAILED;
+	if(span)
+		memory = mmap(nullptr, num_pages * PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_ANONYMOUS, 0, 0);
+	if(memory == MAP_FAILED || !pagemap_reserve((uintptr_t) memory, 1)) {
+		if(memory != MAP_FAILED)
+			munmap(memory, num_pages * PAGE_SIZE);
+		if(span)
+			free_span_descriptor(span);
+		errno = ENOMEM;
+		return nullptr;
+	}
+	span->start = (uintptr_t) memory;
+	span->num_pages = num_pages;
+	span->type = SpanType::Huge;
+	pagemap_set(span->start, span);
+	return memory;
+}
+
+void* malloc(size_t size) {
+	if(size <= MAX_SMALL_SIZE)
+		return alloc_small(size);
+	if(size > SIZE_MAX - PAGE_SIZE) {
+		errno = ENOMEM;
+		return nullptr;
+	}
+	return alloc_large(size);
+}
+
+void free(void* ptr) {
+	if(!ptr)
+		return;
+
+	Span* span = pagemap_get((uintptr_t) ptr);
+	if(!span)
+		return;
+
+	switch(span->type) {
+		case SpanType::Small:
+			free_small(span, ptr);
+			break;
+
+		case SpanType::Large: {
+			LOCK(heap_lock);
+			heap_free_run(span);
+			break;
+		}
+
+		case SpanType::Huge: {
+			LOCK(heap_lock);
+			pagemap_set(span->start, nullptr);
+			munmap((void*) span->start, span->num_pages * PAGE_SIZE);
+			free_span_descriptor(span);
+			break;
+		}
+
+		case SpanType::Free:
+			break;
+	}
+}
+
+size_t malloc_usable_size(void* ptr) {
+	if(!ptr)
+		return 0;
+	Span* span = pagemap_get((uintptr_t) ptr);
+	if(!span)
+		return 0;
+	if(span->type == SpanType::Small)
+		return class_sizes[span->size_class];
+	return span->num_pages * PAGE_SIZE;
+}
+
+void* calloc(size_t nobj, size_t size) {
+	if(size && nobj > SIZE_MAX / size) {
+		errno = ENOMEM;
+		return nullptr;
+	}
+	void* ptr = malloc(nobj * size);
+	if(ptr)
+		memset(ptr, 0, nobj * size);
+	return ptr;
+}
+
+void* realloc(void* ptr, size_t size) {
+	if(!ptr)
+		return malloc(size);
+	if(!size) {
+		free(ptr);
+		return nullptr;
+	}
+
+	// Keep the allocation if it's big enough and we wouldn't be wasting most of it
+	size_t old_size = malloc_usable_size(ptr);
+	if(size <= old_size && size >= old_size / 2)
+		return ptr;
+
+	void* new_ptr = malloc(size);
+	if(!new_ptr)
+		return nullptr;
+	memcpy(new_ptr, ptr, size < old_size ? size : old_size);
+	free(ptr);
+	return new_ptr;
+}
@@ -0,0 +1,23 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later */
+/* Copyright © 2016-2023 Byteduck */
+
+#pragma once
+
+#include <sys/cdefs.h>
+#include <stddef.h>
+
+__DECL_BEGIN
+
+void* malloc(size_t size);
+void* realloc(void* ptr, size_t size);
+void* calloc(size_t nobj, size_t size);
+void free(void* ptr);
+
+/**
+ * Gets the number of bytes that can actually be used in an allocation, which may be more than was asked for.
+ * @param ptr A pointer returned by malloc, calloc, or realloc.
+ * @return The usable size of the allocation, or 0 if ptr is null.
+ */
+size_t malloc_usable_size(void* ptr);
+
+__DECL_END
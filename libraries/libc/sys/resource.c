@@ -0,0 +1,17 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later */
+/* Copyright © 2016-2023 Byteduck */
+
+#include <sys/resource.h>
+#include <sys/syscall.h>
+
+int getpriority(int which, id_t who) {
+	int res = syscall3(SYS_GETPRIORITY, which, who);
+	if(res < 0)
+		return res;
+	// The kernel offsets the value so that it's never negative
+	return res + PRIO_MIN;
+}
+
+int setpriority(int which, id_t who, int prio) {
+	return syscall4(SYS_SETPRIORITY, which, who, prio);
+}
@@ -0,0 +1,32 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later */
+/* Copyright © 2016-2023 Byteduck */
+
+#pragma once
+
+#include <sys/cdefs.h>
+#include <sys/types.h>
+#include <kernel/api/resource.h>
+
+__DECL_BEGIN
+
+typedef int id_t;
+
+/**
+ * Gets the nice value of a process. Only PRIO_PROCESS is supported.
+ * @param which PRIO_PROCESS.
+ * @param who The pid of the process, or 0 for the calling process.
+ * @return The nice value of the process, or -1 with errno set on error. Since -1 is a valid nice value, errno should
+ * be cleared before calling this to tell the two apart.
+ */
+int getpriority(int which, id_t who);
+
+/**
+ * Sets the nice value of a process. Only root can lower a process's nice value or change another user's process.
+ * @param which PRIO_PROCESS.
+ * @param who The pid of the process, or 0 for the calling process.
+ * @param prio The new nice value, from PRIO_MIN to PRIO_MAX - 1. Lower values are scheduled more favorably.
+ * @return 0 if successful, -1 if not.
+ */
+int setpriority(int which, id_t who, int prio);
+
+__DECL_END
@@ -0,0 +1,127 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later */
+/* Copyright © 2016-2023 Byteduck */
+
+#include <threads.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <sys/futex.h>
+#include <sys/thread.h>
+
+// How many times to try taking a contended mutex before going to sleep
+#define MTX_SPIN_COUNT 100
+
+static bool mtx_try_acquire(mtx_t* mtx, int* state) {
+	*state = 0;
+	return __atomic_compare_exchange_n(&mtx->state, state, 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+}
+
+int mtx_init(mtx_t* mtx, int type) {
+	mtx->state = 0;
+	mtx->type = type;
+	mtx->owner = 0;
+	mtx->times_locked = 0;
+	return thrd_success;
+}
+
+int mtx_lock(mtx_t* mtx) {
+	tid_t tid = 0;
+	if(mtx->type & mtx_recursive) {
+		tid = gettid();
+		if(__atomic_load_n(&mtx->owner, __ATOMIC_RELAXED) == tid) {
+			mtx->times_locked++;
+			return thrd_success;
+		}
+	}
+
+	// Spin for a little while in case the holder is about to release the mutex
+	int state;
+	for(int i = 0; i < MTX_SPIN_COUNT; i++) {
+		if(mtx_try_acquire(mtx, &state))
+			goto acquired;
+		if(state == 2)
+			break;
+	}
+
+	// Mark the mutex as contended and sleep until we're the one to take it
+	if(state != 2)
+		state = __atomic_exchange_n(&mtx->state, 2, __ATOMIC_ACQUIRE);
+	while(state) {
+		futex_wait(&mtx->state, 2);
+		state = __atomic_exchange_n(&mtx->state, 2, __ATOMIC_ACQUIRE);
+	}
+
+acquired:
+	if(mtx->type & mtx_recursive) {
+		__atomic_store_n(&mtx->owner, tid, __ATOMIC_RELAXED);
+		mtx->times_locked = 1;
+	}
+	return thrd_success;
+}
+
+int mtx_trylock(mtx_t* mtx) {
+	tid_t tid = 0;
+	if(mtx->type & mtx_recursive) {
+		tid = gettid();
+		if(__atomic_load_n(&mtx->owner, __ATOMIC_RELAXED) == tid) {
+			mtx->times_locked++;
+			return thrd_success;
+		}
+	}
+
+	int state;
+	if(!mtx_try_acquire(mtx, &state))
+		return thrd_busy;
+
+	if(mtx->type & mtx_recursive) {
+		__atomic_store_n(&mtx->owner, tid, __ATOMIC_RELAXED);
+		mtx->times_locked = 1;
+	}
+	return thrd_success;
+}
+
+int mtx_unlock(mtx_t* mtx) {
+	if(mtx->type & mtx_recursive) {
+		if(--mtx->times_locked)
+			return thrd_success;
+		__atomic_store_n(&mtx->owner, 0, __ATOMIC_RELAXED);
+	}
+
+	// Only make a syscall if someone might be sleeping on the mutex
+	if(__atomic_exchange_n(&mtx->state, 0, __ATOMIC_RELEASE) == 2)
+		futex_wake(&mtx->state, 1);
+	return thrd_success;
+}
+
+void mtx_destroy(mtx_t* mtx) {
+	(void) mtx;
+}
+
+int cnd_init(cnd_t* cnd) {
+	cnd->seq = 0;
+	return thrd_success;
+}
+
+int cnd_wait(cnd_t* cnd, mtx_t* mtx) {
+	// If the condition is signaled after we unlock but before we sleep, the sequence will have changed and we won't sleep
+	int seq = __atomic_load_n(&cnd->seq, __ATOMIC_RELAXED);
+	mtx_unlock(mtx);
+	futex_wait(&cnd->seq, seq);
+	mtx_lock(mtx);
+	return thrd_success;
+}
+
+int cnd_signal(cnd_t* cnd) {
+	__atomic_add_fetch(&cnd->seq, 1, __ATOMIC_RELAXED);
+	futex_wake(&cnd->seq, 1);
+	return thrd_success;
+}
+
+int cnd_broadcast(cnd_t* cnd) {
+	__atomic_add_fetch(&cnd->seq, 1, __ATOMIC_RELAXED);
+	futex_wake(&cnd->seq, INT_MAX);
+	return thrd_success;
+}
+
+void cnd_destroy(cnd_t* cnd) {
+	(void) cnd;
+}
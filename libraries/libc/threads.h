@@ -20,7 +20,55 @@
 #ifndef DUCKOS_LIBC_THREADS_H
 #define DUCKOS_LIBC_THREADS_H
 
+#include <sys/cdefs.h>
+#include <sys/types.h>
+
+__DECL_BEGIN
+
 #define thread_local _Thread_local
-//TODO
+
+enum {
+	thrd_success = 0,
+	thrd_busy = 1,
+	thrd_error = 2,
+	thrd_nomem = 3,
+	thrd_timedout = 4
+};
+
+enum {
+	mtx_plain = 0x0,
+	mtx_recursive = 0x1,
+	mtx_timed = 0x2
+};
+
+/**
+ * A mutex that spins briefly and then sleeps on a futex until it is released. The state is 0 if unlocked, 1 if locked,
+ * and 2 if locked with (possibly) sleeping waiters, so that unlocking an uncontended mutex doesn't need a syscall.
+ */
+typedef struct {
+	int state;
+	int type;
+	tid_t owner;
+	unsigned int times_locked;
+} mtx_t;
+
+/** A condition variable. Waiters sleep on the sequence number, which is bumped each time the condition is signaled. **/
+typedef struct {
+	int seq;
+} cnd_t;
+
+int mtx_init(mtx_t* mtx, int type);
+int mtx_lock(mtx_t* mtx);
+int mtx_trylock(mtx_t* mtx);
+int mtx_unlock(mtx_t* mtx);
+void mtx_destroy(mtx_t* mtx);
+
+int cnd_init(cnd_t* cnd);
+int cnd_wait(cnd_t* cnd, mtx_t* mtx);
+int cnd_signal(cnd_t* cnd);
+int cnd_broadcast(cnd_t* cnd);
+void cnd_destroy(cnd_t* cnd);
+
+__DECL_END
 
 #endif //DUCKOS_LIBC_THREADS_H
@@ -21,6 +21,7 @@
 #include <assert.h>
 #include <unistd.h>
 #include <sys/ioctl.h>
+#include <sys/resource.h>
 #include <termios.h>
 #include <stdlib.h>
 #include <string.h>
@@ -219,6 +220,24 @@ int truncate(const char* path, off_t length) {
 	return syscall3(SYS_TRUNCATE, (int) path, (int) length);
 }
 
+void sync() {
+	syscall(SYS_SYNC);
+}
+
+int fsync(int fd) {
+	return syscall2(SYS_FSYNC, fd);
+}
+
+int nice(int inc) {
+	errno = 0;
+	int prio = getpriority(PRIO_PROCESS, 0);
+	if(prio == -1 && errno)
+		return -1;
+	if(setpriority(PRIO_PROCESS, 0, prio + inc) < 0)
+		return -1;
+	return getpriority(PRIO_PROCESS, 0);
+}
+
 int access(const char* path, int how) {
 	return syscall3(SYS_ACCESS, (int) path, (int) how);
 }
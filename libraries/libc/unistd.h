@@ -83,6 +83,9 @@ int symlink(const char* target, const char* linkname);
 int rmdir(const char* pathname);
 int chown(const char* pathname, uid_t uid, gid_t gid);
 int truncate(const char* path, off_t length);
+void sync();
+int fsync(int fd);
+int nice(int inc);
 int access(const char* path, int how);
 
 int dup(int fd);
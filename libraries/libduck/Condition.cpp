@@ -0,0 +1,26 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later */
+/* Copyright © 2016-2023 Byteduck */
+
+#include "Condition.h"
+#include <climits>
+#include <sys/futex.h>
+
+using namespace Duck;
+
+void Condition::wait(SpinLock& lock) {
+	// If we're signaled between releasing the lock and sleeping, the sequence will have changed and we won't sleep.
+	int seq = m_seq.load(std::memory_order_relaxed);
+	lock.release();
+	futex_wait((int*) &m_seq, seq);
+	lock.acquire();
+}
+
+void Condition::signal() {
+	m_seq.fetch_add(1, std::memory_order_relaxed);
+	futex_wake((int*) &m_seq, 1);
+}
+
+void Condition::broadcast() {
+	m_seq.fetch_add(1, std::memory_order_relaxed);
+	futex_wake((int*) &m_seq, INT_MAX);
+}
@@ -0,0 +1,33 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later */
+/* Copyright © 2016-2023 Byteduck */
+
+#pragma once
+
+#include "SpinLock.h"
+
+namespace Duck {
+	/** A condition variable that threads holding a SpinLock can sleep on until another thread signals it. **/
+	class Condition {
+	public:
+		Condition() = default;
+
+		/** Releases the lock, sleeps until the condition is signaled, and then re-acquires the lock. **/
+		void wait(SpinLock& lock);
+
+		/** Sleeps until the predicate is true, with the given lock held while it's checked. **/
+		template<typename F>
+		void wait(SpinLock& lock, F&& predicate) {
+			while(!predicate())
+				wait(lock);
+		}
+
+		/** Wakes one waiting thread. **/
+		void signal();
+
+		/** Wakes all waiting threads. **/
+		void broadcast();
+
+	private:
+		std::atomic<int> m_seq = {0};
+	};
+}
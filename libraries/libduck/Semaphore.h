@@ -0,0 +1,27 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later */
+/* Copyright © 2016-2023 Byteduck */
+
+#pragma once
+
+#include <semaphore.h>
+
+namespace Duck {
+	/** A counting semaphore. Threads waiting on it sleep until it's posted. **/
+	class Semaphore {
+	public:
+		explicit Semaphore(unsigned int value = 0) { sem_init(&m_sem, 0, value); }
+		~Semaphore() { sem_destroy(&m_sem); }
+		Semaphore(const Semaphore& other) = delete;
+		Semaphore& operator=(const Semaphore& other) = delete;
+
+		/** Decrements the semaphore, sleeping until it's positive if need be. **/
+		void wait() { while(sem_wait(&m_sem)); }
+		/** Decrements the semaphore if it's positive. Returns whether it was decremented. **/
+		bool try_wait() { return !sem_trywait(&m_sem); }
+		/** Increments the semaphore, waking up a waiter if there is one. **/
+		void post() { sem_post(&m_sem); }
+
+	private:
+		sem_t m_sem;
+	};
+}
@@ -18,14 +18,38 @@
 */
 
 #include "SpinLock.h"
-#include <sys/thread.h>
+#include <sys/futex.h>
+
+// How many times to try taking a contended lock before going to sleep
+#define SPINLOCK_SPIN_COUNT 100
 
 void Duck::SpinLock::acquire() {
-	while(times_locked.exchange(1, std::memory_order_acquire));
+	int cur_state = 0;
+	for(int i = 0; i < SPINLOCK_SPIN_COUNT; i++) {
+		cur_state = 0;
+		if(state.compare_exchange_weak(cur_state, 1, std::memory_order_acquire, std::memory_order_relaxed))
+			return;
+		if(cur_state == 2)
+			break;
+	}
+
+	// Mark the lock as contended and sleep until we're the one to take it
+	if(cur_state != 2)
+		cur_state = state.exchange(2, std::memory_order_acquire);
+	while(cur_state) {
+		futex_wait((int*) &state, 2);
+		cur_state = state.exchange(2, std::memory_order_acquire);
+	}
+}
+
+bool Duck::SpinLock::try_acquire() {
+	int cur_state = 0;
+	return state.compare_exchange_strong(cur_state, 1, std::memory_order_acquire, std::memory_order_relaxed);
 }
 
 void Duck::SpinLock::release() {
-	times_locked.store(0, std::memory_order_release);
+	if(state.exchange(0, std::memory_order_release) == 2)
+		futex_wake((int*) &state, 1);
 }
 
 Duck::ScopedLock::ScopedLock(Duck::SpinLock& lock): lock(lock) {
@@ -25,14 +25,19 @@
 #define LOCK(l) Duck::ScopedLock __lock(l);
 
 namespace Duck {
+	/**
+	 * A lock that spins for a short while when contended, and then sleeps on a futex until it is released.
+	 * Despite the name, a thread waiting on a SpinLock held for a long time doesn't burn CPU time.
+	 */
 	class SpinLock {
 	public:
 		SpinLock() = default;
 		void acquire();
+		bool try_acquire();
 		void release();
 
 	private:
-		std::atomic<int> times_locked = {0};
+		std::atomic<int> state = {0}; ///< 0 if unlocked, 1 if locked, 2 if locked and there may be sleeping waiters
 	};
 
 	class ScopedLock {
@@ -35,6 +35,7 @@ namespace Duck {
 		[[nodiscard]] int64_t epoch() const { return m_sec; }
 		[[nodiscard]] long interval_usec() const { return m_usec; }
 		[[nodiscard]] long millis() const { return ((long) m_sec * 1000) + (m_usec / 1000); }
+		[[nodiscard]] int64_t micros() const { return m_sec * 1000000 + m_usec; }
 
 		Time operator+(const Time& other) const;
 		Time operator-(const Time& other) const;
@@ -101,6 +101,8 @@ Result Process::update() {
 	_physical_mem = {std::stoul(proc["pmem"])};
 	_virtual_mem = {std::stoul(proc["vmem"])};
 	_shared_mem = {std::stoul(proc["shmem"])};
+	_nice = std::stoi(proc["nice"]);
+	_priority = std::stoi(proc["priority"]);
 
 	return Result::SUCCESS;
 }
@@ -49,6 +49,8 @@ namespace Sys {
 		Mem::Amount physical_mem() const { return _physical_mem; }
 		Mem::Amount virtual_mem() const { return _virtual_mem; }
 		Mem::Amount shared_mem() const { return _shared_mem; }
+		int nice() const { return _nice; }
+		int priority() const { return _priority; }
 
 		Duck::ResultRet<App::Info> app_info() const;
 
@@ -64,6 +66,8 @@ namespace Sys {
 		Mem::Amount _physical_mem;
 		Mem::Amount _virtual_mem;
 		Mem::Amount _shared_mem;
+		int _nice = 0;
+		int _priority = 0;
 	};
 }
 
@@ -0,0 +1,95 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later */
+/* Copyright © 2016-2023 Byteduck */
+
+// A program that measures how quickly files can be appended to, and how fragmented they end up on disk.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <libduck/Time.h>
+
+using Duck::Time;
+
+#define MAX_FILES 64
+
+size_t num_files = 4;
+size_t write_size = 1024;
+size_t file_size = 1024 * 1024;
+
+int main(int argc, char** argv) {
+	if(argc > 1)
+		num_files = strtoul(argv[1], nullptr, 10);
+	if(argc > 2)
+		write_size = strtoul(argv[2], nullptr, 10);
+	if(argc > 3)
+		file_size = strtoul(argv[3], nullptr, 10);
+	if(argc > 4 || !num_files || num_files > MAX_FILES || !write_size || file_size < write_size) {
+		fprintf(stderr, "Usage: appendbench [NUM_FILES] [WRITE_SIZE] [FILE_SIZE]\nAt most %d files can be written at once.\n", MAX_FILES);
+		return 1;
+	}
+
+	int fds[MAX_FILES];
+	char paths[MAX_FILES][64];
+	for(size_t i = 0; i < num_files; i++) {
+		snprintf(paths[i], sizeof(paths[i]), "appendbench-%d-%zu", getpid(), i);
+		fds[i] = open(paths[i], O_RDWR | O_CREAT | O_EXCL | O_APPEND, 0644);
+		if(fds[i] < 0) {
+			perror("appendbench: open");
+			return errno;
+		}
+	}
+
+	// Append to all of the files in turn, so that an allocator that doesn't plan ahead will interleave their blocks
+	auto* buf = (char*) malloc(file_size);
+	memset(buf, 'a', file_size);
+	size_t num_writes = file_size / write_size;
+	long max_latency_micros = 0;
+	auto start_time = Time::now();
+	for(size_t n = 0; n < num_writes; n++) {
+		for(size_t i = 0; i < num_files; i++) {
+			auto write_start = Time::now();
+			if(write(fds[i], buf, write_size) != (ssize_t) write_size) {
+				perror("appendbench: write");
+				return errno;
+			}
+			long latency_micros = (Time::now() - write_start).micros();
+			if(latency_micros > max_latency_micros)
+				max_latency_micros = latency_micros;
+		}
+	}
+	auto append_micros = (Time::now() - start_time).micros();
+
+	// Fragmented files can't be read in big contiguous runs, so read throughput shows how well the blocks were placed
+	start_time = Time::now();
+	for(size_t i = 0; i < num_files; i++) {
+		lseek(fds[i], 0, SEEK_SET);
+		size_t nread = 0;
+		while(nread < num_writes * write_size) {
+			ssize_t res = read(fds[i], buf, file_size);
+			if(res <= 0) {
+				perror("appendbench: read");
+				return errno;
+			}
+			nread += res;
+		}
+	}
+	auto read_millis = (Time::now() - start_time).millis();
+
+	for(size_t i = 0; i < num_files; i++) {
+		close(fds[i]);
+		unlink(paths[i]);
+	}
+	free(buf);
+
+	size_t total_writes = num_writes * num_files;
+	size_t total_kib = total_writes * write_size / 1024;
+	printf("%zu appends of %zu bytes to %zu files: %ld us average, %ld us max\n", total_writes, write_size, num_files, (long) (append_micros / total_writes), max_latency_micros);
+	printf("Read back %zu KiB in %ld ms", total_kib, read_millis);
+	if(read_millis)
+		printf(", %ld KiB/s", (long) ((uint64_t) total_kib * 1000 / read_millis));
+	printf("\n");
+	return 0;
+}
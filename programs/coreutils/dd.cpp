@@ -0,0 +1,120 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later */
+/* Copyright © 2016-2023 Byteduck */
+
+// A program that copies blocks from one file to another and reports the throughput, i.e. for measuring disk speed.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <libduck/Time.h>
+#include <libduck/DataSize.h>
+
+using Duck::Time, Duck::DataSize;
+
+size_t parse_size(const char* str) {
+	char* end;
+	size_t size = strtoul(str, &end, 10);
+	switch(*end) {
+		case 'k':
+		case 'K':
+			return size * 1024;
+		case 'm':
+		case 'M':
+			return size * 1024 * 1024;
+		default:
+			return size;
+	}
+}
+
+int main(int argc, char** argv) {
+	const char* in_path = nullptr;
+	const char* out_path = nullptr;
+	size_t block_size = 512;
+	size_t count = 0;
+	bool do_sync = false;
+
+	for(int i = 1; i < argc; i++) {
+		if(!strncmp(argv[i], "if=", 3)) {
+			in_path = argv[i] + 3;
+		} else if(!strncmp(argv[i], "of=", 3)) {
+			out_path = argv[i] + 3;
+		} else if(!strncmp(argv[i], "bs=", 3)) {
+			block_size = parse_size(argv[i] + 3);
+		} else if(!strncmp(argv[i], "count=", 6)) {
+			count = parse_size(argv[i] + 6);
+		} else if(!strcmp(argv[i], "conv=fsync")) {
+			do_sync = true;
+		} else {
+			fprintf(stderr, "dd: Unknown operand '%s'\nUsage: dd [if=FILE] [of=FILE] [bs=SIZE] [count=N] [conv=fsync]\n", argv[i]);
+			return 1;
+		}
+	}
+
+	if(!block_size) {
+		fprintf(stderr, "dd: Invalid block size\n");
+		return 1;
+	}
+
+	int in_fd = STDIN_FILENO;
+	if(in_path && (in_fd = open(in_path, O_RDONLY)) < 0) {
+		fprintf(stderr, "dd: Couldn't open '%s': %s\n", in_path, strerror(errno));
+		return errno;
+	}
+
+	int out_fd = STDOUT_FILENO;
+	if(out_path && (out_fd = open(out_path, O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0) {
+		fprintf(stderr, "dd: Couldn't open '%s': %s\n", out_path, strerror(errno));
+		return errno;
+	}
+
+	auto* buf = (uint8_t*) malloc(block_size);
+	if(!buf) {
+		fprintf(stderr, "dd: Couldn't allocate a buffer of %zu bytes\n", block_size);
+		return ENOMEM;
+	}
+
+	size_t full_blocks = 0, partial_blocks = 0, total_bytes = 0;
+	auto start_time = Time::now();
+	while(!count || full_blocks + partial_blocks < count) {
+		ssize_t nread = read(in_fd, buf, block_size);
+		if(nread < 0) {
+			perror("dd: read");
+			return errno;
+		}
+		if(!nread)
+			break;
+
+		ssize_t nwritten = 0;
+		while(nwritten < nread) {
+			ssize_t res = write(out_fd, buf + nwritten, nread - nwritten);
+			if(res < 0) {
+				perror("dd: write");
+				return errno;
+			}
+			nwritten += res;
+		}
+
+		total_bytes += nread;
+		if((size_t) nread == block_size)
+			full_blocks++;
+		else
+			partial_blocks++;
+	}
+
+	if(do_sync)
+		fsync(out_fd);
+	auto elapsed = Time::now() - start_time;
+
+	long millis = elapsed.millis();
+	fprintf(stderr, "%zu+%zu records\n", full_blocks, partial_blocks);
+	fprintf(stderr, "%zu bytes (%s) copied in %ld.%03lds", total_bytes, DataSize(total_bytes).readable().c_str(), millis / 1000, millis % 1000);
+	if(millis)
+		fprintf(stderr, ", %s/s", DataSize((size_t) ((uint64_t) total_bytes * 1000 / millis)).readable().c_str());
+	fprintf(stderr, "\n");
+
+	free(buf);
+	return 0;
+}
@@ -51,6 +51,7 @@ int main(int argc, char** argv, char** envp) {
 			printf("Kernel virtual: %s\n", info.kernel_virt.readable().c_str());
 			printf("Kernel heap: %s\n", info.kernel_heap.readable().c_str());
 			printf("Kernel disk cache: %s\n", info.kernel_disk_cache.readable().c_str());
+			printf("Kernel disk cache (dirty): %s\n", info.kernel_dirty_cache.readable().c_str());
 		}
 	} else {
 		printf("Total: %lu\n", info.usable.bytes);
@@ -62,6 +63,7 @@ int main(int argc, char** argv, char** envp) {
 			printf("Kernel virtual: %lu\n", info.kernel_virt.bytes);
 			printf("Kernel heap: %lu\n", info.kernel_heap.bytes);
 			printf("Kernel disk cache: %lu\n", info.kernel_disk_cache.bytes);
+			printf("Kernel disk cache (dirty): %lu\n", info.kernel_dirty_cache.bytes);
 		}
 	}
 
@@ -0,0 +1,252 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later */
+/* Copyright © 2016-2023 Byteduck */
+
+// A program that generates the dynamic linker's cache of library locations and symbol resolutions.
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <ld/ld.h>
+#include <map>
+#include <algorithm>
+
+struct Library {
+	std::string name;
+	std::string path;
+	struct stat st;
+	const elf32_sym* symbols = nullptr;
+	size_t num_symbols = 0;
+	const char* strings = nullptr;
+	size_t strings_size = 0;
+};
+
+// The same order that ld searches in when LD_LIBRARY_PATH isn't set
+const char* search_path[] = {"/lib", "/usr/lib"};
+bool verbose = false;
+
+std::vector<Library> libraries;
+std::map<std::string, size_t> library_indices;
+
+// Translates a virtual address in an object to a pointer into the mapped file, or nullptr if it isn't in the file.
+const uint8_t* vaddr_to_file(const uint8_t* file, size_t file_size, const std::vector<elf32_pheader>& pheaders, uint32_t vaddr) {
+	for(auto& pheader : pheaders) {
+		if(pheader.p_type != PT_LOAD || vaddr < pheader.p_vaddr || vaddr >= pheader.p_vaddr + pheader.p_filesz)
+			continue;
+		size_t offset = pheader.p_offset + (vaddr - pheader.p_vaddr);
+		return offset < file_size ? file + offset : nullptr;
+	}
+	return nullptr;
+}
+
+// Counts the symbols in a GNU hash table, which unlike a sysv hash table doesn't store the count.
+size_t count_gnu_symbols(const uint32_t* gnu_hash) {
+	uint32_t num_buckets = gnu_hash[0];
+	uint32_t sym_offset = gnu_hash[1];
+	const uint32_t* buckets = &gnu_hash[4 + gnu_hash[2]];
+	const uint32_t* chain = &buckets[num_buckets];
+
+	uint32_t last_symbol = 0;
+	for(uint32_t i = 0; i < num_buckets; i++)
+		last_symbol = std::max(last_symbol, buckets[i]);
+	if(last_symbol < sym_offset)
+		return sym_offset;
+	while(!(chain[last_symbol - sym_offset] & 1))
+		last_symbol++;
+	return last_symbol + 1;
+}
+
+// Reads the dynamic symbol table of a library. The file is left mapped, since the symbols are used until we exit.
+bool read_library(Library& library) {
+	int fd = open(library.path.c_str(), O_RDONLY);
+	if(fd < 0)
+		return false;
+	if(fstat(fd, &library.st) < 0 || (size_t) library.st.st_size < sizeof(elf32_ehdr)) {
+		close(fd);
+		return false;
+	}
+	size_t size = library.st.st_size;
+	auto* file = (const uint8_t*) mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if(file == MAP_FAILED)
+		return false;
+
+	auto* header = (const elf32_ehdr*) file;
+	if(*((uint32_t*) header->e_ident) != ELF_MAGIC || header->e_type != ELF_TYPE_SHARED ||
+	   header->e_phoff + (size_t) header->e_phnum * header->e_phentsize > size)
+		return false;
+
+	std::vector<elf32_pheader> pheaders(header->e_phnum);
+	const elf32_pheader* dynamic_header = nullptr;
+	for(size_t i = 0; i < pheaders.size(); i++) {
+		pheaders[i] = *((const elf32_pheader*) (file + header->e_phoff + i * header->e_phentsize));
+		if(pheaders[i].p_type == PT_DYNAMIC)
+			dynamic_header = &pheaders[i];
+	}
+	if(!dynamic_header || dynamic_header->p_offset + dynamic_header->p_filesz > size)
+		return false;
+
+	const uint32_t* hash = nullptr;
+	const uint32_t* gnu_hash = nullptr;
+	auto* dynamic_table = (const elf32_dynamic*) (file + dynamic_header->p_offset);
+	for(size_t i = 0; i < dynamic_header->p_filesz / sizeof(elf32_dynamic); i++) {
+		auto& dynamic = dynamic_table[i];
+		switch(dynamic.d_tag) {
+			case DT_HASH:
+				hash = (const uint32_t*) vaddr_to_file(file, size, pheaders, dynamic.d_val);
+				break;
+			case DT_GNU_HASH:
+				gnu_hash = (const uint32_t*) vaddr_to_file(file, size, pheaders, dynamic.d_val);
+				break;
+			case DT_SYMTAB:
+				library.symbols = (const elf32_sym*) vaddr_to_file(file, size, pheaders, dynamic.d_val);
+				break;
+			case DT_STRTAB:
+				library.strings = (const char*) vaddr_to_file(file, size, pheaders, dynamic.d_val);
+				break;
+			case DT_STRSZ:
+				library.strings_size = dynamic.d_val;
+				break;
+			default:
+				break;
+		}
+	}
+
+	if(!library.symbols || !library.strings || (!hash && !gnu_hash))
+		return false;
+	library.num_symbols = hash ? hash[1] : count_gnu_symbols(gnu_hash);
+	return true;
+}
+
+const char* symbol_name(const Library& library, const elf32_sym& symbol) {
+	return symbol.st_name < library.strings_size ? library.strings + symbol.st_name : "";
+}
+
+void find_libraries() {
+	for(auto* dir_path : search_path) {
+		DIR* dir = opendir(dir_path);
+		if(!dir)
+			continue;
+		while(auto* entry = readdir(dir)) {
+			if(!strstr(entry->d_name, ".so") || library_indices.count(entry->d_name))
+				continue;
+			Library library;
+			library.name = entry->d_name;
+			library.path = std::string(dir_path) + "/" + entry->d_name;
+			if(!read_library(library)) {
+				if(verbose)
+					printf("Skipping %s\n", library.path.c_str());
+				continue;
+			}
+			if(verbose)
+				printf("%s -> %s (%zu symbols)\n", library.name.c_str(), library.path.c_str(), library.num_symbols);
+			library_indices[library.name] = libraries.size();
+			libraries.push_back(std::move(library));
+		}
+		closedir(dir);
+	}
+}
+
+int main(int argc, char** argv) {
+	if(argc > 1 && !strcmp(argv[1], "-v")) {
+		verbose = true;
+	} else if(argc > 1) {
+		fprintf(stderr, "Usage: ldconfig [-v]\nRegenerates %s.\n", LD_CACHE_PATH);
+		return 1;
+	}
+
+	find_libraries();
+
+	// Find out which library defines each symbol. Symbols defined by more than one library can't be cached, since
+	// which definition wins depends on the order the libraries are loaded in.
+	std::map<std::string, std::pair<uint32_t, uint32_t>> definitions;
+	std::map<std::string, bool> conflicts;
+	for(size_t lib = 0; lib < libraries.size(); lib++) {
+		auto& library = libraries[lib];
+		for(size_t i = 1; i < library.num_symbols; i++) {
+			auto& symbol = library.symbols[i];
+			auto* name = symbol_name(library, symbol);
+			if(symbol.st_shndx == SHN_UNDEF || ELF32_ST_BIND(symbol.st_info) == STB_LOCAL || !*name)
+				continue;
+			if(definitions.count(name))
+				conflicts[name] = true;
+			else
+				definitions[name] = {lib, symbol.st_value};
+		}
+	}
+
+	std::vector<ld_cache_library> cache_libraries;
+	std::vector<ld_cache_resolution> resolutions;
+	std::string strings(1, '\0');
+	auto add_string = [&](const std::string& str) {
+		uint32_t offset = strings.size();
+		strings.append(str.c_str(), str.size() + 1);
+		return offset;
+	};
+
+	for(auto& library : libraries) {
+		ld_cache_library entry = {};
+		entry.name = add_string(library.name);
+		entry.path = add_string(library.path);
+		entry.inode = library.st.st_ino;
+		entry.size = library.st.st_size;
+		entry.mtime = library.st.st_mtime;
+		entry.first_resolution = resolutions.size();
+
+		// Symbols are visited in order, so each library's resolutions are sorted by symbol index
+		for(size_t i = 1; i < library.num_symbols; i++) {
+			auto& symbol = library.symbols[i];
+			auto* name = symbol_name(library, symbol);
+			if(symbol.st_shndx != SHN_UNDEF || !*name || conflicts.count(name))
+				continue;
+			auto def_it = definitions.find(name);
+			if(def_it != definitions.end())
+				resolutions.push_back({(uint32_t) i, def_it->second.first, def_it->second.second});
+		}
+
+		entry.num_resolutions = resolutions.size() - entry.first_resolution;
+		cache_libraries.push_back(entry);
+	}
+
+	ld_cache_header header = {};
+	header.magic = LD_CACHE_MAGIC;
+	header.version = LD_CACHE_VERSION;
+	header.num_libraries = cache_libraries.size();
+	header.libraries_offset = sizeof(header);
+	header.num_resolutions = resolutions.size();
+	header.resolutions_offset = header.libraries_offset + cache_libraries.size() * sizeof(ld_cache_library);
+	header.strings_size = strings.size();
+	header.strings_offset = header.resolutions_offset + resolutions.size() * sizeof(ld_cache_resolution);
+
+	// Write to a temporary file first so that ld never sees a partially written cache
+	auto tmp_path = std::string(LD_CACHE_PATH) + ".tmp";
+	FILE* file = fopen(tmp_path.c_str(), "w");
+	if(!file) {
+		fprintf(stderr, "ldconfig: Couldn't open %s: %s\n", tmp_path.c_str(), strerror(errno));
+		return errno;
+	}
+	bool success = fwrite(&header, sizeof(header), 1, file) == 1 &&
+			fwrite(cache_libraries.data(), sizeof(ld_cache_library), cache_libraries.size(), file) == cache_libraries.size() &&
+			fwrite(resolutions.data(), sizeof(ld_cache_resolution), resolutions.size(), file) == resolutions.size() &&
+			fwrite(strings.data(), 1, strings.size(), file) == strings.size();
+	success &= !fclose(file);
+
+	// rename() won't replace an existing file, so the old cache has to be removed first. ld just searches for libraries
+	// itself if it runs in between and doesn't find a cache.
+	if(success && unlink(LD_CACHE_PATH) < 0 && errno != ENOENT)
+		success = false;
+	if(!success || rename(tmp_path.c_str(), LD_CACHE_PATH) < 0) {
+		fprintf(stderr, "ldconfig: Couldn't write %s: %s\n", LD_CACHE_PATH, strerror(errno));
+		unlink(tmp_path.c_str());
+		return 1;
+	}
+
+	if(verbose)
+		printf("Cached %zu libraries and %zu symbol resolutions (%zu symbols defined more than once)\n",
+			   cache_libraries.size(), resolutions.size(), conflicts.size());
+	return 0;
+}
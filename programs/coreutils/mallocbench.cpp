@@ -0,0 +1,172 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later */
+/* Copyright © 2016-2023 Byteduck */
+
+// A program that measures malloc/free throughput under a few different allocation patterns.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <semaphore.h>
+#include <sys/thread.h>
+#include <libduck/Time.h>
+#include <string>
+#include <memory>
+#include <vector>
+
+using Duck::Time;
+
+#define MAX_LIVE_ALLOCATIONS 16
+#define CHURN_LIVE_ALLOCATIONS 1024
+#define BATCH_SIZE 64
+#define NUM_BATCHES 8
+
+size_t num_threads = 4;
+size_t num_iterations = 100000;
+
+unsigned int next_random(unsigned int& seed) {
+	seed = seed * 1103515245 + 12345;
+	return seed >> 16;
+}
+
+// Several threads each allocating and freeing small blocks, keeping a few alive at a time.
+void* contend_thread(void* arg) {
+	// Keep a few allocations alive at a time so that frees don't always hit the block that was just allocated
+	void* live[MAX_LIVE_ALLOCATIONS] = {nullptr};
+	auto seed = (unsigned int) (size_t) arg;
+	for(size_t i = 0; i < num_iterations; i++) {
+		auto& slot = live[i % MAX_LIVE_ALLOCATIONS];
+		free(slot);
+		slot = malloc(16 + next_random(seed) % 512);
+		if(!slot)
+			return (void*) 1;
+	}
+	for(auto& slot : live)
+		free(slot);
+	return nullptr;
+}
+
+// One thread replacing random blocks in a large working set, with the occasional big allocation mixed in.
+void* churn_thread(void*) {
+	auto** live = (void**) calloc(CHURN_LIVE_ALLOCATIONS, sizeof(void*));
+	unsigned int seed = 1;
+	for(size_t i = 0; i < num_iterations; i++) {
+		auto& slot = live[next_random(seed) % CHURN_LIVE_ALLOCATIONS];
+		free(slot);
+		size_t size = (next_random(seed) % 32) ? 8 + next_random(seed) % 1024 : 4096 + next_random(seed) % 65536;
+		slot = malloc(size);
+		if(!slot)
+			return (void*) 1;
+		memset(slot, 0, size < 64 ? size : 64);
+	}
+	for(size_t i = 0; i < CHURN_LIVE_ALLOCATIONS; i++)
+		free(live[i]);
+	free(live);
+	return nullptr;
+}
+
+// A producer thread allocating blocks that a consumer thread frees, so every free comes from another thread.
+void* batches[NUM_BATCHES][BATCH_SIZE];
+sem_t batches_empty;
+sem_t batches_full;
+
+void* producer_thread(void*) {
+	unsigned int seed = 1;
+	for(size_t batch = 0; batch < num_iterations / BATCH_SIZE; batch++) {
+		sem_wait(&batches_empty);
+		for(auto& ptr : batches[batch % NUM_BATCHES]) {
+			ptr = malloc(16 + next_random(seed) % 256);
+			if(!ptr)
+				return (void*) 1;
+		}
+		sem_post(&batches_full);
+	}
+	return nullptr;
+}
+
+void* consumer_thread(void*) {
+	for(size_t batch = 0; batch < num_iterations / BATCH_SIZE; batch++) {
+		sem_wait(&batches_full);
+		for(auto& ptr : batches[batch % NUM_BATCHES])
+			free(ptr);
+		sem_post(&batches_empty);
+	}
+	return nullptr;
+}
+
+// Lots of small, short-lived C++ objects, like a GUI program makes when laying out and drawing widgets.
+void* objects_thread(void*) {
+	for(size_t i = 0; i < num_iterations / 16; i++) {
+		std::vector<std::shared_ptr<std::string>> strings;
+		for(int j = 0; j < 16; j++)
+			strings.push_back(std::make_shared<std::string>("A string long enough to not fit in the SSO buffer " + std::to_string(j)));
+		std::string joined;
+		for(auto& string : strings)
+			joined += *string;
+	}
+	return nullptr;
+}
+
+// Runs threads with the given entry points and reports how long it took for them all to finish.
+bool run(const char* name, std::vector<void* (*)(void*)> entries, uint64_t num_ops) {
+	std::vector<tid_t> threads;
+	auto start_time = Time::now();
+	for(size_t i = 0; i < entries.size(); i++) {
+		tid_t tid = thread_create(entries[i], (void*) (i + 1));
+		if(tid < 0) {
+			perror("mallocbench: thread_create");
+			return false;
+		}
+		threads.push_back(tid);
+	}
+
+	bool failed = false;
+	for(auto tid : threads) {
+		void* ret;
+		thread_join(tid, &ret);
+		failed |= ret != nullptr;
+	}
+	long millis = (Time::now() - start_time).millis();
+
+	if(failed) {
+		fprintf(stderr, "mallocbench: Allocation failed in %s\n", name);
+		return false;
+	}
+
+	printf("%-9s %zu thread(s), %llu ops in %ld ms", name, entries.size(), num_ops, millis);
+	if(millis)
+		printf(", %llu ops/s", num_ops * 1000 / millis);
+	printf("\n");
+	return true;
+}
+
+int main(int argc, char** argv) {
+	const char* mode = "all";
+	int arg = 1;
+	if(argc > arg && (argv[arg][0] < '0' || argv[arg][0] > '9'))
+		mode = argv[arg++];
+	if(argc > arg)
+		num_threads = strtoul(argv[arg++], nullptr, 10);
+	if(argc > arg)
+		num_iterations = strtoul(argv[arg++], nullptr, 10);
+	bool all = !strcmp(mode, "all");
+	if(argc > arg || !num_threads || (!all && strcmp(mode, "contend") && strcmp(mode, "churn") &&
+	   strcmp(mode, "prodcons") && strcmp(mode, "objects"))) {
+		fprintf(stderr, "Usage: mallocbench [all|contend|churn|prodcons|objects] [THREADS] [ITERATIONS]\n");
+		return 1;
+	}
+
+	bool success = true;
+	if(all || !strcmp(mode, "contend"))
+		success &= run("contend", std::vector<void* (*)(void*)>(num_threads, contend_thread), (uint64_t) num_threads * num_iterations);
+	if(all || !strcmp(mode, "churn"))
+		success &= run("churn", {churn_thread}, num_iterations);
+	if(all || !strcmp(mode, "prodcons")) {
+		sem_init(&batches_empty, 0, NUM_BATCHES);
+		sem_init(&batches_full, 0, 0);
+		success &= run("prodcons", {producer_thread, consumer_thread}, (num_iterations / BATCH_SIZE) * BATCH_SIZE);
+	}
+	if(all || !strcmp(mode, "objects"))
+		success &= run("objects", std::vector<void* (*)(void*)>(num_threads, objects_thread), (uint64_t) num_threads * (num_iterations / 16) * 16);
+
+	return success ? 0 : 1;
+}
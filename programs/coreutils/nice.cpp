@@ -0,0 +1,42 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later */
+/* Copyright © 2016-2023 Byteduck */
+
+// A program that runs a command with a different nice value, or prints the current nice value.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+int main(int argc, char** argv) {
+	int adjustment = 10;
+	int arg = 1;
+	if(arg < argc && !strcmp(argv[arg], "-n")) {
+		if(arg + 1 >= argc) {
+			fprintf(stderr, "Usage: nice [-n ADJUSTMENT] [COMMAND [ARG]...]\n");
+			return 1;
+		}
+		adjustment = atoi(argv[arg + 1]);
+		arg += 2;
+	}
+
+	if(arg >= argc) {
+		errno = 0;
+		int cur = nice(0);
+		if(cur == -1 && errno) {
+			perror("nice");
+			return 1;
+		}
+		printf("%d\n", cur);
+		return 0;
+	}
+
+	errno = 0;
+	if(nice(adjustment) == -1 && errno)
+		perror("nice: Couldn't set niceness");
+
+	execvp(argv[arg], argv + arg);
+	fprintf(stderr, "nice: Couldn't run '%s': %s\n", argv[arg], strerror(errno));
+	return errno == ENOENT ? 127 : 126;
+}
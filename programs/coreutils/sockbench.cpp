@@ -0,0 +1,146 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later */
+/* Copyright © 2016-2023 Byteduck */
+
+// A program that measures SocketFS throughput and round-trip latency between two processes.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/socketfs.h>
+#include <libduck/Time.h>
+
+using Duck::Time;
+
+size_t packet_size = 64;
+size_t num_packets = 10000;
+size_t num_pings = 1000;
+
+// Waits for and reads exactly one packet with a payload of `length` bytes into `buf`.
+bool receive(int fd, uint8_t* buf, size_t length) {
+	size_t total = sizeof(SocketFSPacket) + length;
+	size_t nread = 0;
+	while(nread < total) {
+		pollfd pfd = {fd, POLLIN, 0};
+		if(poll(&pfd, 1, -1) < 0) {
+			perror("sockbench: poll");
+			return false;
+		}
+		ssize_t res = read(fd, buf + nread, total - nread);
+		if(res < 0) {
+			perror("sockbench: read");
+			return false;
+		}
+		nread += res;
+	}
+	return true;
+}
+
+// Sends a packet of `length` bytes to `recipient`, blocking while the recipient's queue is full.
+bool send(int fd, uint8_t* buf, sockid_t recipient, size_t length) {
+	auto* packet = (SocketFSPacket*) buf;
+	packet->type = SOCKETFS_TYPE_MSG;
+	packet->recipient = recipient;
+	packet->length = length;
+	packet->shm_id = 0;
+	packet->shm_perms = 0;
+	if(write(fd, buf, sizeof(SocketFSPacket) + length) < 0) {
+		perror("sockbench: write");
+		return false;
+	}
+	return true;
+}
+
+int client(const char* path) {
+	int fd = open(path, O_RDWR);
+	if(fd < 0) {
+		perror("sockbench: open");
+		return errno;
+	}
+
+	auto* buf = (uint8_t*) malloc(sizeof(SocketFSPacket) + packet_size);
+	memset(buf, 0, sizeof(SocketFSPacket) + packet_size);
+
+	for(size_t i = 0; i < num_packets; i++)
+		if(!send(fd, buf, SOCKETFS_RECIPIENT_HOST, packet_size))
+			return 1;
+
+	// Ping-pong with the host to measure round-trip latency
+	for(size_t i = 0; i < num_pings; i++) {
+		if(!send(fd, buf, SOCKETFS_RECIPIENT_HOST, packet_size) || !receive(fd, buf, packet_size))
+			return 1;
+	}
+
+	free(buf);
+	close(fd);
+	return 0;
+}
+
+int main(int argc, char** argv) {
+	if(argc > 1)
+		packet_size = strtoul(argv[1], nullptr, 10);
+	if(argc > 2)
+		num_packets = strtoul(argv[2], nullptr, 10);
+	if(argc > 3)
+		num_pings = strtoul(argv[3], nullptr, 10);
+	if(argc > 4 || sizeof(SocketFSPacket) + packet_size > SOCKETFS_MAX_BUFFER_SIZE) {
+		fprintf(stderr, "Usage: sockbench [PACKET_SIZE] [NUM_PACKETS] [NUM_PINGS]\nPackets can be at most %zu bytes.\n", SOCKETFS_MAX_BUFFER_SIZE - sizeof(SocketFSPacket));
+		return 1;
+	}
+
+	char path[64];
+	snprintf(path, sizeof(path), "/sock/sockbench-%d", getpid());
+	int fd = open(path, O_RDWR | O_CREAT | O_EXCL | O_NONBLOCK);
+	if(fd < 0) {
+		perror("sockbench: open");
+		return errno;
+	}
+
+	pid_t child = fork();
+	if(child < 0) {
+		perror("sockbench: fork");
+		return errno;
+	}
+	if(!child)
+		return client(path);
+
+	auto* buf = (uint8_t*) malloc(sizeof(SocketFSPacket) + packet_size);
+	if(!receive(fd, buf, 0))
+		return 1;
+	auto* packet = (SocketFSPacket*) buf;
+	if(packet->type != SOCKETFS_TYPE_MSG_CONNECT) {
+		fprintf(stderr, "sockbench: Expected a connect message\n");
+		return 1;
+	}
+	sockid_t client_id = packet->connected_id;
+
+	auto start_time = Time::now();
+	for(size_t i = 0; i < num_packets; i++)
+		if(!receive(fd, buf, packet_size))
+			return 1;
+	long throughput_millis = (Time::now() - start_time).millis();
+
+	start_time = Time::now();
+	for(size_t i = 0; i < num_pings; i++) {
+		if(!receive(fd, buf, packet_size) || !send(fd, buf, client_id, packet_size))
+			return 1;
+	}
+	auto latency_micros = (Time::now() - start_time).micros();
+
+	waitpid(child, nullptr, 0);
+
+	printf("%zu packets of %zu bytes in %ld ms", num_packets, packet_size, throughput_millis);
+	if(throughput_millis)
+		printf(", %ld packets/s", (long) ((uint64_t) num_packets * 1000 / throughput_millis));
+	printf("\n");
+	if(num_pings)
+		printf("%zu round trips, %ld us average\n", num_pings, (long) (latency_micros / num_pings));
+
+	free(buf);
+	close(fd);
+	return 0;
+}